@@ -709,11 +709,10 @@ INT APIENTRY OnCreate(const HWND hWnd, CREATESTRUCT* cs) {
 	/*    ----------------    END OF ENABLING DARK MODE   ----------------    */
 	
 	// Populate 'ddlGenre':
-	std::vector<_Genre> vecGenres = getGenreList();
-	std::string         genre     = "";
-	UINT                resAddStr = 0ui32;
-	for (_Genre& gnr_ : vecGenres) {
-		genre = gnr_._value;
+	std::string genre     = "";
+	UINT        resAddStr = 0ui32;
+	for (uint32_t id_ = 0; id_ < kGENRE_COUNT; ++id_) {
+		genre     = GetGenreName(id_);
 		resAddStr = AddString(ddl_Genre.m_Handle, std::ref(genre));
 	}
 
@@ -7,25 +7,28 @@
 
 
 /* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <filesystem>
+
 // PROJECT-SPECIFIC HEADERS:
 #include "TagsIO.hpp"
+#include "core/PaddingJob.hpp"
+#include "core/TagFields.hpp"
+#include "genres/GenreList.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
 
 
 /* **************************** CLASS DEFINITION **************************** */
+// NOTE: A 'TagsIO' built from a missing or non-MP3 file is left empty, and 
+//       'isValid()' returns 'false'; it is up to the caller to tell the user 
+//       (the GUI with a message box, the command-line tool on stderr).
 TagsIO::TagsIO(string& MP3Filename) noexcept : MP3Filename_(MP3Filename) {
 	// Verify that the file specified by 'MP3Filename' exists and is an MP3:
-	bool bIsMP3 = isValidMP3();
-	if (!bIsMP3) {
-		static string mb_title_ = "Error Encountered";
-		static string mb_body_{
-			fmt::format("The file \"{0}\" does not exist, or does does not "
-						"appear to be a valid MP3.", 
-						MP3Filename)
-		};
-		MessageBoxA(0, 
-					mb_body_.c_str(), 
-					mb_title_.c_str(), 
-					MB_OK|MB_ICONEXCLAMATION);
+	IsValid_ = isValidMP3();
+	if (!IsValid_) {
 		return;
 	}
 	
@@ -34,110 +37,62 @@ TagsIO::TagsIO(string& MP3Filename) noexcept : MP3Filename_(MP3Filename) {
 	if (Tag_ == nullptr) {
 		Tag_ = new_tag();
 	}
-	Frame temp;
-	/* Field: Title */
-	temp._frame         = tag_get_title(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	Title_              = temp._value;
-	mapFrames_["Title"] = temp;
-	
-	/* Field: Artist */
-	temp._frame         = tag_get_artist(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	Artist_             = temp._value;
-	mapFrames_["Artist"] = temp;
-	
-	/* Field: Album */
-	temp._frame         = tag_get_album(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	Album_              = temp._value;
-	mapFrames_["Album"] = temp;
-	
-	/* Field: Year */
-	temp._frame         = tag_get_year(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	Year_               = temp._value;
-	mapFrames_["Year"]  = temp;
 	
-	/* Field: Track */
-	temp._frame         = tag_get_track(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	Track_              = temp._value;
-	mapFrames_["Track"] = temp;
-	
-	/* Field: Comment */
-	temp._frame           = tag_get_comment(Tag_);
-	auto* comment__       = parse_comment_frame_content(temp._frame);
-	auto* comment__text_  = comment__->text;
-	temp._value           = comment__text_->data;
-	Comment_              = temp._value;
-	mapFrames_["Comment"] = temp;
-	
-	/* Field: AlbumArtist */
-	temp._frame         = tag_get_album_artist(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	AlbumArtist_        = temp._value;
-	mapFrames_["AlbumArtist"] = temp;
-	
-	/* Field: Genre */
-	temp._frame         = tag_get_genre(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	Genre_              = temp._value;
-	mapFrames_["Genre"] = temp;
-	
-	/* Field: Composer */
-	temp._frame         = tag_get_composer(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	Composer_           = temp._value;
-	mapFrames_["Composer"] = temp;
+	// Read each field; frames that the tag does not have read as "":
+	std::vector<string*> members_ = fieldMembers();
+	const char* keys_[] = {
+		"Title", "Artist", "Album", "AlbumArtist", "Genre", 
+		"Track", "Year", "Comment", "DiscNumber", "Composer"
+	};
+	const std::vector<TagField>& fields_ = GetTagFields();
+	for (size_t i = 0; i < fields_.size(); ++i) {
+		Frame temp;
+		temp._frame          = fields_[i].Get_(Tag_);
+		temp._value          = DecodeFrameText(temp._frame);
+		*members_[i]         = temp._value;
+		mapFrames_[keys_[i]] = temp;
+	}
 	
-	/* Field: DiscNumber */
-	temp._frame         = tag_get_disc_number(Tag_);
-	temp._text_content  = parse_text_frame_content(temp._frame);
-	temp._value         = temp._text_content->data;
-	DiscNumber_         = temp._value;
-	mapFrames_["DiscNumber"] = temp;
+	// Show (and save) "(17)" and the like as the genre's name:
+	NormalizeGenre(Genre_);
 }
 
 
 TagsIO::~TagsIO() noexcept {
+	if (!IsValid_ || (Tag_ == nullptr)) {
+		return;
+	}
+	
 	// Write the new tag values to the file:
-	tag_set_title(Title_.data(),              0, Tag_);
-	tag_set_artist(Artist_.data(),            0, Tag_);
-	tag_set_album(Album_.data(),              0, Tag_);
-	tag_set_album_artist(AlbumArtist_.data(), 0, Tag_);
-	tag_set_genre(Genre_.data(),              0, Tag_);
-	tag_set_track(Track_.data(),              0, Tag_);
-	tag_set_year(Year_.data(),                0, Tag_);
-	tag_set_comment(Comment_.data(),          0, Tag_);
-	tag_set_disc_number(DiscNumber_.data(),   0, Tag_);
-	tag_set_composer(Composer_.data(),        0, Tag_);
-	set_tag(MP3Filename_.data(), Tag_);
+	std::vector<string*> members_ = fieldMembers();
+	const std::vector<TagField>& fields_ = GetTagFields();
+	for (size_t i = 0; i < fields_.size(); ++i) {
+		SetTagFieldText(Tag_, fields_[i], *members_[i]);
+	}
+	set_tag_with_padding_policy(MP3Filename_.data(), Tag_, PaddingPolicy_);
+	free_tag(Tag_);
+}
+
+
+bool TagsIO::isValid() const noexcept {
+	return IsValid_;
+}
+
+
+// The public field members, in the same order as 'GetTagFields()':
+std::vector<string*> TagsIO::fieldMembers() {
+	return {
+		&Title_, &Artist_, &Album_, &AlbumArtist_, &Genre_, 
+		&Track_, &Year_, &Comment_, &DiscNumber_, &Composer_
+	};
 }
 
 
 bool TagsIO::isValidMP3() {
-	// Check if the file/path exists:
-	fs::path _path(MP3Filename_);
-	if (fs::exists(_path) == false) {
-		return false;
-	}
-	
-	// Check if the file extension is ".mp3"/".MP3":
-	string expected_ = ".mp3"s;
-	string actual_   = _path.extension().string();
-	actual_ = ConvertTextToLowerCase(std::ref(actual_));
-	bool bIsMatch = CompareStrings(std::ref(expected_), std::ref(actual_));
-	if (!bIsMatch) {
+	// Check that the file exists and has an ".mp3"/".MP3" extension:
+	std::error_code ec_;
+	if (!fs::is_regular_file(MP3Filename_, ec_)) {
 		return false;
 	}
-	return true;
+	return IsMP3Filename(MP3Filename_);
 }
@@ -11,8 +11,19 @@
 
 
 /* **************************** INCLUDED HEADERS **************************** */
-// PROJECT-SPECIFIC HEADERS:
-#include "StdAfx.hpp"
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <map>
+#include <string>
+#include <vector>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+using namespace std::string_literals; // Enable s-suffix for std::string litrl's
+using std::string;
 
 
 /* *************************** CUSTOM DATA TYPES **************************** */
@@ -29,7 +40,8 @@ using Frame = struct _Frame {
 class TagsIO {
 	
 	private:
-		ID3v2_tag*              Tag_;
+		ID3v2_tag*              Tag_     = nullptr;
+		bool                    IsValid_ = false;
 		std::map<string, Frame> mapFrames_;
 	
 	public:
@@ -44,13 +56,23 @@ class TagsIO {
 		string Genre_       = "Genre"s;
 		string Composer_    = "Composer"s;
 		string DiscNumber_  = "DiscNumber"s;
+		
+		// Padding used when the tag no longer fits in the space already 
+		// reserved in the file. Points at the library-wide policy by default, 
+		// which lives for the whole session, so that an adaptive policy learns 
+		// from every file saved (the GUI makes one 'TagsIO' per file). Must 
+		// outlive this object:
+		ID3v2_padding_policy* PaddingPolicy_ = get_default_padding_policy();
 	
 	public:
 		TagsIO() = delete;
 		TagsIO(string& MP3Filename) noexcept;
 		~TagsIO() noexcept;
+		
+		bool isValid() const noexcept;
 	
 	private:
-		bool isValidMP3();
+		std::vector<string*> fieldMembers();
+		bool                 isValidMP3();
 	
 };
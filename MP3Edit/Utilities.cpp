@@ -7,6 +7,7 @@
 
 /* **************************** INCLUDED HEADERS **************************** */
 #include "Utilities.hpp"
+#include "core/DirCrawler.hpp"
 #include <iostream>
 
 // THIRD-PARTY LIBRARY HEADERS:
@@ -321,17 +322,14 @@ auto CreateFolder(std::string& FolderName)->bool {
 
 
 // FUNCTION:    GetListOfFilesInFolder
-// DESCRIPTION: Iterates through the folder specified by 'path', and creates an 
-//              'std::vector' of the filenames of each directory entry.
+// DESCRIPTION: Returns the paths of all files below the folder 'Directory' 
+//              (sorted, each hard-linked file once). The folder is read with 
+//              'CrawlDirectory()', which walks subfolders in parallel.
 auto GetListOfFilesInFolder(std::string& Directory)->std::vector<std::string> {
-	std::vector<std::string> FileList;
-	if (!Directory.empty()) {
-		fs::path dir_(Directory);
-		for (auto& p : fs::recursive_directory_iterator(dir_)) {
-			FileList.push_back(p.path().string());
-		}
-	}
-	return FileList;
+	CrawlOptions options_;
+	options_.Extensions_.clear();
+	options_.SkipHidden_ = false;
+	return CrawlDirectoryPaths(Directory, options_);
 }
 
 
@@ -593,17 +591,15 @@ auto GetDayOfYear()->uint32_t {
 }
 
 
-// FUNCTION:    UInt32ToBytes
-// DESCRIPTION: Converts a 'uint32_t' to a vector of 'unsigned char'. This was 
-//              adapted from: https://stackoverflow.com/a/5585683
+// FUNCTION:    VariableToBytes
+// DESCRIPTION: Converts an integer to a vector of 'unsigned char', most 
+//              significant byte first (the byte order of ID3v2 tags).
 template <typename T>
 std::vector<unsigned char> VariableToBytes(T value) {
 	constexpr const size_t SizeInBytes = sizeof(T);
 	std::vector<unsigned char> arrayOfBytes(SizeInBytes);
-#pragma loop(hint_parallel(8))
 	for (size_t i = 0; i < SizeInBytes; ++i) {
-		//arrayOfBytes[SizeInBytes - i] = (value >> (i * 8));
-		arrayOfBytes.push_back((value >> (i * 8))); // FIXME: Is this correct???
+		arrayOfBytes[SizeInBytes - 1 - i] = static_cast<unsigned char>(value >> (i * 8));
 	}
 	return arrayOfBytes;
 }
@@ -0,0 +1,900 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      MP3EditCli.cpp
+// FILE PURPOSE:  Defines the entry point of 'mp3edit', the headless 
+//                command-line front end to the MP3Edit core.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "../core/DirCrawler.hpp"
+#include "../core/EditPlan.hpp"
+#include "../core/FileGlob.hpp"
+#include "../core/LibraryWatcher.hpp"
+#include "../core/TagFields.hpp"
+#include "../core/TagIndex.hpp"
+#include "../core/TagPipeline.hpp"
+#include "../core/TagQuery.hpp"
+#include "../core/TagStore.hpp"
+#include "../core/TagStream.hpp"
+#include "../core/TrigramIndex.hpp"
+#include "../core/WorkStealingPool.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const int kEXIT_OK      = 0;
+constexpr static const int kEXIT_FAILURE = 1; // At least one file failed
+constexpr static const int kEXIT_USAGE   = 2; // Bad command line
+
+
+/* ******************************* STRUCTURES ******************************* */
+using FieldValue = std::pair<const TagField*, std::string>;
+
+struct CliOptions {
+	std::string                  Command_;
+	size_t                       Threads_ = 0; // 0 = one per hardware thread
+	std::vector<const TagField*> Fields_;      // 'get -f'
+	std::vector<FieldValue>      Values_;      // 'set -s'
+	std::string                  IndexFile_;   // 'index/plan -o', 'search/select/apply -i'
+	std::string                  JournalFile_; // 'set/apply -J'
+	std::string                  CheckpointFile_; // 'set/apply -c'
+	size_t                       Limit_ = 20;  // 'search -n'
+	std::string                  Query_;       // 'search' words, 'select -q'
+	std::vector<std::string>     Files_;
+	std::vector<std::string>     Folders_;     // Folders given, for 'watch'
+	bool                         Stdin_ = false; // 'dump -'
+};
+
+
+/* **************************** STATIC VARIABLES **************************** */
+// Set by SIGINT/SIGTERM to end 'watch':
+static volatile std::sig_atomic_t s_StopRequested_ = 0;
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    PrintUsage
+// PURPOSE: Prints the command-line help to 'Out'.
+auto static PrintUsage(std::ostream& Out)->void {
+	Out << "usage: mp3edit [-j N] <command> [options] <file|folder|pattern>...\n"
+		   "\n"
+		   "commands:\n"
+		   "  get   [-f FIELD]...        print fields as FILE<TAB>FIELD<TAB>VALUE\n"
+		   "                             (all fields unless -f is given)\n"
+		   "  set   -s FIELD=VALUE...    set fields, creating the tag if needed\n"
+		   "        [-J JOURNAL]         save in durable groups through JOURNAL, and\n"
+		   "                             first finish a run it shows was interrupted\n"
+		   "        [-c CHECKPOINT]      save progress to CHECKPOINT every few seconds,\n"
+		   "                             and resume from it when run again\n"
+		   "  plan  -s FIELD=VALUE...    show how 'set' would save each file (in place,\n"
+		   "        [-o PLAN]            insert-range or rewrite) and the I/O it would\n"
+		   "                             cost, writing nothing; -o saves the plan\n"
+		   "  apply -i PLAN [-J JOURNAL] run a saved plan (files changed since fail);\n"
+		   "        [-c CHECKPOINT]      -J and -c work as for 'set'\n"
+		   "  strip                      remove the ID3v2 tag\n"
+		   "  dump                       print every frame in the tag ('-' reads\n"
+		   "                             it from standard input as it arrives)\n"
+		   "  index -o INDEX             create or refresh a library index, only\n"
+		   "                             re-reading files changed since the last run\n"
+		   "  search -i INDEX [-n N]     print the N (default 20) best matches for the\n"
+		   "                             given words in title/artist/album/comment\n"
+		   "  select -q QUERY [-i INDEX] print the files matching QUERY, from the index\n"
+		   "                             or else from the given files, e.g.\n"
+		   "                               -q 'artist:\"Miles Davis\" year:>=1959\n"
+		   "                                   -genre:Fusion has:cover'\n"
+		   "  watch                      follow the given folders and print the tags\n"
+		   "                             of files as they are added/changed/removed\n"
+		   "\n"
+		   "options:\n"
+		   "  -j N         run N files at a time (default: one per CPU)\n"
+		   "  -h, --help   show this help\n"
+		   "\n"
+		   "Patterns may use *, ?, [...] and ** (any number of directories).\n"
+		   "Folders are searched recursively for .mp3 files.\n"
+		   "\n"
+		   "fields:";
+	for (const TagField& field_ : GetTagFields()) {
+		Out << ' ' << field_.Name_;
+	}
+	Out << '\n';
+}
+
+
+// NAME:    UsageError
+// PURPOSE: Prints 'Message' and a hint to stderr, and returns 'kEXIT_USAGE'.
+auto static UsageError(const std::string& Message)->int {
+	std::cerr << "mp3edit: " << Message << "\n"
+			  << "Try 'mp3edit --help' for more information.\n";
+	return kEXIT_USAGE;
+}
+
+
+// NAME:    ParseCount
+// PURPOSE: Parses the argument to '-j' or '-n'. Returns 'false' if it is not a 
+//          positive number.
+auto static ParseCount(const char* Text, size_t& Out)->bool {
+	char*              end_   = nullptr;
+	unsigned long long value_ = std::strtoull(Text, &end_, 10);
+	if ((end_ == Text) || (*end_ != '\0') || (value_ == 0)) {
+		return false;
+	}
+	Out = static_cast<size_t>(value_);
+	return true;
+}
+
+
+// NAME:    ParseArgs
+// PURPOSE: Fills 'Opts' from the command line. Returns 'kEXIT_OK' on success, 
+//          or the exit code to stop with.
+auto static ParseArgs(int argc, char* argv[], CliOptions& Opts)->int {
+	std::vector<std::string> patterns_;
+	bool                     options_ = true;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg_ = argv[i];
+		
+		if (options_ && (arg_ == "--")) {
+			options_ = false;
+			continue;
+		}
+		if (options_ && ((arg_ == "-h") || (arg_ == "--help"))) {
+			PrintUsage(std::cout);
+			return -1;
+		}
+		if (options_ && (arg_.compare(0, 2, "-j") == 0)) {
+			const char* value_ = (arg_.length() > 2) 
+								 ? (argv[i] + 2) 
+								 : ((i + 1) < argc ? argv[++i] : "");
+			if (!ParseCount(value_, Opts.Threads_)) {
+				return UsageError("-j needs a positive number");
+			}
+			continue;
+		}
+		if (options_ && (arg_ == "-f")) {
+			if ((i + 1) >= argc) {
+				return UsageError("-f needs a field name");
+			}
+			const TagField* field_ = FindTagField(argv[++i]);
+			if (field_ == nullptr) {
+				return UsageError("unknown field '" + std::string(argv[i]) + "'");
+			}
+			Opts.Fields_.push_back(field_);
+			continue;
+		}
+		if (options_ && (arg_ == "-s")) {
+			if ((i + 1) >= argc) {
+				return UsageError("-s needs FIELD=VALUE");
+			}
+			const std::string pair_ = argv[++i];
+			const size_t      eq_   = pair_.find('=');
+			if (eq_ == std::string::npos) {
+				return UsageError("-s needs FIELD=VALUE, got '" + pair_ + "'");
+			}
+			const TagField* field_ = FindTagField(pair_.substr(0, eq_));
+			if (field_ == nullptr) {
+				return UsageError("unknown field '" + pair_.substr(0, eq_) + "'");
+			}
+			Opts.Values_.emplace_back(field_, pair_.substr(eq_ + 1));
+			continue;
+		}
+		if (options_ && (arg_ == "-o")) {
+			if ((i + 1) >= argc) {
+				return UsageError("-o needs a file name");
+			}
+			Opts.IndexFile_ = argv[++i];
+			continue;
+		}
+		if (options_ && (arg_ == "-J")) {
+			if ((i + 1) >= argc) {
+				return UsageError("-J needs a file name");
+			}
+			Opts.JournalFile_ = argv[++i];
+			continue;
+		}
+		if (options_ && (arg_ == "-c")) {
+			if ((i + 1) >= argc) {
+				return UsageError("-c needs a file name");
+			}
+			Opts.CheckpointFile_ = argv[++i];
+			continue;
+		}
+		if (options_ && (arg_ == "-i")) {
+			if ((i + 1) >= argc) {
+				return UsageError("-i needs a file name");
+			}
+			Opts.IndexFile_ = argv[++i];
+			continue;
+		}
+		if (options_ && (arg_ == "-q")) {
+			if ((i + 1) >= argc) {
+				return UsageError("-q needs a query");
+			}
+			Opts.Query_ = argv[++i];
+			continue;
+		}
+		if (options_ && (arg_ == "-n")) {
+			if (((i + 1) >= argc) || !ParseCount(argv[i + 1], Opts.Limit_)) {
+				return UsageError("-n needs a positive number");
+			}
+			++i;
+			continue;
+		}
+		if (options_ && (arg_.length() > 1) && (arg_[0] == '-')) {
+			return UsageError("unknown option '" + arg_ + "'");
+		}
+		
+		if (Opts.Command_.empty()) {
+			Opts.Command_ = arg_;
+			continue;
+		}
+		if (Opts.Command_ == "search") {
+			Opts.Query_ += (Opts.Query_.empty() ? "" : " ") + arg_;
+			continue;
+		}
+		if (arg_ == "-") {
+			Opts.Stdin_ = true;
+			continue;
+		}
+		patterns_.push_back(arg_);
+	}
+	
+	// Expand the patterns; folders are searched (recursively) for MP3s:
+	CrawlOptions crawl_;
+	crawl_.Threads_ = Opts.Threads_;
+	for (const std::string& pattern_ : patterns_) {
+		for (std::string& path_ : ExpandGlob(pattern_)) {
+			std::error_code ec_;
+			if (!fs::is_directory(path_, ec_)) {
+				Opts.Files_.push_back(std::move(path_));
+				continue;
+			}
+			Opts.Folders_.push_back(path_);
+			if (Opts.Command_ == "watch") {
+				continue; // Only the folders matter
+			}
+			std::vector<CrawlError> errors_;
+			for (std::string& file_ : CrawlDirectoryPaths(path_, crawl_, &errors_)) {
+				Opts.Files_.push_back(std::move(file_));
+			}
+			for (const CrawlError& error_ : errors_) {
+				std::cerr << "mp3edit: " << error_.Path_ << ": " 
+						  << std::strerror(error_.Error_) << " (skipped)\n";
+			}
+		}
+	}
+	
+	if (Opts.Command_.empty()) {
+		return UsageError("no command given");
+	}
+	if ((Opts.Command_ != "get") && (Opts.Command_ != "set") 
+		&& (Opts.Command_ != "strip") && (Opts.Command_ != "dump") 
+		&& (Opts.Command_ != "index") && (Opts.Command_ != "watch") 
+		&& (Opts.Command_ != "search") && (Opts.Command_ != "select") 
+		&& (Opts.Command_ != "plan") && (Opts.Command_ != "apply")) {
+		return UsageError("unknown command '" + Opts.Command_ + "'");
+	}
+	if (((Opts.Command_ == "set") || (Opts.Command_ == "plan")) && Opts.Values_.empty()) {
+		return UsageError(Opts.Command_ + " needs at least one -s FIELD=VALUE");
+	}
+	if (Opts.Command_ == "apply") {
+		if (Opts.IndexFile_.empty() || !Opts.Files_.empty()) {
+			return UsageError("apply needs -i PLAN (and no files)");
+		}
+		return kEXIT_OK;
+	}
+	if ((Opts.Command_ == "index") && Opts.IndexFile_.empty()) {
+		return UsageError("index needs -o INDEX");
+	}
+	if (Opts.Command_ == "search") {
+		if (Opts.IndexFile_.empty() || Opts.Query_.empty()) {
+			return UsageError("search needs -i INDEX and one or more words");
+		}
+		return kEXIT_OK;
+	}
+	if (Opts.Command_ == "select") {
+		if (Opts.Query_.empty()) {
+			return UsageError("select needs -q QUERY");
+		}
+		if (Opts.IndexFile_.empty() == Opts.Files_.empty()) {
+			return UsageError("select needs either -i INDEX or files (not both)");
+		}
+		return kEXIT_OK;
+	}
+	if (Opts.Stdin_) {
+		if ((Opts.Command_ != "dump") || !Opts.Files_.empty()) {
+			return UsageError("only dump reads standard input ('-'), and then "
+							  "no files");
+		}
+		return kEXIT_OK;
+	}
+	if (Opts.Command_ == "watch") {
+		if (!Opts.Files_.empty() || Opts.Folders_.empty()) {
+			return UsageError("watch needs one or more folders (and no files)");
+		}
+		return kEXIT_OK;
+	}
+	if (Opts.Files_.empty()) {
+		return UsageError("no files given (or no files match)");
+	}
+	return kEXIT_OK;
+}
+
+
+// NAME:    CheckFile
+// PURPOSE: Returns 'true' if 'Filename' is a regular file; otherwise, writes 
+//          an error message to 'Err' and returns 'false'.
+auto static CheckFile(const std::string& Filename, std::ostream& Err)->bool {
+	std::error_code ec_;
+	if (!fs::is_regular_file(Filename, ec_)) {
+		Err << "mp3edit: " << Filename << ": not a regular file\n";
+		return false;
+	}
+	return true;
+}
+
+
+// NAME:    RunGet
+// PURPOSE: Formats the requested fields of one file.
+auto static RunGet(const CliOptions& Opts, 
+				   const std::string& Filename, 
+				   std::ostream&      Out, 
+				   std::ostream&      Err)->bool {
+	if (!CheckFile(Filename, Err)) {
+		return false;
+	}
+	ID3v2_tag* tag_ = load_tag(Filename.c_str());
+	if (tag_ == nullptr) {
+		return true; // No tag: nothing to print, but not an error
+	}
+	
+	std::vector<const TagField*> fields_ = Opts.Fields_;
+	if (fields_.empty()) {
+		for (const TagField& field_ : GetTagFields()) {
+			fields_.push_back(&field_);
+		}
+	}
+	for (const TagField* field_ : fields_) {
+		// Print only frames that exist, unless the field was asked for:
+		ID3v2_frame* frame_ = field_->Get_(tag_);
+		if ((frame_ == nullptr) && Opts.Fields_.empty()) {
+			continue;
+		}
+		Out << Filename << '\t' << field_->Name_ << '\t'
+			<< DecodeFrameText(frame_) << '\n';
+	}
+	
+	free_tag(tag_);
+	return true;
+}
+
+
+// NAME:    RunDump
+// PURPOSE: Formats the header and every frame of one file's tag.
+auto static RunDump(const std::string& Filename, 
+					std::ostream&      Out, 
+					std::ostream&      Err)->bool {
+	if (!CheckFile(Filename, Err)) {
+		return false;
+	}
+	Out << Filename << '\n';
+	ID3v2_tag* tag_ = load_tag(Filename.c_str());
+	if (tag_ == nullptr) {
+		Out << "  (no ID3v2 tag)\n";
+		return true;
+	}
+	
+	const ID3v2_header* header_ = tag_->tag_header;
+	Out << "  ID3v2." << static_cast<int>(header_->major_version)
+		<< '.' << static_cast<int>(header_->minor_version)
+		<< ", " << header_->tag_size << " bytes"
+		<< " (" << tag_->used_size << " in frames, "
+		<< (header_->tag_size - tag_->used_size) << " padding)\n";
+	
+	for (ID3v2_frame_list* list_ = tag_->frames;
+		 list_ != nullptr;
+		 list_ = list_->next) {
+		const ID3v2_frame* frame_ = list_->frame;
+		if (frame_ == nullptr) {
+			continue;
+		}
+		Out << "  " << std::string(frame_->frame_id, ID3_FRAME_ID)
+			<< "  " << frame_->size << " bytes";
+		if ((frame_->frame_id[0] == 'T') 
+			|| (std::memcmp(frame_->frame_id, 
+							COMMENT_FRAME_ID, 
+							ID3_FRAME_ID) == 0)) {
+			Out << "  " << DecodeFrameText(frame_);
+		}
+		Out << '\n';
+	}
+	
+	free_tag(tag_);
+	return true;
+}
+
+
+// NAME:    PrintStreamHeader
+// PURPOSE: Formats the header of the tag 'Parser' is reading, once.
+auto static PrintStreamHeader(const TagStreamParser& Parser, bool& Printed)->void {
+	if (!Printed) {
+		std::cout << "  ID3v2." << static_cast<int>(Parser.version())
+				  << '.' << static_cast<int>(Parser.revision())
+				  << ", " << Parser.tagSize() << " bytes\n";
+		Printed = true;
+	}
+}
+
+
+// NAME:    RunDumpStdin
+// PURPOSE: Formats the tag at the start of standard input, frame by frame as 
+//          it arrives. Only frames of up to 'kSTREAM_MAX_BUFFERED' bytes are 
+//          held in memory, so pipes of any size work; reading stops where 
+//          the tag ends.
+auto static RunDumpStdin()->int {
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	bool            header_ = false;
+	TagStreamParser parser_([&](const TagStreamFrame& Frame) {
+		if (!Frame.Last_) {
+			return; // Pieces of a large frame: print it once, at the end
+		}
+		PrintStreamHeader(parser_, header_);
+		std::cout << "  " << Frame.Id_.data() << "  " << Frame.Size_ << " bytes";
+		if ((Frame.Offset_ == 0) 
+			&& ((Frame.Id_[0] == 'T') 
+				|| (std::memcmp(Frame.Id_.data(), 
+								COMMENT_FRAME_ID, 
+								ID3_FRAME_ID) == 0))) {
+			ID3v2_frame frame_ = {};
+			std::memcpy(frame_.frame_id, Frame.Id_.data(), ID3_FRAME_ID);
+			frame_.size = static_cast<int32_t>(Frame.Length_);
+			frame_.data = const_cast<char*>(Frame.Data_);
+			std::cout << "  " << DecodeFrameText(&frame_);
+		}
+		std::cout << '\n';
+	});
+	
+	std::cout << "-\n";
+	std::vector<char> buffer_(64 * 1024);
+	while (!parser_.done()) {
+		const size_t read_ = std::fread(buffer_.data(), 1, buffer_.size(), stdin);
+		if (read_ == 0) {
+			break;
+		}
+		parser_.push(buffer_.data(), read_);
+	}
+	if (!parser_.finish()) {
+		std::cout.flush();
+		std::cerr << "mp3edit: -: " << parser_.error() << '\n';
+		return kEXIT_FAILURE;
+	}
+	if (parser_.state() == TagStreamState::NoTag) {
+		std::cout << "  (no ID3v2 tag)\n";
+		return kEXIT_OK;
+	}
+	PrintStreamHeader(parser_, header_);
+	std::cout << "  (" << parser_.usedSize() << " in frames, "
+			  << (parser_.tagSize() - parser_.usedSize()) << " padding)\n";
+	return kEXIT_OK;
+}
+
+
+// NAME:    RunReadOnly
+// PURPOSE: Runs 'get' or 'dump' over all files in parallel, then prints the 
+//          results in the order the files were given.
+auto static RunReadOnly(const CliOptions& Opts)->int {
+	std::vector<std::string> out_(Opts.Files_.size());
+	std::vector<std::string> err_(Opts.Files_.size());
+	std::atomic<bool>        failed_{false};
+	
+	{
+		WorkStealingPool pool_(Opts.Threads_);
+		for (size_t i = 0; i < Opts.Files_.size(); ++i) {
+			pool_.submit([&, i]() {
+				std::ostringstream out__;
+				std::ostringstream err__;
+				bool ok_ = (Opts.Command_ == "get") 
+						   ? RunGet(Opts, Opts.Files_[i], out__, err__) 
+						   : RunDump(Opts.Files_[i], out__, err__);
+				if (!ok_) {
+					failed_ = true;
+				}
+				out_[i] = out__.str();
+				err_[i] = err__.str();
+			});
+		}
+		pool_.wait();
+	}
+	
+	for (size_t i = 0; i < Opts.Files_.size(); ++i) {
+		std::cerr << err_[i];
+		std::cout << out_[i];
+	}
+	return failed_ ? kEXIT_FAILURE : kEXIT_OK;
+}
+
+
+// NAME:    RunStrip
+// PURPOSE: Removes the ID3v2 tag from every file.
+auto static RunStrip(const CliOptions& Opts)->int {
+	std::atomic<bool> failed_{false};
+	std::atomic<size_t> stripped_{0};
+	
+	{
+		WorkStealingPool pool_(Opts.Threads_);
+		for (const std::string& file_ : Opts.Files_) {
+			pool_.submit([&]() {
+				std::ostringstream err__;
+				if (!CheckFile(file_, err__)) {
+					std::cerr << err__.str();
+					failed_ = true;
+					return;
+				}
+				if (remove_tag(file_.c_str())) {
+					++stripped_;
+				}
+			});
+		}
+		pool_.wait();
+	}
+	
+	std::cerr << "mp3edit: stripped " << stripped_.load() << " of "
+			  << Opts.Files_.size() << " file(s)\n";
+	return failed_ ? kEXIT_FAILURE : kEXIT_OK;
+}
+
+
+// NAME:    MakeSetTransform
+// PURPOSE: Returns the transform behind 'set', 'plan' and 'apply': it sets 
+//          'Values' (which must outlive it), and reports a change only if one 
+//          of them differed.
+auto static MakeSetTransform(const std::vector<FieldValue>& Values)->TagPipeline::Transform {
+	return [&Values](const std::string&, ID3v2_tag* Tag) {
+		bool changed_ = false;
+		for (const auto& [field_, value_] : Values) {
+			if (GetTagFieldText(Tag, *field_) != value_) {
+				SetTagFieldText(Tag, *field_, value_);
+				changed_ = true;
+			}
+		}
+		return changed_;
+	};
+}
+
+
+// NAME:    DescribeEdit
+// PURPOSE: Returns 'Values' as "FIELD\0VALUE\0" pairs, as saved in a plan and 
+//          as the job of a checkpoint.
+auto static DescribeEdit(const std::vector<FieldValue>& Values)->std::string {
+	std::string out_;
+	for (const auto& [field_, value_] : Values) {
+		out_.append(field_->Name_).append(1, '\0').append(value_).append(1, '\0');
+	}
+	return out_;
+}
+
+
+// NAME:    GetSaveOptions
+// PURPOSE: Fills 'Options' for the commands that save tags, which set 
+//          'Values'. With '-J', a run the journal shows was interrupted is 
+//          finished first; returns 'false' if that could not be done.
+auto static GetSaveOptions(const CliOptions&              Opts, 
+						   const std::vector<FieldValue>& Values, 
+						   PipelineOptions&               Options)->bool {
+	Options.ParseThreads_      = Opts.Threads_;
+	Options.CreateMissingTags_ = true;
+	Options.Journal_           = Opts.JournalFile_;
+	Options.Checkpoint_        = Opts.CheckpointFile_;
+	Options.CheckpointJob_     = DescribeEdit(Values);
+	if (Opts.JournalFile_.empty()) {
+		return true;
+	}
+	const RecoveryReport report_ = TagJournal::recover(Opts.JournalFile_);
+	if (report_.Found_) {
+		std::cerr << "mp3edit: " << Opts.JournalFile_ << ": finished an interrupted run ("
+				  << report_.Replayed_ << " replayed, " << report_.Intact_ 
+				  << " already saved, " << report_.Failed_ << " failed)\n";
+	}
+	if (report_.Failed_ > 0) {
+		std::cerr << "mp3edit: " << Opts.JournalFile_ 
+				  << ": some files changed since; journal kept\n";
+		return false;
+	}
+	return true;
+}
+
+
+// NAME:    ReportSaves
+// PURPOSE: Prints the outcome of 'set' or 'apply', and returns the exit code.
+auto static ReportSaves(const BatchResult& Result)->int {
+	for (const std::string& file_ : Result.FailedFiles_) {
+		std::cerr << "mp3edit: " << file_ << ": could not update tag\n";
+	}
+	std::cerr << "mp3edit: updated " << Result.FilesModified_ << ", unchanged "
+			  << Result.FilesUnchanged_ << ", failed " << Result.FilesFailed_;
+	if (Result.FilesResumed_ > 0) {
+		std::cerr << ", done before " << Result.FilesResumed_;
+	}
+	std::cerr << '\n';
+	return (Result.FilesFailed_ > 0) ? kEXIT_FAILURE : kEXIT_OK;
+}
+
+
+// NAME:    RunSet
+// PURPOSE: Sets the requested fields in every file through 'TagPipeline', 
+//          with '-j' threads for the parse stage. Files that already hold the 
+//          requested values are not rewritten.
+auto static RunSet(const CliOptions& Opts)->int {
+	PipelineOptions options_;
+	if (!GetSaveOptions(Opts, Opts.Values_, options_)) {
+		return kEXIT_FAILURE;
+	}
+	TagPipeline pipeline_(options_);
+	return ReportSaves(pipeline_.run(Opts.Files_, MakeSetTransform(Opts.Values_)));
+}
+
+
+// NAME:    RunPlan
+// PURPOSE: Prints, for every file, how 'set' would save it: 
+//          "ACTION<TAB>OLD TAG<TAB>NEW TAG<TAB>BYTES WRITTEN<TAB>FILE", then 
+//          the totals, writing nothing to the files. '-o' saves the plan, with 
+//          the '-s' values, for 'apply'.
+auto static RunPlan(const CliOptions& Opts)->int {
+	PipelineOptions options_;
+	options_.ParseThreads_      = Opts.Threads_;
+	options_.CreateMissingTags_ = true;
+	EditPlan plan_ = PlanEdit(Opts.Files_, MakeSetTransform(Opts.Values_), options_);
+	plan_.Edit_ = DescribeEdit(Opts.Values_);
+	
+	std::ostringstream out_;
+	for (const PlanEntry& entry_ : plan_.Entries_) {
+		out_ << GetPlanActionName(entry_.Action_) << '\t' << entry_.OldTagSize_ << '\t' 
+			 << entry_.NewTagSize_ << '\t' << entry_.BytesWritten_ << '\t' 
+			 << entry_.Path_ << '\n';
+	}
+	std::cout << out_.str() << std::flush;
+	const PlanSummary sum_ = SummarizePlan(plan_);
+	std::cerr << std::fixed << std::setprecision(2) 
+			  << "mp3edit: plan: in place " << sum_.FilesInPlace_ << ", insert-range " 
+			  << sum_.FilesInsertRange_ << ", rewrite " << sum_.FilesRewrite_ 
+			  << ", unchanged " << sum_.FilesUnchanged_ << ", failed " 
+			  << sum_.FilesFailed_ << "; " << (sum_.BytesRead_ / 1.0e9) 
+			  << " GB read, " << (sum_.BytesWritten_ / 1.0e9) << " GB written, about " 
+			  << sum_.Seconds_ << " s\n";
+	
+	if (!Opts.IndexFile_.empty() && !SaveEditPlan(Opts.IndexFile_, plan_)) {
+		std::cerr << "mp3edit: " << Opts.IndexFile_ << ": could not write plan\n";
+		return kEXIT_FAILURE;
+	}
+	return (sum_.FilesFailed_ > 0) ? kEXIT_FAILURE : kEXIT_OK;
+}
+
+
+// NAME:    RunApply
+// PURPOSE: Runs the plan named by '-i', with the '-s' values saved in it.
+auto static RunApply(const CliOptions& Opts)->int {
+	EditPlan                plan_;
+	std::vector<FieldValue> values_;
+	bool                    ok_ = LoadEditPlan(Opts.IndexFile_, plan_);
+	for (size_t at_ = 0; ok_ && (at_ < plan_.Edit_.size()); ) {
+		const size_t    name_  = plan_.Edit_.find('\0', at_);
+		const size_t    value_ = (name_ != std::string::npos) 
+								 ? plan_.Edit_.find('\0', name_ + 1) : name_;
+		const TagField* field_ = (value_ != std::string::npos) 
+								 ? FindTagField(plan_.Edit_.substr(at_, name_ - at_)) 
+								 : nullptr;
+		ok_ = (field_ != nullptr);
+		if (ok_) {
+			values_.emplace_back(field_, plan_.Edit_.substr(name_ + 1, value_ - name_ - 1));
+			at_ = value_ + 1;
+		}
+	}
+	if (!ok_ || values_.empty()) {
+		std::cerr << "mp3edit: " << Opts.IndexFile_ << ": not a plan from 'mp3edit plan'\n";
+		return kEXIT_FAILURE;
+	}
+	
+	PipelineOptions options_;
+	if (!GetSaveOptions(Opts, values_, options_)) {
+		return kEXIT_FAILURE;
+	}
+	return ReportSaves(RunEditPlan(plan_, MakeSetTransform(values_), options_));
+}
+
+
+// NAME:    RunIndex
+// PURPOSE: Brings the index named by '-o' up to date with the given files.
+auto static RunIndex(const CliOptions& Opts)->int {
+	IndexUpdateReport report_ = UpdateTagIndex(Opts.IndexFile_, Opts.Files_, 
+											   Opts.Threads_);
+	if (!report_.Written_) {
+		std::cerr << "mp3edit: " << Opts.IndexFile_ << ": could not write index\n";
+		return kEXIT_FAILURE;
+	}
+	std::cerr << "mp3edit: indexed " << report_.FilesTotal_ << " (re-read " 
+			  << report_.FilesParsed_ << ", unchanged " << report_.FilesReused_ 
+			  << ", removed " << report_.FilesRemoved_ << ", failed " 
+			  << report_.FilesFailed_ << ")\n";
+	return (report_.FilesFailed_ > 0) ? kEXIT_FAILURE : kEXIT_OK;
+}
+
+
+// NAME:    RunSearch
+// PURPOSE: Loads the index named by '-i' and prints the best matches for the 
+//          query, one "SCORE<TAB>FILE" line each.
+auto static RunSearch(const CliOptions& Opts)->int {
+	TagIndex index_;
+	if (!index_.open(Opts.IndexFile_)) {
+		std::cerr << "mp3edit: " << Opts.IndexFile_ << ": cannot read index\n";
+		return kEXIT_FAILURE;
+	}
+	TrigramIndex search_;
+	search_.load(index_);
+	std::ostringstream out_;
+	for (const SearchHit& hit_ : search_.search(Opts.Query_, Opts.Limit_)) {
+		out_ << hit_.Score_ << '\t' << hit_.Path_ << '\n';
+	}
+	std::cout << out_.str();
+	return kEXIT_OK;
+}
+
+
+// NAME:    RunSelect
+// PURPOSE: Prints the files matching the '-q' query, one per line. Files read 
+//          directly (without '-i') only have the fields it names decoded.
+auto static RunSelect(const CliOptions& Opts)->int {
+	TagQuery query_;
+	if (!query_.compile(Opts.Query_)) {
+		return UsageError("bad query: " + query_.error());
+	}
+	TagStore store_;
+	TagIndex index_;
+	if (!Opts.IndexFile_.empty()) {
+		if (!index_.open(Opts.IndexFile_)) {
+			std::cerr << "mp3edit: " << Opts.IndexFile_ << ": cannot read index\n";
+			return kEXIT_FAILURE;
+		}
+		store_.load(index_);
+	} else {
+		std::vector<IndexEntry> entries_ = ReadTagEntries(Opts.Files_, 
+														  query_.fieldMask(), 
+														  Opts.Threads_);
+		store_.reserve(entries_.size());
+		for (const IndexEntry& entry_ : entries_) {
+			store_.add(entry_);
+		}
+	}
+	std::ostringstream out_;
+	for (RowId row_ : query_.select(store_)) {
+		out_ << store_.path(row_) << '\n';
+	}
+	std::cout << out_.str();
+	return kEXIT_OK;
+}
+
+
+// NAME:    OnStopSignal
+// PURPOSE: Handles SIGINT/SIGTERM during 'watch'.
+extern "C" void OnStopSignal(int) {
+	s_StopRequested_ = 1;
+}
+
+
+// NAME:    RunWatch
+// PURPOSE: Follows the given folders until interrupted, printing one line per 
+//          change: "added|modified<TAB>FILE<TAB>FIELD<TAB>VALUE" for each 
+//          non-empty field (or just "KIND<TAB>FILE" for an untagged file), and 
+//          "removed<TAB>FILE".
+auto static RunWatch(const CliOptions& Opts)->int {
+	const std::vector<TagField>& fields_ = GetTagFields();
+	LibraryWatcher               watcher_;
+	bool started_ = watcher_.start(
+		Opts.Folders_, 
+		[&fields_](const std::vector<TagChange>& Changes) {
+			std::ostringstream out_;
+			for (const TagChange& change_ : Changes) {
+				const char* kind_ = (change_.Kind_ == TagChangeKind::Added) 
+									? "added" 
+									: (change_.Kind_ == TagChangeKind::Modified) 
+									  ? "modified" : "removed";
+				bool printed_ = false;
+				for (size_t f = 0; f < fields_.size(); ++f) {
+					const std::string& value_ = change_.Entry_.Fields_[f];
+					if (!value_.empty()) {
+						out_ << kind_ << '\t' << change_.Entry_.Path_ << '\t' 
+							 << fields_[f].Name_ << '\t' << value_ << '\n';
+						printed_ = true;
+					}
+				}
+				if (!printed_) {
+					out_ << kind_ << '\t' << change_.Entry_.Path_ << '\n';
+				}
+			}
+			std::cout << out_.str() << std::flush;
+		});
+	if (!started_) {
+		std::cerr << "mp3edit: cannot watch these folders on this system\n";
+		return kEXIT_FAILURE;
+	}
+	
+	std::signal(SIGINT, OnStopSignal);
+	std::signal(SIGTERM, OnStopSignal);
+	while (!s_StopRequested_) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	watcher_.stop();
+	return kEXIT_OK;
+}
+
+
+/* ****************************** ENTRY POINT ******************************* */
+int main(int argc, char* argv[]) {
+	CliOptions opts_;
+	int        status_ = ParseArgs(argc, argv, opts_);
+	if (status_ < 0) {
+		return kEXIT_OK; // '--help'
+	}
+	if (status_ != kEXIT_OK) {
+		return status_;
+	}
+	
+	if (opts_.Command_ == "set") {
+		return RunSet(opts_);
+	}
+	if (opts_.Command_ == "plan") {
+		return RunPlan(opts_);
+	}
+	if (opts_.Command_ == "apply") {
+		return RunApply(opts_);
+	}
+	if (opts_.Command_ == "watch") {
+		return RunWatch(opts_);
+	}
+	if (opts_.Command_ == "index") {
+		return RunIndex(opts_);
+	}
+	if (opts_.Command_ == "search") {
+		return RunSearch(opts_);
+	}
+	if (opts_.Command_ == "select") {
+		return RunSelect(opts_);
+	}
+	if (opts_.Command_ == "strip") {
+		return RunStrip(opts_);
+	}
+	if (opts_.Stdin_) {
+		return RunDumpStdin();
+	}
+	return RunReadOnly(opts_);
+}
@@ -0,0 +1,1106 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      AsyncTagIO.cpp
+// FILE PURPOSE:  Defines the class 'AsyncTagIO', and a minimal io_uring 
+//                wrapper ('IoUring') built on the raw system calls.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <filesystem>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cerrno>
+#include <cstring>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+// 'IORING_OP_OPENAT' and 'IORING_OP_CLOSE' arrived with this flag (5.6):
+#if defined(__linux__) && defined(IORING_FEAT_RW_CUR_POS)
+#define MP3EDIT_IO_URING 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib/codec.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "AsyncTagIO.hpp"
+#include "WorkStealingPool.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// Steps of a file's chain of operations:
+constexpr static const int kSTEP_IDLE  = -1;
+constexpr static const int kSTEP_OPEN  = 0;
+constexpr static const int kSTEP_READ  = 1;
+constexpr static const int kSTEP_WRITE = 2;
+constexpr static const int kSTEP_SYNC  = 3;
+constexpr static const int kSTEP_CLOSE = 4;
+
+constexpr static const uint8_t kFLAG_FOOTER = 0x10;
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    AsBytes
+// PURPOSE: Views tag bytes as the unsigned bytes 'codec.h' works on.
+auto static AsBytes(char* Data)->uint8_t* {
+	return reinterpret_cast<uint8_t*>(Data);
+}
+
+
+// NAME:    TagBytesNeeded
+// PURPOSE: Returns the size of the tag at the start of 'Data', header 
+//          included, or 0 if there is no ID3v2.3/2.4 tag that 
+//          'load_tag_with_buffer()' can parse.
+auto static TagBytesNeeded(const char* Data, size_t Length)->size_t {
+	if ((Length < ID3_HEADER) || (std::memcmp(Data, "ID3", 3) != 0) 
+		|| ((Data[3] != 3) && (Data[3] != 4))) {
+		return 0;
+	}
+	const uint32_t raw_ = id3_read_be32(reinterpret_cast<const uint8_t*>(Data + 6));
+	if (!id3_syncsafe_valid(raw_)) {
+		return 0;
+	}
+	return ID3_HEADER + id3_syncsafe_decode(raw_);
+}
+
+
+// NAME:    ParseTag
+// PURPOSE: Parses the first 'Length' bytes of 'Buffer', which hold a whole tag.
+auto static ParseTag(std::vector<char>& Buffer, size_t Length)->ID3v2_tag* {
+	return load_tag_with_buffer(Buffer.data(), static_cast<int32_t>(Length));
+}
+
+
+#if !defined(_WIN32)
+// NAME:    ReadAt
+// PURPOSE: Reads up to 'Length' bytes at 'Offset', stopping early only at the 
+//          end of the file. Returns the bytes read, or -1 (see 'errno').
+auto static ReadAt(int Fd, char* Data, size_t Length, uint64_t Offset)->ssize_t {
+	size_t done_ = 0;
+	while (done_ < Length) {
+		const ssize_t got_ = ::pread(Fd, Data + done_, Length - done_, 
+									 static_cast<off_t>(Offset + done_));
+		if (got_ < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (got_ == 0) {
+			break;
+		}
+		done_ += static_cast<size_t>(got_);
+	}
+	return static_cast<ssize_t>(done_);
+}
+
+
+// NAME:    WriteAt
+// PURPOSE: Writes all 'Length' bytes at 'Offset'.
+auto static WriteAt(int Fd, const char* Data, size_t Length, uint64_t Offset)->bool {
+	size_t done_ = 0;
+	while (done_ < Length) {
+		const ssize_t put_ = ::pwrite(Fd, Data + done_, Length - done_, 
+									  static_cast<off_t>(Offset + done_));
+		if (put_ < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		done_ += static_cast<size_t>(put_);
+	}
+	return true;
+}
+#endif
+
+
+// NAME:    LoadFileSync
+// PURPOSE: Loads the tag of 'Path' with blocking calls, as the io_uring chain
+//          does: one read of 'ReadAhead' bytes, and a second if the tag is 
+//          larger. Returns an 'errno' value, or 0.
+auto static LoadFileSync(const std::string& Path, 
+						 size_t             ReadAhead, 
+						 ID3v2_tag*&        Tag, 
+						 uint64_t&          Read)->int {
+	Tag = nullptr;
+#if defined(_WIN32)
+	std::error_code ec_;
+	if (!fs::is_regular_file(Path, ec_)) {
+		return ENOENT;
+	}
+	Tag = load_tag(Path.c_str());
+	return 0;
+#else
+	const int fd_ = ::open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		return errno;
+	}
+	int               error_  = 0;
+	std::vector<char> buffer_(ReadAhead);
+	ssize_t           got_    = ReadAt(fd_, buffer_.data(), ReadAhead, 0);
+	if (got_ < 0) {
+		error_ = errno;
+	} else {
+		const size_t want_ = TagBytesNeeded(buffer_.data(), static_cast<size_t>(got_));
+		if ((want_ > static_cast<size_t>(got_)) && (static_cast<size_t>(got_) == ReadAhead)) {
+			buffer_.resize(want_);
+			const ssize_t more_ = ReadAt(fd_, buffer_.data() + got_, want_ - got_, got_);
+			if (more_ < 0) {
+				error_ = errno;
+			} else {
+				got_ += more_;
+			}
+		}
+		Read += static_cast<uint64_t>(std::max<ssize_t>(got_, 0));
+		if ((error_ == 0) && (want_ != 0) && (static_cast<size_t>(got_) >= want_)) {
+			Tag = ParseTag(buffer_, want_);
+		}
+	}
+	::close(fd_);
+	return error_;
+#endif
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+#if defined(MP3EDIT_IO_URING)
+// Just what 'AsyncTagIO' needs from io_uring: one ring, with the submission 
+// and completion queues mapped into this process. Only one thread may use it.
+class IoUring {
+
+	private:
+		int           Fd_       = -1;
+		unsigned      Entries_  = 0;
+		void*         SqRing_   = MAP_FAILED;
+		size_t        SqSize_   = 0;
+		void*         CqRing_   = MAP_FAILED;
+		size_t        CqSize_   = 0;
+		io_uring_sqe* Sqes_     = nullptr;
+		size_t        SqesSize_ = 0;
+		unsigned*     SqHead_   = nullptr;
+		unsigned*     SqTail_   = nullptr;
+		unsigned*     SqArray_  = nullptr;
+		unsigned      SqMask_   = 0;
+		unsigned*     CqHead_   = nullptr;
+		unsigned*     CqTail_   = nullptr;
+		unsigned      CqMask_   = 0;
+		io_uring_cqe* Cqes_     = nullptr;
+		unsigned      Pending_  = 0;       // Queued but not yet submitted
+		unsigned      InFlight_ = 0;       // Submitted, completion not yet reaped
+	
+	public:
+		explicit IoUring(unsigned Entries);
+		~IoUring() noexcept;
+		
+		IoUring(const IoUring&)            = delete;
+		IoUring& operator=(const IoUring&) = delete;
+		
+		bool          ok() const noexcept;
+		unsigned      entries() const noexcept;
+		io_uring_sqe* next() noexcept;
+		int           submit(unsigned WaitFor) noexcept;
+		
+		// Calls 'Fn(UserData, Result)' for every completion that has arrived:
+		template <typename Fn>
+		void reap(Fn&& OnCompletion) {
+			unsigned       head_ = *CqHead_;
+			const unsigned tail_ = __atomic_load_n(CqTail_, __ATOMIC_ACQUIRE);
+			while (head_ != tail_) {
+				const io_uring_cqe& cqe_ = Cqes_[head_ & CqMask_];
+				const uint64_t      data_ = cqe_.user_data;
+				const int32_t       res_  = cqe_.res;
+				++head_;
+				__atomic_store_n(CqHead_, head_, __ATOMIC_RELEASE);
+				--InFlight_;
+				OnCompletion(data_, res_);
+			}
+		}
+		
+		// Waits for every submitted entry to complete, reaping as 'reap()' 
+		// does; entries queued but never submitted never run. Returns 'false' 
+		// if the ring failed while waiting:
+		template <typename Fn>
+		bool drain(Fn&& OnCompletion) {
+			for (;;) {
+				reap(OnCompletion);
+				if (InFlight_ == 0) {
+					return true;
+				}
+				const long done_ = ::syscall(__NR_io_uring_enter, Fd_, 0, InFlight_, 
+											 IORING_ENTER_GETEVENTS, nullptr, 0);
+				if ((done_ < 0) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+					return false;
+				}
+			}
+		}
+	
+	private:
+		bool          supports(const std::vector<uint8_t>& Ops) noexcept;
+		void          unmap() noexcept;
+
+};
+
+
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+IoUring::IoUring(unsigned Entries) {
+	io_uring_params params_;
+	std::memset(&params_, 0, sizeof(params_));
+	params_.flags = IORING_SETUP_CLAMP;
+	Fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, Entries, &params_));
+	if (Fd_ < 0) {
+		return;
+	}
+	
+	SqSize_ = params_.sq_off.array + (params_.sq_entries * sizeof(unsigned));
+	CqSize_ = params_.cq_off.cqes + (params_.cq_entries * sizeof(io_uring_cqe));
+	if (params_.features & IORING_FEAT_SINGLE_MMAP) {
+		SqSize_ = CqSize_ = std::max(SqSize_, CqSize_);
+	}
+	SqRing_ = ::mmap(nullptr, SqSize_, PROT_READ | PROT_WRITE, 
+					 MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_SQ_RING);
+	CqRing_ = (params_.features & IORING_FEAT_SINGLE_MMAP) 
+			  ? SqRing_ 
+			  : ::mmap(nullptr, CqSize_, PROT_READ | PROT_WRITE, 
+					   MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_CQ_RING);
+	SqesSize_ = params_.sq_entries * sizeof(io_uring_sqe);
+	void* sqes_ = ::mmap(nullptr, SqesSize_, PROT_READ | PROT_WRITE, 
+						 MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_SQES);
+	if ((SqRing_ == MAP_FAILED) || (CqRing_ == MAP_FAILED) || (sqes_ == MAP_FAILED)) {
+		if (sqes_ != MAP_FAILED) {
+			::munmap(sqes_, SqesSize_);
+		}
+		unmap();
+		return;
+	}
+	
+	char* sq_ = static_cast<char*>(SqRing_);
+	char* cq_ = static_cast<char*>(CqRing_);
+	Sqes_    = static_cast<io_uring_sqe*>(sqes_);
+	Entries_ = params_.sq_entries;
+	SqHead_  = reinterpret_cast<unsigned*>(sq_ + params_.sq_off.head);
+	SqTail_  = reinterpret_cast<unsigned*>(sq_ + params_.sq_off.tail);
+	SqMask_  = *reinterpret_cast<unsigned*>(sq_ + params_.sq_off.ring_mask);
+	SqArray_ = reinterpret_cast<unsigned*>(sq_ + params_.sq_off.array);
+	CqHead_  = reinterpret_cast<unsigned*>(cq_ + params_.cq_off.head);
+	CqTail_  = reinterpret_cast<unsigned*>(cq_ + params_.cq_off.tail);
+	CqMask_  = *reinterpret_cast<unsigned*>(cq_ + params_.cq_off.ring_mask);
+	Cqes_    = reinterpret_cast<io_uring_cqe*>(cq_ + params_.cq_off.cqes);
+	
+	if (!supports({ IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, 
+					IORING_OP_FSYNC, IORING_OP_CLOSE })) {
+		unmap();
+	}
+}
+
+
+IoUring::~IoUring() noexcept {
+	unmap();
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    ok
+// DESCRIPTION: Tests whether the ring was set up and supports every operation 
+//              'AsyncTagIO' uses.
+bool IoUring::ok() const noexcept {
+	return Fd_ >= 0;
+}
+
+
+unsigned IoUring::entries() const noexcept {
+	return Entries_;
+}
+
+
+// FUNCTION:    next
+// DESCRIPTION: Returns a cleared submission entry to fill in, or 'nullptr' if 
+//              the queue is full.
+io_uring_sqe* IoUring::next() noexcept {
+	const unsigned tail_ = *SqTail_;
+	if ((tail_ - __atomic_load_n(SqHead_, __ATOMIC_ACQUIRE)) >= Entries_) {
+		return nullptr;
+	}
+	io_uring_sqe* sqe_ = &Sqes_[tail_ & SqMask_];
+	std::memset(sqe_, 0, sizeof(*sqe_));
+	SqArray_[tail_ & SqMask_] = tail_ & SqMask_;
+	__atomic_store_n(SqTail_, tail_ + 1, __ATOMIC_RELEASE);
+	++Pending_;
+	return sqe_;
+}
+
+
+// FUNCTION:    submit
+// DESCRIPTION: Submits the queued entries and waits until at least 'WaitFor' 
+//              completions have arrived. Returns 0, or a negative 'errno' 
+//              value if the ring itself failed.
+int IoUring::submit(unsigned WaitFor) noexcept {
+	for (;;) {
+		const long done_ = ::syscall(__NR_io_uring_enter, Fd_, Pending_, WaitFor, 
+									 IORING_ENTER_GETEVENTS, nullptr, 0);
+		if (done_ >= 0) {
+			Pending_  -= static_cast<unsigned>(done_);
+			InFlight_ += static_cast<unsigned>(done_);
+			return 0;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		// Out of memory for requests, or completions backing up: reap first.
+		if ((errno == EAGAIN) || (errno == EBUSY)) {
+			return 0;
+		}
+		return -errno;
+	}
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    supports
+// DESCRIPTION: Asks the kernel whether it knows every operation in 'Ops'.
+bool IoUring::supports(const std::vector<uint8_t>& Ops) noexcept {
+	constexpr const unsigned kPROBE_OPS = 256;
+	std::vector<char> buffer_(sizeof(io_uring_probe)
+							  + (kPROBE_OPS * sizeof(io_uring_probe_op)), 0);
+	io_uring_probe* probe_ = reinterpret_cast<io_uring_probe*>(buffer_.data());
+	if (::syscall(__NR_io_uring_register, Fd_, IORING_REGISTER_PROBE, 
+				  probe_, kPROBE_OPS) < 0) {
+		return false;
+	}
+	for (uint8_t op_ : Ops) {
+		if ((op_ > probe_->last_op) 
+			|| !(probe_->ops[op_].flags & IO_URING_OP_SUPPORTED)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void IoUring::unmap() noexcept {
+	if (Sqes_ != nullptr) {
+		::munmap(Sqes_, SqesSize_);
+		Sqes_ = nullptr;
+	}
+	if ((CqRing_ != MAP_FAILED) && (CqRing_ != SqRing_)) {
+		::munmap(CqRing_, CqSize_);
+	}
+	if (SqRing_ != MAP_FAILED) {
+		::munmap(SqRing_, SqSize_);
+	}
+	SqRing_ = CqRing_ = MAP_FAILED;
+	if (Fd_ >= 0) {
+		::close(Fd_);
+		Fd_ = -1;
+	}
+}
+
+
+/*  --------  STATIC FUNCTIONS  --------  */
+// NAME:    PrepOpen, PrepReadWrite, PrepSync, PrepClose
+// PURPOSE: Fill in a submission entry for one step of a file's chain; the 
+//          slot the file occupies travels as the user data.
+auto static PrepOpen(io_uring_sqe* Sqe, const char* Path, int Flags, 
+					 uint64_t Slot)->void {
+	Sqe->opcode     = IORING_OP_OPENAT;
+	Sqe->fd         = AT_FDCWD;
+	Sqe->addr       = reinterpret_cast<uint64_t>(Path);
+	Sqe->open_flags = static_cast<uint32_t>(Flags);
+	Sqe->user_data  = Slot;
+}
+
+auto static PrepReadWrite(io_uring_sqe* Sqe, uint8_t Op, int Fd, char* Data, 
+						  size_t Length, uint64_t Offset, uint64_t Slot)->void {
+	Sqe->opcode    = Op;
+	Sqe->fd        = Fd;
+	Sqe->addr      = reinterpret_cast<uint64_t>(Data);
+	Sqe->len       = static_cast<uint32_t>(std::min<size_t>(Length, 1u << 30));
+	Sqe->off       = Offset;
+	Sqe->user_data = Slot;
+}
+
+auto static PrepSync(io_uring_sqe* Sqe, int Fd, uint64_t Slot)->void {
+	Sqe->opcode      = IORING_OP_FSYNC;
+	Sqe->fd          = Fd;
+	Sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	Sqe->user_data   = Slot;
+}
+
+auto static PrepClose(io_uring_sqe* Sqe, int Fd, uint64_t Slot)->void {
+	Sqe->opcode    = IORING_OP_CLOSE;
+	Sqe->fd        = Fd;
+	Sqe->user_data = Slot;
+}
+
+
+// NAME:    DriveRing
+// PURPOSE: Runs jobs '0' to 'Count - 1' through 'Ring', 'Depth' at a time. 
+//          'Start(Slot, Job)' queues the first step of a job in a free slot; 
+//          'Step(Slot, Result)' handles a completion and returns 'false' once 
+//          the slot's job is over. Returns 0, or a negative 'errno' value if 
+//          the ring failed; 'Next' is then the first job not started.
+template <typename StartFn, typename StepFn>
+auto static DriveRing(IoUring& Ring, size_t Count, size_t Depth, size_t& Next, 
+					  StartFn&& Start, StepFn&& Step)->int {
+	std::vector<size_t> free_;
+	free_.reserve(Depth);
+	for (size_t s = Depth; s > 0; --s) {
+		free_.push_back(s - 1);
+	}
+	
+	size_t busy_ = 0;
+	Next = 0;
+	while ((Next < Count) || (busy_ > 0)) {
+		while (!free_.empty() && (Next < Count)) {
+			Start(free_.back(), Next++);
+			free_.pop_back();
+			++busy_;
+		}
+		const int error_ = Ring.submit(1);
+		if (error_ != 0) {
+			return error_;
+		}
+		Ring.reap([&](uint64_t Slot, int32_t Result) {
+			if (!Step(static_cast<size_t>(Slot), Result)) {
+				free_.push_back(static_cast<size_t>(Slot));
+				--busy_;
+			}
+		});
+	}
+	return 0;
+}
+
+
+// NAME:    AbandonRing
+// PURPOSE: Tears 'Ring' down after it failed, so that 'Slots' can be freed: 
+//          first waits for what it still has in flight (an open may yet hand 
+//          back a file, a read may yet fill a buffer), then closes the files 
+//          left open. If even that wait fails, the buffers of busy slots are 
+//          leaked rather than freed under the kernel, and a file whose close 
+//          may have run is not closed again.
+template <typename SlotT>
+auto static AbandonRing(std::unique_ptr<IoUring>& Ring, std::vector<SlotT>& Slots)->void {
+	const bool drained_ = Ring->drain([&](uint64_t Slot, int32_t Result) {
+		SlotT& slot_ = Slots[static_cast<size_t>(Slot)];
+		if (slot_.Step_ == kSTEP_OPEN) {
+			slot_.Fd_ = (Result >= 0) ? Result : -1;
+		} else if (slot_.Step_ == kSTEP_CLOSE) {
+			slot_.Fd_ = -1;
+		}
+	});
+	Ring.reset();
+	for (SlotT& slot_ : Slots) {
+		if (!drained_ && (slot_.Step_ != kSTEP_IDLE)) {
+			static_cast<void>(new std::vector<char>(std::move(slot_.Buffer_)));
+			if (slot_.Step_ == kSTEP_CLOSE) {
+				slot_.Fd_ = -1;
+			}
+		}
+		if (slot_.Fd_ >= 0) {
+			::close(slot_.Fd_);
+			slot_.Fd_ = -1;
+		}
+	}
+}
+#else
+class IoUring {};
+#endif
+
+
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+AsyncTagIO::AsyncTagIO() : AsyncTagIO(AsyncIOOptions()) {}
+
+
+AsyncTagIO::AsyncTagIO(AsyncIOOptions Options) : Options_(std::move(Options)) {
+	Options_.QueueDepth_ = std::max<size_t>(Options_.QueueDepth_, 1);
+	Options_.ReadAhead_  = std::max<size_t>(Options_.ReadAhead_, ID3_HEADER);
+#if defined(MP3EDIT_IO_URING)
+	if (!Options_.UseThreads_) {
+		Ring_ = std::make_unique<IoUring>(static_cast<unsigned>(
+			std::min<size_t>(Options_.QueueDepth_, 32768)));
+		if (!Ring_->ok()) {
+			Ring_.reset();
+		}
+	}
+#endif
+}
+
+
+AsyncTagIO::~AsyncTagIO() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    load
+// DESCRIPTION: Loads the tag of every file in 'Files', passing each to 'Fn' as 
+//              it completes (not in order). Blocks until all are done.
+void AsyncTagIO::load(const std::vector<std::string>& Files, 
+					  const LoadCallback&             Fn) {
+	std::vector<size_t> leftover_;
+	if (Ring_) {
+		loadWithRing(Files, Fn, leftover_);
+	} else {
+		leftover_.resize(Files.size());
+		for (size_t i = 0; i < Files.size(); ++i) {
+			leftover_[i] = i;
+		}
+	}
+	if (!leftover_.empty()) {
+		loadWithThreads(Files, leftover_, Fn);
+	}
+}
+
+
+// FUNCTION:    save
+// DESCRIPTION: Writes 'Tags[i]' to 'Files[i]' for every 'i', reporting each 
+//              result to 'Fn' as it completes. A tag that fits in the old one 
+//              is written over it; any other goes through 
+//              'set_tag_with_padding_policy()' with 'PaddingPolicy_'. Either 
+//              way the tag is updated as that function would update it. The 
+//              tags stay owned by the caller. Blocks until all are done.
+void AsyncTagIO::save(const std::vector<std::string>& Files, 
+					  const std::vector<ID3v2_tag*>&  Tags, 
+					  const SaveCallback&             Fn) {
+	std::vector<size_t> leftover_;
+	const size_t        count_ = std::min(Files.size(), Tags.size());
+	if (Ring_) {
+		saveWithRing(Files, Tags, Fn, leftover_);
+	} else {
+		leftover_.resize(count_);
+		for (size_t i = 0; i < count_; ++i) {
+			leftover_[i] = i;
+		}
+	}
+	if (!leftover_.empty()) {
+		saveWithThreads(Files, Tags, leftover_, Fn);
+	}
+}
+
+
+// FUNCTION:    usesUring
+// DESCRIPTION: Tests whether io_uring is in use (rather than the thread pool).
+bool AsyncTagIO::usesUring() const noexcept {
+	return static_cast<bool>(Ring_);
+}
+
+
+// FUNCTION:    stats
+// DESCRIPTION: Returns the totals of every load and save so far.
+AsyncIOStats AsyncTagIO::stats() const noexcept {
+	std::lock_guard<std::mutex> guard_(Lock_);
+	return Stats_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    loadWithRing
+// DESCRIPTION: Runs open -> read (-> read) -> close for every file on the 
+//              ring. The first read takes 'ReadAhead_' bytes; a tag larger 
+//              than that takes one more. Files the ring could not finish are 
+//              added to 'Leftover'.
+void AsyncTagIO::loadWithRing(const std::vector<std::string>& Files, 
+							  const LoadCallback&             Fn, 
+							  std::vector<size_t>&            Leftover) {
+#if defined(MP3EDIT_IO_URING)
+	struct Slot {
+		size_t            Job_  = 0;
+		int               Fd_   = -1;
+		int               Step_ = kSTEP_IDLE;
+		size_t            Have_ = 0;
+		size_t            Want_ = 0;  // Tag size, once known
+		std::vector<char> Buffer_;
+	};
+	
+	IoUring&          ring_  = *Ring_;
+	const size_t      depth_ = std::min<size_t>(Options_.QueueDepth_, ring_.entries());
+	std::vector<Slot> slots_(depth_);
+	AsyncIOStats      delta_;
+	
+	// Hands the result on and closes the file:
+	auto finish_ = [&](size_t s, ID3v2_tag* Tag, int Error) {
+		Slot& slot_ = slots_[s];
+		++delta_.Files_;
+		delta_.Failed_ += (Error != 0) ? 1 : 0;
+		Fn(slot_.Job_, Tag, Error);
+		if (slot_.Buffer_.size() > Options_.ReadAhead_) {
+			std::vector<char>().swap(slot_.Buffer_); // Do not keep big tags
+		}
+		PrepClose(ring_.next(), slot_.Fd_, s);
+		slot_.Step_ = kSTEP_CLOSE;
+	};
+	
+	auto start_ = [&](size_t s, size_t Job) {
+		Slot& slot_ = slots_[s];
+		slot_.Job_  = Job;
+		slot_.Fd_   = -1;
+		slot_.Step_ = kSTEP_OPEN;
+		slot_.Have_ = 0;
+		slot_.Want_ = 0;
+		PrepOpen(ring_.next(), Files[Job].c_str(), O_RDONLY | O_CLOEXEC, s);
+	};
+	
+	auto step_ = [&](size_t s, int32_t Result)->bool {
+		Slot& slot_ = slots_[s];
+		switch (slot_.Step_) {
+			case kSTEP_OPEN:
+				if (Result < 0) {
+					++delta_.Files_;
+					++delta_.Failed_;
+					slot_.Step_ = kSTEP_IDLE;
+					Fn(slot_.Job_, nullptr, -Result);
+					return false;
+				}
+				slot_.Fd_   = Result;
+				slot_.Step_ = kSTEP_READ;
+				slot_.Buffer_.resize(Options_.ReadAhead_);
+				PrepReadWrite(ring_.next(), IORING_OP_READ, slot_.Fd_, 
+							  slot_.Buffer_.data(), slot_.Buffer_.size(), 0, s);
+				return true;
+			
+			case kSTEP_READ:
+				if (Result < 0) {
+					finish_(s, nullptr, -Result);
+					return true;
+				}
+				slot_.Have_       += static_cast<size_t>(Result);
+				delta_.BytesRead_ += static_cast<uint64_t>(Result);
+				if ((slot_.Want_ == 0) && ((slot_.Have_ >= ID3_HEADER) || (Result == 0))) {
+					slot_.Want_ = TagBytesNeeded(slot_.Buffer_.data(), slot_.Have_);
+					if (slot_.Want_ == 0) {
+						finish_(s, nullptr, 0); // No tag
+						return true;
+					}
+				}
+				if ((slot_.Want_ != 0) && (slot_.Have_ >= slot_.Want_)) {
+					finish_(s, ParseTag(slot_.Buffer_, slot_.Want_), 0);
+				} else if (Result == 0) {
+					finish_(s, nullptr, 0); // Cut short, as for 'load_tag()'
+				} else {
+					if (slot_.Buffer_.size() < slot_.Want_) {
+						slot_.Buffer_.resize(slot_.Want_);
+					}
+					PrepReadWrite(ring_.next(), IORING_OP_READ, slot_.Fd_, 
+								  slot_.Buffer_.data() + slot_.Have_, 
+								  slot_.Buffer_.size() - slot_.Have_, 
+								  slot_.Have_, s);
+				}
+				return true;
+			
+			default: // kSTEP_CLOSE
+				slot_.Fd_   = -1;
+				slot_.Step_ = kSTEP_IDLE;
+				return false;
+		}
+	};
+	
+	size_t    next_  = 0;
+	const int error_ = DriveRing(ring_, Files.size(), depth_, next_, start_, step_);
+	if (error_ != 0) {
+		// Only a broken ring gets here. Its files fail; the rest go to the pool:
+		AbandonRing(Ring_, slots_);
+		for (Slot& slot_ : slots_) {
+			if ((slot_.Step_ != kSTEP_IDLE) && (slot_.Step_ != kSTEP_CLOSE)) {
+				++delta_.Files_;
+				++delta_.Failed_;
+				Fn(slot_.Job_, nullptr, -error_);
+			}
+		}
+		for (size_t i = next_; i < Files.size(); ++i) {
+			Leftover.push_back(i);
+		}
+	}
+	count(delta_);
+#else
+	static_cast<void>(Files);
+	static_cast<void>(Fn);
+	static_cast<void>(Leftover);
+#endif
+}
+
+
+// FUNCTION:    saveWithRing
+// DESCRIPTION: Runs open -> read header -> write -> fdatasync -> close for 
+//              every tag that fits in the file's old tag. Files whose tag does 
+//              not fit (or has to be created) are closed and added to 
+//              'Leftover', for the thread pool to rewrite.
+void AsyncTagIO::saveWithRing(const std::vector<std::string>& Files, 
+							  const std::vector<ID3v2_tag*>&  Tags, 
+							  const SaveCallback&             Fn, 
+							  std::vector<size_t>&            Leftover) {
+#if defined(MP3EDIT_IO_URING)
+	struct Slot {
+		size_t            Job_      = 0;
+		int               Fd_       = -1;
+		int               Step_     = kSTEP_IDLE;
+		int32_t           Result_   = TAG_WRITE_FAILED;
+		bool              Rewrite_  = false;
+		int64_t           Capacity_ = 0;
+		size_t            Done_     = 0;
+		std::vector<char> Buffer_;
+	};
+	
+	IoUring&          ring_  = *Ring_;
+	const size_t      depth_ = std::min<size_t>(Options_.QueueDepth_, ring_.entries());
+	const size_t      count_ = std::min(Files.size(), Tags.size());
+	std::vector<Slot> slots_(depth_);
+	AsyncIOStats      delta_;
+	
+	auto close_ = [&](size_t s, int32_t Result) {
+		slots_[s].Result_ = Result;
+		slots_[s].Step_   = kSTEP_CLOSE;
+		PrepClose(ring_.next(), slots_[s].Fd_, s);
+	};
+	
+	auto start_ = [&](size_t s, size_t Job) {
+		Slot& slot_    = slots_[s];
+		slot_.Job_     = Job;
+		slot_.Fd_      = -1;
+		slot_.Step_    = kSTEP_OPEN;
+		slot_.Result_  = TAG_WRITE_FAILED;
+		slot_.Rewrite_ = false;
+		slot_.Done_    = 0;
+		PrepOpen(ring_.next(), Files[Job].c_str(), O_RDWR | O_CLOEXEC, s);
+	};
+	
+	auto step_ = [&](size_t s, int32_t Result)->bool {
+		Slot& slot_ = slots_[s];
+		switch (slot_.Step_) {
+			case kSTEP_OPEN:
+				if (Result < 0) {
+					++delta_.Files_;
+					++delta_.Failed_;
+					slot_.Step_ = kSTEP_IDLE;
+					Fn(slot_.Job_, TAG_WRITE_FAILED);
+					return false;
+				}
+				slot_.Fd_   = Result;
+				slot_.Step_ = kSTEP_READ;
+				slot_.Buffer_.assign(ID3_HEADER, '\0');
+				PrepReadWrite(ring_.next(), IORING_OP_READ, slot_.Fd_, 
+							  slot_.Buffer_.data(), ID3_HEADER, 0, s);
+				return true;
+			
+			case kSTEP_READ:
+				if (Result < 0) {
+					close_(s, TAG_WRITE_FAILED);
+					return true;
+				}
+				delta_.BytesRead_ += static_cast<uint64_t>(Result);
+				slot_.Capacity_    = GetTagCapacity(slot_.Buffer_.data(), 
+												  static_cast<size_t>(Result));
+				if (!RenderTag(Tags[slot_.Job_], slot_.Capacity_, slot_.Buffer_)) {
+					slot_.Rewrite_ = true;
+					close_(s, TAG_WRITE_REWRITE);
+					return true;
+				}
+				slot_.Step_ = kSTEP_WRITE;
+				PrepReadWrite(ring_.next(), IORING_OP_WRITE, slot_.Fd_, 
+							  slot_.Buffer_.data(), slot_.Buffer_.size(), 0, s);
+				return true;
+			
+			case kSTEP_WRITE:
+				if (Result <= 0) {
+					close_(s, TAG_WRITE_FAILED);
+					return true;
+				}
+				slot_.Done_          += static_cast<size_t>(Result);
+				delta_.BytesWritten_ += static_cast<uint64_t>(Result);
+				if (slot_.Done_ < slot_.Buffer_.size()) {
+					PrepReadWrite(ring_.next(), IORING_OP_WRITE, slot_.Fd_, 
+								  slot_.Buffer_.data() + slot_.Done_, 
+								  slot_.Buffer_.size() - slot_.Done_, 
+								  slot_.Done_, s);
+				} else if (Options_.Sync_) {
+					slot_.Step_ = kSTEP_SYNC;
+					PrepSync(ring_.next(), slot_.Fd_, s);
+				} else {
+					close_(s, TAG_WRITE_IN_PLACE);
+				}
+				return true;
+			
+			case kSTEP_SYNC:
+				close_(s, (Result < 0) ? TAG_WRITE_FAILED : TAG_WRITE_IN_PLACE);
+				return true;
+			
+			default: // kSTEP_CLOSE: only now is the save known to be good
+				slot_.Fd_   = -1;
+				slot_.Step_ = kSTEP_IDLE;
+				if (slot_.Rewrite_) {
+					Leftover.push_back(slot_.Job_);
+					return false;
+				}
+				if ((Result < 0) && (slot_.Result_ == TAG_WRITE_IN_PLACE)) {
+					slot_.Result_ = TAG_WRITE_FAILED;
+				}
+				++delta_.Files_;
+				if (slot_.Result_ == TAG_WRITE_IN_PLACE) {
+					finishInPlace(Tags[slot_.Job_], slot_.Capacity_);
+					++delta_.InPlace_;
+				} else {
+					++delta_.Failed_;
+				}
+				if (slot_.Buffer_.size() > Options_.ReadAhead_) {
+					std::vector<char>().swap(slot_.Buffer_);
+				}
+				Fn(slot_.Job_, slot_.Result_);
+				return false;
+		}
+	};
+	
+	size_t    next_  = 0;
+	const int error_ = DriveRing(ring_, count_, depth_, next_, start_, step_);
+	if (error_ != 0) {
+		AbandonRing(Ring_, slots_);
+		for (Slot& slot_ : slots_) {
+			if (slot_.Step_ == kSTEP_IDLE) {
+				continue;
+			}
+			if (slot_.Rewrite_) {
+				Leftover.push_back(slot_.Job_);
+				continue;
+			}
+			++delta_.Files_;
+			++delta_.Failed_;
+			Fn(slot_.Job_, TAG_WRITE_FAILED);
+		}
+		for (size_t i = next_; i < count_; ++i) {
+			Leftover.push_back(i);
+		}
+	}
+	count(delta_);
+#else
+	static_cast<void>(Files);
+	static_cast<void>(Tags);
+	static_cast<void>(Fn);
+	static_cast<void>(Leftover);
+#endif
+}
+
+
+// FUNCTION:    loadWithThreads
+// DESCRIPTION: Loads the files in 'Which' with blocking calls on a thread pool.
+void AsyncTagIO::loadWithThreads(const std::vector<std::string>& Files, 
+								 const std::vector<size_t>&      Which, 
+								 const LoadCallback&             Fn) {
+	WorkStealingPool pool_(Options_.Threads_);
+	for (size_t job_ : Which) {
+		pool_.submit([&, job_]() {
+			ID3v2_tag*    tag_   = nullptr;
+			AsyncIOStats  delta_;
+			const int     error_ = LoadFileSync(Files[job_], Options_.ReadAhead_, 
+												tag_, delta_.BytesRead_);
+			delta_.Files_  = 1;
+			delta_.Failed_ = (error_ != 0) ? 1 : 0;
+			count(delta_);
+			Fn(job_, tag_, error_);
+		});
+	}
+	pool_.wait();
+}
+
+
+// FUNCTION:    saveWithThreads
+// DESCRIPTION: Saves the files in 'Which' with blocking calls on a thread
+//              pool: over the old tag if the new one fits, and otherwise with 
+//              'set_tag_with_padding_policy()'. As in 'BatchEngine', each 
+//              rewrite works on a copy of the padding policy, and the edit is 
+//              then recorded on the shared one.
+void AsyncTagIO::saveWithThreads(const std::vector<std::string>& Files, 
+								 const std::vector<ID3v2_tag*>&  Tags, 
+								 const std::vector<size_t>&      Which, 
+								 const SaveCallback&             Fn) {
+	WorkStealingPool pool_(Options_.Threads_);
+	for (size_t job_ : Which) {
+		pool_.submit([&, job_]() {
+			const std::string& file_   = Files[job_];
+			ID3v2_tag*         tag_    = Tags[job_];
+			int32_t            result_ = TAG_WRITE_FAILED;
+			AsyncIOStats       delta_;
+			delta_.Files_ = 1;
+			if (tag_ == nullptr) {
+				delta_.Failed_ = 1;
+				count(delta_);
+				Fn(job_, TAG_WRITE_FAILED);
+				return;
+			}
+#if !defined(_WIN32)
+			const int fd_ = ::open(file_.c_str(), O_RDWR | O_CLOEXEC);
+			if (fd_ < 0) {
+				delta_.Failed_ = 1;
+				count(delta_);
+				Fn(job_, TAG_WRITE_FAILED);
+				return;
+			}
+			char              header_[ID3_HEADER];
+			std::vector<char> out_;
+			const ssize_t     got_      = ReadAt(fd_, header_, ID3_HEADER, 0);
+			const int64_t     capacity_ = (got_ < 0) ? -1 
+											: GetTagCapacity(header_, static_cast<size_t>(got_));
+			if (RenderTag(tag_, capacity_, out_)) {
+				bool ok_ = WriteAt(fd_, out_.data(), out_.size(), 0) 
+						   && (!Options_.Sync_ || (::fdatasync(fd_) == 0));
+				ok_ = (::close(fd_) == 0) && ok_;
+				delta_.BytesRead_ = static_cast<uint64_t>(got_);
+				if (ok_) {
+					finishInPlace(tag_, capacity_);
+					delta_.InPlace_      = 1;
+					delta_.BytesWritten_ = out_.size();
+					result_              = TAG_WRITE_IN_PLACE;
+				} else {
+					delta_.Failed_ = 1;
+				}
+				count(delta_);
+				Fn(job_, result_);
+				return;
+			}
+			::close(fd_);
+#endif
+			ID3v2_padding_policy policy_;
+			{
+				std::lock_guard<std::mutex> guard_(Lock_);
+				policy_ = Options_.PaddingPolicy_;
+			}
+			const int32_t oldSize_ = tag_->used_size;
+			result_ = set_tag_with_padding_policy(file_.c_str(), tag_, &policy_);
+			if (result_ == TAG_WRITE_FAILED) {
+				delta_.Failed_ = 1;
+			} else {
+				std::lock_guard<std::mutex> guard_(Lock_);
+				record_padding_edit(&Options_.PaddingPolicy_, oldSize_, tag_->used_size);
+				if (result_ == TAG_WRITE_IN_PLACE) {
+					delta_.InPlace_ = 1;
+				} else {
+					delta_.Rewritten_ = 1;
+				}
+			}
+			count(delta_);
+			Fn(job_, result_);
+		});
+	}
+	pool_.wait();
+}
+
+
+// FUNCTION:    finishInPlace
+// DESCRIPTION: Brings 'Tag' up to date after it was written over an old tag 
+//              with room for 'Capacity' bytes, as 'write_tag()' does, and 
+//              records the edit on the padding policy.
+void AsyncTagIO::finishInPlace(ID3v2_tag* Tag, int64_t Capacity) {
+	const int32_t frames_ = static_cast<int32_t>(GetFramesSize(Tag));
+	{
+		std::lock_guard<std::mutex> guard_(Lock_);
+		record_padding_edit(&Options_.PaddingPolicy_, Tag->used_size, frames_);
+	}
+	free(Tag->tag_header);
+	Tag->tag_header = new_header();
+	std::memcpy(Tag->tag_header->tag, "ID3", 3);
+	Tag->tag_header->major_version = '\x03';
+	Tag->tag_header->minor_version = '\x00';
+	Tag->tag_header->flags         = '\x00';
+	Tag->tag_header->tag_size      = static_cast<int32_t>(Capacity);
+	Tag->used_size                 = frames_;
+}
+
+
+// FUNCTION:    count
+// DESCRIPTION: Adds 'Delta' to the totals.
+void AsyncTagIO::count(const AsyncIOStats& Delta) {
+	std::lock_guard<std::mutex> guard_(Lock_);
+	Stats_.Files_        += Delta.Files_;
+	Stats_.Failed_       += Delta.Failed_;
+	Stats_.InPlace_      += Delta.InPlace_;
+	Stats_.Rewritten_    += Delta.Rewritten_;
+	Stats_.BytesRead_    += Delta.BytesRead_;
+	Stats_.BytesWritten_ += Delta.BytesWritten_;
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    GetTagCapacity
+// DESCRIPTION: Returns the room for frames and padding in the tag whose 
+//              header is 'Data' (counting a v2.4 footer, which an in-place 
+//              save turns into padding), or -1 if there is no tag. Matches 
+//              'write_tag()'.
+auto GetTagCapacity(const char* Data, size_t Length)->int64_t {
+	if ((Length < ID3_HEADER) || (std::memcmp(Data, "ID3", 3) != 0)) {
+		return -1;
+	}
+	const uint32_t raw_ = id3_read_be32(reinterpret_cast<const uint8_t*>(Data + 6));
+	return static_cast<int64_t>(id3_syncsafe_decode(raw_))
+		   + ((static_cast<uint8_t>(Data[5]) & kFLAG_FOOTER) ? ID3_HEADER : 0);
+}
+
+
+// FUNCTION:    GetFramesSize
+// DESCRIPTION: Returns the bytes 'Tag's frames take when written, headers 
+//              included.
+auto GetFramesSize(const ID3v2_tag* Tag)->int64_t {
+	int64_t size_ = 0;
+	if ((Tag == nullptr) || (Tag->frames == nullptr)) {
+		return size_;
+	}
+	for (const ID3v2_frame_list* list_ = Tag->frames->start;
+		 list_ != nullptr;
+		 list_ = list_->next) {
+		if (list_->frame != nullptr) {
+			size_ += ID3_FRAME + list_->frame->size;
+		}
+	}
+	return size_;
+}
+
+
+// FUNCTION:    RenderTag
+// DESCRIPTION: Lays out 'Tag' as an ID3v2.3 tag of exactly 'Capacity' bytes 
+//              (after the header), padded with zeros, as 'write_tag()' writes 
+//              it. Returns 'false' if there is no 'Tag', or if 'Capacity' is 
+//              negative (no old tag) or too small for the frames.
+auto RenderTag(const ID3v2_tag*   Tag, 
+			   int64_t            Capacity, 
+			   std::vector<char>& Out)->bool {
+	if ((Tag == nullptr) || (Capacity < 0) || (Capacity > ID3_MAX_TAG_SIZE) 
+		|| (GetFramesSize(Tag) > Capacity)) {
+		return false;
+	}
+	Out.assign(static_cast<size_t>(ID3_HEADER + Capacity), '\0');
+	char* out_ = Out.data();
+	std::memcpy(out_, "ID3\x03\x00\x00", 6);
+	id3_write_syncsafe32(AsBytes(out_ + 6), static_cast<uint32_t>(Capacity));
+	
+	size_t at_ = ID3_HEADER;
+	for (const ID3v2_frame_list* list_ = Tag->frames ? Tag->frames->start : nullptr;
+		 list_ != nullptr;
+		 list_ = list_->next) {
+		const ID3v2_frame* frame_ = list_->frame;
+		if (frame_ == nullptr) {
+			continue;
+		}
+		std::memcpy(out_ + at_, frame_->frame_id, ID3_FRAME_ID);
+		id3_write_be32(AsBytes(out_ + at_ + ID3_FRAME_ID), 
+					   static_cast<uint32_t>(frame_->size));
+		std::memcpy(out_ + at_ + ID3_FRAME_ID + ID3_FRAME_SIZE, 
+					frame_->flags, 
+					ID3_FRAME_FLAGS);
+		if (frame_->size > 0) {
+			std::memcpy(out_ + at_ + ID3_FRAME, frame_->data, frame_->size);
+		}
+		at_ += ID3_FRAME + frame_->size;
+	}
+	return true;
+}
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      AsyncTagIO.hpp
+// FILE PURPOSE:  Declares the class 'AsyncTagIO', which loads and saves the 
+//                tags of many files at once with asynchronous I/O (io_uring 
+//                on Linux), keeping a fixed number of file operations in 
+//                flight instead of one blocking call chain per thread.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const size_t kDEFAULT_QUEUE_DEPTH = 256;
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct AsyncIOOptions {
+	size_t  QueueDepth_  = kDEFAULT_QUEUE_DEPTH; // Files in flight at once
+	size_t  Threads_     = 0;         // Thread pool fallback; 0 = one per CPU
+	size_t  ReadAhead_   = 64 * 1024; // First read of a file; most tags fit
+	bool    Sync_        = true;      // 'fdatasync()' files after writing
+	bool    UseThreads_  = false;     // Never use io_uring
+	ID3v2_padding_policy PaddingPolicy_ = *get_default_padding_policy();
+};
+
+struct AsyncIOStats {
+	size_t   Files_        = 0;
+	size_t   Failed_       = 0; // Could not be opened, read or written
+	size_t   InPlace_      = 0; // Saved over the old tag
+	size_t   Rewritten_    = 0; // Saved by moving the audio (thread pool)
+	uint64_t BytesRead_    = 0;
+	uint64_t BytesWritten_ = 0;
+};
+
+class IoUring;
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// With io_uring, each file is a chain open -> read (-> read) -> close, or 
+// open -> read header -> write -> fdatasync -> close, and up to 'QueueDepth_' 
+// chains run at once from the calling thread; the depth, not the number of 
+// threads, is what keeps the device busy. Where io_uring is missing (other 
+// systems, old kernels, or blocked by a sandbox) the same steps run as 
+// blocking calls on a thread pool. Saves that do not fit in the old tag 
+// always go through 'set_tag_with_padding_policy()' on the pool, since they 
+// move the audio.
+class AsyncTagIO {
+
+	public:
+		// Takes ownership of 'Tag' (free it with 'free_tag()'), which is 
+		// 'nullptr' if the file has no tag or could not be read; 'Error' is 
+		// then an 'errno' value, or 0. Called on the thread that called 
+		// 'load()' with io_uring, and on pool threads (for different files
+		// at once) without:
+		using LoadCallback = std::function<void(size_t     Index, 
+												ID3v2_tag* Tag, 
+												int        Error)>;
+		// 'Result' is one of the 'TAG_WRITE_*' constants; same threads:
+		using SaveCallback = std::function<void(size_t Index, int32_t Result)>;
+	
+	private:
+		AsyncIOOptions           Options_;
+		std::unique_ptr<IoUring> Ring_;
+		AsyncIOStats             Stats_;
+		mutable std::mutex       Lock_;    // 'Stats_' and the padding policy
+	
+	public:
+		AsyncTagIO();
+		explicit AsyncTagIO(AsyncIOOptions Options);
+		~AsyncTagIO() noexcept;
+		
+		AsyncTagIO(const AsyncTagIO&)            = delete;
+		AsyncTagIO& operator=(const AsyncTagIO&) = delete;
+		
+		void         load(const std::vector<std::string>& Files, 
+						  const LoadCallback&             Fn);
+		void         save(const std::vector<std::string>& Files, 
+						  const std::vector<ID3v2_tag*>&  Tags, 
+						  const SaveCallback&             Fn);
+		
+		bool         usesUring() const noexcept;
+		AsyncIOStats stats() const noexcept;
+	
+	private:
+		void         loadWithRing(const std::vector<std::string>& Files, 
+								  const LoadCallback&             Fn, 
+								  std::vector<size_t>&            Leftover);
+		void         saveWithRing(const std::vector<std::string>& Files, 
+								  const std::vector<ID3v2_tag*>&  Tags, 
+								  const SaveCallback&             Fn, 
+								  std::vector<size_t>&            Leftover);
+		void         loadWithThreads(const std::vector<std::string>& Files, 
+									 const std::vector<size_t>&      Which, 
+									 const LoadCallback&             Fn);
+		void         saveWithThreads(const std::vector<std::string>& Files, 
+									 const std::vector<ID3v2_tag*>&  Tags, 
+									 const std::vector<size_t>&      Which, 
+									 const SaveCallback&             Fn);
+		void         finishInPlace(ID3v2_tag* Tag, int64_t Capacity);
+		void         count(const AsyncIOStats& Delta);
+
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto GetTagCapacity(const char* Data, size_t Length)->int64_t;
+auto GetFramesSize(const ID3v2_tag* Tag)->int64_t;
+auto RenderTag(const ID3v2_tag*   Tag, 
+			   int64_t            Capacity, 
+			   std::vector<char>& Out)->bool;
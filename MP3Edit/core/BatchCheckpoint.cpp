@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      BatchCheckpoint.cpp
+// FILE PURPOSE:  Defines the class 'BatchCheckpoint', and its file format.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstdio>
+#include <cstring>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib/codec.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "BatchCheckpoint.hpp"
+#include "TagIndex.hpp"
+
+
+/* *************************** IMPORTED NAMESPACES ************************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// The file is the magic, then (each 8 bytes, big-endian) the list hash, the 
+// job hash, the file count, the save time, the cursor and the number of 
+// words, and then the words, starting with the one that holds the cursor:
+constexpr static const char     kCHECKPOINT_MAGIC[8] = { 'M', 'P', '3', 'E', 'C', 'K', 'P', '1' };
+constexpr static const size_t   kCHECKPOINT_HEAD     = sizeof(kCHECKPOINT_MAGIC) + (6 * 8);
+constexpr static const uint64_t kFNV_OFFSET          = 0xCBF29CE484222325ull;
+constexpr static const uint64_t kFNV_PRIME           = 0x100000001B3ull;
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    HashBytes
+// PURPOSE: Continues the 64-bit FNV-1a hash 'Hash' over 'Length' bytes.
+auto static HashBytes(uint64_t Hash, const char* Data, size_t Length)->uint64_t {
+	for (size_t i = 0; i < Length; ++i) {
+		Hash = (Hash ^ static_cast<uint8_t>(Data[i])) * kFNV_PRIME;
+	}
+	return Hash;
+}
+
+
+// NAME:    NowNs
+// PURPOSE: Returns the time on 'Clock', in nanoseconds since its epoch.
+template <typename Clock>
+auto static NowNs()->int64_t {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		Clock::now().time_since_epoch()).count();
+}
+
+
+// NAME:    PutNumber
+// PURPOSE: Appends 'Value' to 'Out' as 8 big-endian bytes.
+auto static PutNumber(std::string& Out, uint64_t Value)->void {
+	uint8_t bytes_[8];
+	id3_write_be32(bytes_, static_cast<uint32_t>(Value >> 32));
+	id3_write_be32(bytes_ + 4, static_cast<uint32_t>(Value));
+	Out.append(reinterpret_cast<const char*>(bytes_), sizeof(bytes_));
+}
+
+
+// NAME:    GetNumber
+// PURPOSE: Reads the number 'PutNumber()' wrote at 'Data'.
+auto static GetNumber(const char* Data)->uint64_t {
+	const uint8_t* bytes_ = reinterpret_cast<const uint8_t*>(Data);
+	return (static_cast<uint64_t>(id3_read_be32(bytes_)) << 32) | id3_read_be32(bytes_ + 4);
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+// Starts with no file done; 'resume()' loads the checkpoint in 'Filename'.
+BatchCheckpoint::BatchCheckpoint(const std::string&              Filename, 
+								 const std::vector<std::string>& Files, 
+								 const std::string&              Job, 
+								 uint32_t                        IntervalMs) 
+	: Path_(Filename), 
+	  ListHash_(kFNV_OFFSET), 
+	  JobHash_(HashBytes(kFNV_OFFSET, Job.data(), Job.size())), 
+	  Count_(Files.size()), 
+	  Words_((Files.size() + 63) / 64), 
+	  Done_(new std::atomic<uint64_t>[(Files.size() + 63) / 64]), 
+	  IntervalNs_(static_cast<int64_t>(IntervalMs) * 1000000) {
+	for (const std::string& file_ : Files) {
+		ListHash_ = HashBytes(ListHash_, file_.c_str(), file_.size() + 1);
+	}
+	for (size_t w = 0; w < Words_; ++w) {
+		Done_[w].store(0, std::memory_order_relaxed);
+	}
+	LastSave_ = NowNs<std::chrono::steady_clock>();
+}
+
+
+BatchCheckpoint::~BatchCheckpoint() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    resume
+// DESCRIPTION: Loads the saved checkpoint, if it is one of this job, and 
+//              returns the number of files it marks done (0 if there was none 
+//              to use).
+size_t BatchCheckpoint::resume() {
+	std::error_code ec_;
+	const uint64_t  size_ = fs::file_size(Path_, ec_);
+	std::FILE*      in_   = (ec_ || (size_ < kCHECKPOINT_HEAD)) 
+							? nullptr : std::fopen(Path_.c_str(), "rb");
+	if (in_ == nullptr) {
+		return 0;
+	}
+	std::string data_(static_cast<size_t>(size_), '\0');
+	const bool  read_ = (std::fread(data_.data(), 1, data_.size(), in_) == data_.size());
+	std::fclose(in_);
+	
+	const char*    at_     = data_.data() + sizeof(kCHECKPOINT_MAGIC);
+	const uint64_t cursor_ = read_ ? GetNumber(at_ + 32) : 0;
+	const uint64_t words_  = read_ ? GetNumber(at_ + 40) : 0;
+	if (!read_ 
+		|| (std::memcmp(data_.data(), kCHECKPOINT_MAGIC, sizeof(kCHECKPOINT_MAGIC)) != 0) 
+		|| (GetNumber(at_) != ListHash_) 
+		|| (GetNumber(at_ + 8) != JobHash_) 
+		|| (GetNumber(at_ + 16) != Count_) 
+		|| (cursor_ > Count_) 
+		|| (words_ > Words_ - (cursor_ / 64)) 
+		|| (size_ != kCHECKPOINT_HEAD + (words_ * 8))) {
+		return 0;
+	}
+	ResumedAt_ = static_cast<int64_t>(GetNumber(at_ + 24));
+	
+	// Everything before the cursor is done; the words say the rest:
+	size_t done_ = 0;
+	for (size_t i = 0; i < (cursor_ & ~static_cast<uint64_t>(63)); i += 64) {
+		Done_[i / 64].store(~0ull, std::memory_order_relaxed);
+		done_ += 64;
+	}
+	at_ += 48;
+	for (size_t w = 0; w < words_; ++w, at_ += 8) {
+		uint64_t word_ = GetNumber(at_);
+		if ((cursor_ / 64) + w == Words_ - 1) {
+			word_ &= ((Count_ % 64) != 0) ? ((1ull << (Count_ % 64)) - 1) : ~0ull;
+		}
+		Done_[(cursor_ / 64) + w].store(word_, std::memory_order_relaxed);
+		for (; word_ != 0; word_ &= (word_ - 1)) {
+			++done_;
+		}
+	}
+	return done_;
+}
+
+
+// FUNCTION:    skip
+// DESCRIPTION: Tells whether file 'Index' ('Filename') was done before the 
+//              checkpoint resumed from was saved, and has not been modified 
+//              since. Costs one stat for a file marked done, and nothing for 
+//              any other.
+bool BatchCheckpoint::skip(size_t Index, const std::string& Filename) const {
+	if ((ResumedAt_ < 0) || !isDone(Index)) {
+		return false;
+	}
+	FileKey key_;
+	return GetFileKey(Filename, key_) && (key_.MtimeNs_ <= ResumedAt_);
+}
+
+
+// FUNCTION:    markDone
+// DESCRIPTION: Marks file 'Index' done, and saves the checkpoint if the 
+//              interval has passed since the last save (unless another thread 
+//              is saving it already).
+void BatchCheckpoint::markDone(size_t Index) {
+	if (Index >= Count_) {
+		return;
+	}
+	Done_[Index / 64].fetch_or(1ull << (Index % 64), std::memory_order_release);
+	const int64_t now_ = NowNs<std::chrono::steady_clock>();
+	if (now_ - LastSave_.load(std::memory_order_relaxed) < IntervalNs_) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock_(SaveLock_, std::try_to_lock);
+	if (lock_.owns_lock() && (now_ - LastSave_.load() >= IntervalNs_)) {
+		write();
+		LastSave_ = now_;
+	}
+}
+
+
+// FUNCTION:    save
+// DESCRIPTION: Saves the checkpoint now.
+bool BatchCheckpoint::save() {
+	std::lock_guard<std::mutex> guard_(SaveLock_);
+	LastSave_ = NowNs<std::chrono::steady_clock>();
+	return write();
+}
+
+
+// FUNCTION:    remove
+// DESCRIPTION: Deletes the saved checkpoint, once the job is complete.
+void BatchCheckpoint::remove() {
+	std::lock_guard<std::mutex> guard_(SaveLock_);
+	std::error_code ec_;
+	fs::remove(Path_, ec_);
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+bool BatchCheckpoint::isDone(size_t Index) const noexcept {
+	return (Index < Count_) 
+		   && ((Done_[Index / 64].load(std::memory_order_acquire) >> (Index % 64)) & 1u);
+}
+
+
+// FUNCTION:    write
+// DESCRIPTION: Writes the checkpoint beside its file and renames it over it. 
+//              The save time is taken before the words are read, so it errs 
+//              early: a file a worker saves and marks in between is in the 
+//              snapshot with a newer time, and 'skip()' redoes it rather 
+//              than trust it, while any file changed after the save time is 
+//              redone. Bits only ever get set, so a file marked while the 
+//              words are read is at worst left for the next save. The caller 
+//              holds 'SaveLock_'.
+bool BatchCheckpoint::write() {
+	const int64_t savedAt_ = NowNs<std::chrono::system_clock>();
+	std::vector<uint64_t> words_(Words_);
+	for (size_t w = 0; w < Words_; ++w) {
+		words_[w] = Done_[w].load(std::memory_order_acquire);
+	}
+	size_t first_ = 0;
+	while ((first_ < Words_) && (words_[first_] == ~0ull)) {
+		++first_;
+	}
+	size_t cursor_ = first_ * 64;
+	if (first_ < Words_) {
+		while ((cursor_ < Count_) && ((words_[first_] >> (cursor_ % 64)) & 1u)) {
+			++cursor_;
+		}
+	}
+	cursor_ = std::min(cursor_, Count_);
+	size_t last_ = Words_;
+	while ((last_ > first_) && (words_[last_ - 1] == 0)) {
+		--last_;
+	}
+	
+	std::string out_(kCHECKPOINT_MAGIC, sizeof(kCHECKPOINT_MAGIC));
+	PutNumber(out_, ListHash_);
+	PutNumber(out_, JobHash_);
+	PutNumber(out_, Count_);
+	PutNumber(out_, static_cast<uint64_t>(savedAt_));
+	PutNumber(out_, cursor_);
+	PutNumber(out_, last_ - first_);
+	for (size_t w = first_; w < last_; ++w) {
+		PutNumber(out_, words_[w]);
+	}
+	
+	const std::string temp_ = Path_ + ".tmp";
+	std::FILE*        file_ = std::fopen(temp_.c_str(), "wb");
+	if (file_ == nullptr) {
+		return false;
+	}
+	bool ok_ = (std::fwrite(out_.data(), 1, out_.size(), file_) == out_.size()) 
+			   && (std::fflush(file_) == 0);
+#if defined(__linux__)
+	ok_ = ok_ && (::fsync(::fileno(file_)) == 0);
+#endif
+	ok_ = (std::fclose(file_) == 0) && ok_;
+	// 'fs::rename()' replaces an existing file everywhere ('std::rename()' 
+	// fails on Windows when the target exists):
+	std::error_code ec_;
+	if (ok_) {
+		fs::rename(temp_, Path_, ec_);
+	}
+	if (!ok_ || ec_) {
+		std::remove(temp_.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      BatchCheckpoint.hpp
+// FILE PURPOSE:  Declares the class 'BatchCheckpoint', which records which 
+//                files of a batch job are done, and saves that to a compact 
+//                file at regular intervals so that a killed job can resume.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+#include <cstddef>
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const uint32_t kCHECKPOINT_INTERVAL_MS = 5000;
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// A checkpoint holds one bit per file of the job, and the cursor: the first 
+// file not yet done. Only the bits from the cursor's word up to the last file 
+// done are written, so a job that runs mostly in order saves a few bytes however 
+// many files it has. A checkpoint belongs to one list of files and one 'Job' 
+// (the caller's description of the work); any other is ignored. On resume, a 
+// file marked done is skipped after a single stat, unless it was modified 
+// after the checkpoint was saved. 'markDone()' and 'skip()' may be called from 
+// any thread.
+class BatchCheckpoint {
+
+	private:
+		std::string                              Path_;
+		uint64_t                                 ListHash_;
+		uint64_t                                 JobHash_;
+		size_t                                   Count_;
+		size_t                                   Words_;
+		std::unique_ptr<std::atomic<uint64_t>[]> Done_;           // One bit per file
+		int64_t                                  ResumedAt_ = -1; // Save time (ns) of the checkpoint resumed from
+		int64_t                                  IntervalNs_;
+		std::atomic<int64_t>                     LastSave_{0};    // Steady clock (ns)
+		std::mutex                               SaveLock_;
+	
+	public:
+		BatchCheckpoint() = delete;
+		BatchCheckpoint(const std::string&              Filename, 
+						const std::vector<std::string>& Files, 
+						const std::string&              Job, 
+						uint32_t                        IntervalMs = kCHECKPOINT_INTERVAL_MS);
+		~BatchCheckpoint() noexcept;
+		
+		BatchCheckpoint(const BatchCheckpoint&)            = delete;
+		BatchCheckpoint& operator=(const BatchCheckpoint&) = delete;
+		
+		size_t resume();
+		bool   skip(size_t Index, const std::string& Filename) const;
+		void   markDone(size_t Index);
+		bool   save();
+		void   remove();
+	
+	private:
+		bool   isDone(size_t Index) const noexcept;
+		bool   write();
+
+};
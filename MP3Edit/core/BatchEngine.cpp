@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      BatchEngine.cpp
+// FILE PURPOSE:  Defines the class 'BatchEngine'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <chrono>
+#include <exception>
+#include <filesystem>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "BatchEngine.hpp"
+#include "WorkStealingPool.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const int32_t kFILE_UNCHANGED = 0;
+constexpr static const int32_t kFILE_MODIFIED  = 1;
+constexpr static const int32_t kFILE_FAILED    = 2;
+constexpr static const int32_t kFILE_SKIPPED   = 3;
+
+// How long a worker waits for a busy device before re-queueing the file:
+constexpr static const auto kDEVICE_RETRY = std::chrono::milliseconds(2);
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+BatchEngine::BatchEngine() noexcept {}
+
+
+BatchEngine::BatchEngine(BatchOptions Options) noexcept 
+	: Options_(Options) {}
+
+
+BatchEngine::~BatchEngine() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+void BatchEngine::setProgressCallback(ProgressCallback Callback) {
+	OnProgress_ = std::move(Callback);
+}
+
+
+// FUNCTION:    cancel
+// DESCRIPTION: Asks a running job to stop. Files that are already being 
+//              processed are finished (so no file is left half-written); the 
+//              rest are counted as skipped. Safe to call from any thread, 
+//              including from inside the progress callback.
+void BatchEngine::cancel() noexcept {
+	Cancelled_ = true;
+}
+
+
+bool BatchEngine::isCancelled() const noexcept {
+	return Cancelled_.load();
+}
+
+
+// FUNCTION:    run
+// DESCRIPTION: Loads the tag of every file in 'Files', passes it to 'Fn', and 
+//              saves it if 'Fn' returns 'true'. Files are spread over a 
+//              work-stealing thread pool, with at most 
+//              'BatchOptions::MaxPerDevice_' files open at once on any one 
+//              storage device. Blocks until the job is done or cancelled.
+BatchResult BatchEngine::run(const std::vector<std::string>& Files, 
+							 const Transform&                Fn) {
+	struct FileTask {
+		size_t   Index_      = 0;
+		uint64_t Device_     = 0;
+		bool     HaveDevice_ = false;
+	};
+	
+	BatchResult   result_;
+	BatchProgress progress_;
+	result_.FilesTotal_   = Files.size();
+	progress_.FilesTotal_ = Files.size();
+	Cancelled_            = false;
+	
+	WorkStealingPool pool_(Options_.Threads_);
+	
+	// Tallies the outcome for one file and reports progress:
+	auto finish_ = [&](const std::string& file_, int32_t status_) {
+		std::lock_guard<std::mutex> guard_(ProgressLock_);
+		switch (status_) {
+			case kFILE_MODIFIED:
+				++result_.FilesModified_;
+				++progress_.FilesModified_;
+				break;
+			case kFILE_FAILED:
+				++result_.FilesFailed_;
+				++progress_.FilesFailed_;
+				result_.FailedFiles_.push_back(file_);
+				break;
+			case kFILE_SKIPPED:
+				++result_.FilesSkipped_;
+				break;
+			default:
+				++result_.FilesUnchanged_;
+				break;
+		}
+		++progress_.FilesDone_;
+		progress_.CurrentFile_ = file_;
+		if (OnProgress_) {
+			OnProgress_(progress_);
+		}
+	};
+	
+	std::function<void(FileTask, bool)> schedule_;
+	schedule_ = [&](FileTask task_, bool retry_) {
+		auto body_ = [&, task_]() mutable {
+			const std::string& file_ = Files[task_.Index_];
+			if (Cancelled_) {
+				finish_(file_, kFILE_SKIPPED);
+				return;
+			}
+			
+			// Respect the per-device cap; if the device is busy, wait briefly 
+			// and put the file back in the queue rather than tying up this 
+			// worker, which can meanwhile run files from other devices:
+			const bool limited_ = (Options_.MaxPerDevice_ > 0);
+			if (limited_) {
+				if (!task_.HaveDevice_) {
+					task_.Device_     = GetDeviceId(file_);
+					task_.HaveDevice_ = true;
+				}
+				if (!tryAcquireDevice(task_.Device_)) {
+					waitForDevice(task_.Device_);
+					schedule_(task_, true);
+					return;
+				}
+			}
+			
+			int32_t status_ = processFile(file_, Fn);
+			if (limited_) {
+				releaseDevice(task_.Device_);
+			}
+			finish_(file_, status_);
+		};
+		if (retry_) {
+			pool_.defer(std::move(body_));
+		} else {
+			pool_.submit(std::move(body_));
+		}
+	};
+	
+	for (size_t i = 0; i < Files.size(); ++i) {
+		FileTask task_;
+		task_.Index_ = i;
+		schedule_(task_, false);
+	}
+	pool_.wait();
+	
+	result_.Cancelled_ = Cancelled_.load();
+	return result_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+bool BatchEngine::tryAcquireDevice(uint64_t Device) {
+	std::lock_guard<std::mutex> guard_(DeviceLock_);
+	size_t& active_ = DeviceActive_[Device];
+	if (active_ >= Options_.MaxPerDevice_) {
+		return false;
+	}
+	++active_;
+	return true;
+}
+
+
+void BatchEngine::releaseDevice(uint64_t Device) {
+	{
+		std::lock_guard<std::mutex> guard_(DeviceLock_);
+		--DeviceActive_[Device];
+	}
+	DeviceFree_.notify_all();
+}
+
+
+void BatchEngine::waitForDevice(uint64_t Device) {
+	std::unique_lock<std::mutex> lock_(DeviceLock_);
+	DeviceFree_.wait_for(lock_, kDEVICE_RETRY, [&]() {
+		return DeviceActive_[Device] < Options_.MaxPerDevice_;
+	});
+}
+
+
+// FUNCTION:    processFile
+// DESCRIPTION: Runs load -> transform -> save for a single file. The padding 
+//              policy is shared by all workers, so each save works on a copy 
+//              and the edit is then recorded on the shared policy under a 
+//              lock (this is what lets PADDING_ADAPTIVE learn across files).
+int32_t BatchEngine::processFile(const std::string& Filename, 
+								 const Transform&   Fn) {
+	std::error_code ec_;
+	if (!fs::is_regular_file(Filename, ec_)) {
+		return kFILE_FAILED;
+	}
+	
+	ID3v2_tag* tag_ = load_tag(Filename.c_str());
+	if (tag_ == nullptr) {
+		if (!Options_.CreateMissingTags_) {
+			return kFILE_UNCHANGED;
+		}
+		tag_ = new_tag();
+	}
+	
+	int32_t status_ = kFILE_UNCHANGED;
+	try {
+		if (Fn(Filename, tag_)) {
+			ID3v2_padding_policy policy_;
+			{
+				std::lock_guard<std::mutex> guard_(PolicyLock_);
+				policy_ = Options_.PaddingPolicy_;
+			}
+			const int32_t oldSize_ = tag_->used_size;
+			if (set_tag_with_padding_policy(Filename.c_str(), tag_, &policy_) 
+				== TAG_WRITE_FAILED) {
+				status_ = kFILE_FAILED;
+			} else {
+				std::lock_guard<std::mutex> guard_(PolicyLock_);
+				record_padding_edit(&Options_.PaddingPolicy_, 
+									oldSize_, 
+									tag_->used_size);
+				status_ = kFILE_MODIFIED;
+			}
+		}
+	} catch (...) {
+		// A throwing transform fails its own file, not the whole job:
+		status_ = kFILE_FAILED;
+	}
+	
+	free_tag(tag_);
+	return status_;
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    GetDeviceId
+// DESCRIPTION: Returns the ID of the storage device that holds 'Filename' 
+//              (the 'st_dev' field of 'stat()'), or 0 if it cannot be read.
+auto GetDeviceId(const std::string& Filename)->uint64_t {
+#ifdef _WIN32
+	struct _stat64 st_;
+	if (_stat64(Filename.c_str(), &st_) != 0) {
+		return 0;
+	}
+#else
+	struct stat st_;
+	if (stat(Filename.c_str(), &st_) != 0) {
+		return 0;
+	}
+#endif
+	return static_cast<uint64_t>(st_.st_dev);
+}
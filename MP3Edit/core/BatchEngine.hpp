@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      BatchEngine.hpp
+// FILE PURPOSE:  Declares the class 'BatchEngine', which runs a 
+//                load -> transform -> save job over many MP3s in parallel, 
+//                without any dependency on the GUI.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct BatchOptions {
+	size_t  Threads_             = 0;     // 0 = one per hardware thread
+	size_t  MaxPerDevice_        = 4;     // Concurrent files per device; 0 = no cap
+	bool    CreateMissingTags_   = false; // Give tag-less files a new tag
+	ID3v2_padding_policy PaddingPolicy_ = *get_default_padding_policy();
+};
+
+struct BatchProgress {
+	size_t      FilesTotal_    = 0;
+	size_t      FilesDone_     = 0; // Includes failed and skipped files
+	size_t      FilesModified_ = 0;
+	size_t      FilesFailed_   = 0;
+	std::string CurrentFile_;
+};
+
+struct BatchResult {
+	size_t FilesTotal_     = 0;
+	size_t FilesModified_  = 0;
+	size_t FilesUnchanged_ = 0;
+	size_t FilesFailed_    = 0;
+	size_t FilesSkipped_   = 0; // Not processed because the job was cancelled
+	size_t FilesResumed_   = 0; // Done by an earlier, interrupted run (see 'TagPipeline')
+	bool   Cancelled_      = false;
+	std::vector<std::string> FailedFiles_;
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+class BatchEngine {
+
+	public:
+		// Returns 'true' if it changed 'Tag' and the file should be saved:
+		using Transform = std::function<bool(const std::string& Filename, 
+											 ID3v2_tag*         Tag)>;
+		// Called from worker threads, one call at a time:
+		using ProgressCallback = std::function<void(const BatchProgress&)>;
+	
+	private:
+		BatchOptions                 Options_;
+		ProgressCallback             OnProgress_;
+		std::atomic<bool>            Cancelled_{false};
+		std::mutex                   ProgressLock_;
+		std::mutex                   PolicyLock_;
+		std::mutex                   DeviceLock_;
+		std::condition_variable      DeviceFree_;
+		std::map<uint64_t, size_t>   DeviceActive_;
+	
+	public:
+		BatchEngine() noexcept;
+		explicit BatchEngine(BatchOptions Options) noexcept;
+		~BatchEngine() noexcept;
+		
+		void        setProgressCallback(ProgressCallback Callback);
+		void        cancel() noexcept;
+		bool        isCancelled() const noexcept;
+		BatchResult run(const std::vector<std::string>& Files, 
+						const Transform&                Fn);
+	
+	private:
+		bool        tryAcquireDevice(uint64_t Device);
+		void        releaseDevice(uint64_t Device);
+		void        waitForDevice(uint64_t Device);
+		int32_t     processFile(const std::string& Filename, 
+								const Transform&   Fn);
+
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto GetDeviceId(const std::string& Filename)->uint64_t;
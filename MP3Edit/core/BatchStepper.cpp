@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      BatchStepper.cpp
+// FILE PURPOSE:  Defines the class 'BatchStepper'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "BatchStepper.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// A background thread with nothing to do (or nowhere to put its output) 
+// yields this many times, then sleeps for 'kIDLE_WAIT' between tries:
+constexpr static const unsigned kSPIN_YIELDS = 64;
+constexpr static const auto     kIDLE_WAIT   = std::chrono::microseconds(100);
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    Backoff
+// PURPOSE: Waits a little before a thread retries a full or empty queue.
+auto static Backoff(unsigned& Spins)->void {
+	if (++Spins < kSPIN_YIELDS) {
+		std::this_thread::yield();
+	} else {
+		std::this_thread::sleep_for(kIDLE_WAIT);
+	}
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+// Nothing runs until 'start()':
+BatchStepper::BatchStepper(std::vector<std::string> Files, 
+						   Transform                Fn, 
+						   StepperOptions           Options) 
+	: Files_(std::move(Files)), 
+	  Fn_(std::move(Fn)), 
+	  Options_(Options), 
+	  ParseQueue_(Options.QueueCapacity_), 
+	  WriteQueue_(Options.QueueCapacity_), 
+	  Results_(Options.ResultCapacity_), 
+	  ReadersLeft_(std::max<size_t>(Options.ReadThreads_, 1)) {
+	Result_.FilesTotal_ = Files_.size();
+}
+
+
+// Cancels the job, and waits for the files already handed to the write thread 
+// to be saved (their results are counted, as if taken by 'poll()'):
+BatchStepper::~BatchStepper() noexcept {
+	cancel();
+	for (std::thread& reader_ : Readers_) {
+		reader_.join();
+	}
+	Item item_;
+	while (ParseQueue_.tryPop(item_)) {
+		drop(item_);
+	}
+	if (Holding_) {
+		drop(Held_);
+		Holding_ = false;
+	}
+	StepsDone_ = true;
+	if (Writer_.joinable()) {
+		StepResult result_;
+		unsigned   spins_ = 0;
+		while (!isDone()) {
+			if (!poll(result_)) {
+				Backoff(spins_);
+			}
+		}
+		Writer_.join();
+	}
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    start
+// DESCRIPTION: Starts the read threads and the write thread. Does nothing if 
+//              they are already started.
+void BatchStepper::start() {
+	if (Writer_.joinable()) {
+		return;
+	}
+	for (size_t t = ReadersLeft_.load(); t > 0; --t) {
+		Readers_.emplace_back(&BatchStepper::read, this);
+	}
+	Writer_ = std::thread(&BatchStepper::write, this);
+}
+
+
+// FUNCTION:    step
+// DESCRIPTION: Parses and transforms the files the read threads have ready, 
+//              and hands the changed ones to the write thread, until about 
+//              'BudgetUs' microseconds have passed (at least one file is 
+//              done, if one is ready). Returns early, without waiting, when 
+//              no file is ready or the write thread is behind. Returns 
+//              'false' once every file has been passed on.
+bool BatchStepper::step(uint32_t BudgetUs) {
+	if (StepsDone_) {
+		return false;
+	}
+	const auto until_ = std::chrono::steady_clock::now() 
+						+ std::chrono::microseconds(BudgetUs);
+	do {
+		if (Holding_) {
+			if (!WriteQueue_.tryPush(Held_)) {
+				return true;
+			}
+			Holding_ = false;
+		}
+		
+		// As in 'TagPipeline', the readers are counted before the queue is 
+		// tried, so that a file pushed just before the last one quit is seen:
+		const bool last_ = (ReadersLeft_.load() == 0);
+		Item       item_;
+		if (!ParseQueue_.tryPop(item_)) {
+			if (last_) {
+				StepsDone_ = true;
+				return false;
+			}
+			return true;
+		}
+		if (Cancelled_) {
+			drop(item_);
+			continue;
+		}
+		
+		if (item_.Status_ == StepStatus::Modified) {
+			if (!item_.Raw_.empty()) {
+				item_.Tag_ = load_tag_with_buffer(item_.Raw_.data(), 
+												  static_cast<int32_t>(item_.Raw_.size()));
+				std::vector<char>().swap(item_.Raw_);
+			}
+			if ((item_.Tag_ == nullptr) && Options_.CreateMissingTags_) {
+				item_.Tag_ = new_tag();
+			}
+			try {
+				if ((item_.Tag_ == nullptr) || !Fn_(Files_[item_.Index_], item_.Tag_)) {
+					item_.Status_ = StepStatus::Unchanged;
+				}
+			} catch (...) {
+				// A throwing transform fails its own file, not the whole job:
+				item_.Status_ = StepStatus::Failed;
+			}
+			if ((item_.Status_ != StepStatus::Modified) && (item_.Tag_ != nullptr)) {
+				free_tag(item_.Tag_);
+				item_.Tag_ = nullptr;
+			}
+		}
+		
+		// Every file goes on to the write thread, which posts its result:
+		if (!WriteQueue_.tryPush(item_)) {
+			Held_    = std::move(item_);
+			Holding_ = true;
+			return true;
+		}
+	} while (std::chrono::steady_clock::now() < until_);
+	return true;
+}
+
+
+// FUNCTION:    poll
+// DESCRIPTION: Takes the next file's outcome, in the order the files were 
+//              saved, and counts it in 'result()'. Returns 'false' if there 
+//              is none yet.
+bool BatchStepper::poll(StepResult& Result) {
+	const bool done_ = WriterDone_.load();
+	if (!Results_.tryPop(Result)) {
+		// Whatever was never passed on was skipped by a cancel:
+		if (done_) {
+			Result_.FilesSkipped_ = Result_.FilesTotal_ - Result_.FilesModified_ 
+									- Result_.FilesUnchanged_ - Result_.FilesFailed_;
+			Result_.Cancelled_    = Cancelled_.load();
+		}
+		return false;
+	}
+	switch (Result.Status_) {
+		case StepStatus::Modified:
+			++Result_.FilesModified_;
+			break;
+		case StepStatus::Failed:
+			++Result_.FilesFailed_;
+			Result_.FailedFiles_.push_back(Files_[Result.Index_]);
+			break;
+		default:
+			++Result_.FilesUnchanged_;
+			break;
+	}
+	return true;
+}
+
+
+// FUNCTION:    cancel
+// DESCRIPTION: Asks the job to stop. Files already handed to the write thread 
+//              are saved (so no file is left half-written); the rest are 
+//              counted as skipped. Safe to call from any thread.
+void BatchStepper::cancel() noexcept {
+	Cancelled_ = true;
+}
+
+
+bool BatchStepper::isCancelled() const noexcept {
+	return Cancelled_.load();
+}
+
+
+// FUNCTION:    isDone
+// DESCRIPTION: Tells whether the job is over and every result has been taken 
+//              by 'poll()'; 'result()' is then final.
+bool BatchStepper::isDone() const noexcept {
+	return WriterDone_.load() && Results_.empty();
+}
+
+
+// FUNCTION:    result
+// DESCRIPTION: Returns the counts of the results taken by 'poll()' so far.
+const BatchResult& BatchStepper::result() const noexcept {
+	return Result_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    read
+// DESCRIPTION: A read thread: fetches each file's raw tag, with the same calls 
+//              as 'load_tag()', and queues it for 'step()' (parsed already, if 
+//              it is over 'StepParseLimit_'). A file that cannot be opened, 
+//              or whose tag is cut short, is queued as failed. As in 'TagPipeline', a tag is only read once 
+//              the memory budget has room for it.
+void BatchStepper::read() {
+	for (size_t i = Next_++; (i < Files_.size()) && !Cancelled_; i = Next_++) {
+		const std::string& file_ = Files_[i];
+		std::error_code    ec_;
+		Item               item_;
+		item_.Index_ = i;
+		std::FILE* in_ = fs::is_regular_file(file_, ec_) 
+						 ? std::fopen(file_.c_str(), "rb") : nullptr;
+		if (in_ == nullptr) {
+			item_.Status_ = StepStatus::Failed;
+		} else {
+			char          head_[ID3_HEADER + ID3_EXTENDED_HEADER_SIZE];
+			const size_t  got_    = std::fread(head_, 1, sizeof(head_), in_);
+			ID3v2_header* header_ = get_tag_header_with_buffer(
+				head_, static_cast<int32_t>(got_));
+			if (header_ != nullptr) {
+				item_.Charge_ = ID3_HEADER + static_cast<uint64_t>(header_->tag_size);
+				free(header_);
+				if (!acquireMemory(item_.Charge_)) {
+					std::fclose(in_);
+					break;  // Cancelled: this file and the rest are skipped
+				}
+				item_.Raw_.assign(static_cast<size_t>(item_.Charge_), '\0');
+				const size_t headBytes_ = std::min(got_, item_.Raw_.size());
+				std::memcpy(item_.Raw_.data(), head_, headBytes_);
+				if (std::fread(item_.Raw_.data() + headBytes_, 1, 
+							   item_.Raw_.size() - headBytes_, in_) 
+					!= (item_.Raw_.size() - headBytes_)) {
+					// The file is shorter than its tag says (or shrank):
+					drop(item_);
+					item_.Status_ = StepStatus::Failed;
+				}
+			}
+			std::fclose(in_);
+		}
+		if (item_.Raw_.size() > Options_.StepParseLimit_) {
+			item_.Tag_ = load_tag_with_buffer(item_.Raw_.data(), 
+											  static_cast<int32_t>(item_.Raw_.size()));
+			std::vector<char>().swap(item_.Raw_);
+		}
+		
+		unsigned spins_ = 0;
+		while (!ParseQueue_.tryPush(item_)) {
+			if (Cancelled_) {
+				drop(item_);
+				break;
+			}
+			Backoff(spins_);
+		}
+	}
+	--ReadersLeft_;
+}
+
+
+// FUNCTION:    write
+// DESCRIPTION: The write thread: saves each changed tag 'step()' passes on, 
+//              and posts every file's result, waiting while the caller has 
+//              not taken enough of them. Being the only thread that saves, it 
+//              hands 'write_tag()' the padding policy itself, with no copy or 
+//              lock, and lets it record each edit that succeeds.
+void BatchStepper::write() {
+	Item     item_;
+	unsigned spins_ = 0;
+	for (;;) {
+		const bool last_ = StepsDone_.load();
+		if (!WriteQueue_.tryPop(item_)) {
+			if (last_) {
+				break;
+			}
+			Backoff(spins_);
+			continue;
+		}
+		spins_ = 0;
+		
+		StepResult result_;
+		result_.Index_  = item_.Index_;
+		result_.Status_ = item_.Status_;
+		if (item_.Status_ == StepStatus::Modified) {
+			if (set_tag_with_padding_policy(Files_[item_.Index_].c_str(), item_.Tag_, 
+											&Options_.PaddingPolicy_) 
+				== TAG_WRITE_FAILED) {
+				result_.Status_ = StepStatus::Failed;
+			}
+		}
+		drop(item_);
+		while (!Results_.tryPush(result_)) {
+			Backoff(spins_);
+		}
+		spins_ = 0;
+	}
+	WriterDone_ = true;
+}
+
+
+// FUNCTION:    drop
+// DESCRIPTION: Frees what a file holds, and gives its memory back to the budget.
+void BatchStepper::drop(Item& Entry) noexcept {
+	if (Entry.Tag_ != nullptr) {
+		free_tag(Entry.Tag_);
+		Entry.Tag_ = nullptr;
+	}
+	std::vector<char>().swap(Entry.Raw_);
+	releaseMemory(Entry.Charge_);
+	Entry.Charge_ = 0;
+}
+
+
+// FUNCTION:    acquireMemory
+// DESCRIPTION: Charges 'Bytes' to the memory budget, waiting while it would be 
+//              overspent. Anything is let through while nothing else is held. 
+//              Returns 'false' if the job was cancelled while waiting.
+bool BatchStepper::acquireMemory(uint64_t Bytes) {
+	unsigned spins_ = 0;
+	uint64_t held_  = InFlight_.load();
+	while (!Cancelled_) {
+		if ((held_ == 0) || (held_ + Bytes <= Options_.MemoryBudget_)) {
+			if (InFlight_.compare_exchange_weak(held_, held_ + Bytes)) {
+				return true;
+			}
+			continue;
+		}
+		Backoff(spins_);
+		held_ = InFlight_.load();
+	}
+	return false;
+}
+
+
+void BatchStepper::releaseMemory(uint64_t Bytes) noexcept {
+	InFlight_ -= Bytes;
+}
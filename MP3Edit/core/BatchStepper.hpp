@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      BatchStepper.hpp
+// FILE PURPOSE:  Declares the class 'BatchStepper', which runs a batch 
+//                load -> transform -> save job in small time-boxed steps 
+//                on the caller's thread (so that a UI thread can drive it 
+//                between messages), with the file I/O on background threads.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "BatchEngine.hpp"
+#include "BoundedQueue.hpp"
+#include "SpscQueue.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct StepperOptions {
+	size_t   ReadThreads_       = 2;     // I/O: raw tag bytes off the disk
+	size_t   QueueCapacity_     = 64;    // Files waiting on either side of 'step()'
+	size_t   ResultCapacity_    = 1024;  // Results not yet taken by 'poll()'
+	size_t   StepParseLimit_    = 256 * 1024; // Larger tags are parsed by the read threads
+	uint64_t MemoryBudget_      = 64ull * 1024 * 1024; // Tag bytes in flight
+	bool     CreateMissingTags_ = false; // Give tag-less files a new tag
+	ID3v2_padding_policy PaddingPolicy_ = *get_default_padding_policy();
+};
+
+enum class StepStatus : uint8_t {
+	Unchanged, 
+	Modified, 
+	Failed
+};
+
+struct StepResult {
+	size_t     Index_  = 0; // Into the files given
+	StepStatus Status_ = StepStatus::Unchanged;
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// The same job as 'TagPipeline', but its parse/transform stage is not a thread
+// of its own: it runs inside 'step()', for as long as the caller allows, and 
+// never waits there. Read threads fill a queue of raw tags ahead of it (up to 
+// 'MemoryBudget_' bytes of tags, held until each file is saved), and a 
+// single write thread saves what it passes on and posts every file's outcome 
+// to a 'SpscQueue', which the caller empties with 'poll()'. A UI thread calls 
+// both from a timer, so that it stays responsive however many files there are; 
+// a step overruns its budget by at most one file's transform, and the parse 
+// of one tag of up to 'StepParseLimit_' bytes (a larger tag, say with a big 
+// cover picture, is parsed on its read thread instead). All member functions 
+// but 'cancel()' belong to the thread that made the object.
+class BatchStepper {
+
+	public:
+		using Transform = BatchEngine::Transform;
+	
+	private:
+		struct Item {
+			size_t            Index_  = 0;
+			std::vector<char> Raw_;              // The tag as read, header included
+			ID3v2_tag*        Tag_    = nullptr; // The tag as transformed
+			StepStatus        Status_ = StepStatus::Modified;
+			uint64_t          Charge_ = 0;       // Against the memory budget
+		};
+		
+		std::vector<std::string> Files_;
+		Transform                Fn_;
+		StepperOptions           Options_;
+		BoundedQueue<Item>       ParseQueue_; // Read threads -> 'step()'
+		SpscQueue<Item>          WriteQueue_; // 'step()' -> write thread
+		SpscQueue<StepResult>    Results_;    // Write thread -> 'poll()'
+		Item                     Held_;       // Parsed, but the write queue was full
+		bool                     Holding_ = false;
+		BatchResult              Result_;
+		std::atomic<size_t>      Next_{0};
+		std::atomic<size_t>      ReadersLeft_{0};
+		std::atomic<uint64_t>    InFlight_{0};       // Bytes charged to the budget
+		std::atomic<bool>        Cancelled_{false};
+		std::atomic<bool>        StepsDone_{false};  // 'step()' will pass on nothing more
+		std::atomic<bool>        WriterDone_{false}; // Every result is posted
+		std::vector<std::thread> Readers_;
+		std::thread              Writer_;
+	
+	public:
+		BatchStepper() = delete;
+		BatchStepper(std::vector<std::string> Files, 
+					 Transform                Fn, 
+					 StepperOptions           Options = StepperOptions());
+		~BatchStepper() noexcept;
+		
+		BatchStepper(const BatchStepper&)            = delete;
+		BatchStepper& operator=(const BatchStepper&) = delete;
+		
+		void               start();
+		bool               step(uint32_t BudgetUs);
+		bool               poll(StepResult& Result);
+		void               cancel() noexcept;
+		bool               isCancelled() const noexcept;
+		bool               isDone() const noexcept;
+		const BatchResult& result() const noexcept;
+	
+	private:
+		void               read();
+		void               write();
+		void               drop(Item& Entry) noexcept;
+		bool               acquireMemory(uint64_t Bytes);
+		void               releaseMemory(uint64_t Bytes) noexcept;
+
+};
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      BoundedQueue.hpp
+// FILE PURPOSE:  Declares and defines the class template 'BoundedQueue', a 
+//                fixed-capacity lock-free queue for any number of producers 
+//                and consumers.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstddef>
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// A ring of cells, each tagged with a sequence number that says whether it is 
+// ready to be written or read on the current lap (D. Vyukov's bounded MPMC 
+// queue). 'tryPush()' and 'tryPop()' never block and never allocate; a full 
+// or empty queue just returns 'false', and the caller decides how to wait.
+template <typename T>
+class BoundedQueue {
+
+	private:
+		struct Cell {
+			std::atomic<size_t> Sequence_;
+			T                   Value_;
+		};
+		
+		// Producers and consumers each get their own cache line:
+		std::unique_ptr<Cell[]> Cells_;
+		size_t                  Mask_;
+		alignas(64) std::atomic<size_t> Tail_{0};
+		alignas(64) std::atomic<size_t> Head_{0};
+	
+	public:
+		explicit BoundedQueue(size_t Capacity);
+		~BoundedQueue() noexcept = default;
+		
+		BoundedQueue(const BoundedQueue&)            = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+		
+		bool   tryPush(T& Value);
+		bool   tryPop(T& Value);
+		size_t capacity() const noexcept;
+
+};
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+// The capacity is rounded up to a power of two (at least 2):
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t Capacity) {
+	size_t size_ = 2;
+	while (size_ < Capacity) {
+		size_ <<= 1;
+	}
+	Cells_.reset(new Cell[size_]);
+	Mask_ = size_ - 1;
+	for (size_t i = 0; i < size_; ++i) {
+		Cells_[i].Sequence_.store(i, std::memory_order_relaxed);
+	}
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    tryPush
+// DESCRIPTION: Moves 'Value' into the queue, or returns 'false' (leaving 
+//              'Value' alone) if the queue is full.
+template <typename T>
+bool BoundedQueue<T>::tryPush(T& Value) {
+	size_t tail_ = Tail_.load(std::memory_order_relaxed);
+	for (;;) {
+		Cell&        cell_ = Cells_[tail_ & Mask_];
+		const size_t seq_  = cell_.Sequence_.load(std::memory_order_acquire);
+		const auto   lap_  = static_cast<std::ptrdiff_t>(seq_ - tail_);
+		if (lap_ == 0) {
+			if (Tail_.compare_exchange_weak(tail_, tail_ + 1, 
+											std::memory_order_relaxed)) {
+				cell_.Value_ = std::move(Value);
+				cell_.Sequence_.store(tail_ + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (lap_ < 0) {
+			return false; // The cell still holds last lap's value
+		} else {
+			tail_ = Tail_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+
+// FUNCTION:    tryPop
+// DESCRIPTION: Moves the oldest value into 'Value', or returns 'false' if the 
+//              queue is empty.
+template <typename T>
+bool BoundedQueue<T>::tryPop(T& Value) {
+	size_t head_ = Head_.load(std::memory_order_relaxed);
+	for (;;) {
+		Cell&        cell_ = Cells_[head_ & Mask_];
+		const size_t seq_  = cell_.Sequence_.load(std::memory_order_acquire);
+		const auto   lap_  = static_cast<std::ptrdiff_t>(seq_ - (head_ + 1));
+		if (lap_ == 0) {
+			if (Head_.compare_exchange_weak(head_, head_ + 1, 
+											std::memory_order_relaxed)) {
+				Value = std::move(cell_.Value_);
+				cell_.Sequence_.store(head_ + Mask_ + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (lap_ < 0) {
+			return false; // Nothing written to this cell yet
+		} else {
+			head_ = Head_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+
+template <typename T>
+size_t BoundedQueue<T>::capacity() const noexcept {
+	return Mask_ + 1;
+}
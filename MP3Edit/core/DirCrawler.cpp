@@ -0,0 +1,438 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      DirCrawler.cpp
+// FILE PURPOSE:  Defines 'CrawlDirectory()'. On Linux, every directory is read 
+//                with 'getdents64()' relative to its parent's descriptor, and 
+//                subdirectories are fanned out over a work-stealing pool; 
+//                elsewhere, it falls back to 'std::filesystem'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// PROJECT-SPECIFIC HEADERS:
+#include "DirCrawler.hpp"
+#include "WorkStealingPool.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const size_t kDIRENT_BUFFER_SIZE = 65536;
+constexpr static const size_t kINODE_SHARDS       = 64;
+
+
+/* ****************************** LOCAL TYPES ******************************* */
+namespace {
+
+// Set of (device, inode) pairs, split into shards so that workers rarely 
+// contend for the same lock:
+class InodeSet {
+	private:
+		struct KeyHash {
+			size_t operator()(const std::pair<uint64_t, uint64_t>& Key) const {
+				return std::hash<uint64_t>()(Key.second * 0x9E3779B97F4A7C15ULL
+											 ^ Key.first);
+			}
+		};
+		struct Shard {
+			std::mutex Lock_;
+			std::unordered_set<std::pair<uint64_t, uint64_t>, KeyHash> Keys_;
+		};
+		std::array<Shard, kINODE_SHARDS> Shards_;
+	
+	public:
+		// Returns 'true' the first time a given pair is inserted:
+		bool insert(uint64_t Device, uint64_t Inode) {
+			Shard& shard_ = Shards_[(Inode ^ (Inode >> 17)) % kINODE_SHARDS];
+			std::lock_guard<std::mutex> guard_(shard_.Lock_);
+			return shard_.Keys_.emplace(Device, Inode).second;
+		}
+};
+
+#if defined(__linux__)
+// Appends 'Name' to the folder path 'Dir' (which is "/" for the root):
+inline std::string JoinPath(const std::string& Dir, 
+							const char*        Name, 
+							size_t             Length) {
+	std::string path_;
+	path_.reserve(Dir.length() + 1 + Length);
+	path_.append(Dir);
+	if (path_.empty() || (path_.back() != '/')) {
+		path_.push_back('/');
+	}
+	path_.append(Name, Length);
+	return path_;
+}
+
+// Layout of the records returned by the 'getdents64' system call:
+struct LinuxDirent64 {
+	uint64_t       d_ino;
+	int64_t        d_off;
+	unsigned short d_reclen;
+	unsigned char  d_type;
+	char           d_name[1];
+};
+
+// An open directory. Children hold a reference only until they have opened 
+// themselves with 'openat()', so at most one descriptor per queued directory
+// level stays open:
+struct DirHandle {
+	int         Fd_     = -1;
+	uint64_t    Device_ = 0;
+	std::string Path_;
+	
+	~DirHandle() {
+		if (Fd_ >= 0) {
+			close(Fd_);
+		}
+	}
+};
+
+class LinuxCrawl {
+	private:
+		const CrawlOptions&       Options_;
+		WorkStealingPool          Pool_;
+		InodeSet                  SeenFiles_;
+		InodeSet                  SeenDirs_;
+		std::mutex                ResultLock_;
+		std::vector<CrawledFile>& Out_;
+		std::vector<CrawlError>&  Errors_;
+	
+	public:
+		LinuxCrawl(const CrawlOptions&       Options, 
+				   std::vector<CrawledFile>& Out, 
+				   std::vector<CrawlError>&  Errors) 
+			: Options_(Options), Pool_(Options.Threads_), Out_(Out), Errors_(Errors) {}
+		
+		void run(const std::string& Root) {
+			std::string root_ = Root;
+			while ((root_.length() > 1) && (root_.back() == '/')) {
+				root_.pop_back();
+			}
+			auto parent_ = std::make_shared<DirHandle>();
+			parent_->Fd_ = AT_FDCWD;
+			crawl(parent_, root_, true);
+			Pool_.wait();
+		}
+	
+	private:
+		void crawl(std::shared_ptr<DirHandle> Parent, 
+				   std::string                Name, 
+				   bool                       IsRoot);
+		void submit(const std::shared_ptr<DirHandle>& Parent, 
+					std::string                       Name);
+		void fail(std::string Path, int Error);
+};
+
+
+// Records that 'Path' could not be read ('Error' is the 'errno' value):
+void LinuxCrawl::fail(std::string Path, int Error) {
+	CrawlError error_;
+	error_.Path_  = std::move(Path);
+	error_.Error_ = Error;
+	std::lock_guard<std::mutex> guard_(ResultLock_);
+	Errors_.push_back(std::move(error_));
+}
+
+
+void LinuxCrawl::submit(const std::shared_ptr<DirHandle>& Parent, 
+						std::string                       Name) {
+	Pool_.submit([this, Parent, name_ = std::move(Name)]() mutable {
+		crawl(std::move(Parent), std::move(name_), false);
+	});
+}
+
+
+// Lists one directory. Regular files are matched on the name and 'd_type' 
+// alone; 'fstatat()' is only needed for symbolic links and for file systems 
+// that do not fill in 'd_type':
+void LinuxCrawl::crawl(std::shared_ptr<DirHandle> Parent, 
+					   std::string                Name, 
+					   bool                       IsRoot) {
+	int flags_ = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+	if (!Options_.FollowSymlinks_ && !IsRoot) {
+		flags_ |= O_NOFOLLOW;
+	}
+	auto dir_   = std::make_shared<DirHandle>();
+	dir_->Fd_   = openat(Parent->Fd_, Name.c_str(), flags_);
+	const int openError_ = errno;
+	dir_->Path_ = IsRoot 
+				  ? Name 
+				  : JoinPath(Parent->Path_, Name.c_str(), Name.length());
+	Parent.reset();
+	if (dir_->Fd_ < 0) {
+		// A link to a file (or nowhere) is not a folder to crawl, not an error:
+		if ((openError_ != ELOOP) || Options_.FollowSymlinks_ || IsRoot) {
+			fail(dir_->Path_, openError_);
+		}
+		return;
+	}
+	
+	struct stat st_;
+	if (fstat(dir_->Fd_, &st_) != 0) {
+		fail(dir_->Path_, errno);
+		return;
+	}
+	dir_->Device_ = static_cast<uint64_t>(st_.st_dev);
+	// Following links can lead back up the tree; visit each folder once:
+	if (Options_.FollowSymlinks_ 
+		&& !SeenDirs_.insert(st_.st_dev, st_.st_ino)) {
+		return;
+	}
+	
+	thread_local std::vector<char> buffer_(kDIRENT_BUFFER_SIZE);
+	std::vector<CrawledFile>       found_;
+	std::vector<std::string>       subdirs_;
+	
+	while (true) {
+		long read_ = syscall(SYS_getdents64, 
+							 dir_->Fd_, 
+							 buffer_.data(), 
+							 buffer_.size());
+		if (read_ < 0) {
+			fail(dir_->Path_, errno);
+		}
+		if (read_ <= 0) {
+			break;
+		}
+		for (long pos_ = 0; pos_ < read_; ) {
+			const LinuxDirent64* ent_
+				= reinterpret_cast<const LinuxDirent64*>(buffer_.data() + pos_);
+			pos_ += ent_->d_reclen;
+			
+			const char*  name_ = ent_->d_name;
+			const size_t len_  = std::strlen(name_);
+			if ((name_[0] == '.') 
+				&& ((len_ == 1) || ((len_ == 2) && (name_[1] == '.')) 
+					|| Options_.SkipHidden_)) {
+				continue;
+			}
+			
+			unsigned char type_  = ent_->d_type;
+			uint64_t      inode_ = ent_->d_ino;
+			uint64_t      dev_   = dir_->Device_;
+			const bool    match_ = HasExtension(name_, 
+											len_, 
+											Options_.Extensions_);
+			
+			if ((type_ == DT_UNKNOWN) || (type_ == DT_LNK)) {
+				// Not following links, a link can only be listed as a file, 
+				// so one that fails the name filter needs no 'stat' at all:
+				if ((type_ == DT_LNK) && !match_ && !Options_.FollowSymlinks_) {
+					continue;
+				}
+				int atFlags_ = (type_ == DT_LNK) ? 0 : AT_SYMLINK_NOFOLLOW;
+				if (fstatat(dir_->Fd_, name_, &st_, atFlags_) != 0) {
+					// A dangling link is just skipped:
+					const int error_ = errno;
+					if ((error_ != ENOENT) || (type_ != DT_LNK)) {
+						fail(JoinPath(dir_->Path_, name_, len_), error_);
+					}
+					continue;
+				}
+				if (S_ISDIR(st_.st_mode)) {
+					if ((type_ == DT_LNK) && !Options_.FollowSymlinks_) {
+						continue;
+					}
+					type_ = DT_DIR;
+				} else if (S_ISREG(st_.st_mode)) {
+					type_ = DT_REG;
+				} else {
+					continue;
+				}
+				inode_ = static_cast<uint64_t>(st_.st_ino);
+				dev_   = static_cast<uint64_t>(st_.st_dev);
+			}
+			
+			if (type_ == DT_DIR) {
+				subdirs_.emplace_back(name_, len_);
+			} else if ((type_ == DT_REG) && match_) {
+				if (Options_.DedupeHardLinks_ 
+					&& !SeenFiles_.insert(dev_, inode_)) {
+					continue;
+				}
+				CrawledFile file_;
+				file_.Path_   = JoinPath(dir_->Path_, name_, len_);
+				file_.Device_ = dev_;
+				file_.Inode_  = inode_;
+				found_.push_back(std::move(file_));
+			}
+		}
+	}
+	
+	for (std::string& sub_ : subdirs_) {
+		submit(dir_, std::move(sub_));
+	}
+	dir_.reset();
+	
+	if (!found_.empty()) {
+		std::lock_guard<std::mutex> guard_(ResultLock_);
+		Out_.insert(Out_.end(), 
+					std::make_move_iterator(found_.begin()), 
+					std::make_move_iterator(found_.end()));
+	}
+}
+#endif // __linux__
+
+} // namespace
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+#if !defined(__linux__)
+// NAME:    CrawlPortable
+// PURPOSE: Single-threaded 'std::filesystem' version of the crawl, for 
+//          platforms without 'getdents64()'. Hard links are not detected, 
+//          since 'std::filesystem' does not expose inode numbers.
+auto static CrawlPortable(const std::string&        Root, 
+						  const CrawlOptions&       Options, 
+						  std::vector<CrawledFile>& Out, 
+						  std::vector<CrawlError>&  Errors)->void {
+	std::error_code    ec_;
+	fs::directory_options dirOpts_ = fs::directory_options::skip_permission_denied;
+	if (Options.FollowSymlinks_) {
+		dirOpts_ |= fs::directory_options::follow_directory_symlink;
+	}
+	
+	fs::recursive_directory_iterator it_(Root, dirOpts_, ec_);
+	for (; !ec_ && (it_ != fs::recursive_directory_iterator());
+		 it_.increment(ec_)) {
+		const std::string name_ = it_->path().filename().string();
+		if (Options.SkipHidden_ && !name_.empty() && (name_[0] == '.')) {
+			if (it_->is_directory(ec_)) {
+				it_.disable_recursion_pending();
+			}
+			continue;
+		}
+		if (!HasExtension(name_.c_str(), name_.length(), Options.Extensions_) 
+			|| !it_->is_regular_file(ec_)) {
+			continue;
+		}
+		CrawledFile file_;
+		file_.Path_ = it_->path().string();
+		Out.push_back(std::move(file_));
+	}
+	
+	// The iterator stops at the first error it cannot skip:
+	if (ec_) {
+		CrawlError error_;
+		error_.Path_  = (it_ != fs::recursive_directory_iterator()) 
+						? it_->path().string() : Root;
+		error_.Error_ = ec_.value();
+		Errors.push_back(std::move(error_));
+	}
+}
+#endif
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    HasExtension
+// DESCRIPTION: Returns 'true' if the file name 'Name' ends with one of 
+//              'Extensions' (compared case-insensitively; each extension 
+//              includes its dot, e.g. ".mp3"). An empty list matches anything.
+auto HasExtension(const char*                     Name, 
+				  size_t                          Length, 
+				  const std::vector<std::string>& Extensions)->bool {
+	if (Extensions.empty()) {
+		return true;
+	}
+	for (const std::string& ext_ : Extensions) {
+		if (Length < ext_.length()) {
+			continue;
+		}
+		const char* tail_ = Name + (Length - ext_.length());
+		bool        equal_ = true;
+		for (size_t i = 0; i < ext_.length(); ++i) {
+			if (std::tolower(static_cast<unsigned char>(tail_[i]))
+				!= std::tolower(static_cast<unsigned char>(ext_[i]))) {
+				equal_ = false;
+				break;
+			}
+		}
+		if (equal_) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// FUNCTION:    CrawlDirectory
+// DESCRIPTION: Returns every file below 'Root' whose name passes the 
+//              extension filter, sorted by path. Folders that cannot be read 
+//              are skipped, and added to 'Errors' (if given), so that the 
+//              caller can tell a partial crawl from a complete one. With 
+//              'DedupeHardLinks_', a file reachable through several hard 
+//              links is listed once (under whichever name the crawl reaches 
+//              first).
+auto CrawlDirectory(const std::string&       Root, 
+					const CrawlOptions&      Options, 
+					std::vector<CrawlError>* Errors)->std::vector<CrawledFile> {
+	std::vector<CrawledFile> files_;
+	std::vector<CrawlError>  errors_;
+	if (Root.empty()) {
+		return files_;
+	}
+
+#if defined(__linux__)
+	LinuxCrawl crawl_(Options, files_, errors_);
+	crawl_.run(Root);
+#else
+	CrawlPortable(Root, Options, files_, errors_);
+#endif
+	
+	if (Errors != nullptr) {
+		std::sort(errors_.begin(), errors_.end(), 
+				  [](const CrawlError& a_, const CrawlError& b_) {
+					  return a_.Path_ < b_.Path_;
+				  });
+		Errors->insert(Errors->end(), 
+					   std::make_move_iterator(errors_.begin()), 
+					   std::make_move_iterator(errors_.end()));
+	}
+
+	std::sort(files_.begin(), files_.end(), 
+			  [](const CrawledFile& a_, const CrawledFile& b_) {
+				  return a_.Path_ < b_.Path_;
+			  });
+	return files_;
+}
+
+
+// FUNCTION:    CrawlDirectoryPaths
+// DESCRIPTION: Like 'CrawlDirectory()', but returns only the paths.
+auto CrawlDirectoryPaths(const std::string&       Root, 
+						 const CrawlOptions&      Options, 
+						 std::vector<CrawlError>* Errors)->std::vector<std::string> {
+	std::vector<CrawledFile> files_ = CrawlDirectory(Root, Options, Errors);
+	std::vector<std::string> paths_;
+	paths_.reserve(files_.size());
+	for (CrawledFile& file_ : files_) {
+		paths_.push_back(std::move(file_.Path_));
+	}
+	return paths_;
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      DirCrawler.hpp
+// FILE PURPOSE:  Declares 'CrawlDirectory()', a parallel directory walker 
+//                that lists the files below a folder, filtered by extension.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct CrawlOptions {
+	size_t                   Threads_         = 0;         // 0 = one per CPU
+	std::vector<std::string> Extensions_      = { ".mp3" }; // Empty = all files
+	bool                     SkipHidden_      = true;  // Skip ".name" entries
+	bool                     FollowSymlinks_  = false; // Into linked folders
+	bool                     DedupeHardLinks_ = true;  // List each inode once
+};
+
+struct CrawledFile {
+	std::string Path_;
+	uint64_t    Device_ = 0;
+	uint64_t    Inode_  = 0;
+};
+
+// A folder (or entry) the crawl could not read, so whatever lies below it is 
+// missing from the result:
+struct CrawlError {
+	std::string Path_;
+	int         Error_ = 0; // 'errno' value
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto CrawlDirectory(const std::string&       Root, 
+					const CrawlOptions&      Options, 
+					std::vector<CrawlError>* Errors = nullptr)->std::vector<CrawledFile>;
+auto CrawlDirectoryPaths(const std::string&       Root, 
+						 const CrawlOptions&      Options, 
+						 std::vector<CrawlError>* Errors = nullptr)->std::vector<std::string>;
+auto HasExtension(const char*                     Name, 
+				  size_t                          Length, 
+				  const std::vector<std::string>& Extensions)->bool;
@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      EditPlan.cpp
+// FILE PURPOSE:  Defines the dry-run planner, and the plan file format.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <unordered_map>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__linux__)
+#include <linux/falloc.h>
+#include <sys/vfs.h>
+#endif
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib/codec.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "AsyncTagIO.hpp"
+#include "EditPlan.hpp"
+#include "WorkStealingPool.hpp"
+#include "WriteScheduler.hpp"
+
+
+/* *************************** IMPORTED NAMESPACES ************************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const char   kPLAN_MAGIC[8]       = { 'M', 'P', '3', 'E', 'P', 'L', 'N', '1' };
+constexpr static const size_t kPLAN_FILES_PER_TASK = 16;
+
+// File systems where 'fallocate(FALLOC_FL_INSERT_RANGE)' works ('statfs()'):
+constexpr static const int64_t kEXT4_MAGIC = 0xEF53;
+constexpr static const int64_t kXFS_MAGIC  = 0x58465342;
+
+
+/* ******************************* STRUCTURES ******************************* */
+// What the parallel first pass learns of a file:
+struct ParsedFile {
+	bool    Ok_       = false;
+	bool    Changed_  = false;
+	int64_t OldSize_  = 0; // The tag on disk, header included
+	int32_t UsedSize_ = 0; // Its frames, as parsed
+	int64_t Frames_   = 0; // Its frames after the transform
+};
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    ParseFile
+// PURPOSE: Reads only the tag of 'Filename' (not the audio), runs 'Fn' on it, 
+//          and measures the result. 'Out' is left not 'Ok_' if the file cannot 
+//          be opened or is shorter than its tag says.
+auto static ParseFile(const std::string&            Filename, 
+					  const TagPipeline::Transform& Fn, 
+					  bool                          CreateMissingTags, 
+					  ParsedFile&                   Out)->void {
+	std::FILE* in_ = std::fopen(Filename.c_str(), "rb");
+	if (in_ == nullptr) {
+		return;
+	}
+	char          head_[ID3_HEADER];
+	const size_t  got_      = std::fread(head_, 1, sizeof(head_), in_);
+	const int64_t capacity_ = GetTagCapacity(head_, got_);
+	ID3v2_tag*    tag_      = nullptr;
+	if (capacity_ >= 0) {
+		Out.OldSize_ = ID3_HEADER + capacity_;
+		std::vector<char> raw_(static_cast<size_t>(Out.OldSize_), '\0');
+		std::memcpy(raw_.data(), head_, sizeof(head_));
+		if (std::fread(raw_.data() + sizeof(head_), 1, raw_.size() - sizeof(head_), in_) 
+			!= (raw_.size() - sizeof(head_))) {
+			std::fclose(in_);
+			return;  // Cut short: planned as failed, not from zeros
+		}
+		tag_ = load_tag_with_buffer(raw_.data(), static_cast<int32_t>(raw_.size()));
+	}
+	std::fclose(in_);
+	if (tag_ == nullptr) {
+		if (!CreateMissingTags) {
+			Out.Ok_ = true;
+			return;
+		}
+		tag_ = new_tag();
+	}
+	Out.UsedSize_ = tag_->used_size;
+	
+	try {
+		Out.Changed_ = Fn(Filename, tag_);
+		Out.Ok_      = true;
+	} catch (...) {
+		Out.Ok_ = false;
+	}
+	Out.Frames_ = GetFramesSize(tag_);
+	free_tag(tag_);
+}
+
+
+// NAME:    CanInsertRange
+// PURPOSE: Tells whether the file system holding 'Filename' can insert blocks 
+//          into a file, which is what 'write_tag()' tries before moving audio.
+auto static CanInsertRange(const std::string& Filename)->bool {
+#if defined(__linux__) && defined(FALLOC_FL_INSERT_RANGE)
+	struct statfs fs_;
+	if (::statfs(Filename.c_str(), &fs_) != 0) {
+		return false;
+	}
+	const int64_t type_ = static_cast<int64_t>(fs_.f_type);
+	return (type_ == kEXT4_MAGIC) || (type_ == kXFS_MAGIC);
+#else
+	static_cast<void>(Filename);
+	return false;
+#endif
+}
+
+
+// NAME:    PlanSave
+// PURPOSE: Decides 'Entry's action and sizes as 'write_tag()' would for 
+//          'File', and records the edit on 'Policy', as a save would.
+auto static PlanSave(PlanEntry&            Entry, 
+					 const ParsedFile&     File, 
+					 ID3v2_padding_policy& Policy)->void {
+	const int64_t capacity_ = (File.OldSize_ > 0) ? (File.OldSize_ - ID3_HEADER) : -1;
+	Entry.OldTagSize_ = File.OldSize_;
+	Entry.NewTagSize_ = File.OldSize_;
+	if (!File.Ok_) {
+		Entry.Action_ = PlanAction::Failed;
+		return;
+	}
+	if (!File.Changed_) {
+		Entry.Action_ = PlanAction::Unchanged;
+		return;
+	}
+	if (File.Frames_ > ID3_MAX_TAG_SIZE) {
+		Entry.Action_ = PlanAction::Failed;
+		return;
+	}
+	if (File.Frames_ <= capacity_) {
+		Entry.Action_ = PlanAction::InPlace;
+		record_padding_edit(&Policy, File.UsedSize_, static_cast<int32_t>(File.Frames_));
+		return;
+	}
+	
+	Entry.Action_     = PlanAction::Rewrite;
+	Entry.NewTagSize_ = ID3_HEADER + File.Frames_
+						+ compute_padding(&Policy, static_cast<int32_t>(File.Frames_), 
+										  Entry.Path_.c_str());
+	if ((Entry.NewTagSize_ > File.OldSize_) && CanInsertRange(Entry.Path_)) {
+		const int64_t block_ = (Policy.block_size > 0) 
+							   ? Policy.block_size 
+							   : get_fs_block_size(Entry.Path_.c_str());
+		const int64_t grow_  = ((Entry.NewTagSize_ - File.OldSize_ + block_ - 1) / block_) * block_;
+		if (File.OldSize_ + grow_ - ID3_HEADER <= ID3_MAX_TAG_SIZE) {
+			Entry.Action_     = PlanAction::InsertRange;
+			Entry.NewTagSize_ = File.OldSize_ + grow_;
+		}
+	}
+	
+	// Like 'write_tag()', the edit is recorded once the tag is sized:
+	record_padding_edit(&Policy, File.UsedSize_, static_cast<int32_t>(File.Frames_));
+}
+
+
+// NAME:    CostSave
+// PURPOSE: Fills in 'Entry's bytes and time. 'Rotational' picks the model.
+auto static CostSave(PlanEntry& Entry, bool Rotational)->void {
+	const uint64_t audio_ = Entry.Key_.Size_ - std::min<uint64_t>(Entry.Key_.Size_, 
+																  Entry.OldTagSize_);
+	uint64_t seeks_ = 1;
+	switch (Entry.Action_) {
+		case PlanAction::InPlace:
+			Entry.BytesRead_    = Entry.OldTagSize_;
+			Entry.BytesWritten_ = Entry.NewTagSize_;
+			break;
+		case PlanAction::InsertRange:
+			// The inserted blocks only remap extents; no audio moves:
+			Entry.BytesRead_    = Entry.OldTagSize_;
+			Entry.BytesWritten_ = Entry.NewTagSize_;
+			seeks_              = 2;
+			break;
+		case PlanAction::Rewrite:
+			Entry.BytesRead_    = Entry.OldTagSize_ + audio_;
+			Entry.BytesWritten_ = Entry.NewTagSize_ + audio_;
+			seeks_              = 2;
+			break;
+		default:
+			Entry.BytesRead_    = Entry.OldTagSize_; // Read to plan it, not to save it
+			Entry.BytesWritten_ = 0;
+			Entry.Seconds_      = 0.0;
+			return;
+	}
+	const double rate_ = Rotational ? kPLAN_HDD_BYTES_PER_SEC : kPLAN_SSD_BYTES_PER_SEC;
+	const double seek_ = Rotational ? kPLAN_HDD_SEEK_SEC : kPLAN_SSD_SEEK_SEC;
+	Entry.Seconds_ = (static_cast<double>(seeks_) * seek_)
+					 + (static_cast<double>(Entry.BytesRead_ + Entry.BytesWritten_) / rate_);
+}
+
+
+// NAME:    PutNumber
+// PURPOSE: Appends 'Value' to 'Out' as 'Bytes' (4 or 8) big-endian bytes.
+auto static PutNumber(std::string& Out, uint64_t Value, size_t Bytes)->void {
+	uint8_t bytes_[8];
+	id3_write_be32(bytes_, static_cast<uint32_t>(Value >> 32));
+	id3_write_be32(bytes_ + 4, static_cast<uint32_t>(Value));
+	Out.append(reinterpret_cast<const char*>(bytes_) + (8 - Bytes), Bytes);
+}
+
+
+// NAME:    GetNumber
+// PURPOSE: Reads a number written by 'PutNumber()' at 'At', advancing it. 
+//          Returns 'false' if 'Data' ends first.
+auto static GetNumber(const std::string& Data, 
+					  size_t&            At, 
+					  size_t             Bytes, 
+					  uint64_t&          Value)->bool {
+	if (Data.size() - At < Bytes) {
+		return false;
+	}
+	uint8_t bytes_[8] = {};
+	std::memcpy(bytes_ + (8 - Bytes), Data.data() + At, Bytes);
+	Value = (static_cast<uint64_t>(id3_read_be32(bytes_)) << 32) | id3_read_be32(bytes_ + 4);
+	At   += Bytes;
+	return true;
+}
+
+
+// NAME:    GetString
+// PURPOSE: Reads a length-prefixed string written by 'SaveEditPlan()'.
+auto static GetString(const std::string& Data, size_t& At, std::string& Value)->bool {
+	uint64_t length_ = 0;
+	if (!GetNumber(Data, At, 4, length_) || (Data.size() - At < length_)) {
+		return false;
+	}
+	Value.assign(Data, At, static_cast<size_t>(length_));
+	At += static_cast<size_t>(length_);
+	return true;
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    GetPlanActionName
+// DESCRIPTION: Returns the name shown for 'Action'.
+auto GetPlanActionName(PlanAction Action)->const char* {
+	switch (Action) {
+		case PlanAction::Unchanged:   return "unchanged";
+		case PlanAction::InPlace:     return "in-place";
+		case PlanAction::InsertRange: return "insert-range";
+		case PlanAction::Rewrite:     return "rewrite";
+		default:                      return "failed";
+	}
+}
+
+
+// FUNCTION:    PlanEdit
+// DESCRIPTION: Predicts what running 'Fn' over 'Files' with 'Options' would 
+//              do, writing nothing. Only each file's tag is read and parsed 
+//              (on 'ParseThreads_' threads); the new tag is sized against the 
+//              old one's room, and then, in file order, against the padding 
+//              policy, just as the saves would run through it. The plan is of 
+//              plain saves; a 'Journal_' never inserts ranges, and rewrites 
+//              instead.
+auto PlanEdit(const std::vector<std::string>& Files, 
+			  const TagPipeline::Transform&   Fn, 
+			  const PipelineOptions&          Options)->EditPlan {
+	EditPlan                plan_;
+	std::vector<ParsedFile> parsed_(Files.size());
+	plan_.Entries_.resize(Files.size());
+	{
+		WorkStealingPool pool_(Options.ParseThreads_);
+		for (size_t start_ = 0; start_ < Files.size(); start_ += kPLAN_FILES_PER_TASK) {
+			const size_t end_ = std::min(start_ + kPLAN_FILES_PER_TASK, Files.size());
+			pool_.submit([&, start_, end_]() {
+				for (size_t i = start_; i < end_; ++i) {
+					PlanEntry& entry_ = plan_.Entries_[i];
+					entry_.Path_      = Files[i];
+					std::error_code ec_;
+					if (fs::is_regular_file(Files[i], ec_) && GetFileKey(Files[i], entry_.Key_)) {
+						ParseFile(Files[i], Fn, Options.CreateMissingTags_, parsed_[i]);
+					}
+				}
+			});
+		}
+	}
+	
+	ID3v2_padding_policy               policy_ = Options.PaddingPolicy_;
+	std::unordered_map<uint64_t, bool> rotational_; // Device -> costed as a disk
+	for (size_t i = 0; i < Files.size(); ++i) {
+		PlanEntry& entry_ = plan_.Entries_[i];
+		PlanSave(entry_, parsed_[i], policy_);
+		auto it_ = rotational_.find(entry_.Key_.Device_);
+		if (it_ == rotational_.end()) {
+			const DeviceInfo info_ = GetDeviceInfo(entry_.Key_.Device_);
+			it_ = rotational_.emplace(entry_.Key_.Device_, 
+									  !info_.Known_ || info_.Rotational_).first;
+		}
+		CostSave(entry_, it_->second);
+	}
+	return plan_;
+}
+
+
+// FUNCTION:    SummarizePlan
+// DESCRIPTION: Totals 'Plan' by action, bytes and time.
+auto SummarizePlan(const EditPlan& Plan)->PlanSummary {
+	PlanSummary sum_;
+	sum_.FilesTotal_ = Plan.Entries_.size();
+	for (const PlanEntry& entry_ : Plan.Entries_) {
+		switch (entry_.Action_) {
+			case PlanAction::Unchanged:   ++sum_.FilesUnchanged_;   break;
+			case PlanAction::InPlace:     ++sum_.FilesInPlace_;     break;
+			case PlanAction::InsertRange: ++sum_.FilesInsertRange_; break;
+			case PlanAction::Rewrite:     ++sum_.FilesRewrite_;     break;
+			default:                      ++sum_.FilesFailed_;      break;
+		}
+		sum_.BytesRead_    += entry_.BytesRead_;
+		sum_.BytesWritten_ += entry_.BytesWritten_;
+		sum_.Seconds_      += entry_.Seconds_;
+	}
+	return sum_;
+}
+
+
+// FUNCTION:    SaveEditPlan
+// DESCRIPTION: Writes 'Plan' to 'Filename': the magic, 'Edit_', the entry 
+//              count, then each entry's path, key, action, sizes and cost 
+//              (the time in microseconds), all numbers big-endian. As with 
+//              the index, it is written beside the target and renamed over 
+//              it.
+auto SaveEditPlan(const std::string& Filename, const EditPlan& Plan)->bool {
+	std::string out_(kPLAN_MAGIC, sizeof(kPLAN_MAGIC));
+	PutNumber(out_, Plan.Edit_.size(), 4);
+	out_ += Plan.Edit_;
+	PutNumber(out_, Plan.Entries_.size(), 8);
+	for (const PlanEntry& entry_ : Plan.Entries_) {
+		PutNumber(out_, entry_.Path_.size(), 4);
+		out_ += entry_.Path_;
+		PutNumber(out_, entry_.Key_.Device_, 8);
+		PutNumber(out_, entry_.Key_.Inode_, 8);
+		PutNumber(out_, entry_.Key_.Size_, 8);
+		PutNumber(out_, static_cast<uint64_t>(entry_.Key_.MtimeNs_), 8);
+		PutNumber(out_, static_cast<uint64_t>(entry_.Action_), 4);
+		PutNumber(out_, static_cast<uint64_t>(entry_.OldTagSize_), 8);
+		PutNumber(out_, static_cast<uint64_t>(entry_.NewTagSize_), 8);
+		PutNumber(out_, entry_.BytesRead_, 8);
+		PutNumber(out_, entry_.BytesWritten_, 8);
+		PutNumber(out_, static_cast<uint64_t>(std::llround(entry_.Seconds_ * 1.0e6)), 8);
+	}
+	
+	const std::string temp_ = Filename + ".tmp";
+	std::FILE*        file_ = std::fopen(temp_.c_str(), "wb");
+	if (file_ == nullptr) {
+		return false;
+	}
+	bool ok_ = (std::fwrite(out_.data(), 1, out_.size(), file_) == out_.size());
+	ok_      = (std::fclose(file_) == 0) && ok_;
+	// 'fs::rename()' replaces an existing file everywhere ('std::rename()' 
+	// fails on Windows when the target exists):
+	std::error_code ec_;
+	if (ok_) {
+		fs::rename(temp_, Filename, ec_);
+	}
+	if (!ok_ || ec_) {
+		std::remove(temp_.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+// FUNCTION:    LoadEditPlan
+// DESCRIPTION: Reads a plan written by 'SaveEditPlan()' into 'Plan'. Returns 
+//              'false' if the file is missing, not a plan, or cut short.
+auto LoadEditPlan(const std::string& Filename, EditPlan& Plan)->bool {
+	std::error_code ec_;
+	const uint64_t  size_ = fs::file_size(Filename, ec_);
+	std::FILE*      in_   = ec_ ? nullptr : std::fopen(Filename.c_str(), "rb");
+	if (in_ == nullptr) {
+		return false;
+	}
+	std::string data_(static_cast<size_t>(size_), '\0');
+	const bool  read_ = (std::fread(data_.data(), 1, data_.size(), in_) == data_.size());
+	std::fclose(in_);
+	if (!read_ || (data_.compare(0, sizeof(kPLAN_MAGIC), kPLAN_MAGIC, sizeof(kPLAN_MAGIC)) != 0)) {
+		return false;
+	}
+	
+	size_t   at_    = sizeof(kPLAN_MAGIC);
+	uint64_t count_ = 0;
+	EditPlan plan_;
+	if (!GetString(data_, at_, plan_.Edit_) || !GetNumber(data_, at_, 8, count_)) {
+		return false;
+	}
+	for (uint64_t n = 0; n < count_; ++n) {
+		PlanEntry entry_;
+		uint64_t  mtime_ = 0, action_ = 0, old_ = 0, new_ = 0, micros_ = 0;
+		if (!GetString(data_, at_, entry_.Path_) 
+			|| !GetNumber(data_, at_, 8, entry_.Key_.Device_) 
+			|| !GetNumber(data_, at_, 8, entry_.Key_.Inode_) 
+			|| !GetNumber(data_, at_, 8, entry_.Key_.Size_) 
+			|| !GetNumber(data_, at_, 8, mtime_) 
+			|| !GetNumber(data_, at_, 4, action_) 
+			|| !GetNumber(data_, at_, 8, old_) 
+			|| !GetNumber(data_, at_, 8, new_) 
+			|| !GetNumber(data_, at_, 8, entry_.BytesRead_) 
+			|| !GetNumber(data_, at_, 8, entry_.BytesWritten_) 
+			|| !GetNumber(data_, at_, 8, micros_) 
+			|| (action_ > static_cast<uint64_t>(PlanAction::Failed))) {
+			return false;
+		}
+		entry_.Key_.MtimeNs_ = static_cast<int64_t>(mtime_);
+		entry_.Action_       = static_cast<PlanAction>(action_);
+		entry_.OldTagSize_   = static_cast<int64_t>(old_);
+		entry_.NewTagSize_   = static_cast<int64_t>(new_);
+		entry_.Seconds_      = static_cast<double>(micros_) / 1.0e6;
+		plan_.Entries_.push_back(std::move(entry_));
+	}
+	Plan = std::move(plan_);
+	return true;
+}
+
+
+// FUNCTION:    RunEditPlan
+// DESCRIPTION: Runs the saves 'Plan' predicts, through a 'TagPipeline', with
+//              no second dry run: files planned as unchanged are not opened, 
+//              and files planned as failed fail again. 'Fn' must be the 
+//              transform the plan was made with. A file whose size, mtime or 
+//              inode has changed since planning fails without being touched, 
+//              since its plan no longer holds.
+auto RunEditPlan(const EditPlan&               Plan, 
+				 const TagPipeline::Transform& Fn, 
+				 PipelineOptions               Options)->BatchResult {
+	BatchResult              result_;
+	std::vector<std::string> files_;
+	result_.FilesTotal_ = Plan.Entries_.size();
+	for (const PlanEntry& entry_ : Plan.Entries_) {
+		FileKey key_;
+		switch (entry_.Action_) {
+			case PlanAction::Unchanged:
+				++result_.FilesUnchanged_;
+				break;
+			case PlanAction::Failed:
+				++result_.FilesFailed_;
+				result_.FailedFiles_.push_back(entry_.Path_);
+				break;
+			default:
+				if (!GetFileKey(entry_.Path_, key_) || !SameFileKey(key_, entry_.Key_)) {
+					++result_.FilesFailed_;
+					result_.FailedFiles_.push_back(entry_.Path_);
+				} else {
+					files_.push_back(entry_.Path_);
+				}
+				break;
+		}
+	}
+	
+	TagPipeline       pipeline_(std::move(Options));
+	const BatchResult run_ = pipeline_.run(files_, Fn);
+	result_.FilesModified_  += run_.FilesModified_;
+	result_.FilesUnchanged_ += run_.FilesUnchanged_;
+	result_.FilesFailed_    += run_.FilesFailed_;
+	result_.FilesSkipped_   += run_.FilesSkipped_;
+	result_.Cancelled_       = run_.Cancelled_;
+	result_.FailedFiles_.insert(result_.FailedFiles_.end(), 
+								run_.FailedFiles_.begin(), run_.FailedFiles_.end());
+	return result_;
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      EditPlan.hpp
+// FILE PURPOSE:  Declares the dry-run planner, which predicts how each file of 
+//                a batch edit would be saved (in place, by inserting blocks, 
+//                or by rewriting the file) and what that costs in I/O, and the 
+//                functions that save, load and run such a plan.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagIndex.hpp"
+#include "TagPipeline.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// The cost model behind 'PlanEntry::Seconds_': a file costs its seeks plus its 
+// bytes at the device's streaming rate. Devices not under /sys/block (network 
+// shares, and every device off Linux) are costed as rotational:
+constexpr static const double kPLAN_HDD_BYTES_PER_SEC = 120.0e6;
+constexpr static const double kPLAN_HDD_SEEK_SEC      = 0.010;
+constexpr static const double kPLAN_SSD_BYTES_PER_SEC = 500.0e6;
+constexpr static const double kPLAN_SSD_SEEK_SEC      = 0.0002;
+
+
+/* ******************************* STRUCTURES ******************************* */
+// How 'write_tag()' will save a file, as it decides it:
+enum class PlanAction : uint8_t {
+	Unchanged,   // The transform leaves the tag alone; no save
+	InPlace,     // The new tag fits in the old one
+	InsertRange, // The tag grows by whole blocks inserted in front (ext4, XFS)
+	Rewrite,     // The audio is moved to make room
+	Failed       // Unreadable, or the transform threw
+};
+
+struct PlanEntry {
+	std::string Path_;
+	FileKey     Key_;                // When planned; the plan is void for a file that no longer matches
+	PlanAction  Action_       = PlanAction::Unchanged;
+	int64_t     OldTagSize_   = 0;   // Header included; 0 = no tag
+	int64_t     NewTagSize_   = 0;   // Header included, after the save
+	uint64_t    BytesRead_    = 0;
+	uint64_t    BytesWritten_ = 0;
+	double      Seconds_      = 0.0; // Estimated, per the cost model above
+};
+
+struct EditPlan {
+	std::string            Edit_;    // The caller's description of the transform, kept with the plan
+	std::vector<PlanEntry> Entries_; // In the order of the files given
+};
+
+struct PlanSummary {
+	size_t   FilesTotal_       = 0;
+	size_t   FilesUnchanged_   = 0;
+	size_t   FilesInPlace_     = 0;
+	size_t   FilesInsertRange_ = 0;
+	size_t   FilesRewrite_     = 0;
+	size_t   FilesFailed_      = 0;
+	uint64_t BytesRead_        = 0;
+	uint64_t BytesWritten_     = 0;
+	double   Seconds_          = 0.0; // As if the files were saved one at a time
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto GetPlanActionName(PlanAction Action)->const char*;
+auto PlanEdit(const std::vector<std::string>& Files, 
+			  const TagPipeline::Transform&   Fn, 
+			  const PipelineOptions&          Options)->EditPlan;
+auto SummarizePlan(const EditPlan& Plan)->PlanSummary;
+auto SaveEditPlan(const std::string& Filename, const EditPlan& Plan)->bool;
+auto LoadEditPlan(const std::string& Filename, EditPlan& Plan)->bool;
+auto RunEditPlan(const EditPlan&               Plan, 
+				 const TagPipeline::Transform& Fn, 
+				 PipelineOptions               Options)->BatchResult;
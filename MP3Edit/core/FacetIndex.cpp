@@ -0,0 +1,664 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      FacetIndex.cpp
+// FILE PURPOSE:  Defines the classes 'RowBitmap' and 'FacetIndex'. A facet 
+//                query (genre = Jazz, year 1955-1965, has cover) is a few 
+//                bitmap operations, and the count of each value of a facet 
+//                within a selection is one intersection count per value.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <bitset>
+#include <iterator>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "FacetIndex.hpp"
+#include "SimdSupport.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+enum class WordOp {
+	And, 
+	Or, 
+	AndNot
+};
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    PopCount
+// PURPOSE: Returns the number of set bits in 'Word'.
+auto static PopCount(uint64_t Word)->size_t {
+	return std::bitset<64>(Word).count();
+}
+
+
+// NAME:    CombineWords
+// PURPOSE: Stores 'A Op B' for 'Words' words into 'Out' and returns the number 
+//          of bits set in the result. With SSE2, two words are combined per 
+//          step.
+template <WordOp Op>
+auto static CombineWords(const uint64_t* A, 
+						 const uint64_t* B, 
+						 uint64_t*       Out, 
+						 size_t          Words)->size_t {
+	size_t count_ = 0;
+	size_t i      = 0;
+#if defined(MP3EDIT_HAVE_SSE2)
+	for (; (i + 2) <= Words; i += 2) {
+		const __m128i a_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(A + i));
+		const __m128i b_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(B + i));
+		__m128i       r_;
+		if constexpr (Op == WordOp::And) {
+			r_ = _mm_and_si128(a_, b_);
+		} else if constexpr (Op == WordOp::Or) {
+			r_ = _mm_or_si128(a_, b_);
+		} else {
+			r_ = _mm_andnot_si128(b_, a_);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + i), r_);
+		count_ += PopCount(Out[i]) + PopCount(Out[i + 1]);
+	}
+#endif
+	for (; i < Words; ++i) {
+		if constexpr (Op == WordOp::And) {
+			Out[i] = A[i] & B[i];
+		} else if constexpr (Op == WordOp::Or) {
+			Out[i] = A[i] | B[i];
+		} else {
+			Out[i] = A[i] & ~B[i];
+		}
+		count_ += PopCount(Out[i]);
+	}
+	return count_;
+}
+
+
+// NAME:    AndCountWords
+// PURPOSE: Returns the number of bits set in both 'A' and 'B', without 
+//          storing the intersection.
+auto static AndCountWords(const uint64_t* A, const uint64_t* B, size_t Words)->size_t {
+	size_t count_ = 0;
+	for (size_t i = 0; i < Words; ++i) {
+		count_ += PopCount(A[i] & B[i]);
+	}
+	return count_;
+}
+
+
+// NAME:    TestBit
+// PURPOSE: Returns 'true' if bit 'Bit' of 'Bits' is set.
+auto static TestBit(const std::vector<uint64_t>& Bits, uint16_t Bit)->bool {
+	return ((Bits[Bit >> 6] >> (Bit & 63)) & 1) != 0;
+}
+
+
+/* **************************** STATIC VARIABLES **************************** */
+// NAME:    s_EmptyBitmap_
+// PURPOSE: Returned by 'FacetIndex::rows()' for values no row has.
+static const RowBitmap s_EmptyBitmap_;
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  RowBitmap: PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    add
+// DESCRIPTION: Adds 'Row' to the set. Adding rows in ascending order (as 
+//              'FacetIndex::build()' does) only ever appends.
+void RowBitmap::add(RowId Row) {
+	const uint16_t key_ = static_cast<uint16_t>(Row >> 16);
+	const uint16_t low_ = static_cast<uint16_t>(Row & 0xFFFF);
+	
+	auto it_ = Chunks_.end();
+	if (Chunks_.empty() || (Chunks_.back().Key_ < key_)) {
+		Chunks_.emplace_back();
+		Chunks_.back().Key_ = key_;
+		it_ = Chunks_.end() - 1;
+	} else if (Chunks_.back().Key_ == key_) {
+		it_ = Chunks_.end() - 1;
+	} else {
+		it_ = std::lower_bound(Chunks_.begin(), Chunks_.end(), key_, 
+							   [](const Chunk& C, uint16_t Key) { return C.Key_ < Key; });
+		if ((it_ == Chunks_.end()) || (it_->Key_ != key_)) {
+			it_       = Chunks_.emplace(it_);
+			it_->Key_ = key_;
+		}
+	}
+	
+	Chunk& chunk_ = *it_;
+	if (!chunk_.Bits_.empty()) {
+		uint64_t&      word_ = chunk_.Bits_[low_ >> 6];
+		const uint64_t bit_  = uint64_t(1) << (low_ & 63);
+		if ((word_ & bit_) == 0) {
+			word_ |= bit_;
+			++chunk_.Count_;
+		}
+		return;
+	}
+	if (chunk_.Array_.empty() || (chunk_.Array_.back() < low_)) {
+		chunk_.Array_.push_back(low_);
+	} else {
+		auto pos_ = std::lower_bound(chunk_.Array_.begin(), chunk_.Array_.end(), low_);
+		if (*pos_ == low_) {
+			return;
+		}
+		chunk_.Array_.insert(pos_, low_);
+	}
+	++chunk_.Count_;
+	if (chunk_.Array_.size() > kARRAY_MAX) {
+		toBits(chunk_);
+	}
+}
+
+
+bool RowBitmap::contains(RowId Row) const noexcept {
+	const uint16_t key_ = static_cast<uint16_t>(Row >> 16);
+	const uint16_t low_ = static_cast<uint16_t>(Row & 0xFFFF);
+	auto it_ = std::lower_bound(Chunks_.begin(), Chunks_.end(), key_, 
+								[](const Chunk& C, uint16_t Key) { return C.Key_ < Key; });
+	if ((it_ == Chunks_.end()) || (it_->Key_ != key_)) {
+		return false;
+	}
+	return !it_->Bits_.empty() 
+		   ? TestBit(it_->Bits_, low_) 
+		   : std::binary_search(it_->Array_.begin(), it_->Array_.end(), low_);
+}
+
+
+size_t RowBitmap::count() const noexcept {
+	size_t count_ = 0;
+	for (const Chunk& chunk_ : Chunks_) {
+		count_ += chunk_.Count_;
+	}
+	return count_;
+}
+
+
+bool RowBitmap::empty() const noexcept {
+	return Chunks_.empty();
+}
+
+
+void RowBitmap::clear() noexcept {
+	Chunks_.clear();
+}
+
+
+// FUNCTION:    memoryUsage
+// DESCRIPTION: Returns roughly how many bytes the set takes.
+size_t RowBitmap::memoryUsage() const noexcept {
+	size_t bytes_ = Chunks_.capacity() * sizeof(Chunk);
+	for (const Chunk& chunk_ : Chunks_) {
+		bytes_ += (chunk_.Array_.capacity() * sizeof(uint16_t))
+				  + (chunk_.Bits_.capacity() * sizeof(uint64_t));
+	}
+	return bytes_;
+}
+
+
+// FUNCTION:    rows
+// DESCRIPTION: Returns the rows in the set in ascending order, as taken by 
+//              the 'TagStore' filters and 'sortRows()'.
+std::vector<RowId> RowBitmap::rows() const {
+	std::vector<RowId> out_;
+	out_.reserve(count());
+	for (const Chunk& chunk_ : Chunks_) {
+		const RowId base_ = static_cast<RowId>(chunk_.Key_) << 16;
+		if (chunk_.Bits_.empty()) {
+			for (uint16_t low_ : chunk_.Array_) {
+				out_.push_back(base_ | low_);
+			}
+			continue;
+		}
+		for (size_t w = 0; w < kWORDS; ++w) {
+			for (uint64_t word_ = chunk_.Bits_[w]; word_ != 0; word_ &= (word_ - 1)) {
+				// The lowest set bit's index is the count of the zeros below it:
+				const size_t bit_ = PopCount((word_ & (~word_ + 1)) - 1);
+				out_.push_back(base_ | static_cast<RowId>((w << 6) | bit_));
+			}
+		}
+	}
+	return out_;
+}
+
+
+// FUNCTION:    intersect
+// DESCRIPTION: Returns the rows in both 'A' and 'B'.
+RowBitmap RowBitmap::intersect(const RowBitmap& A, const RowBitmap& B) {
+	RowBitmap out_;
+	size_t    a_ = 0;
+	size_t    b_ = 0;
+	while ((a_ < A.Chunks_.size()) && (b_ < B.Chunks_.size())) {
+		const Chunk& ca_ = A.Chunks_[a_];
+		const Chunk& cb_ = B.Chunks_[b_];
+		if (ca_.Key_ < cb_.Key_) {
+			++a_;
+		} else if (cb_.Key_ < ca_.Key_) {
+			++b_;
+		} else {
+			Chunk chunk_;
+			andChunks(ca_, cb_, chunk_);
+			if (chunk_.Count_ != 0) {
+				out_.Chunks_.push_back(std::move(chunk_));
+			}
+			++a_;
+			++b_;
+		}
+	}
+	return out_;
+}
+
+
+// FUNCTION:    unite
+// DESCRIPTION: Returns the rows in 'A', 'B' or both.
+RowBitmap RowBitmap::unite(const RowBitmap& A, const RowBitmap& B) {
+	RowBitmap out_;
+	size_t    a_ = 0;
+	size_t    b_ = 0;
+	out_.Chunks_.reserve(std::max(A.Chunks_.size(), B.Chunks_.size()));
+	while ((a_ < A.Chunks_.size()) || (b_ < B.Chunks_.size())) {
+		if ((b_ == B.Chunks_.size()) 
+			|| ((a_ < A.Chunks_.size()) && (A.Chunks_[a_].Key_ < B.Chunks_[b_].Key_))) {
+			out_.Chunks_.push_back(A.Chunks_[a_++]);
+		} else if ((a_ == A.Chunks_.size()) || (B.Chunks_[b_].Key_ < A.Chunks_[a_].Key_)) {
+			out_.Chunks_.push_back(B.Chunks_[b_++]);
+		} else {
+			Chunk chunk_;
+			orChunks(A.Chunks_[a_++], B.Chunks_[b_++], chunk_);
+			out_.Chunks_.push_back(std::move(chunk_));
+		}
+	}
+	return out_;
+}
+
+
+// FUNCTION:    subtract
+// DESCRIPTION: Returns the rows in 'A' but not in 'B'.
+RowBitmap RowBitmap::subtract(const RowBitmap& A, const RowBitmap& B) {
+	RowBitmap out_;
+	size_t    b_ = 0;
+	for (const Chunk& ca_ : A.Chunks_) {
+		while ((b_ < B.Chunks_.size()) && (B.Chunks_[b_].Key_ < ca_.Key_)) {
+			++b_;
+		}
+		if ((b_ == B.Chunks_.size()) || (B.Chunks_[b_].Key_ != ca_.Key_)) {
+			out_.Chunks_.push_back(ca_);
+			continue;
+		}
+		Chunk chunk_;
+		andNotChunks(ca_, B.Chunks_[b_], chunk_);
+		if (chunk_.Count_ != 0) {
+			out_.Chunks_.push_back(std::move(chunk_));
+		}
+	}
+	return out_;
+}
+
+
+// FUNCTION:    intersectCount
+// DESCRIPTION: Returns the number of rows in both 'A' and 'B', without 
+//              building their intersection.
+size_t RowBitmap::intersectCount(const RowBitmap& A, const RowBitmap& B) {
+	size_t count_ = 0;
+	size_t a_     = 0;
+	size_t b_     = 0;
+	while ((a_ < A.Chunks_.size()) && (b_ < B.Chunks_.size())) {
+		const Chunk& ca_ = A.Chunks_[a_];
+		const Chunk& cb_ = B.Chunks_[b_];
+		if (ca_.Key_ < cb_.Key_) {
+			++a_;
+		} else if (cb_.Key_ < ca_.Key_) {
+			++b_;
+		} else {
+			count_ += andCount(ca_, cb_);
+			++a_;
+			++b_;
+		}
+	}
+	return count_;
+}
+
+
+/*  --------  RowBitmap: PRIVATE MEMBER FUNCTIONS  --------  */
+void RowBitmap::andChunks(const Chunk& A, const Chunk& B, Chunk& Out) {
+	Out.Key_ = A.Key_;
+	if (!A.Bits_.empty() && !B.Bits_.empty()) {
+		Out.Bits_.resize(kWORDS);
+		Out.Count_ = static_cast<uint32_t>(CombineWords<WordOp::And>(
+			A.Bits_.data(), B.Bits_.data(), Out.Bits_.data(), kWORDS));
+		shrink(Out);
+		return;
+	}
+	if (!A.Bits_.empty() || !B.Bits_.empty()) {
+		const Chunk& array_ = A.Bits_.empty() ? A : B;
+		const Chunk& bits_  = A.Bits_.empty() ? B : A;
+		for (uint16_t low_ : array_.Array_) {
+			if (TestBit(bits_.Bits_, low_)) {
+				Out.Array_.push_back(low_);
+			}
+		}
+	} else {
+		std::set_intersection(A.Array_.begin(), A.Array_.end(), 
+							  B.Array_.begin(), B.Array_.end(), 
+							  std::back_inserter(Out.Array_));
+	}
+	Out.Count_ = static_cast<uint32_t>(Out.Array_.size());
+}
+
+
+void RowBitmap::orChunks(const Chunk& A, const Chunk& B, Chunk& Out) {
+	Out.Key_ = A.Key_;
+	if (!A.Bits_.empty() && !B.Bits_.empty()) {
+		Out.Bits_.resize(kWORDS);
+		Out.Count_ = static_cast<uint32_t>(CombineWords<WordOp::Or>(
+			A.Bits_.data(), B.Bits_.data(), Out.Bits_.data(), kWORDS));
+		return;
+	}
+	if (A.Bits_.empty() && B.Bits_.empty() && ((A.Count_ + B.Count_) <= kARRAY_MAX)) {
+		std::set_union(A.Array_.begin(), A.Array_.end(), 
+					   B.Array_.begin(), B.Array_.end(), 
+					   std::back_inserter(Out.Array_));
+		Out.Count_ = static_cast<uint32_t>(Out.Array_.size());
+		return;
+	}
+	
+	// At least one side is (or the result may be) dense; work in bits:
+	const Chunk& first_  = !B.Bits_.empty() ? B : A;
+	const Chunk& second_ = !B.Bits_.empty() ? A : B;
+	Out.Array_ = first_.Array_;
+	Out.Bits_  = first_.Bits_;
+	Out.Count_ = first_.Count_;
+	if (Out.Bits_.empty()) {
+		toBits(Out);
+	}
+	for (uint16_t low_ : second_.Array_) {
+		uint64_t&      word_ = Out.Bits_[low_ >> 6];
+		const uint64_t bit_  = uint64_t(1) << (low_ & 63);
+		Out.Count_ += ((word_ & bit_) == 0) ? 1 : 0;
+		word_      |= bit_;
+	}
+	shrink(Out);
+}
+
+
+void RowBitmap::andNotChunks(const Chunk& A, const Chunk& B, Chunk& Out) {
+	Out.Key_ = A.Key_;
+	if (!A.Bits_.empty() && !B.Bits_.empty()) {
+		Out.Bits_.resize(kWORDS);
+		Out.Count_ = static_cast<uint32_t>(CombineWords<WordOp::AndNot>(
+			A.Bits_.data(), B.Bits_.data(), Out.Bits_.data(), kWORDS));
+		shrink(Out);
+		return;
+	}
+	if (!A.Bits_.empty()) {
+		Out.Bits_  = A.Bits_;
+		Out.Count_ = A.Count_;
+		for (uint16_t low_ : B.Array_) {
+			uint64_t&      word_ = Out.Bits_[low_ >> 6];
+			const uint64_t bit_  = uint64_t(1) << (low_ & 63);
+			Out.Count_ -= ((word_ & bit_) != 0) ? 1 : 0;
+			word_      &= ~bit_;
+		}
+		shrink(Out);
+		return;
+	}
+	if (!B.Bits_.empty()) {
+		for (uint16_t low_ : A.Array_) {
+			if (!TestBit(B.Bits_, low_)) {
+				Out.Array_.push_back(low_);
+			}
+		}
+	} else {
+		std::set_difference(A.Array_.begin(), A.Array_.end(), 
+							B.Array_.begin(), B.Array_.end(), 
+							std::back_inserter(Out.Array_));
+	}
+	Out.Count_ = static_cast<uint32_t>(Out.Array_.size());
+}
+
+
+size_t RowBitmap::andCount(const Chunk& A, const Chunk& B) {
+	if (!A.Bits_.empty() && !B.Bits_.empty()) {
+		return AndCountWords(A.Bits_.data(), B.Bits_.data(), kWORDS);
+	}
+	size_t count_ = 0;
+	if (!A.Bits_.empty() || !B.Bits_.empty()) {
+		const Chunk& array_ = A.Bits_.empty() ? A : B;
+		const Chunk& bits_  = A.Bits_.empty() ? B : A;
+		for (uint16_t low_ : array_.Array_) {
+			count_ += TestBit(bits_.Bits_, low_) ? 1 : 0;
+		}
+		return count_;
+	}
+	auto a_ = A.Array_.begin();
+	auto b_ = B.Array_.begin();
+	while ((a_ != A.Array_.end()) && (b_ != B.Array_.end())) {
+		if (*a_ < *b_) {
+			++a_;
+		} else if (*b_ < *a_) {
+			++b_;
+		} else {
+			++count_;
+			++a_;
+			++b_;
+		}
+	}
+	return count_;
+}
+
+
+// FUNCTION:    toBits
+// DESCRIPTION: Switches a chunk from the sorted array to the bit set.
+void RowBitmap::toBits(Chunk& Target) {
+	Target.Bits_.assign(kWORDS, 0);
+	for (uint16_t low_ : Target.Array_) {
+		Target.Bits_[low_ >> 6] |= uint64_t(1) << (low_ & 63);
+	}
+	std::vector<uint16_t>().swap(Target.Array_);
+}
+
+
+// FUNCTION:    shrink
+// DESCRIPTION: Switches a chunk back to a sorted array if that is smaller.
+void RowBitmap::shrink(Chunk& Target) {
+	if (Target.Bits_.empty() || (Target.Count_ > kARRAY_MAX)) {
+		return;
+	}
+	Target.Array_.clear();
+	Target.Array_.reserve(Target.Count_);
+	for (size_t w = 0; w < kWORDS; ++w) {
+		for (uint64_t word_ = Target.Bits_[w]; word_ != 0; word_ &= (word_ - 1)) {
+			const size_t bit_ = PopCount((word_ & (~word_ + 1)) - 1);
+			Target.Array_.push_back(static_cast<uint16_t>((w << 6) | bit_));
+		}
+	}
+	std::vector<uint64_t>().swap(Target.Bits_);
+}
+
+
+/*  --------  FacetIndex: CONSTRUCTORS AND DESTRUCTOR  --------  */
+FacetIndex::FacetIndex() noexcept {}
+
+
+FacetIndex::~FacetIndex() noexcept {}
+
+
+/*  --------  FacetIndex: PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    build
+// DESCRIPTION: Indexes every row of 'Store': one bitmap per value of each 
+//              'Dictionary' column and of the year, and one per tag feature.
+void FacetIndex::build(const TagStore& Store) {
+	clear();
+	Store_ = &Store;
+	const RowId rows_ = static_cast<RowId>(Store.size());
+	
+	for (size_t c = 0; c < kINDEX_FIELD_COUNT; ++c) {
+		const TagColumn column_ = static_cast<TagColumn>(c);
+		if (TagStore::columnKind(column_) == TagColumnKind::Dictionary) {
+			ByValue_[c].resize(Store.dictionary(column_).size());
+		}
+	}
+	
+	// Rows are visited in order, so every bitmap is built by appending:
+	const std::vector<RowId> noComment_ = Store.filterEquals(TagColumn::Comment, "");
+	size_t                   next_      = 0;
+	RowBitmap*               year_      = nullptr;
+	uint32_t                 yearValue_ = UINT32_MAX;
+	for (RowId row_ = 0; row_ < rows_; ++row_) {
+		All_.add(row_);
+		for (size_t c = 0; c < kINDEX_FIELD_COUNT; ++c) {
+			if (!ByValue_[c].empty()) {
+				ByValue_[c][Store.dictionaryId(row_, static_cast<TagColumn>(c))].add(row_);
+			}
+		}
+		const uint32_t thisYear_ = Store.number(row_, TagColumn::Year);
+		if (thisYear_ != yearValue_) {
+			yearValue_ = thisYear_;
+			year_      = &ByYear_[thisYear_];
+		}
+		year_->add(row_);
+		
+		const uint32_t flags_ = Store.flags(row_);
+		if (flags_ & kINDEX_HAS_TAG) {
+			Features_[static_cast<size_t>(TagFeature::Tagged)].add(row_);
+		}
+		if (flags_ & kINDEX_HAS_COVER) {
+			Features_[static_cast<size_t>(TagFeature::Cover)].add(row_);
+		}
+		const uint32_t version_ = (flags_ >> kINDEX_VERSION_SHIFT) & 0xFF;
+		if (version_ == 3) {
+			Features_[static_cast<size_t>(TagFeature::Id3v23)].add(row_);
+		} else if (version_ == 4) {
+			Features_[static_cast<size_t>(TagFeature::Id3v24)].add(row_);
+		}
+		if ((next_ < noComment_.size()) && (noComment_[next_] == row_)) {
+			++next_;
+		} else {
+			Features_[static_cast<size_t>(TagFeature::Comment)].add(row_);
+		}
+	}
+}
+
+
+void FacetIndex::clear() noexcept {
+	Store_ = nullptr;
+	All_.clear();
+	for (auto& column_ : ByValue_) {
+		column_.clear();
+	}
+	ByYear_.clear();
+	for (RowBitmap& feature_ : Features_) {
+		feature_.clear();
+	}
+}
+
+
+// FUNCTION:    memoryUsage
+// DESCRIPTION: Returns roughly how many bytes the bitmaps take.
+size_t FacetIndex::memoryUsage() const noexcept {
+	size_t bytes_ = All_.memoryUsage();
+	for (const auto& column_ : ByValue_) {
+		for (const RowBitmap& rows_ : column_) {
+			bytes_ += rows_.memoryUsage();
+		}
+	}
+	for (const auto& year_ : ByYear_) {
+		bytes_ += sizeof(year_) + year_.second.memoryUsage();
+	}
+	for (const RowBitmap& feature_ : Features_) {
+		bytes_ += feature_.memoryUsage();
+	}
+	return bytes_;
+}
+
+
+// FUNCTION:    all
+// DESCRIPTION: Returns every row, for use as the left side of 'subtract()'.
+const RowBitmap& FacetIndex::all() const noexcept {
+	return All_;
+}
+
+
+// FUNCTION:    rows
+// DESCRIPTION: Returns the rows whose 'Column' is 'Value': a dictionary id for 
+//              a 'Dictionary' column (0 for rows where it is empty), or the 
+//              year itself (0 for rows without one).
+const RowBitmap& FacetIndex::rows(TagColumn Column, uint32_t Value) const noexcept {
+	if (Column == TagColumn::Year) {
+		auto it_ = ByYear_.find(Value);
+		return (it_ != ByYear_.end()) ? it_->second : s_EmptyBitmap_;
+	}
+	const auto& column_ = ByValue_[static_cast<size_t>(Column)];
+	return (Value < column_.size()) ? column_[Value] : s_EmptyBitmap_;
+}
+
+
+const RowBitmap& FacetIndex::rows(TagColumn Column, std::string_view Value) const {
+	if (Column == TagColumn::Year) {
+		return rows(Column, ParseTagNumber(Value) >> 16);
+	}
+	if ((Store_ == nullptr) || !isFaceted(Column)) {
+		return s_EmptyBitmap_;
+	}
+	const uint32_t id_ = Store_->dictionary(Column).find(Value);
+	return (id_ != TagStore::kNOT_FOUND) ? rows(Column, id_) : s_EmptyBitmap_;
+}
+
+
+// FUNCTION:    yearRange
+// DESCRIPTION: Returns the rows whose year is in ['Low', 'High'].
+RowBitmap FacetIndex::yearRange(uint32_t Low, uint32_t High) const {
+	RowBitmap out_;
+	for (auto it_ = ByYear_.lower_bound(Low);
+		 (it_ != ByYear_.end()) && (it_->first <= High); ++it_) {
+		out_ = RowBitmap::unite(out_, it_->second);
+	}
+	return out_;
+}
+
+
+const RowBitmap& FacetIndex::feature(TagFeature Feature) const noexcept {
+	return Features_[static_cast<size_t>(Feature)];
+}
+
+
+// FUNCTION:    counts
+// DESCRIPTION: Returns how many rows (of 'Selection', or of all rows) have 
+//              each value of 'Column', most common first; values no such row 
+//              has are left out.
+std::vector<FacetCount> FacetIndex::counts(TagColumn        Column, 
+										   const RowBitmap* Selection) const {
+	std::vector<FacetCount> out_;
+	auto tally_ = [&](uint32_t Value, const RowBitmap& Rows) {
+		const size_t count_ = (Selection != nullptr) 
+							  ? RowBitmap::intersectCount(Rows, *Selection) 
+							  : Rows.count();
+		if (count_ != 0) {
+			out_.push_back({ Value, count_ });
+		}
+	};
+	if (Column == TagColumn::Year) {
+		for (const auto& [year_, rows_ ] : ByYear_) {
+			tally_(year_, rows_);
+		}
+	} else if (isFaceted(Column)) {
+		const auto& column_ = ByValue_[static_cast<size_t>(Column)];
+		for (size_t v = 0; v < column_.size(); ++v) {
+			tally_(static_cast<uint32_t>(v), column_[v]);
+		}
+	}
+	std::sort(out_.begin(), out_.end(), [](const FacetCount& a_, const FacetCount& b_) {
+		return (a_.Count_ != b_.Count_) ? (a_.Count_ > b_.Count_) : (a_.Value_ < b_.Value_);
+	});
+	return out_;
+}
+
+
+// FUNCTION:    isFaceted
+// DESCRIPTION: Returns 'true' for the columns that have per-value bitmaps: the 
+//              'Dictionary' columns and the year.
+bool FacetIndex::isFaceted(TagColumn Column) noexcept {
+	return (Column == TagColumn::Year) 
+		   || (TagStore::columnKind(Column) == TagColumnKind::Dictionary);
+}
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      FacetIndex.hpp
+// FILE PURPOSE:  Declares the class 'RowBitmap', a compressed set of 'TagStore' 
+//                rows, and 'FacetIndex', which keeps one such set per value of 
+//                the low-cardinality columns and per tag feature, for faceted 
+//                browsing without scanning every row.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <array>
+#include <map>
+#include <string_view>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagStore.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+enum class TagFeature : uint8_t {
+	Tagged,   // Has an ID3v2 tag at all
+	Cover,    // Has an APIC frame
+	Comment,  // Has a non-empty comment
+	Id3v23, 
+	Id3v24
+};
+
+constexpr static const size_t kTAG_FEATURE_COUNT = 5;
+
+struct FacetCount {
+	uint32_t Value_;  // Dictionary id, or the year itself
+	size_t   Count_;
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// Rows are split into chunks of 65536 by their top 16 bits. A chunk keeps the 
+// low 16 bits of its rows as a sorted array while it has few of them, and as 
+// a 65536-bit set once the set is smaller (the layout of "Roaring" bitmaps); 
+// two bit sets combine a machine word, or with SSE2 two, at a time.
+class RowBitmap {
+
+	private:
+		constexpr static const size_t kARRAY_MAX = 4096; // Array <= bit set size
+		constexpr static const size_t kWORDS     = 1024; // 64-bit words per set
+		
+		struct Chunk {
+			uint16_t              Key_   = 0; // Top 16 bits of the rows
+			uint32_t              Count_ = 0;
+			std::vector<uint16_t> Array_;     // Used while 'Bits_' is empty
+			std::vector<uint64_t> Bits_;      // 'kWORDS' words once dense
+		};
+		
+		std::vector<Chunk> Chunks_;           // Sorted by 'Key_'
+	
+	public:
+		void               add(RowId Row);
+		bool               contains(RowId Row) const noexcept;
+		size_t             count() const noexcept;
+		bool               empty() const noexcept;
+		void               clear() noexcept;
+		size_t             memoryUsage() const noexcept;
+		std::vector<RowId> rows() const;
+		
+		static RowBitmap   intersect(const RowBitmap& A, const RowBitmap& B);
+		static RowBitmap   unite(const RowBitmap& A, const RowBitmap& B);
+		static RowBitmap   subtract(const RowBitmap& A, const RowBitmap& B);
+		static size_t      intersectCount(const RowBitmap& A, const RowBitmap& B);
+	
+	private:
+		static void        andChunks(const Chunk& A, const Chunk& B, Chunk& Out);
+		static void        orChunks(const Chunk& A, const Chunk& B, Chunk& Out);
+		static void        andNotChunks(const Chunk& A, const Chunk& B, Chunk& Out);
+		static size_t      andCount(const Chunk& A, const Chunk& B);
+		static void        toBits(Chunk& Target);
+		static void        shrink(Chunk& Target);
+
+};
+
+
+// Built from a 'TagStore', which must outlive it and not change while it is in 
+// use; rebuild it after adding rows.
+class FacetIndex {
+
+	private:
+		const TagStore*                                          Store_ = nullptr;
+		RowBitmap                                                All_;
+		// Per 'Dictionary' column (indexed by 'TagColumn'): dictionary id -> rows
+		std::array<std::vector<RowBitmap>, kINDEX_FIELD_COUNT>   ByValue_;
+		std::map<uint32_t, RowBitmap>                            ByYear_;
+		std::array<RowBitmap, kTAG_FEATURE_COUNT>                Features_;
+	
+	public:
+		FacetIndex() noexcept;
+		~FacetIndex() noexcept;
+		
+		FacetIndex(const FacetIndex&)            = delete;
+		FacetIndex& operator=(const FacetIndex&) = delete;
+		
+		void             build(const TagStore& Store);
+		void             clear() noexcept;
+		size_t           memoryUsage() const noexcept;
+		
+		const RowBitmap& all() const noexcept;
+		const RowBitmap& rows(TagColumn Column, uint32_t Value) const noexcept;
+		const RowBitmap& rows(TagColumn Column, std::string_view Value) const;
+		RowBitmap        yearRange(uint32_t Low, uint32_t High) const;
+		const RowBitmap& feature(TagFeature Feature) const noexcept;
+		
+		std::vector<FacetCount> counts(TagColumn        Column, 
+									   const RowBitmap* Selection = nullptr) const;
+		
+		static bool      isFaceted(TagColumn Column) noexcept;
+
+};
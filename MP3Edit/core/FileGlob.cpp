@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      FileGlob.cpp
+// FILE PURPOSE:  Defines portable wildcard matching and pattern expansion.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "FileGlob.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    MatchClass
+// PURPOSE: Matches 'c_' against the bracket expression that starts at 
+//          'Pattern[Pos]' (just after the '['). On return, 'Pos' is just past 
+//          the closing ']'. Returns 'false' in 'Valid' if there is no ']'.
+auto static MatchClass(const std::string& Pattern, 
+					   size_t&            Pos, 
+					   char               c_, 
+					   bool&              Valid)->bool {
+	size_t i       = Pos;
+	bool   negate_ = false;
+	bool   match_  = false;
+	if ((i < Pattern.length()) && ((Pattern[i] == '!') || (Pattern[i] == '^'))) {
+		negate_ = true;
+		++i;
+	}
+	
+	bool first_ = true;
+	while ((i < Pattern.length()) && (first_ || (Pattern[i] != ']'))) {
+		first_   = false;
+		char lo_ = Pattern[i];
+		char hi_ = lo_;
+		if (((i + 2) < Pattern.length()) && (Pattern[i + 1] == '-') 
+			&& (Pattern[i + 2] != ']')) {
+			hi_ = Pattern[i + 2];
+			i  += 2;
+		}
+		if ((c_ >= lo_) && (c_ <= hi_)) {
+			match_ = true;
+		}
+		++i;
+	}
+	
+	Valid = (i < Pattern.length());
+	Pos   = i + 1;
+	return (match_ != negate_);
+}
+
+
+// NAME:    ExpandComponents
+// PURPOSE: Recursively expands the path components 'Parts[Index...]' below 
+//          'Base', appending every existing match to 'Out'.
+auto static ExpandComponents(const fs::path&                 Base, 
+							 const std::vector<std::string>& Parts, 
+							 size_t                          Index, 
+							 std::vector<std::string>&       Out)->void {
+	std::error_code ec_;
+	if (Index == Parts.size()) {
+		if (fs::exists(Base, ec_)) {
+			Out.push_back(Base.generic_string());
+		}
+		return;
+	}
+	
+	const std::string& part_ = Parts[Index];
+	const fs::path     dir_  = Base.empty() ? fs::path(".") : Base;
+	
+	if (!HasGlobChars(part_)) {
+		ExpandComponents(Base / part_, Parts, Index + 1, Out);
+		return;
+	}
+	
+	if (part_ == "**") {
+		// "**" matches zero or more directories:
+		ExpandComponents(Base, Parts, Index + 1, Out);
+		fs::recursive_directory_iterator it_(
+			dir_, fs::directory_options::skip_permission_denied, ec_);
+		for (; !ec_ && (it_ != fs::recursive_directory_iterator());
+			 it_.increment(ec_)) {
+			if (it_->is_directory(ec_)) {
+				fs::path sub_ = Base.empty() 
+								? it_->path().lexically_relative(".") 
+								: it_->path();
+				ExpandComponents(sub_, Parts, Index + 1, Out);
+			}
+		}
+		return;
+	}
+	
+	fs::directory_iterator it_(
+		dir_, fs::directory_options::skip_permission_denied, ec_);
+	for (; !ec_ && (it_ != fs::directory_iterator()); it_.increment(ec_)) {
+		const std::string name_ = it_->path().filename().string();
+		// As in POSIX shells, wildcards do not match a leading '.':
+		if ((name_[0] == '.') && (part_[0] != '.')) {
+			continue;
+		}
+		if (MatchGlob(part_, name_)) {
+			ExpandComponents(Base / name_, Parts, Index + 1, Out);
+		}
+	}
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    HasGlobChars
+// DESCRIPTION: Returns 'true' if 'Pattern' contains any of "*?[".
+auto HasGlobChars(const std::string& Pattern)->bool {
+	return Pattern.find_first_of("*?[") != std::string::npos;
+}
+
+
+// FUNCTION:    MatchGlob
+// DESCRIPTION: Matches a single file name against a shell-style pattern:
+//              '*' (any run of characters), '?' (any one character), and 
+//              '[abc]', '[a-z]', '[!abc]' (character classes). Uses the usual 
+//              backtracking-on-the-last-star algorithm, so it runs in 
+//              O(len(Pattern) * len(Name)) at worst.
+auto MatchGlob(const std::string& Pattern, const std::string& Name)->bool {
+	size_t p_     = 0;
+	size_t n_     = 0;
+	size_t starP_ = std::string::npos;
+	size_t starN_ = 0;
+	
+	while (n_ < Name.length()) {
+		if (p_ < Pattern.length()) {
+			const char pc_ = Pattern[p_];
+			if (pc_ == '*') {
+				starP_ = p_++;
+				starN_ = n_;
+				continue;
+			}
+			if (pc_ == '?') {
+				++p_;
+				++n_;
+				continue;
+			}
+			if (pc_ == '[') {
+				size_t next_  = p_ + 1;
+				bool   valid_ = false;
+				bool   match_ = MatchClass(Pattern, next_, Name[n_], valid_);
+				if (valid_) {
+					if (match_) {
+						p_ = next_;
+						++n_;
+						continue;
+					}
+				} else if (Name[n_] == '[') {
+					// An unterminated '[' is an ordinary character:
+					++p_;
+					++n_;
+					continue;
+				}
+			} else if (pc_ == Name[n_]) {
+				++p_;
+				++n_;
+				continue;
+			}
+		}
+		if (starP_ == std::string::npos) {
+			return false;
+		}
+		p_ = starP_ + 1;
+		n_ = ++starN_;
+	}
+	
+	while ((p_ < Pattern.length()) && (Pattern[p_] == '*')) {
+		++p_;
+	}
+	return (p_ == Pattern.length());
+}
+
+
+// FUNCTION:    ExpandGlob
+// DESCRIPTION: Returns the paths that match 'Pattern', sorted. Each path 
+//              component may contain wildcards, and a "**" component matches 
+//              any number of directories. A pattern without wildcards is 
+//              returned unchanged (even if it does not exist), so that the 
+//              caller can report the missing file; a pattern with wildcards 
+//              that matches nothing gives an empty list.
+auto ExpandGlob(const std::string& Pattern)->std::vector<std::string> {
+	if (!HasGlobChars(Pattern)) {
+		return { Pattern };
+	}
+	
+	// Split into the root (if any) and the components below it:
+	fs::path                 path_(Pattern);
+	fs::path                 base_ = path_.root_path();
+	std::vector<std::string> parts_;
+	for (const fs::path& part_ : path_.relative_path()) {
+		if (!part_.empty()) {
+			parts_.push_back(part_.string());
+		}
+	}
+	
+	std::vector<std::string> out_;
+	ExpandComponents(base_, parts_, 0, out_);
+	std::sort(out_.begin(), out_.end());
+	out_.erase(std::unique(out_.begin(), out_.end()), out_.end());
+	return out_;
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      FileGlob.hpp
+// FILE PURPOSE:  Declares portable wildcard matching and expansion of file 
+//                name patterns such as "music/**/*.mp3".
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <string>
+#include <vector>
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto HasGlobChars(const std::string& Pattern)->bool;
+auto MatchGlob(const std::string& Pattern, const std::string& Name)->bool;
+auto ExpandGlob(const std::string& Pattern)->std::vector<std::string>;
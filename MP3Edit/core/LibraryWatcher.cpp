@@ -0,0 +1,413 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      LibraryWatcher.cpp
+// FILE PURPOSE:  Defines the class 'LibraryWatcher'. On Linux, every folder 
+//                below the roots gets an inotify watch; events only mark files 
+//                as touched, and a file is read once it has been quiet for 
+//                'QuietMs_', so that a burst (such as rsync writing an album) 
+//                costs one parse per file. Elsewhere, 'start()' fails.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cerrno>
+#include <cinttypes>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// PROJECT-SPECIFIC HEADERS:
+#include "DirCrawler.hpp"
+#include "LibraryWatcher.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const size_t kEVENT_BUFFER_SIZE = 65536;
+
+#if defined(__linux__)
+// Closing a written file, renames in and out, deletions, and new entries 
+// (new folders must be watched; new hard links never see a write):
+constexpr static const uint32_t kWATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO
+											  | IN_MOVED_FROM | IN_DELETE
+											  | IN_CREATE | IN_ONLYDIR
+											  | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+#endif
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    IsBelow
+// PURPOSE: Returns 'true' if 'Path' is 'Folder' or lies below it.
+auto static IsBelow(const std::string& Path, const std::string& Folder)->bool {
+	return (Path.compare(0, Folder.length(), Folder) == 0) 
+		   && ((Path.length() == Folder.length()) 
+			   || (Path[Folder.length()] == '/'));
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+LibraryWatcher::LibraryWatcher() noexcept {}
+
+
+LibraryWatcher::LibraryWatcher(WatchOptions Options) noexcept 
+	: Options_(std::move(Options)) {}
+
+
+LibraryWatcher::~LibraryWatcher() noexcept {
+	stop();
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    start
+// DESCRIPTION: Starts watching the folders 'Roots' (and everything below them) 
+//              on a background thread. The files already present are only 
+//              stat'ed, not reported; after that, 'OnChange' is called on the 
+//              background thread with each batch of changes, sorted by path. 
+//              Returns 'false' if a root is not a folder, if the watcher is 
+//              already running, or if the platform has no inotify.
+bool LibraryWatcher::start(const std::vector<std::string>& Roots, 
+						   ChangeCallback                  OnChange) {
+#if defined(__linux__)
+	if (Running_ || Thread_.joinable()) {
+		return false;
+	}
+	
+	Roots_.clear();
+	for (const std::string& root_ : Roots) {
+		std::error_code ec_;
+		if (!fs::is_directory(root_, ec_)) {
+			return false;
+		}
+		std::string clean_ = root_;
+		while ((clean_.length() > 1) && (clean_.back() == '/')) {
+			clean_.pop_back();
+		}
+		Roots_.push_back(std::move(clean_));
+	}
+	
+	NotifyFd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	WakeFd_   = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if ((NotifyFd_ < 0) || (WakeFd_ < 0)) {
+		stop();
+		return false;
+	}
+	
+	OnChange_ = std::move(OnChange);
+	Running_  = true;
+	Thread_   = std::thread(&LibraryWatcher::threadLoop, this);
+	return true;
+#else
+	(void)Roots;
+	(void)OnChange;
+	return false;
+#endif
+}
+
+
+// FUNCTION:    stop
+// DESCRIPTION: Stops the background thread and drops all watches. Changes 
+//              that are still waiting out their quiet period are discarded. 
+//              Must not be called from inside the change callback.
+void LibraryWatcher::stop() noexcept {
+#if defined(__linux__)
+	Running_ = false;
+	if (Thread_.joinable()) {
+		const uint64_t one_ = 1;
+		(void)!::write(WakeFd_, &one_, sizeof(one_));
+		Thread_.join();
+	}
+	if (NotifyFd_ >= 0) {
+		::close(NotifyFd_);
+	}
+	if (WakeFd_ >= 0) {
+		::close(WakeFd_);
+	}
+#endif
+	NotifyFd_ = -1;
+	WakeFd_   = -1;
+	Watches_.clear();
+	Known_.clear();
+	Pending_.clear();
+}
+
+
+bool LibraryWatcher::isRunning() const noexcept {
+	return Running_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    threadLoop
+// DESCRIPTION: Body of the background thread: watches the roots, then waits 
+//              for events, sleeping no longer than the next pending file needs.
+void LibraryWatcher::threadLoop() {
+#if defined(__linux__)
+	for (const std::string& root_ : Roots_) {
+		watchTree(root_, false);
+	}
+	
+	while (Running_) {
+		int timeout_ = -1;
+		if (!Pending_.empty()) {
+			Clock::time_point next_ = Pending_.begin()->second;
+			for (const auto& pending_ : Pending_) {
+				next_ = std::min(next_, pending_.second);
+			}
+			auto wait_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+				next_ - Clock::now()).count();
+			timeout_ = static_cast<int>(std::max<decltype(wait_)>(wait_ + 1, 0));
+		}
+		
+		struct pollfd fds_[2] = { { NotifyFd_, POLLIN, 0 }, 
+								  { WakeFd_,   POLLIN, 0 } };
+		if ((::poll(fds_, 2, timeout_) < 0) && (errno != EINTR)) {
+			break;
+		}
+		if (!Running_ || (fds_[1].revents != 0)) {
+			break;
+		}
+		if (fds_[0].revents & POLLIN) {
+			readEvents();
+		}
+		flush();
+	}
+#endif
+}
+
+
+// FUNCTION:    watchTree
+// DESCRIPTION: Adds a watch to 'Folder' and every folder below it. Each folder 
+//              is watched before it is listed, so nothing created meanwhile is 
+//              missed. Files found are stat'ed into 'Known_', or, if 
+//              'TouchFiles' is set (the folder is new to us), queued as touched.
+void LibraryWatcher::watchTree(const std::string& Folder, bool TouchFiles) {
+#if defined(__linux__)
+	std::vector<std::string> stack_ = { Folder };
+	while (!stack_.empty()) {
+		std::string dir_ = std::move(stack_.back());
+		stack_.pop_back();
+		
+		int wd_ = ::inotify_add_watch(NotifyFd_, dir_.c_str(), kWATCH_MASK);
+		if (wd_ < 0) {
+			continue;
+		}
+		Watches_[wd_] = dir_;
+		
+		std::error_code        ec_;
+		fs::directory_iterator it_(dir_, ec_);
+		for (; !ec_ && (it_ != fs::directory_iterator()); it_.increment(ec_)) {
+			const std::string name_ = it_->path().filename().string();
+			if (Options_.SkipHidden_ && (name_[0] == '.')) {
+				continue;
+			}
+			std::string     path_ = dir_ + '/' + name_;
+			std::error_code typeEc_;
+			if (it_->is_directory(typeEc_) && !it_->is_symlink(typeEc_)) {
+				stack_.push_back(std::move(path_));
+				continue;
+			}
+			if (!isWanted(name_)) {
+				continue;
+			}
+			if (TouchFiles) {
+				touch(path_);
+				continue;
+			}
+			FileKey key_;
+			if (GetFileKey(path_, key_)) {
+				Known_[path_] = key_;
+			}
+		}
+	}
+#else
+	(void)Folder;
+	(void)TouchFiles;
+#endif
+}
+
+
+// FUNCTION:    unwatchTree
+// DESCRIPTION: Drops the watches on 'Folder' and below (it was moved away or 
+//              deleted), and queues every file known below it, so that each is 
+//              reported as removed unless it turns up again.
+void LibraryWatcher::unwatchTree(const std::string& Folder) {
+#if defined(__linux__)
+	for (auto it_ = Watches_.begin(); it_ != Watches_.end();) {
+		if (IsBelow(it_->second, Folder)) {
+			::inotify_rm_watch(NotifyFd_, it_->first);
+			it_ = Watches_.erase(it_);
+		} else {
+			++it_;
+		}
+	}
+	for (const auto& known_ : Known_) {
+		if (IsBelow(known_.first, Folder)) {
+			touch(known_.first);
+		}
+	}
+#else
+	(void)Folder;
+#endif
+}
+
+
+// FUNCTION:    readEvents
+// DESCRIPTION: Drains the inotify queue, turning events into touched files and 
+//              new or vanished folders into watch changes.
+void LibraryWatcher::readEvents() {
+#if defined(__linux__)
+	alignas(struct inotify_event) static thread_local char
+		buffer_[kEVENT_BUFFER_SIZE];
+	
+	for (;;) {
+		ssize_t got_ = ::read(NotifyFd_, buffer_, sizeof(buffer_));
+		if (got_ <= 0) {
+			return; // EAGAIN: drained
+		}
+		
+		for (ssize_t pos_ = 0; pos_ < got_;) {
+			const auto* ev_ = reinterpret_cast<const struct inotify_event*>(
+				buffer_ + pos_);
+			pos_ += static_cast<ssize_t>(sizeof(struct inotify_event) + ev_->len);
+			
+			if (ev_->mask & IN_Q_OVERFLOW) {
+				rescan();
+				continue;
+			}
+			if (ev_->mask & IN_IGNORED) {
+				Watches_.erase(ev_->wd);
+				continue;
+			}
+			auto dir_ = Watches_.find(ev_->wd);
+			if ((dir_ == Watches_.end()) || (ev_->len == 0)) {
+				continue;
+			}
+			
+			const std::string name_ = ev_->name;
+			if (Options_.SkipHidden_ && (name_[0] == '.')) {
+				continue;
+			}
+			const std::string path_ = dir_->second + '/' + name_;
+			if (ev_->mask & IN_ISDIR) {
+				if (ev_->mask & (IN_MOVED_FROM | IN_DELETE)) {
+					unwatchTree(path_);
+				} else if (ev_->mask & (IN_CREATE | IN_MOVED_TO)) {
+					watchTree(path_, true);
+				}
+			} else if (isWanted(name_)) {
+				touch(path_);
+			}
+		}
+	}
+#endif
+}
+
+
+// FUNCTION:    touch
+// DESCRIPTION: Queues 'Path' to be read once it has been quiet for 'QuietMs_'; 
+//              a later event on the same file pushes the deadline back.
+void LibraryWatcher::touch(const std::string& Path) {
+	Pending_[Path] = Clock::now() + std::chrono::milliseconds(Options_.QuietMs_);
+}
+
+
+// FUNCTION:    rescan
+// DESCRIPTION: Recovers from an inotify queue overflow, after which events
+//              were lost: every watch is re-added and every file, old or new, 
+//              is queued. Files whose key did not change are then skipped by 
+//              'flush()', so only real changes are reported.
+void LibraryWatcher::rescan() {
+#if defined(__linux__)
+	for (const auto& watch_ : Watches_) {
+		::inotify_rm_watch(NotifyFd_, watch_.first);
+	}
+	Watches_.clear();
+	for (const auto& known_ : Known_) {
+		touch(known_.first);
+	}
+	for (const std::string& root_ : Roots_) {
+		watchTree(root_, true);
+	}
+#endif
+}
+
+
+// FUNCTION:    flush
+// DESCRIPTION: Reads every touched file whose quiet period is over, compares 
+//              its key to the last one seen, and passes the real changes to 
+//              the callback in one batch.
+void LibraryWatcher::flush() {
+	const Clock::time_point now_ = Clock::now();
+	std::vector<std::string> ready_;
+	for (auto it_ = Pending_.begin(); it_ != Pending_.end();) {
+		if (it_->second <= now_) {
+			ready_.push_back(it_->first);
+			it_ = Pending_.erase(it_);
+		} else {
+			++it_;
+		}
+	}
+	if (ready_.empty()) {
+		return;
+	}
+	std::sort(ready_.begin(), ready_.end());
+	
+	std::vector<TagChange> changes_;
+	for (std::string& path_ : ready_) {
+		auto    known_ = Known_.find(path_);
+		FileKey key_;
+		if (!GetFileKey(path_, key_)) {
+			if (known_ != Known_.end()) {
+				Known_.erase(known_);
+				TagChange change_{ TagChangeKind::Removed, IndexEntry() };
+				change_.Entry_.Path_ = std::move(path_);
+				changes_.push_back(std::move(change_));
+			}
+			continue;
+		}
+		
+		const bool isNew_ = (known_ == Known_.end());
+		if (!isNew_ && SameFileKey(known_->second, key_)) {
+			continue; // Touched but unchanged (e.g. opened for writing only)
+		}
+		
+		TagChange change_{ isNew_ ? TagChangeKind::Added : TagChangeKind::Modified, 
+						   IndexEntry() };
+		change_.Entry_.Path_    = path_;
+		ReadTagEntry(change_.Entry_);
+		change_.Entry_.Device_  = key_.Device_;
+		change_.Entry_.Inode_   = key_.Inode_;
+		change_.Entry_.Size_    = key_.Size_;
+		change_.Entry_.MtimeNs_ = key_.MtimeNs_;
+		Known_[path_] = key_;
+		changes_.push_back(std::move(change_));
+	}
+	
+	if (!changes_.empty() && OnChange_) {
+		OnChange_(changes_);
+	}
+}
+
+
+// FUNCTION:    isWanted
+// DESCRIPTION: Returns 'true' if the file name 'Name' has one of the watched 
+//              extensions.
+bool LibraryWatcher::isWanted(const std::string& Name) const {
+	return HasExtension(Name.c_str(), Name.length(), Options_.Extensions_);
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      LibraryWatcher.hpp
+// FILE PURPOSE:  Declares the class 'LibraryWatcher', which follows changes 
+//                below a set of library folders and reports the tags of the 
+//                files that were added, modified or removed.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagIndex.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+enum class TagChangeKind {
+	Added, 
+	Modified, 
+	Removed
+};
+
+struct TagChange {
+	TagChangeKind Kind_;
+	IndexEntry    Entry_;    // Only 'Path_' is set for 'Removed'
+};
+
+struct WatchOptions {
+	std::vector<std::string> Extensions_ = { ".mp3" };
+	bool                     SkipHidden_ = true;  // Also skips rsync's temp files
+	unsigned                 QuietMs_    = 500;   // Wait this long after the last
+												  // event on a file before reading it
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+class LibraryWatcher {
+
+	public:
+		using ChangeCallback = std::function<void(const std::vector<TagChange>&)>;
+		using Clock          = std::chrono::steady_clock;
+	
+	private:
+		WatchOptions                              Options_;
+		ChangeCallback                            OnChange_;
+		std::vector<std::string>                  Roots_;
+		std::thread                               Thread_;
+		std::atomic<bool>                         Running_{false};
+		int                                       NotifyFd_ = -1;
+		int                                       WakeFd_   = -1;
+		std::unordered_map<int, std::string>      Watches_; // Descriptor -> folder
+		std::unordered_map<std::string, FileKey>  Known_;   // File -> last key seen
+		std::unordered_map<std::string, Clock::time_point> Pending_; // Touched files
+	
+	public:
+		LibraryWatcher() noexcept;
+		explicit LibraryWatcher(WatchOptions Options) noexcept;
+		~LibraryWatcher() noexcept;
+		
+		LibraryWatcher(const LibraryWatcher&)            = delete;
+		LibraryWatcher& operator=(const LibraryWatcher&) = delete;
+		
+		bool start(const std::vector<std::string>& Roots, ChangeCallback OnChange);
+		void stop() noexcept;
+		bool isRunning() const noexcept;
+	
+	private:
+		void threadLoop();
+		void watchTree(const std::string& Folder, bool TouchFiles);
+		void unwatchTree(const std::string& Folder);
+		void readEvents();
+		void touch(const std::string& Path);
+		void rescan();
+		void flush();
+		bool isWanted(const std::string& Name) const;
+
+};
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      PaddingJob.cpp
+// FILE PURPOSE:  Defines the batch job that rewrites the tags of a set of 
+//                MP3s so that their padding matches a padding policy.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "PaddingJob.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    IsMP3Filename
+// DESCRIPTION: Returns 'true' if 'Filename' has an ".mp3" extension (in any 
+//              case). Unlike 'TagsIO::isValidMP3()', this does not touch the 
+//              file system, so it is cheap enough to run over whole libraries.
+auto IsMP3Filename(const std::string& Filename)->bool {
+	constexpr const char Expected_[] = ".mp3";
+	constexpr const size_t ExtLen_   = sizeof(Expected_) - 1;
+	if (Filename.length() < ExtLen_) {
+		return false;
+	}
+	return std::equal(Filename.end() - ExtLen_, 
+					  Filename.end(), 
+					  Expected_, 
+					  [](char a_, char b_) {
+						  return std::tolower(static_cast<unsigned char>(a_)) 
+								 == b_;
+					  });
+}
+
+
+// FUNCTION:    NormalizePadding
+// DESCRIPTION: Rewrites the tag of every MP3 in 'Files' whose padding differs 
+//              from what 'Policy' asks for. Files that are not MP3s are 
+//              ignored; files that are already sized correctly are not 
+//              written to. Intended to be run once over a library after the 
+//              policy changes, so that later edits can be done in place.
+auto NormalizePadding(const std::vector<std::string>& Files, 
+					  ID3v2_padding_policy&           Policy)->PaddingReport {
+	PaddingReport report_;
+	std::error_code ec_;
+	
+	for (const std::string& file_ : Files) {
+		if (!IsMP3Filename(file_) || !fs::is_regular_file(file_, ec_)) {
+			continue;
+		}
+		++report_.FilesScanned_;
+		
+		switch (normalize_tag_padding(file_.c_str(), &Policy)) {
+			case TAG_WRITE_IN_PLACE:
+				++report_.FilesUnchanged_;
+				break;
+			case TAG_WRITE_REWRITE:
+			case TAG_WRITE_INSERT_RANGE:
+				++report_.FilesRewritten_;
+				break;
+			default:
+				++report_.FilesFailed_;
+				break;
+		}
+	}
+	
+	return report_;
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      PaddingJob.hpp
+// FILE PURPOSE:  Declares the batch job that rewrites the tags of a set of 
+//                MP3s so that their padding matches a padding policy.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct PaddingReport {
+	size_t FilesScanned_   = 0;
+	size_t FilesRewritten_ = 0; // Padding was resized to match the policy
+	size_t FilesUnchanged_ = 0; // Padding already matched the policy
+	size_t FilesFailed_    = 0; // No readable ID3v2 tag, or write failed
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto IsMP3Filename(const std::string& Filename)->bool;
+auto NormalizePadding(const std::vector<std::string>& Files, 
+					  ID3v2_padding_policy&           Policy)->PaddingReport;
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      SimdSupport.hpp
+// FILE PURPOSE:  Detects the vector instructions the core's hot loops may use 
+//                and includes their intrinsics. Defines 'MP3EDIT_HAVE_SSE2' 
+//                when SSE2 is available (always so on x86-64).
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MP3EDIT_HAVE_SSE2 1
+#endif
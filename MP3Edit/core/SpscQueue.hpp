@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      SpscQueue.hpp
+// FILE PURPOSE:  Declares and defines the class template 'SpscQueue', a 
+//                fixed-capacity lock-free queue for exactly one producer 
+//                thread and one consumer thread.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstddef>
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// A ring indexed by two counters, each written by one side only (L. Lamport's 
+// queue). Each side also keeps a copy of the other side's counter, and only 
+// reloads it when the copy says the ring is full (or empty), so a push or pop 
+// usually touches no cache line the other thread writes. Cheaper than a 
+// 'BoundedQueue' where there is one thread on each end; like it, 'tryPush()' 
+// and 'tryPop()' never block and never allocate.
+template <typename T>
+class SpscQueue {
+
+	private:
+		std::unique_ptr<T[]> Cells_;
+		size_t               Mask_;
+		alignas(64) std::atomic<size_t> Tail_{0};  // Written by the producer
+		size_t                          HeadCopy_ = 0;
+		alignas(64) std::atomic<size_t> Head_{0};  // Written by the consumer
+		size_t                          TailCopy_ = 0;
+	
+	public:
+		explicit SpscQueue(size_t Capacity);
+		~SpscQueue() noexcept = default;
+		
+		SpscQueue(const SpscQueue&)            = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+		
+		bool   tryPush(T& Value);
+		bool   tryPop(T& Value);
+		bool   empty() const noexcept;
+		size_t capacity() const noexcept;
+
+};
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+// The capacity is rounded up to a power of two (at least 2):
+template <typename T>
+SpscQueue<T>::SpscQueue(size_t Capacity) {
+	size_t size_ = 2;
+	while (size_ < Capacity) {
+		size_ <<= 1;
+	}
+	Cells_.reset(new T[size_]);
+	Mask_ = size_ - 1;
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    tryPush
+// DESCRIPTION: Moves 'Value' into the queue, or returns 'false' (leaving 
+//              'Value' alone) if the queue is full. Producer thread only.
+template <typename T>
+bool SpscQueue<T>::tryPush(T& Value) {
+	const size_t tail_ = Tail_.load(std::memory_order_relaxed);
+	if (tail_ - HeadCopy_ > Mask_) {
+		HeadCopy_ = Head_.load(std::memory_order_acquire);
+		if (tail_ - HeadCopy_ > Mask_) {
+			return false;
+		}
+	}
+	Cells_[tail_ & Mask_] = std::move(Value);
+	Tail_.store(tail_ + 1, std::memory_order_release);
+	return true;
+}
+
+
+// FUNCTION:    tryPop
+// DESCRIPTION: Moves the oldest value into 'Value', or returns 'false' if the 
+//              queue is empty. Consumer thread only.
+template <typename T>
+bool SpscQueue<T>::tryPop(T& Value) {
+	const size_t head_ = Head_.load(std::memory_order_relaxed);
+	if (head_ == TailCopy_) {
+		TailCopy_ = Tail_.load(std::memory_order_acquire);
+		if (head_ == TailCopy_) {
+			return false;
+		}
+	}
+	Value = std::move(Cells_[head_ & Mask_]);
+	Head_.store(head_ + 1, std::memory_order_release);
+	return true;
+}
+
+
+// FUNCTION:    empty
+// DESCRIPTION: Tells whether the queue held nothing at the moment of the call. 
+//              Exact only on the consumer thread, or once the producer is done.
+template <typename T>
+bool SpscQueue<T>::empty() const noexcept {
+	return Head_.load(std::memory_order_acquire) == Tail_.load(std::memory_order_acquire);
+}
+
+
+template <typename T>
+size_t SpscQueue<T>::capacity() const noexcept {
+	return Mask_ + 1;
+}
@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagFields.cpp
+// FILE PURPOSE:  Defines the table of tag fields and the frame text helpers.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <cctype>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagFields.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const char kENCODING_LATIN1   = 0;
+constexpr static const char kENCODING_UTF16    = 1; // With BOM
+constexpr static const char kENCODING_UTF16_BE = 2; // ID3v2.4 only
+constexpr static const char kENCODING_UTF8     = 3; // ID3v2.4 only
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    DecodeText
+// PURPOSE: Converts 'Length' bytes of ID3v2 text in 'Encoding' to UTF-8, 
+//          stopping at the first terminator.
+auto static DecodeText(const unsigned char* Data, 
+					   size_t               Length, 
+					   char                 Encoding)->std::string {
+	std::string out_;
+	out_.reserve(Length);
+	
+	if ((Encoding == kENCODING_UTF16) || (Encoding == kENCODING_UTF16_BE)) {
+		bool   bigEndian_ = (Encoding == kENCODING_UTF16_BE);
+		size_t i          = 0;
+		if (Length >= 2) {
+			if ((Data[0] == 0xFF) && (Data[1] == 0xFE)) {
+				bigEndian_ = false;
+				i          = 2;
+			} else if ((Data[0] == 0xFE) && (Data[1] == 0xFF)) {
+				bigEndian_ = true;
+				i          = 2;
+			}
+		}
+		for (; (i + 1) < Length; i += 2) {
+			uint32_t unit_ = bigEndian_ 
+							 ? ((Data[i] << 8) | Data[i + 1]) 
+							 : ((Data[i + 1] << 8) | Data[i]);
+			if (unit_ == 0) {
+				break;
+			}
+			// Combine surrogate pairs; a lone surrogate is passed through:
+			if ((unit_ >= 0xD800) && (unit_ < 0xDC00) && ((i + 3) < Length)) {
+				uint32_t low_ = bigEndian_ 
+								? ((Data[i + 2] << 8) | Data[i + 3]) 
+								: ((Data[i + 3] << 8) | Data[i + 2]);
+				if ((low_ >= 0xDC00) && (low_ < 0xE000)) {
+					unit_ = 0x10000 + ((unit_ - 0xD800) << 10)
+							+ (low_ - 0xDC00);
+					i += 2;
+				}
+			}
+			AppendUTF8(out_, unit_);
+		}
+	} else if (Encoding == kENCODING_UTF8) {
+		const void* end_ = std::memchr(Data, 0, Length);
+		size_t      len_ = (end_ != nullptr) 
+						   ? (static_cast<const unsigned char*>(end_) - Data) 
+						   : Length;
+		out_.assign(reinterpret_cast<const char*>(Data), len_);
+	} else {
+		for (size_t i = 0; i < Length; ++i) {
+			if (Data[i] == 0) {
+				break;
+			}
+			AppendUTF8(out_, Data[i]);
+		}
+	}
+	
+	return out_;
+}
+
+
+// NAME:    AppendUTF16
+// PURPOSE: Appends the UTF-8 string 'Value' to 'Out' as little-endian UTF-16 
+//          (without BOM or terminator). Malformed UTF-8 becomes U+FFFD.
+auto static AppendUTF16(std::vector<char>& Out, const std::string& Value)->void {
+	auto unit_ = [&Out](uint32_t Unit) {
+		Out.push_back(static_cast<char>(Unit & 0xFF));
+		Out.push_back(static_cast<char>(Unit >> 8));
+	};
+	size_t i = 0;
+	while (i < Value.length()) {
+		const unsigned char lead_ = static_cast<unsigned char>(Value[i]);
+		const size_t count_ = (lead_ < 0x80) ? 1 
+							  : ((lead_ >> 5) == 0x06) ? 2 
+							  : ((lead_ >> 4) == 0x0E) ? 3 
+							  : ((lead_ >> 3) == 0x1E) ? 4 : 0;
+		uint32_t cp_ = (count_ == 1) ? lead_ 
+					   : (count_ == 2) ? (lead_ & 0x1F) 
+					   : (count_ == 3) ? (lead_ & 0x0F) : (lead_ & 0x07);
+		bool ok_ = (count_ != 0) && ((i + count_) <= Value.length());
+		for (size_t k = 1; ok_ && (k < count_); ++k) {
+			const unsigned char next_ = static_cast<unsigned char>(Value[i + k]);
+			ok_ = ((next_ & 0xC0) == 0x80);
+			cp_ = (cp_ << 6) | (next_ & 0x3F);
+		}
+		if (!ok_ || (cp_ > 0x10FFFF) || ((cp_ >= 0xD800) && (cp_ < 0xE000))) {
+			unit_(0xFFFD);
+			i += 1;
+			continue;
+		}
+		if (cp_ >= 0x10000) {
+			unit_(0xD800 + ((cp_ - 0x10000) >> 10));
+			unit_(0xDC00 + ((cp_ - 0x10000) & 0x3FF));
+		} else {
+			unit_(cp_);
+		}
+		i += count_;
+	}
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    AppendUTF8
+// DESCRIPTION: Appends the code point 'Cp' to 'Out' as UTF-8.
+auto AppendUTF8(std::string& Out, uint32_t Cp)->void {
+	if (Cp < 0x80) {
+		Out.push_back(static_cast<char>(Cp));
+	} else if (Cp < 0x800) {
+		Out.push_back(static_cast<char>(0xC0 | (Cp >> 6)));
+		Out.push_back(static_cast<char>(0x80 | (Cp & 0x3F)));
+	} else if (Cp < 0x10000) {
+		Out.push_back(static_cast<char>(0xE0 | (Cp >> 12)));
+		Out.push_back(static_cast<char>(0x80 | ((Cp >> 6) & 0x3F)));
+		Out.push_back(static_cast<char>(0x80 | (Cp & 0x3F)));
+	} else {
+		Out.push_back(static_cast<char>(0xF0 | (Cp >> 18)));
+		Out.push_back(static_cast<char>(0x80 | ((Cp >> 12) & 0x3F)));
+		Out.push_back(static_cast<char>(0x80 | ((Cp >> 6) & 0x3F)));
+		Out.push_back(static_cast<char>(0x80 | (Cp & 0x3F)));
+	}
+}
+
+
+// FUNCTION:    GetTagFields
+// DESCRIPTION: Returns the fields that MP3Edit edits, in display order.
+auto GetTagFields()->const std::vector<TagField>& {
+	static const std::vector<TagField> Fields_{
+		{ "title",        TITLE_FRAME_ID, 
+		  tag_get_title,         tag_set_title }, 
+		{ "artist",       ARTIST_FRAME_ID, 
+		  tag_get_artist,        tag_set_artist }, 
+		{ "album",        ALBUM_FRAME_ID, 
+		  tag_get_album,         tag_set_album }, 
+		{ "album_artist", ALBUM_ARTIST_FRAME_ID, 
+		  tag_get_album_artist,  tag_set_album_artist }, 
+		{ "genre",        GENRE_FRAME_ID, 
+		  tag_get_genre,         tag_set_genre }, 
+		{ "track",        TRACK_FRAME_ID, 
+		  tag_get_track,         tag_set_track }, 
+		{ "year",         YEAR_FRAME_ID, 
+		  tag_get_year,          tag_set_year }, 
+		{ "comment",      COMMENT_FRAME_ID, 
+		  tag_get_comment,       tag_set_comment }, 
+		{ "disc",         DISC_NUMBER_FRAME_ID, 
+		  tag_get_disc_number,   tag_set_disc_number }, 
+		{ "composer",     COMPOSER_FRAME_ID, 
+		  tag_get_composer,      tag_set_composer }, 
+	};
+	return Fields_;
+}
+
+
+// FUNCTION:    FindTagField
+// DESCRIPTION: Looks up a field by name (case-insensitive). Returns 'nullptr' 
+//              if there is no such field.
+auto FindTagField(const std::string& Name)->const TagField* {
+	for (const TagField& field_ : GetTagFields()) {
+		const size_t len_ = std::strlen(field_.Name_);
+		if ((len_ == Name.length()) 
+			&& std::equal(Name.begin(), Name.end(), field_.Name_, 
+						  [](char a_, char b_) {
+							  return std::tolower(static_cast<unsigned char>(a_)) 
+									 == b_;
+						  })) {
+			return &field_;
+		}
+	}
+	return nullptr;
+}
+
+
+// FUNCTION:    DecodeFrameText
+// DESCRIPTION: Returns the text of a text ("T***") or comment ("COMM") frame as 
+//              UTF-8. Unlike 'parse_text_frame_content()', this allocates 
+//              nothing on the C heap and handles UTF-16 text properly. Other 
+//              frame types, and 'nullptr', give an empty string.
+auto DecodeFrameText(const ID3v2_frame* Frame)->std::string {
+	if ((Frame == nullptr) || (Frame->data == nullptr) || (Frame->size < 1)) {
+		return std::string();
+	}
+	
+	const unsigned char* data_ = reinterpret_cast<unsigned char*>(Frame->data);
+	const size_t         size_ = static_cast<size_t>(Frame->size);
+	const char           enc_  = Frame->data[0];
+	
+	if (Frame->frame_id[0] == 'T') {
+		return DecodeText(data_ + 1, size_ - 1, enc_);
+	}
+	if (std::memcmp(Frame->frame_id, COMMENT_FRAME_ID, ID3_FRAME_ID) == 0) {
+		// Encoding, 3-byte language, terminated description, then the text:
+		size_t pos_ = 1 + ID3_FRAME_LANGUAGE;
+		const bool wide_ = (enc_ == kENCODING_UTF16) 
+						   || (enc_ == kENCODING_UTF16_BE);
+		while (pos_ < size_) {
+			if (wide_) {
+				if ((pos_ + 1) >= size_) {
+					pos_ = size_;
+					break;
+				}
+				if ((data_[pos_] == 0) && (data_[pos_ + 1] == 0)) {
+					pos_ += 2;
+					break;
+				}
+				pos_ += 2;
+			} else {
+				if (data_[pos_++] == 0) {
+					break;
+				}
+			}
+		}
+		if (pos_ >= size_) {
+			return std::string();
+		}
+		return DecodeText(data_ + pos_, size_ - pos_, enc_);
+	}
+	return std::string();
+}
+
+
+// FUNCTION:    GetTagFieldText
+// DESCRIPTION: Returns the value of 'Field' in 'Tag' as UTF-8, or an empty 
+//              string if the tag does not have that frame.
+auto GetTagFieldText(ID3v2_tag* Tag, const TagField& Field)->std::string {
+	if (Tag == nullptr) {
+		return std::string();
+	}
+	return DecodeFrameText(Field.Get_(Tag));
+}
+
+
+// FUNCTION:    SetTagFieldText
+// DESCRIPTION: Sets 'Field' in 'Tag' to the UTF-8 string 'Value', adding the 
+//              frame if needed. Text that fits in ISO-8859-1 is stored that 
+//              way (as the GUI does); anything else is stored as UTF-16 with 
+//              a BOM, the only Unicode encoding ID3v2.3 has (and every writer 
+//              here stamps v2.3 headers). The id3v2lib setters cannot write 
+//              the NUL bytes of UTF-16, so that frame's data is built here.
+auto SetTagFieldText(ID3v2_tag*         Tag, 
+					 const TagField&    Field, 
+					 const std::string& Value)->void {
+	std::vector<char> buffer_;
+	buffer_.reserve(Value.length() + 1);
+	
+	bool   latin1_ = true;
+	size_t i       = 0;
+	while (i < Value.length()) {
+		const unsigned char lead_ = static_cast<unsigned char>(Value[i]);
+		if (lead_ < 0x80) {
+			buffer_.push_back(static_cast<char>(lead_));
+			i += 1;
+		} else if (((lead_ == 0xC2) || (lead_ == 0xC3)) 
+				   && ((i + 1) < Value.length())) {
+			const unsigned char next_ = static_cast<unsigned char>(Value[i + 1]);
+			buffer_.push_back(static_cast<char>(((lead_ & 0x03) << 6)
+												| (next_ & 0x3F)));
+			i += 2;
+		} else {
+			latin1_ = false;
+			break;
+		}
+	}
+	
+	if (latin1_) {
+		buffer_.push_back('\0');
+		Field.Set_(buffer_.data(), kENCODING_LATIN1, Tag);
+		return;
+	}
+	
+	// Let the setter find or add the frame, then replace its data: the 
+	// encoding, (for a comment) the language and an empty description, and 
+	// the text, each UTF-16 string with its BOM:
+	char empty_[] = "";
+	Field.Set_(empty_, kENCODING_UTF16, Tag);
+	ID3v2_frame* frame_ = Field.Get_(Tag);
+	if (frame_ == nullptr) {
+		return;
+	}
+	buffer_.assign(1, kENCODING_UTF16);
+	if (std::memcmp(Field.FrameId_, COMMENT_FRAME_ID, ID3_FRAME_ID) == 0) {
+		buffer_.insert(buffer_.end(), { 'e', 'n', 'g', '\xFF', '\xFE', '\0', '\0' });
+	}
+	buffer_.push_back('\xFF');
+	buffer_.push_back('\xFE');
+	AppendUTF16(buffer_, Value);
+	
+	char* data_ = static_cast<char*>(std::malloc(buffer_.size()));
+	if (data_ == nullptr) {
+		return;
+	}
+	std::memcpy(data_, buffer_.data(), buffer_.size());
+	std::free(frame_->data);
+	frame_->data = data_;
+	frame_->size = static_cast<int32_t>(buffer_.size());
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagFields.hpp
+// FILE PURPOSE:  Declares the table of tag fields that MP3Edit knows how to 
+//                read and write, and the helpers that convert frame contents 
+//                to and from UTF-8 strings.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct TagField {
+	const char*  Name_;    // Name used on the command line, e.g. "title"
+	const char*  FrameId_; // ID3v2.3 frame ID, e.g. "TIT2"
+	ID3v2_frame* (*Get_)(ID3v2_tag* Tag);
+	void         (*Set_)(char* Value, char Encoding, ID3v2_tag* Tag);
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto AppendUTF8(std::string& Out, uint32_t Cp)->void;
+auto GetTagFields()->const std::vector<TagField>&;
+auto FindTagField(const std::string& Name)->const TagField*;
+auto DecodeFrameText(const ID3v2_frame* Frame)->std::string;
+auto GetTagFieldText(ID3v2_tag* Tag, const TagField& Field)->std::string;
+auto SetTagFieldText(ID3v2_tag*         Tag, 
+					 const TagField&    Field, 
+					 const std::string& Value)->void;
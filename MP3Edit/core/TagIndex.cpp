@@ -0,0 +1,683 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagIndex.cpp
+// FILE PURPOSE:  Defines the class 'TagIndex' and 'UpdateTagIndex()'. The index 
+//                is a flat file that is mapped read-only, so opening it costs 
+//                one 'mmap()' however many tracks it holds; a rescan 'statx()'s 
+//                every file and opens only those whose key (device, inode, 
+//                size, mtime) no longer matches the index.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "../genres/GenreList.hpp"
+#include "AsyncTagIO.hpp"
+#include "TagFields.hpp"
+#include "TagIndex.hpp"
+#include "WorkStealingPool.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const char     kINDEX_MAGIC[8]   = { 'M', 'P', '3', 'E', 
+														'I', 'D', 'X', '\0' };
+constexpr static const uint32_t kINDEX_BYTE_ORDER = 0x01020304;
+// Files per pool task during a rescan; a 'statx()' is far cheaper than a task:
+constexpr static const size_t   kFILES_PER_TASK   = 256;
+
+static_assert(sizeof(IndexHeader) == 64, "IndexHeader must stay 64 bytes");
+static_assert((sizeof(IndexRecord) % 8) == 0, "IndexRecord must stay aligned");
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    SameKey
+// PURPOSE: Returns 'true' if the file described by 'Key' is unchanged since 
+//          'Record' was written.
+auto static SameKey(const FileKey& Key, const IndexRecord& Record)->bool {
+	return (Key.Device_ == Record.Device_) && (Key.Inode_ == Record.Inode_) 
+		   && (Key.Size_ == Record.Size_) && (Key.MtimeNs_ == Record.MtimeNs_);
+}
+
+
+// NAME:    AddString
+// PURPOSE: Appends 'Str' to 'Pool' (or finds an identical string already 
+//          there, if 'Interned' is given) and returns its location. Returns 
+//          'false' if the pool would outgrow 32-bit offsets.
+auto static AddString(const std::string&                         Str, 
+					  std::string&                               Pool, 
+					  std::unordered_map<std::string, uint32_t>* Interned, 
+					  IndexString&                               Out)->bool {
+	Out.Length_ = static_cast<uint32_t>(Str.length());
+	if (Str.empty()) {
+		Out.Offset_ = 0;
+		return true;
+	}
+	if (Interned != nullptr) {
+		auto it_ = Interned->find(Str);
+		if (it_ != Interned->end()) {
+			Out.Offset_ = it_->second;
+			return true;
+		}
+	}
+	if ((Pool.size() + Str.length()) > UINT32_MAX) {
+		return false;
+	}
+	
+	Out.Offset_ = static_cast<uint32_t>(Pool.size());
+	Pool.append(Str);
+	if (Interned != nullptr) {
+		Interned->emplace(Str, Out.Offset_);
+	}
+	return true;
+}
+
+
+// NAME:    WriteAll
+// PURPOSE: Writes 'Size' bytes to 'File'; returns 'false' on a short write.
+auto static WriteAll(std::FILE* File, const void* Data, size_t Size)->bool {
+	return (Size == 0) || (std::fwrite(Data, 1, Size, File) == Size);
+}
+
+
+// NAME:    FillTagEntry
+// PURPOSE: Fills 'Entry.Fields_' and the tag's features from 'Tag' (which may 
+//          be 'nullptr'), as 'ReadTagEntry()' describes, and frees 'Tag'.
+auto static FillTagEntry(IndexEntry& Entry, ID3v2_tag* Tag, uint32_t FieldMask)->void {
+	Entry.HasTag_     = false;
+	Entry.HasCover_   = false;
+	Entry.TagVersion_ = 0;
+	Entry.Fields_.fill(std::string());
+	if (Tag == nullptr) {
+		return;
+	}
+	
+	const std::vector<TagField>& fields_ = GetTagFields();
+	for (size_t f = 0; (f < fields_.size()) && (f < kINDEX_FIELD_COUNT); ++f) {
+		if (FieldMask & (uint32_t(1) << f)) {
+			Entry.Fields_[f] = GetTagFieldText(Tag, fields_[f]);
+			if (fields_[f].Get_ == tag_get_genre) {
+				NormalizeGenre(Entry.Fields_[f]);
+			}
+		}
+	}
+	Entry.HasTag_     = true;
+	Entry.HasCover_   = (tag_get_album_cover(Tag) != nullptr);
+	Entry.TagVersion_ = static_cast<uint8_t>(Tag->tag_header->major_version);
+	free_tag(Tag);
+}
+
+
+// NAME:    LoadTagEntries
+// PURPOSE: Parses the tags of 'Entries[i]' for every 'i' in 'Which' through 
+//          'AsyncTagIO', which keeps many reads in flight at once instead of 
+//          blocking one thread per file.
+auto static LoadTagEntries(std::vector<IndexEntry>&   Entries, 
+						   const std::vector<size_t>& Which, 
+						   uint32_t                   FieldMask, 
+						   size_t                     Threads)->void {
+	std::vector<std::string> paths_;
+	paths_.reserve(Which.size());
+	for (size_t i : Which) {
+		paths_.push_back(Entries[i].Path_);
+	}
+	
+	AsyncIOOptions options_;
+	options_.Threads_ = Threads;
+	AsyncTagIO io_(options_);
+	io_.load(paths_, [&](size_t Index, ID3v2_tag* Tag, int /* Error */) {
+		FillTagEntry(Entries[Which[Index]], Tag, FieldMask);
+	});
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+TagIndex::TagIndex() noexcept = default;
+
+
+TagIndex::~TagIndex() noexcept {
+	close();
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    open
+// DESCRIPTION: Maps the index file 'Filename' read-only (or, where 'mmap()' is 
+//              unavailable, reads it whole) and checks its header. Returns 
+//              'false', leaving the object closed, if the file is missing, 
+//              truncated, or written by an incompatible version.
+bool TagIndex::open(const std::string& Filename) {
+	close();
+
+#if defined(__linux__)
+	int fd_ = ::open(Filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		return false;
+	}
+	struct stat st_;
+	if ((::fstat(fd_, &st_) != 0) 
+		|| (static_cast<size_t>(st_.st_size) < sizeof(IndexHeader))) {
+		::close(fd_);
+		return false;
+	}
+	void* map_ = ::mmap(nullptr, static_cast<size_t>(st_.st_size), PROT_READ, 
+						MAP_SHARED, fd_, 0);
+	::close(fd_);
+	if (map_ == MAP_FAILED) {
+		return false;
+	}
+	Data_   = static_cast<const char*>(map_);
+	Size_   = static_cast<size_t>(st_.st_size);
+	Mapped_ = true;
+#else
+	std::ifstream in_(Filename, std::ios::binary | std::ios::ate);
+	if (!in_) {
+		return false;
+	}
+	Buffer_.resize(static_cast<size_t>(in_.tellg()));
+	in_.seekg(0);
+	if (!in_.read(Buffer_.data(), static_cast<std::streamsize>(Buffer_.size())) 
+		|| (Buffer_.size() < sizeof(IndexHeader))) {
+		Buffer_.clear();
+		return false;
+	}
+	Data_ = Buffer_.data();
+	Size_ = Buffer_.size();
+#endif
+
+	// Validate the header before trusting any offset in it. Every bound is 
+	// tested by subtracting from one already checked, so that no sum of 
+	// damaged values can wrap around:
+	const IndexHeader& hdr_ = header();
+	if ((std::memcmp(hdr_.Magic_, kINDEX_MAGIC, sizeof(kINDEX_MAGIC)) != 0) 
+		|| (hdr_.Version_ != kINDEX_VERSION) 
+		|| (hdr_.ByteOrder_ != kINDEX_BYTE_ORDER) 
+		|| (hdr_.FieldCount_ != kINDEX_FIELD_COUNT) 
+		|| (hdr_.RecordSize_ != sizeof(IndexRecord)) 
+		|| ((hdr_.RecordsOffset_ % alignof(IndexRecord)) != 0) 
+		|| (hdr_.RecordsOffset_ < sizeof(IndexHeader)) 
+		|| (hdr_.RecordsOffset_ > Size_) 
+		|| (hdr_.EntryCount_ > ((Size_ - hdr_.RecordsOffset_) / sizeof(IndexRecord))) 
+		|| (hdr_.StringsOffset_ < hdr_.RecordsOffset_) 
+		|| (hdr_.StringsOffset_ > Size_) 
+		|| ((hdr_.StringsOffset_ - hdr_.RecordsOffset_) 
+			< (hdr_.EntryCount_ * sizeof(IndexRecord))) 
+		|| (hdr_.StringsSize_ > (Size_ - hdr_.StringsOffset_))) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+// FUNCTION:    close
+// DESCRIPTION: Unmaps the index, if one is open.
+void TagIndex::close() noexcept {
+#if defined(__linux__)
+	if (Mapped_ && (Data_ != nullptr)) {
+		::munmap(const_cast<char*>(Data_), Size_);
+	}
+#endif
+	Buffer_.clear();
+	Buffer_.shrink_to_fit();
+	Data_   = nullptr;
+	Size_   = 0;
+	Mapped_ = false;
+}
+
+
+// FUNCTION:    isOpen
+// DESCRIPTION: Returns 'true' if a valid index is open.
+bool TagIndex::isOpen() const noexcept {
+	return (Data_ != nullptr);
+}
+
+
+// FUNCTION:    size
+// DESCRIPTION: Returns the number of files in the index.
+size_t TagIndex::size() const noexcept {
+	return isOpen() ? static_cast<size_t>(header().EntryCount_) : 0;
+}
+
+
+// FUNCTION:    record
+// DESCRIPTION: Returns the raw record of the 'Index'th file (in path order).
+const IndexRecord& TagIndex::record(size_t Index) const noexcept {
+	const char* base_ = Data_ + header().RecordsOffset_;
+	return reinterpret_cast<const IndexRecord*>(base_)[Index];
+}
+
+
+// FUNCTION:    string
+// DESCRIPTION: Returns a view of a string in the pool. Out-of-range locations 
+//              (which only a damaged file can hold) give an empty view.
+std::string_view TagIndex::string(const IndexString& Str) const noexcept {
+	const IndexHeader& hdr_ = header();
+	if ((Str.Offset_ > hdr_.StringsSize_) 
+		|| (Str.Length_ > (hdr_.StringsSize_ - Str.Offset_))) {
+		return std::string_view();
+	}
+	return std::string_view(Data_ + hdr_.StringsOffset_ + Str.Offset_, 
+							Str.Length_);
+}
+
+
+// FUNCTION:    path
+// DESCRIPTION: Returns the path of the 'Index'th file.
+std::string_view TagIndex::path(size_t Index) const noexcept {
+	return string(record(Index).Path_);
+}
+
+
+// FUNCTION:    field
+// DESCRIPTION: Returns field number 'Field' (an index into 'GetTagFields()') 
+//              of the 'Index'th file.
+std::string_view TagIndex::field(size_t Index, size_t Field) const noexcept {
+	if (Field >= kINDEX_FIELD_COUNT) {
+		return std::string_view();
+	}
+	return string(record(Index).Fields_[Field]);
+}
+
+
+// FUNCTION:    find
+// DESCRIPTION: Binary-searches the index for 'Path'. Returns its position, or 
+//              'size()' if the path is not indexed.
+size_t TagIndex::find(std::string_view Path) const noexcept {
+	size_t lo_ = 0;
+	size_t hi_ = size();
+	while (lo_ < hi_) {
+		const size_t mid_ = lo_ + ((hi_ - lo_) / 2);
+		if (path(mid_) < Path) {
+			lo_ = mid_ + 1;
+		} else {
+			hi_ = mid_;
+		}
+	}
+	return ((lo_ < size()) && (path(lo_) == Path)) ? lo_ : size();
+}
+
+
+// FUNCTION:    entry
+// DESCRIPTION: Copies the 'Index'th record into an owning 'IndexEntry'.
+IndexEntry TagIndex::entry(size_t Index) const {
+	const IndexRecord& rec_ = record(Index);
+	IndexEntry         out_;
+	out_.Path_    = std::string(string(rec_.Path_));
+	out_.Device_  = rec_.Device_;
+	out_.Inode_   = rec_.Inode_;
+	out_.Size_    = rec_.Size_;
+	out_.MtimeNs_ = rec_.MtimeNs_;
+	out_.HasTag_     = ((rec_.Flags_ & kINDEX_HAS_TAG) != 0);
+	out_.HasCover_   = ((rec_.Flags_ & kINDEX_HAS_COVER) != 0);
+	out_.TagVersion_ = static_cast<uint8_t>(rec_.Flags_ >> kINDEX_VERSION_SHIFT);
+	for (size_t f = 0; f < kINDEX_FIELD_COUNT; ++f) {
+		out_.Fields_[f] = std::string(string(rec_.Fields_[f]));
+	}
+	return out_;
+}
+
+
+// FUNCTION:    write
+// DESCRIPTION: Sorts 'Entries' by path, drops duplicate paths, and writes them 
+//              to 'Filename' as a new index. The file is written beside the 
+//              target, flushed to disk, and renamed over it, so a reader (or a 
+//              crash) sees either the old index or the new one, never a mix.
+bool TagIndex::write(const std::string& Filename, std::vector<IndexEntry>& Entries) {
+	std::sort(Entries.begin(), Entries.end(), 
+			  [](const IndexEntry& a_, const IndexEntry& b_) {
+				  return a_.Path_ < b_.Path_;
+			  });
+	Entries.erase(std::unique(Entries.begin(), Entries.end(), 
+							  [](const IndexEntry& a_, const IndexEntry& b_) {
+								  return a_.Path_ == b_.Path_;
+							  }), 
+				  Entries.end());
+	
+	// Build the records and the string pool. Paths are unique, so only the 
+	// field values (where one artist or album recurs across many tracks) are
+	// interned:
+	std::vector<IndexRecord>                  records_(Entries.size());
+	std::string                               pool_;
+	std::unordered_map<std::string, uint32_t> interned_;
+	for (size_t i = 0; i < Entries.size(); ++i) {
+		const IndexEntry& ent_ = Entries[i];
+		IndexRecord&      rec_ = records_[i];
+		std::memset(&rec_, 0, sizeof(rec_));
+		rec_.Device_  = ent_.Device_;
+		rec_.Inode_   = ent_.Inode_;
+		rec_.Size_    = ent_.Size_;
+		rec_.MtimeNs_ = ent_.MtimeNs_;
+		rec_.Flags_   = GetIndexFlags(ent_);
+		if (!AddString(ent_.Path_, pool_, nullptr, rec_.Path_)) {
+			return false;
+		}
+		for (size_t f = 0; f < kINDEX_FIELD_COUNT; ++f) {
+			if (!AddString(ent_.Fields_[f], pool_, &interned_, rec_.Fields_[f])) {
+				return false;
+			}
+		}
+	}
+	
+	IndexHeader hdr_;
+	std::memset(&hdr_, 0, sizeof(hdr_));
+	std::memcpy(hdr_.Magic_, kINDEX_MAGIC, sizeof(kINDEX_MAGIC));
+	hdr_.Version_       = kINDEX_VERSION;
+	hdr_.ByteOrder_     = kINDEX_BYTE_ORDER;
+	hdr_.FieldCount_    = kINDEX_FIELD_COUNT;
+	hdr_.RecordSize_    = sizeof(IndexRecord);
+	hdr_.EntryCount_    = records_.size();
+	hdr_.RecordsOffset_ = sizeof(IndexHeader);
+	hdr_.StringsOffset_ = hdr_.RecordsOffset_
+						  + (records_.size() * sizeof(IndexRecord));
+	hdr_.StringsSize_   = pool_.size();
+	
+	// Written beside the target and renamed over it, so a reader maps either 
+	// the old index or the new one; the name is per process so that two 
+	// writers never share a temporary file:
+#if defined(__linux__)
+	const std::string temp_ = Filename + "." + std::to_string(::getpid()) + ".tmp";
+#else
+	const std::string temp_ = Filename + ".tmp";
+#endif
+	std::FILE*        out_  = std::fopen(temp_.c_str(), "wb");
+	if (out_ == nullptr) {
+		return false;
+	}
+	bool ok_ = WriteAll(out_, &hdr_, sizeof(hdr_)) 
+			   && WriteAll(out_, records_.data(), 
+						   records_.size() * sizeof(IndexRecord)) 
+			   && WriteAll(out_, pool_.data(), pool_.size()) 
+			   && (std::fflush(out_) == 0);
+#if defined(__linux__)
+	ok_ = ok_ && (::fsync(::fileno(out_)) == 0);
+#endif
+	ok_ = (std::fclose(out_) == 0) && ok_;
+	
+	// 'fs::rename()' replaces an existing file everywhere ('std::rename()' 
+	// fails on Windows when the target exists):
+	std::error_code ec_;
+	if (ok_) {
+		fs::rename(temp_, Filename, ec_);
+	}
+	if (!ok_ || ec_) {
+		std::remove(temp_.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    header
+// DESCRIPTION: Returns the header of the open index.
+const IndexHeader& TagIndex::header() const noexcept {
+	return *reinterpret_cast<const IndexHeader*>(Data_);
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    GetFileKey
+// DESCRIPTION: Fills 'Key' with the device, inode, size and modification time 
+//              of 'Filename'. On Linux, 'statx()' is asked for just those 
+//              fields, so that network and FUSE file systems need not fetch 
+//              the rest. Returns 'false' if the file cannot be stat'ed.
+auto GetFileKey(const std::string& Filename, FileKey& Key)->bool {
+#if defined(__linux__) && defined(STATX_INO)
+	struct statx stx_;
+	if (::statx(AT_FDCWD, Filename.c_str(), AT_STATX_SYNC_AS_STAT, 
+				STATX_INO | STATX_SIZE | STATX_MTIME, &stx_) == 0) {
+		// Encoded as 'st_dev' is, so keys match those from 'stat()':
+		Key.Device_  = static_cast<uint64_t>(
+			makedev(stx_.stx_dev_major, stx_.stx_dev_minor));
+		Key.Inode_   = stx_.stx_ino;
+		Key.Size_    = stx_.stx_size;
+		Key.MtimeNs_ = (static_cast<int64_t>(stx_.stx_mtime.tv_sec) * 1000000000)
+					   + stx_.stx_mtime.tv_nsec;
+		return true;
+	}
+	if (errno != ENOSYS) {
+		return false;
+	}
+	// Kernels before 4.11 lack 'statx()'; fall through to 'stat()'.
+#endif
+
+	struct stat st_;
+	if (::stat(Filename.c_str(), &st_) != 0) {
+		return false;
+	}
+	Key.Device_ = static_cast<uint64_t>(st_.st_dev);
+	Key.Inode_  = static_cast<uint64_t>(st_.st_ino);
+	Key.Size_   = static_cast<uint64_t>(st_.st_size);
+#if defined(__linux__)
+	Key.MtimeNs_ = (static_cast<int64_t>(st_.st_mtim.tv_sec) * 1000000000)
+				   + st_.st_mtim.tv_nsec;
+#else
+	Key.MtimeNs_ = static_cast<int64_t>(st_.st_mtime) * 1000000000;
+#endif
+	return true;
+}
+
+
+// FUNCTION:    SameFileKey
+// DESCRIPTION: Tests whether two keys name the same version of a file.
+auto SameFileKey(const FileKey& A, const FileKey& B)->bool {
+	return (A.Device_ == B.Device_) && (A.Inode_ == B.Inode_) 
+		   && (A.Size_ == B.Size_) && (A.MtimeNs_ == B.MtimeNs_);
+}
+
+
+// FUNCTION:    ReadTagEntry
+// DESCRIPTION: Parses the tag of 'Entry.Path_' into 'Entry.Fields_' and the 
+//              tag's features. A file without a tag is still indexed, with 
+//              'HasTag_' cleared. Only the fields whose bit (by position in 
+//              'GetTagFields()') is set in 'FieldMask' are decoded; the rest 
+//              are left empty.
+auto ReadTagEntry(IndexEntry& Entry, uint32_t FieldMask)->void {
+	FillTagEntry(Entry, load_tag(Entry.Path_.c_str()), FieldMask);
+}
+
+
+// FUNCTION:    ReadTagEntries
+// DESCRIPTION: Reads the tags of 'Files', decoding only the fields in 
+//              'FieldMask' (see 'ReadTagEntry()'). The files are stat'ed on up 
+//              to 'Threads' threads (0 = one per hardware thread) and then 
+//              read through 'AsyncTagIO'. Files that cannot be stat'ed are 
+//              left out; the rest come back in the order given.
+auto ReadTagEntries(const std::vector<std::string>& Files, 
+					uint32_t                        FieldMask, 
+					size_t                          Threads)->std::vector<IndexEntry> {
+	std::vector<IndexEntry> entries_(Files.size());
+	std::vector<char>       present_(Files.size(), 0);
+	{
+		WorkStealingPool pool_(Threads);
+		for (size_t start_ = 0; start_ < Files.size(); start_ += kFILES_PER_TASK) {
+			const size_t end_ = std::min(start_ + kFILES_PER_TASK, Files.size());
+			pool_.submit([&, start_, end_]() {
+				for (size_t i = start_; i < end_; ++i) {
+					FileKey key_;
+					if (!GetFileKey(Files[i], key_)) {
+						continue;
+					}
+					present_[i]          = 1;
+					entries_[i].Path_    = Files[i];
+					entries_[i].Device_  = key_.Device_;
+					entries_[i].Inode_   = key_.Inode_;
+					entries_[i].Size_    = key_.Size_;
+					entries_[i].MtimeNs_ = key_.MtimeNs_;
+				}
+			});
+		}
+		pool_.wait();
+	}
+	
+	std::vector<size_t> which_;
+	for (size_t i = 0; i < Files.size(); ++i) {
+		if (present_[i]) {
+			which_.push_back(i);
+		}
+	}
+	LoadTagEntries(entries_, which_, FieldMask, Threads);
+	
+	size_t kept_ = 0;
+	for (size_t i = 0; i < entries_.size(); ++i) {
+		if (present_[i]) {
+			if (kept_ != i) {
+				entries_[kept_] = std::move(entries_[i]);
+			}
+			++kept_;
+		}
+	}
+	entries_.resize(kept_);
+	return entries_;
+}
+
+
+// FUNCTION:    GetIndexFlags
+// DESCRIPTION: Returns the 'IndexRecord::Flags_' value for 'Entry'.
+auto GetIndexFlags(const IndexEntry& Entry)->uint32_t {
+	return (Entry.HasTag_ ? kINDEX_HAS_TAG : 0) 
+		   | (Entry.HasCover_ ? kINDEX_HAS_COVER : 0) 
+		   | (static_cast<uint32_t>(Entry.TagVersion_) << kINDEX_VERSION_SHIFT);
+}
+
+
+// FUNCTION:    UpdateTagIndex
+// DESCRIPTION: Brings the index at 'IndexFile' in line with 'Files' and writes 
+//              it back. Every file is stat'ed; one whose key matches its old 
+//              record (or, after a rename, the record of the same inode) is 
+//              copied from the index without being opened, and only new or 
+//              changed files are parsed (through 'AsyncTagIO', once all are 
+//              stat'ed). Files missing from 'Files' drop out. 
+//              A missing or unreadable index is rebuilt from scratch.
+auto UpdateTagIndex(const std::string&              IndexFile, 
+					const std::vector<std::string>& Files, 
+					size_t                          Threads)->IndexUpdateReport {
+	IndexUpdateReport report_;
+	TagIndex          old_;
+	old_.open(IndexFile);
+	
+	std::vector<std::string> files_(Files);
+	std::sort(files_.begin(), files_.end());
+	files_.erase(std::unique(files_.begin(), files_.end()), files_.end());
+	
+	// Renamed or moved files keep their inode; look them up by it:
+	struct InodeHash {
+		size_t operator()(const std::pair<uint64_t, uint64_t>& Key) const {
+			return std::hash<uint64_t>()(Key.second * 0x9E3779B97F4A7C15ULL
+										 ^ Key.first);
+		}
+	};
+	std::unordered_map<std::pair<uint64_t, uint64_t>, size_t, InodeHash> byInode_;
+	byInode_.reserve(old_.size());
+	for (size_t i = 0; i < old_.size(); ++i) {
+		const IndexRecord& rec_ = old_.record(i);
+		byInode_.emplace(std::make_pair(rec_.Device_, rec_.Inode_), i);
+	}
+	
+	// Each slot is written by the one task that owns file 'i':
+	std::vector<IndexEntry> entries_(files_.size());
+	std::vector<char>       present_(files_.size(), 0);
+	std::vector<char>       inOld_(files_.size(), 0);
+	std::vector<char>       stale_(files_.size(), 0);
+	std::atomic<size_t>     reused_{0};
+	
+	{
+		WorkStealingPool pool_(Threads);
+		for (size_t start_ = 0; start_ < files_.size(); start_ += kFILES_PER_TASK) {
+			const size_t end_ = std::min(start_ + kFILES_PER_TASK, files_.size());
+			pool_.submit([&, start_, end_]() {
+				for (size_t i = start_; i < end_; ++i) {
+					FileKey key_;
+					if (!GetFileKey(files_[i], key_)) {
+						continue;
+					}
+					present_[i] = 1;
+					
+					size_t at_ = old_.find(files_[i]);
+					inOld_[i]  = (at_ != old_.size());
+					if ((at_ == old_.size()) || !SameKey(key_, old_.record(at_))) {
+						auto it_ = byInode_.find({ key_.Device_, key_.Inode_ });
+						at_ = ((it_ != byInode_.end()) 
+							   && SameKey(key_, old_.record(it_->second))) 
+							  ? it_->second : old_.size();
+					}
+					
+					if (at_ != old_.size()) {
+						entries_[i] = old_.entry(at_);
+						++reused_;
+					} else {
+						stale_[i] = 1;
+					}
+					entries_[i].Path_    = files_[i];
+					entries_[i].Device_  = key_.Device_;
+					entries_[i].Inode_   = key_.Inode_;
+					entries_[i].Size_    = key_.Size_;
+					entries_[i].MtimeNs_ = key_.MtimeNs_;
+				}
+			});
+		}
+		pool_.wait();
+	}
+	
+	std::vector<size_t> toParse_;
+	for (size_t i = 0; i < files_.size(); ++i) {
+		if (stale_[i]) {
+			toParse_.push_back(i);
+		}
+	}
+	LoadTagEntries(entries_, toParse_, UINT32_MAX, Threads);
+	
+	// Keep only the files that could be stat'ed:
+	std::vector<IndexEntry> live_;
+	live_.reserve(files_.size());
+	for (size_t i = 0; i < files_.size(); ++i) {
+		if (present_[i]) {
+			live_.push_back(std::move(entries_[i]));
+		} else {
+			++report_.FilesFailed_;
+		}
+	}
+	
+	report_.FilesReused_  = reused_;
+	report_.FilesParsed_  = toParse_.size();
+	report_.FilesRemoved_ = old_.size() - static_cast<size_t>(
+		std::count(inOld_.begin(), inOld_.end(), 1));
+	
+	// The old mapping must go before the file is replaced (Windows cannot 
+	// rename over an open file):
+	old_.close();
+	report_.Written_    = TagIndex::write(IndexFile, live_);
+	report_.FilesTotal_ = live_.size();
+	return report_;
+}
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagIndex.hpp
+// FILE PURPOSE:  Declares the class 'TagIndex', a persistent, memory-mapped 
+//                index of the tags in a music library, and the function that 
+//                brings an index up to date by re-reading only the files that 
+//                changed since it was written.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// One slot per entry of 'GetTagFields()', in the same order:
+constexpr static const size_t   kINDEX_FIELD_COUNT = 10;
+constexpr static const uint32_t kINDEX_VERSION     = 3;
+
+
+/* ******************************* STRUCTURES ******************************* */
+// On-disk layout (native byte order, checked on open):
+// 
+//   IndexHeader                      64 bytes 
+//   IndexRecord[EntryCount_]         sorted by path 
+//   string pool                      UTF-8, not NUL-terminated; field values 
+//                                    are stored once however often they occur
+struct IndexHeader {
+	char     Magic_[8];      // "MP3EIDX\0"
+	uint32_t Version_;       // kINDEX_VERSION
+	uint32_t ByteOrder_;     // 0x01020304 as written
+	uint32_t FieldCount_;    // kINDEX_FIELD_COUNT
+	uint32_t RecordSize_;    // sizeof(IndexRecord)
+	uint64_t EntryCount_;
+	uint64_t RecordsOffset_;
+	uint64_t StringsOffset_;
+	uint64_t StringsSize_;
+	uint64_t Reserved_;
+};
+
+struct IndexString {
+	uint32_t Offset_;        // Into the string pool
+	uint32_t Length_;
+};
+
+struct IndexRecord {
+	uint64_t    Device_;
+	uint64_t    Inode_;
+	uint64_t    Size_;
+	int64_t     MtimeNs_;    // Nanoseconds since the Unix epoch
+	IndexString Path_;
+	IndexString Fields_[kINDEX_FIELD_COUNT];
+	uint32_t    Flags_;      // kINDEX_HAS_* bits, tag version << kINDEX_VERSION_SHIFT
+	uint32_t    Reserved_;
+};
+
+constexpr static const uint32_t kINDEX_HAS_TAG       = 0x1;
+constexpr static const uint32_t kINDEX_HAS_COVER     = 0x2; // An APIC frame
+constexpr static const unsigned kINDEX_VERSION_SHIFT = 8;   // Bits 8-15
+
+// Owning, in-memory form of one record, used when building an index:
+struct IndexEntry {
+	std::string Path_;
+	uint64_t    Device_  = 0;
+	uint64_t    Inode_   = 0;
+	uint64_t    Size_    = 0;
+	int64_t     MtimeNs_ = 0;
+	bool        HasTag_     = false;
+	bool        HasCover_   = false;
+	uint8_t     TagVersion_ = 0;     // ID3v2 major version (3 or 4); 0 if untagged
+	std::array<std::string, kINDEX_FIELD_COUNT> Fields_;
+};
+
+// The change-detection key of a file:
+struct FileKey {
+	uint64_t Device_  = 0;
+	uint64_t Inode_   = 0;
+	uint64_t Size_    = 0;
+	int64_t  MtimeNs_ = 0;
+};
+
+struct IndexUpdateReport {
+	size_t FilesTotal_   = 0; // Entries in the new index
+	size_t FilesReused_  = 0; // Key unchanged; not opened
+	size_t FilesParsed_  = 0; // New or changed; tag re-read
+	size_t FilesRemoved_ = 0; // In the old index but no longer given/present
+	size_t FilesFailed_  = 0; // Could not be stat'ed
+	bool   Written_      = false;
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+class TagIndex {
+
+	private:
+		const char*       Data_   = nullptr;
+		size_t            Size_   = 0;
+		bool              Mapped_ = false;
+		std::vector<char> Buffer_; // Used where 'mmap()' is unavailable
+	
+	public:
+		TagIndex() noexcept;
+		~TagIndex() noexcept;
+		
+		TagIndex(const TagIndex&)            = delete;
+		TagIndex& operator=(const TagIndex&) = delete;
+		
+		bool               open(const std::string& Filename);
+		void               close() noexcept;
+		bool               isOpen() const noexcept;
+		size_t             size() const noexcept;
+		const IndexRecord& record(size_t Index) const noexcept;
+		std::string_view   path(size_t Index) const noexcept;
+		std::string_view   field(size_t Index, size_t Field) const noexcept;
+		std::string_view   string(const IndexString& Str) const noexcept;
+		size_t             find(std::string_view Path) const noexcept;
+		IndexEntry         entry(size_t Index) const;
+		
+		static bool        write(const std::string&       Filename, 
+								 std::vector<IndexEntry>& Entries);
+	
+	private:
+		const IndexHeader& header() const noexcept;
+
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto GetFileKey(const std::string& Filename, FileKey& Key)->bool;
+auto SameFileKey(const FileKey& A, const FileKey& B)->bool;
+auto ReadTagEntry(IndexEntry& Entry, uint32_t FieldMask = UINT32_MAX)->void;
+auto ReadTagEntries(const std::vector<std::string>& Files, 
+					uint32_t                        FieldMask, 
+					size_t                          Threads)->std::vector<IndexEntry>;
+auto GetIndexFlags(const IndexEntry& Entry)->uint32_t;
+auto UpdateTagIndex(const std::string&              IndexFile, 
+					const std::vector<std::string>& Files, 
+					size_t                          Threads)->IndexUpdateReport;
@@ -0,0 +1,717 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagJournal.cpp
+// FILE PURPOSE:  Defines the class 'TagJournal', its journal format, and the 
+//                recovery of an interrupted group.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <map>
+#include <system_error>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstdlib>
+#include <cstring>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib/codec.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "AsyncTagIO.hpp"
+#include "BatchEngine.hpp"
+#include "TagJournal.hpp"
+
+
+/* *************************** IMPORTED NAMESPACES ************************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// The journal is the file magic followed by records; each record is its 
+// magic, the payload length (8 bytes), the payload, and the payload's CRC-32:
+constexpr static const char     kJOURNAL_MAGIC[8] = { 'M', 'P', '3', 'E', 'J', 'R', 'N', '1' };
+constexpr static const uint32_t kRECORD_MAGIC     = 0x4D50334Au; // "MP3J"
+constexpr static const char     kTEMP_SUFFIX[]    = ".mp3edit-new";
+constexpr static const size_t   kCOPY_CHUNK       = 1024 * 1024;
+
+constexpr static const std::array<uint32_t, 256> kCRC_TABLE = []() {
+	std::array<uint32_t, 256> table_ = {};
+	for (uint32_t i = 0; i < 256; ++i) {
+		uint32_t crc_ = i;
+		for (int bit_ = 0; bit_ < 8; ++bit_) {
+			crc_ = (crc_ & 1u) ? (0xEDB88320u ^ (crc_ >> 1)) : (crc_ >> 1);
+		}
+		table_[i] = crc_;
+	}
+	return table_;
+}();
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    UpdateCrc
+// PURPOSE: Continues the CRC-32 'Crc' (start with 0) over 'Length' bytes.
+auto static UpdateCrc(uint32_t Crc, const char* Data, size_t Length)->uint32_t {
+	Crc = ~Crc;
+	for (size_t i = 0; i < Length; ++i) {
+		Crc = kCRC_TABLE[(Crc ^ static_cast<uint8_t>(Data[i])) & 0xFFu] ^ (Crc >> 8);
+	}
+	return ~Crc;
+}
+
+
+// NAME:    SyncFile
+// PURPOSE: Flushes 'File' and waits until its data is on the device.
+auto static SyncFile(std::FILE* File)->bool {
+	if (std::fflush(File) != 0) {
+		return false;
+	}
+#if defined(_WIN32)
+	return ::_commit(::_fileno(File)) == 0;
+#elif defined(__linux__)
+	return ::fdatasync(::fileno(File)) == 0;
+#else
+	return ::fsync(::fileno(File)) == 0;
+#endif
+}
+
+
+// NAME:    SyncDirectoryOf
+// PURPOSE: Makes the directory entry of 'Path' (a new name, after a rename) 
+//          durable. Windows has no such step.
+auto static SyncDirectoryOf(const std::string& Path)->bool {
+#if defined(_WIN32)
+	static_cast<void>(Path);
+	return true;
+#else
+	std::string dir_ = fs::path(Path).parent_path().string();
+	if (dir_.empty()) {
+		dir_ = ".";
+	}
+	const int fd_ = ::open(dir_.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		return false;
+	}
+	const bool ok_ = (::fsync(fd_) == 0);
+	::close(fd_);
+	return ok_;
+#endif
+}
+
+
+// NAME:    SyncDevice
+// PURPOSE: Syncs the whole file system 'Path' is on, in one call (Linux only).
+auto static SyncDevice(const std::string& Path)->bool {
+#if defined(__linux__)
+	const int fd_ = ::open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		return false;
+	}
+	const bool ok_ = (::syncfs(fd_) == 0);
+	::close(fd_);
+	return ok_;
+#else
+	static_cast<void>(Path);
+	return false;
+#endif
+}
+
+
+// NAME:    ReadHead
+// PURPOSE: Reads up to 'Length' bytes from the start of 'Path' into 'Head', 
+//          and the file's size into 'Size'.
+auto static ReadHead(const std::string& Path, 
+					 uint64_t           Length, 
+					 std::vector<char>& Head, 
+					 uint64_t&          Size)->bool {
+	std::error_code ec_;
+	Size = fs::file_size(Path, ec_);
+	if (ec_) {
+		return false;
+	}
+	std::FILE* in_ = std::fopen(Path.c_str(), "rb");
+	if (in_ == nullptr) {
+		return false;
+	}
+	Head.resize(static_cast<size_t>(std::min(Length, Size)));
+	const bool ok_ = (std::fread(Head.data(), 1, Head.size(), in_) == Head.size());
+	std::fclose(in_);
+	return ok_;
+}
+
+
+// NAME:    StartsWith
+// PURPOSE: Tells whether 'Data' begins with all of 'Prefix'.
+auto static StartsWith(const std::vector<char>& Data, 
+					   const std::vector<char>& Prefix)->bool {
+	return (Data.size() >= Prefix.size()) 
+		   && std::equal(Prefix.begin(), Prefix.end(), Data.begin());
+}
+
+
+// NAME:    WriteHead
+// PURPOSE: Writes 'Head' over the start of 'Path', syncing it if 'Sync'.
+auto static WriteHead(const std::string&       Path, 
+					  const std::vector<char>& Head, 
+					  bool                     Sync)->bool {
+	std::FILE* out_ = std::fopen(Path.c_str(), "r+b");
+	if (out_ == nullptr) {
+		return false;
+	}
+	bool ok_ = (std::fwrite(Head.data(), 1, Head.size(), out_) == Head.size());
+	ok_      = ok_ && (!Sync || SyncFile(out_));
+	ok_      = (std::fclose(out_) == 0) && ok_;
+	return ok_;
+}
+
+
+// NAME:    SeekFile
+// PURPOSE: Moves to byte 'Offset' of 'File', which may lie past 2 GB (as 
+//          'file_seek' does in id3v2lib; a 'long' is 32 bits on Windows).
+auto static SeekFile(std::FILE* File, uint64_t Offset)->bool {
+#if defined(_WIN32)
+	return _fseeki64(File, static_cast<int64_t>(Offset), SEEK_SET) == 0;
+#else
+	return fseeko(File, static_cast<off_t>(Offset), SEEK_SET) == 0;
+#endif
+}
+
+
+// NAME:    WriteReplacement
+// PURPOSE: Writes 'Temp' as 'Head' followed by 'Path' past its first 'Skip' 
+//          bytes (its old tag), with 'Path's permissions, syncing it if 
+//          'Sync'. 'Temp' is removed on failure.
+auto static WriteReplacement(const std::string&       Path, 
+							 const std::string&       Temp, 
+							 const std::vector<char>& Head, 
+							 uint64_t                 Skip, 
+							 bool                     Sync)->bool {
+	std::FILE* in_ = std::fopen(Path.c_str(), "rb");
+	if (in_ == nullptr) {
+		return false;
+	}
+	std::FILE* out_ = std::fopen(Temp.c_str(), "wb");
+	if (out_ == nullptr) {
+		std::fclose(in_);
+		return false;
+	}
+	bool ok_ = SeekFile(in_, Skip) 
+			   && (std::fwrite(Head.data(), 1, Head.size(), out_) == Head.size());
+	std::vector<char> chunk_(kCOPY_CHUNK);
+	while (ok_) {
+		const size_t read_ = std::fread(chunk_.data(), 1, chunk_.size(), in_);
+		ok_ = (std::fwrite(chunk_.data(), 1, read_, out_) == read_);
+		if (read_ < chunk_.size()) {
+			ok_ = ok_ && !std::ferror(in_);
+			break;
+		}
+	}
+	std::fclose(in_);
+	ok_ = ok_ && (!Sync || SyncFile(out_));
+	ok_ = (std::fclose(out_) == 0) && ok_;
+	
+	std::error_code ec_;
+	if (ok_) {
+		fs::permissions(Temp, fs::status(Path, ec_).permissions(), ec_);
+	} else {
+		fs::remove(Temp, ec_);
+	}
+	return ok_;
+}
+
+
+// NAME:    WriteRecord
+// PURPOSE: Appends 'Edit's record to the journal 'Out'.
+auto static WriteRecord(std::FILE* Out, const JournalEdit& Edit)->bool {
+	const uint64_t length_ = 4 + Edit.Path_.size() + 4 + Edit.Temp_.size()
+							 + 8 + 8 + Edit.Old_.size() + 8 + Edit.New_.size();
+	uint8_t number_[8];
+	bool    ok_  = true;
+	uint32_t crc_ = 0;
+	auto put_ = [&](const void* Data, size_t Length, bool Payload) {
+		ok_ = ok_ && (std::fwrite(Data, 1, Length, Out) == Length);
+		if (Payload) {
+			crc_ = UpdateCrc(crc_, static_cast<const char*>(Data), Length);
+		}
+	};
+	auto put32_ = [&](uint32_t Value, bool Payload) {
+		id3_write_be32(number_, Value);
+		put_(number_, 4, Payload);
+	};
+	auto put64_ = [&](uint64_t Value, bool Payload) {
+		id3_write_be32(number_, static_cast<uint32_t>(Value >> 32));
+		id3_write_be32(number_ + 4, static_cast<uint32_t>(Value));
+		put_(number_, 8, Payload);
+	};
+	
+	put32_(kRECORD_MAGIC, false);
+	put64_(length_, false);
+	put32_(static_cast<uint32_t>(Edit.Path_.size()), true);
+	put_(Edit.Path_.data(), Edit.Path_.size(), true);
+	put32_(static_cast<uint32_t>(Edit.Temp_.size()), true);
+	put_(Edit.Temp_.data(), Edit.Temp_.size(), true);
+	put64_(Edit.FileSize_, true);
+	put64_(Edit.Old_.size(), true);
+	put_(Edit.Old_.data(), Edit.Old_.size(), true);
+	put64_(Edit.New_.size(), true);
+	put_(Edit.New_.data(), Edit.New_.size(), true);
+	put32_(crc_, false);
+	return ok_;
+}
+
+
+// NAME:    ReadRecord
+// PURPOSE: Reads the next record from the journal 'In' into 'Edit'. Returns 
+//          'false' at the end, or at a record that was not completely written 
+//          (which ends the journal). 'Remaining' is the unread length of 'In'.
+auto static ReadRecord(std::FILE* In, uint64_t& Remaining, JournalEdit& Edit)->bool {
+	uint8_t head_[12];
+	if ((Remaining < sizeof(head_) + 4) 
+		|| (std::fread(head_, 1, sizeof(head_), In) != sizeof(head_)) 
+		|| (id3_read_be32(head_) != kRECORD_MAGIC)) {
+		return false;
+	}
+	const uint64_t length_ = (static_cast<uint64_t>(id3_read_be32(head_ + 4)) << 32)
+							 | id3_read_be32(head_ + 8);
+	if (length_ > Remaining - sizeof(head_) - 4) {
+		return false;
+	}
+	std::vector<char> payload_(static_cast<size_t>(length_));
+	uint8_t           crc_[4];
+	if ((std::fread(payload_.data(), 1, payload_.size(), In) != payload_.size()) 
+		|| (std::fread(crc_, 1, sizeof(crc_), In) != sizeof(crc_)) 
+		|| (UpdateCrc(0, payload_.data(), payload_.size()) != id3_read_be32(crc_))) {
+		return false;
+	}
+	Remaining -= sizeof(head_) + length_ + 4;
+	
+	// The CRC matched, but the lengths are still checked against the payload:
+	const char* at_  = payload_.data();
+	const char* end_ = at_ + payload_.size();
+	auto take_ = [&](uint64_t Length, const char*& Data)->bool {
+		if (static_cast<uint64_t>(end_ - at_) < Length) {
+			return false;
+		}
+		Data = at_;
+		at_ += Length;
+		return true;
+	};
+	auto get32_ = [&](uint64_t& Value)->bool {
+		const char* data_ = nullptr;
+		if (!take_(4, data_)) {
+			return false;
+		}
+		Value = id3_read_be32(reinterpret_cast<const uint8_t*>(data_));
+		return true;
+	};
+	auto get64_ = [&](uint64_t& Value)->bool {
+		const char* data_ = nullptr;
+		if (!take_(8, data_)) {
+			return false;
+		}
+		const uint8_t* bytes_ = reinterpret_cast<const uint8_t*>(data_);
+		Value = (static_cast<uint64_t>(id3_read_be32(bytes_)) << 32) | id3_read_be32(bytes_ + 4);
+		return true;
+	};
+	uint64_t    size_ = 0;
+	const char* data_ = nullptr;
+	if (!get32_(size_) || !take_(size_, data_)) {
+		return false;
+	}
+	Edit.Path_.assign(data_, static_cast<size_t>(size_));
+	if (!get32_(size_) || !take_(size_, data_)) {
+		return false;
+	}
+	Edit.Temp_.assign(data_, static_cast<size_t>(size_));
+	if (!get64_(Edit.FileSize_) || !get64_(size_) || !take_(size_, data_)) {
+		return false;
+	}
+	Edit.Old_.assign(data_, data_ + size_);
+	if (!get64_(size_) || !take_(size_, data_)) {
+		return false;
+	}
+	Edit.New_.assign(data_, data_ + size_);
+	return !Edit.Path_.empty() && (Edit.Old_.size() <= Edit.FileSize_);
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+// Finishes whatever group a crash left in 'JournalFile' first (see 
+// 'recovered()'). If some file of it could not be brought forward, the 
+// journal is kept for another try and this journal is not 'ok()'.
+TagJournal::TagJournal(const std::string& JournalFile, JournalOptions Options) 
+	: Path_(JournalFile), Options_(Options) {
+#if !defined(__linux__)
+	Options_.Sync_ = JournalSync::PerFile;
+#endif
+	Recovered_ = recover(Path_);
+	if (Recovered_.Failed_ > 0) {
+		return;
+	}
+	File_ = std::fopen(Path_.c_str(), "wb");
+	if (File_ == nullptr) {
+		return;
+	}
+	if ((std::fwrite(kJOURNAL_MAGIC, 1, sizeof(kJOURNAL_MAGIC), File_) != sizeof(kJOURNAL_MAGIC)) 
+		|| !SyncFile(File_)) {
+		std::fclose(File_);
+		File_ = nullptr;
+		return;
+	}
+	SyncDirectoryOf(Path_);
+	Open_ = true;
+}
+
+
+// Commits the last group; the journal file is removed if it ends up empty.
+TagJournal::~TagJournal() noexcept {
+	commit();
+	if (File_ != nullptr) {
+		std::fclose(File_);
+		if (Clean_) {
+			std::error_code ec_;
+			fs::remove(Path_, ec_);
+		}
+	}
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    ok
+// DESCRIPTION: Tells whether the journal is open and accepts edits.
+bool TagJournal::ok() const noexcept {
+	return Open_.load();
+}
+
+
+// FUNCTION:    recovered
+// DESCRIPTION: Returns what the constructor's recovery found and did.
+const RecoveryReport& TagJournal::recovered() const noexcept {
+	return Recovered_;
+}
+
+
+// FUNCTION:    setCommitCallback
+// DESCRIPTION: Sets the function told of each file's result. It runs on the 
+//              thread that commits the group, while no other group can commit, 
+//              so it must not call back into the journal.
+void TagJournal::setCommitCallback(CommitCallback Callback) {
+	std::lock_guard<std::mutex> guard_(CommitLock_);
+	OnCommit_ = std::move(Callback);
+}
+
+
+// FUNCTION:    stage
+// DESCRIPTION: Lays out 'Tag' for 'Filename' (in its old tag's room if it 
+//              fits, or else with padding from 'Policy', which may be null) 
+//              and adds the edit to the current group, committing the group 
+//              if it is full or old enough. 'Tag' is updated as 'write_tag()' 
+//              leaves it. Returns 'false', with nothing staged, if the file 
+//              cannot be read or the tag is too large; otherwise the result 
+//              comes through the commit callback, with 'Job'.
+bool TagJournal::stage(size_t                Job, 
+					   const std::string&    Filename, 
+					   ID3v2_tag*            Tag, 
+					   ID3v2_padding_policy* Policy) {
+	if (!ok() || (Tag == nullptr)) {
+		return false;
+	}
+	
+	// Everything up to adding the edit touches only this file, so it is done
+	// outside the lock:
+	JournalEdit       edit_;
+	std::vector<char> header_;
+	edit_.Job_  = Job;
+	edit_.Path_ = Filename;
+	if (!ReadHead(Filename, ID3_HEADER, header_, edit_.FileSize_)) {
+		return false;
+	}
+	const int64_t capacity_ = GetTagCapacity(header_.data(), header_.size());
+	if (capacity_ >= 0) {
+		uint64_t size_ = 0;
+		if (!ReadHead(Filename, ID3_HEADER + capacity_, edit_.Old_, size_) 
+			|| (edit_.Old_.size() != static_cast<size_t>(ID3_HEADER + capacity_))) {
+			return false;  // The tag runs past the end of the file
+		}
+	}
+	
+	const int64_t frames_ = GetFramesSize(Tag);
+	if (frames_ > ID3_MAX_TAG_SIZE) {
+		return false;
+	}
+	if (!RenderTag(Tag, capacity_, edit_.New_)) {
+		int64_t size_ = frames_ + compute_padding(Policy, 
+												  static_cast<int32_t>(frames_), 
+												  Filename.c_str());
+		if ((capacity_ >= 0) && (size_ > capacity_)) {
+			// The same size 'write_tag()' grows an old tag to, in whole 
+			// blocks, so both paths leave the same file:
+			const int64_t block_ = ((Policy != nullptr) && (Policy->block_size > 0)) 
+								   ? Policy->block_size 
+								   : get_fs_block_size(Filename.c_str());
+			const int64_t grown_ = capacity_ 
+								   + ((size_ - capacity_ + block_ - 1) / block_) * block_;
+			if (grown_ <= ID3_MAX_TAG_SIZE) {
+				size_ = grown_;
+			}
+		}
+		if (!RenderTag(Tag, size_, edit_.New_)) {
+			return false;
+		}
+		edit_.Temp_ = Filename + kTEMP_SUFFIX;
+	}
+	record_padding_edit(Policy, Tag->used_size, static_cast<int32_t>(frames_));
+	free(Tag->tag_header);
+	Tag->tag_header = new_header();
+	std::memcpy(Tag->tag_header->tag, "ID3", 3);
+	Tag->tag_header->major_version = '\x03';
+	Tag->tag_header->minor_version = '\x00';
+	Tag->tag_header->flags         = '\x00';
+	Tag->tag_header->tag_size      = static_cast<int32_t>(edit_.New_.size() - ID3_HEADER);
+	Tag->used_size                 = static_cast<int32_t>(frames_);
+	
+	// A full group is taken out under the lock, and committed outside it, so 
+	// that other threads go on staging the next group meanwhile:
+	std::vector<JournalEdit> full_;
+	{
+		std::lock_guard<std::mutex> guard_(Lock_);
+		const auto now_ = std::chrono::steady_clock::now();
+		if (Group_.empty()) {
+			GroupStart_ = now_;
+		}
+		GroupBytes_ += edit_.Old_.size() + edit_.New_.size();
+		Group_.push_back(std::move(edit_));
+		if ((Group_.size() >= Options_.GroupFiles_) 
+			|| (GroupBytes_ >= Options_.GroupBytes_) 
+			|| (now_ - GroupStart_ >= std::chrono::milliseconds(Options_.GroupMs_))) {
+			full_.swap(Group_);
+			GroupBytes_ = 0;
+		}
+	}
+	commitGroup(full_);
+	return true;
+}
+
+
+// FUNCTION:    commit
+// DESCRIPTION: Commits the current group now, however small. Returns 'false' 
+//              if its journal records could not be written (and so none of 
+//              its files were).
+bool TagJournal::commit() {
+	std::vector<JournalEdit> group_;
+	{
+		std::lock_guard<std::mutex> guard_(Lock_);
+		group_.swap(Group_);
+		GroupBytes_ = 0;
+	}
+	return commitGroup(group_);
+}
+
+
+// FUNCTION:    recover
+// DESCRIPTION: Brings every file recorded in 'JournalFile' to its new tag (or 
+//              its old one, if 'RollBack'), skipping files already there, and 
+//              removes stray replacement files. A file is only written if it 
+//              is exactly in the other state, or torn by an in-place write of 
+//              the same length; any other file has changed since, and is left 
+//              alone as 'Failed_'. The journal is removed unless some file 
+//              failed. A missing journal, or one with no complete record, 
+//              reports nothing found.
+RecoveryReport TagJournal::recover(const std::string& JournalFile, bool RollBack) {
+	RecoveryReport report_;
+	std::error_code ec_;
+	uint64_t remaining_ = fs::file_size(JournalFile, ec_);
+	if (ec_ || (remaining_ < sizeof(kJOURNAL_MAGIC))) {
+		return report_;
+	}
+	std::FILE* in_ = std::fopen(JournalFile.c_str(), "rb");
+	if (in_ == nullptr) {
+		return report_;
+	}
+	char magic_[sizeof(kJOURNAL_MAGIC)];
+	if ((std::fread(magic_, 1, sizeof(magic_), in_) != sizeof(magic_)) 
+		|| (std::memcmp(magic_, kJOURNAL_MAGIC, sizeof(magic_)) != 0)) {
+		std::fclose(in_);
+		return report_;
+	}
+	remaining_ -= sizeof(magic_);
+	std::vector<JournalEdit> edits_;
+	JournalEdit              edit_;
+	while (ReadRecord(in_, remaining_, edit_)) {
+		edits_.push_back(std::move(edit_));
+		edit_ = JournalEdit();
+	}
+	std::fclose(in_);
+	report_.Found_ = !edits_.empty();
+	
+	for (const JournalEdit& e : edits_) {
+		const std::vector<char>& target_ = RollBack ? e.Old_ : e.New_;
+		const std::vector<char>& other_  = RollBack ? e.New_ : e.Old_;
+		size_t&                  done_   = RollBack ? report_.RolledBack_ : report_.Replayed_;
+		const uint64_t           audio_  = e.FileSize_ - e.Old_.size();
+		const std::string        temp_   = e.Temp_.empty() ? e.Path_ + kTEMP_SUFFIX : e.Temp_;
+		if (!e.Temp_.empty()) {
+			fs::remove(e.Temp_, ec_);
+		}
+		
+		std::vector<char> head_;
+		uint64_t          size_ = 0;
+		if (!ReadHead(e.Path_, std::max(e.Old_.size(), e.New_.size()), head_, size_)) {
+			++report_.Failed_;
+			continue;
+		}
+		bool ok_ = false;
+		if (StartsWith(head_, target_) && (size_ == audio_ + target_.size())) {
+			// Already there, but perhaps only in the page cache:
+			std::FILE* file_ = std::fopen(e.Path_.c_str(), "r+b");
+			ok_ = (file_ != nullptr) && SyncFile(file_);
+			if (file_ != nullptr) {
+				std::fclose(file_);
+			}
+			ok_ ? ++report_.Intact_ : ++report_.Failed_;
+			continue;
+		}
+		if (StartsWith(head_, other_) && (size_ == audio_ + other_.size())) {
+			if (other_.size() == target_.size()) {
+				ok_ = WriteHead(e.Path_, target_, true);
+			} else {
+				ok_ = WriteReplacement(e.Path_, temp_, target_, other_.size(), true);
+				if (ok_) {
+					fs::rename(temp_, e.Path_, ec_);
+					ok_ = !ec_ && SyncDirectoryOf(e.Path_);
+					if (ec_) {
+						fs::remove(temp_, ec_);
+					}
+				}
+			}
+		} else if ((e.Old_.size() == e.New_.size()) && (size_ == e.FileSize_)) {
+			ok_ = WriteHead(e.Path_, target_, true);  // Torn in-place write
+		}
+		ok_ ? ++done_ : ++report_.Failed_;
+	}
+	if (report_.Failed_ == 0) {
+		fs::remove(JournalFile, ec_);
+	}
+	return report_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    commitGroup
+// DESCRIPTION: Runs the four steps of a commit (see the class comment) for 
+//              'Group', reports each file, and empties 'Group'. Groups share 
+//              the journal file, so they commit one at a time, under 
+//              'CommitLock_' (but not 'Lock_', which 'stage()' needs).
+bool TagJournal::commitGroup(std::vector<JournalEdit>& Group) {
+	if (Group.empty()) {
+		return true;
+	}
+	std::lock_guard<std::mutex> guard_(CommitLock_);
+	std::vector<int32_t> results_(Group.size(), TAG_WRITE_FAILED);
+	
+	// 1. The journal records, synced once for the group:
+	bool logged_ = (File_ != nullptr);
+	for (const JournalEdit& e : Group) {
+		logged_ = logged_ && WriteRecord(File_, e);
+	}
+	logged_ = logged_ && SyncFile(File_);
+	
+	if (logged_) {
+		// 2. The files, with no sync of their own unless 'PerFile':
+		const bool                         perFile_ = (Options_.Sync_ == JournalSync::PerFile);
+		std::map<uint64_t, std::string>    devices_;  // Device -> a file on it
+		std::vector<uint64_t>              device_(Group.size(), 0);
+		for (size_t i = 0; i < Group.size(); ++i) {
+			const JournalEdit& e = Group[i];
+			const bool ok_ = e.Temp_.empty() 
+							 ? WriteHead(e.Path_, e.New_, perFile_) 
+							 : WriteReplacement(e.Path_, e.Temp_, e.New_, e.Old_.size(), perFile_);
+			if (ok_) {
+				results_[i] = e.Temp_.empty() ? TAG_WRITE_IN_PLACE : TAG_WRITE_REWRITE;
+				device_[i]  = GetDeviceId(e.Path_);
+				devices_.emplace(device_[i], e.Path_);
+			} else if (e.Temp_.empty() && !WriteHead(e.Path_, e.Old_, true)) {
+				Clean_ = false;  // Perhaps torn; 'recover()' must see it
+			}
+		}
+		
+		// 3. One sync per device (a failed one fails its files):
+		if (!perFile_) {
+			for (const auto& [dev_, path_] : devices_) {
+				if (SyncDevice(path_)) {
+					continue;
+				}
+				Clean_ = false;
+				for (size_t i = 0; i < Group.size(); ++i) {
+					if ((results_[i] != TAG_WRITE_FAILED) && (device_[i] == dev_)) {
+						results_[i] = TAG_WRITE_FAILED;
+					}
+				}
+			}
+		}
+		
+		// 4. The rewritten files take the old ones' places:
+		std::map<std::string, std::string> dirs_;  // Directory -> a file in it
+		std::error_code                    ec_;
+		for (size_t i = 0; i < Group.size(); ++i) {
+			const JournalEdit& e = Group[i];
+			if (e.Temp_.empty()) {
+				continue;
+			}
+			if (results_[i] == TAG_WRITE_FAILED) {
+				fs::remove(e.Temp_, ec_);
+				continue;
+			}
+			fs::rename(e.Temp_, e.Path_, ec_);
+			if (ec_) {
+				fs::remove(e.Temp_, ec_);
+				results_[i] = TAG_WRITE_FAILED;
+				continue;
+			}
+			dirs_.emplace(fs::path(e.Path_).parent_path().string(), e.Path_);
+		}
+		for (const auto& [dir_, path_] : dirs_) {
+			if (!SyncDirectoryOf(path_)) {
+				Clean_ = false;
+			}
+		}
+	}
+	
+	// 5. The journal is emptied, which is what commits the group:
+	if (Clean_ && (File_ != nullptr)) {
+		std::error_code ec_;
+		std::fflush(File_);
+		fs::resize_file(Path_, sizeof(kJOURNAL_MAGIC), ec_);
+		if (ec_ || (std::fseek(File_, sizeof(kJOURNAL_MAGIC), SEEK_SET) != 0) 
+			|| !SyncFile(File_)) {
+			Clean_ = false;
+		}
+	}
+	if (!Clean_ && (File_ != nullptr)) {
+		// The records stay for 'recover()'; no more edits are taken:
+		Open_ = false;
+		std::fclose(File_);
+		File_ = nullptr;
+	}
+	
+	for (size_t i = 0; i < Group.size(); ++i) {
+		if (OnCommit_) {
+			OnCommit_(Group[i].Job_, results_[i]);
+		}
+	}
+	Group.clear();
+	return logged_;
+}
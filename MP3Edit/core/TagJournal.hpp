@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagJournal.hpp
+// FILE PURPOSE:  Declares the class 'TagJournal', which saves tags in durable 
+//                groups: each group's old and new tag bytes go to an 
+//                append-only journal first, and the files are synced once 
+//                per group instead of once per file. An interrupted group is 
+//                replayed (or rolled back) from the journal on the next start.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const size_t   kJOURNAL_GROUP_FILES = 64;
+constexpr static const uint32_t kJOURNAL_GROUP_MS    = 100;
+constexpr static const uint64_t kJOURNAL_GROUP_BYTES = 32ull * 1024 * 1024;
+
+
+/* ******************************* STRUCTURES ******************************* */
+enum class JournalSync : uint8_t {
+	PerFile,   // 'fdatasync()' every file of the group
+	PerDevice  // 'syncfs()' once per device (Linux; elsewhere as 'PerFile')
+};
+
+struct JournalOptions {
+	size_t      GroupFiles_ = kJOURNAL_GROUP_FILES; // Commit after this many files, 
+	uint32_t    GroupMs_    = kJOURNAL_GROUP_MS;    // this long after the first, 
+	uint64_t    GroupBytes_ = kJOURNAL_GROUP_BYTES; // or this many tag bytes held
+	JournalSync Sync_       = JournalSync::PerDevice;
+};
+
+// One file's edit, as the journal records it:
+struct JournalEdit {
+	size_t            Job_      = 0;
+	std::string       Path_;
+	std::string       Temp_;         // Empty for an in-place edit
+	uint64_t          FileSize_ = 0; // Before the edit
+	std::vector<char> Old_;          // The old tag, as on disk (may be empty)
+	std::vector<char> New_;          // The new tag, with its padding
+};
+
+struct RecoveryReport {
+	bool   Found_      = false; // The journal held an unfinished group
+	size_t Replayed_   = 0;     // Files brought forward to their new tag
+	size_t RolledBack_ = 0;     // Files brought back to their old tag
+	size_t Intact_     = 0;     // Files that were already that way
+	size_t Failed_     = 0;     // Files changed since, or unreadable
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// A group commits in four steps: the journal records of all its files are 
+// written and synced; the files are written, with no sync; the files are 
+// synced together; and the journal is emptied. A tag that fits in the old one 
+// is written over it; any other is written, with the audio, to a new file 
+// beside the old one, which replaces it (by rename) only once synced, so the 
+// audio is never moved in place. Until the journal is emptied, each of its 
+// records holds a file's size and its old and new tag bytes, which is all 
+// 'recover()' needs to finish or undo the edit.
+class TagJournal {
+
+	public:
+		// Called for every staged file when its group commits, with the 'Job' 
+		// given to 'stage()' and one of the 'TAG_WRITE_*' constants:
+		using CommitCallback = std::function<void(size_t Job, int32_t Result)>;
+	
+	private:
+		std::string                           Path_;
+		JournalOptions                        Options_;
+		CommitCallback                        OnCommit_;
+		std::FILE*                            File_       = nullptr;
+		std::atomic<bool>                     Open_{false};       // 'File_' takes edits
+		bool                                  Clean_      = true; // Safe to empty
+		std::vector<JournalEdit>              Group_;
+		uint64_t                              GroupBytes_ = 0;
+		std::chrono::steady_clock::time_point GroupStart_;
+		RecoveryReport                        Recovered_;
+		std::mutex                            Lock_;       // Over the group being staged
+		std::mutex                            CommitLock_; // Over 'File_' and 'OnCommit_', while a group commits
+	
+	public:
+		TagJournal() = delete;
+		explicit TagJournal(const std::string& JournalFile, 
+							JournalOptions     Options = JournalOptions());
+		~TagJournal() noexcept;
+		
+		TagJournal(const TagJournal&)            = delete;
+		TagJournal& operator=(const TagJournal&) = delete;
+		
+		bool                  ok() const noexcept;
+		const RecoveryReport& recovered() const noexcept;
+		void                  setCommitCallback(CommitCallback Callback);
+		bool                  stage(size_t                Job, 
+									const std::string&    Filename, 
+									ID3v2_tag*            Tag, 
+									ID3v2_padding_policy* Policy);
+		bool                  commit();
+		
+		static RecoveryReport recover(const std::string& JournalFile, 
+									  bool               RollBack = false);
+	
+	private:
+		bool                  commitGroup(std::vector<JournalEdit>& Group);
+
+};
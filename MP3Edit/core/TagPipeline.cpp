@@ -0,0 +1,440 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagPipeline.cpp
+// FILE PURPOSE:  Defines the class 'TagPipeline'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "BoundedQueue.hpp"
+#include "TagPipeline.hpp"
+#include "WriteScheduler.hpp"
+
+
+/* **************** IMPORTED NAMESPACES / NAMESPACE ALIASES ***************** */
+namespace fs = std::filesystem;
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const int32_t kFILE_UNCHANGED = 0;
+constexpr static const int32_t kFILE_MODIFIED  = 1;
+constexpr static const int32_t kFILE_FAILED    = 2;
+constexpr static const int32_t kFILE_SKIPPED   = 3;
+constexpr static const int32_t kFILE_PENDING   = 4; // Staged in the journal
+constexpr static const int32_t kFILE_RESUMED   = 5; // Done by an earlier run
+
+// A stage with nothing to do (or nowhere to put its output) yields this many 
+// times, then sleeps for 'kIDLE_WAIT' between tries:
+constexpr static const unsigned kSPIN_YIELDS = 64;
+constexpr static const auto     kIDLE_WAIT   = std::chrono::microseconds(100);
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    Backoff
+// PURPOSE: Waits a little before a stage retries a full or empty queue.
+auto static Backoff(unsigned& Spins)->void {
+	if (++Spins < kSPIN_YIELDS) {
+		std::this_thread::yield();
+	} else {
+		std::this_thread::sleep_for(kIDLE_WAIT);
+	}
+}
+
+
+// NAME:    StageThreads
+// PURPOSE: Returns the number of threads to start for a stage (0 = one per 
+//          hardware thread).
+auto static StageThreads(size_t Requested)->size_t {
+	if (Requested == 0) {
+		Requested = std::thread::hardware_concurrency();
+	}
+	return std::max<size_t>(Requested, 1);
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+TagPipeline::TagPipeline() noexcept {}
+
+
+TagPipeline::TagPipeline(PipelineOptions Options) noexcept 
+	: Options_(Options) {}
+
+
+TagPipeline::~TagPipeline() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+void TagPipeline::setProgressCallback(ProgressCallback Callback) {
+	OnProgress_ = std::move(Callback);
+}
+
+
+// FUNCTION:    cancel
+// DESCRIPTION: Asks a running job to stop. Files already handed to the write 
+//              stage are saved (so no file is left half-written); the rest 
+//              are counted as skipped. Safe to call from any thread, 
+//              including from inside the progress callback.
+void TagPipeline::cancel() noexcept {
+	Cancelled_ = true;
+}
+
+
+bool TagPipeline::isCancelled() const noexcept {
+	return Cancelled_.load();
+}
+
+
+// FUNCTION:    peakMemory
+// DESCRIPTION: Returns the most tag bytes held at once during the last run.
+uint64_t TagPipeline::peakMemory() const noexcept {
+	return PeakInFlight_.load();
+}
+
+
+// FUNCTION:    run
+// DESCRIPTION: Loads the tag of every file in 'Files', passes it to 'Fn', and 
+//              saves it if 'Fn' returns 'true', with the same results as 
+//              'BatchEngine::run()'. Read threads fetch each file's raw tag, 
+//              parse threads turn it into an 'ID3v2_tag' and run 'Fn', and 
+//              write threads save the changed ones in the order a 
+//              'WriteScheduler' picks; each stage hands files to the next 
+//              through a 'BoundedQueue'. Blocks until the job is done or 
+//              cancelled.
+BatchResult TagPipeline::run(const std::vector<std::string>& Files, 
+							 const Transform&                Fn) {
+	struct Item {
+		size_t            Index_  = 0;
+		uint64_t          Charge_ = 0;       // Against the memory budget
+		std::vector<char> Raw_;              // The tag as read, header included
+		ID3v2_tag*        Tag_    = nullptr; // The tag as transformed
+	};
+	
+	BatchResult   result_;
+	BatchProgress progress_;
+	result_.FilesTotal_   = Files.size();
+	progress_.FilesTotal_ = Files.size();
+	Cancelled_            = false;
+	InFlight_             = 0;
+	PeakInFlight_         = 0;
+	
+	BoundedQueue<Item>  parseQueue_(Options_.QueueCapacity_);
+	BoundedQueue<Item>  writeQueue_(Options_.QueueCapacity_);
+	std::atomic<size_t> next_{0};
+	std::atomic<size_t> readersLeft_{StageThreads(Options_.ReadThreads_)};
+	std::atomic<size_t> parsersLeft_{StageThreads(Options_.ParseThreads_)};
+	WriteScheduler      scheduler_(Options_.MaxPerDevice_);
+	std::vector<Item>   scheduled_(Files.size()); // Files waiting in 'scheduler_'
+	std::unique_ptr<TagJournal> journal_;
+	std::unique_ptr<BatchCheckpoint> checkpoint_;
+	if (!Options_.Checkpoint_.empty()) {
+		checkpoint_ = std::make_unique<BatchCheckpoint>(Options_.Checkpoint_, Files, 
+														Options_.CheckpointJob_, 
+														Options_.CheckpointMs_);
+		checkpoint_->resume();
+	}
+	
+	// Tallies the outcome for file 'i' and reports progress:
+	auto finish_ = [&](size_t i, int32_t status_) {
+		const std::string& file_ = Files[i];
+		if (checkpoint_ && ((status_ == kFILE_MODIFIED) || (status_ == kFILE_UNCHANGED))) {
+			checkpoint_->markDone(i);
+		}
+		std::lock_guard<std::mutex> guard_(ProgressLock_);
+		switch (status_) {
+			case kFILE_MODIFIED:
+				++result_.FilesModified_;
+				++progress_.FilesModified_;
+				break;
+			case kFILE_FAILED:
+				++result_.FilesFailed_;
+				++progress_.FilesFailed_;
+				result_.FailedFiles_.push_back(file_);
+				break;
+			case kFILE_SKIPPED:
+				++result_.FilesSkipped_;
+				break;
+			case kFILE_RESUMED:
+				++result_.FilesResumed_;
+				break;
+			default:
+				++result_.FilesUnchanged_;
+				break;
+		}
+		++progress_.FilesDone_;
+		progress_.CurrentFile_ = file_;
+		if (OnProgress_) {
+			OnProgress_(progress_);
+		}
+	};
+	
+	// A staged file is only done once its group commits:
+	if (!Options_.Journal_.empty()) {
+		journal_ = std::make_unique<TagJournal>(Options_.Journal_, Options_.JournalOptions_);
+		journal_->setCommitCallback([&](size_t job_, int32_t result_) {
+			finish_(job_, (result_ == TAG_WRITE_FAILED) ? kFILE_FAILED 
+														: kFILE_MODIFIED);
+		});
+	}
+	
+	// Drops a file from the pipeline (a staged one is finished by the 
+	// journal):
+	auto drop_ = [&](Item& item_, int32_t status_) {
+		if (item_.Tag_ != nullptr) {
+			free_tag(item_.Tag_);
+			item_.Tag_ = nullptr;
+		}
+		std::vector<char>().swap(item_.Raw_);
+		releaseMemory(item_.Charge_);
+		if (status_ != kFILE_PENDING) {
+			finish_(item_.Index_, status_);
+		}
+	};
+	
+	auto push_ = [](BoundedQueue<Item>& queue_, Item& item_) {
+		unsigned spins_ = 0;
+		while (!queue_.tryPush(item_)) {
+			Backoff(spins_);
+		}
+	};
+	
+	// Takes the next file from 'queue_'; returns 'false' once the stage 
+	// feeding it has finished and the queue is empty:
+	auto pop_ = [](BoundedQueue<Item>& queue_, std::atomic<size_t>& feeders_, 
+				   Item& item_) {
+		unsigned spins_ = 0;
+		for (;;) {
+			const bool last_ = (feeders_.load() == 0);
+			if (queue_.tryPop(item_)) {
+				return true;
+			}
+			if (last_) {
+				return false;
+			}
+			Backoff(spins_);
+		}
+	};
+	
+	// Stage 1: the raw tag bytes, read with the same calls as 'load_tag()':
+	auto read_ = [&]() {
+		for (size_t i = next_++; i < Files.size(); i = next_++) {
+			const std::string& file_ = Files[i];
+			std::error_code    ec_;
+			if (Cancelled_) {
+				finish_(i, kFILE_SKIPPED);
+				continue;
+			}
+			if (checkpoint_ && checkpoint_->skip(i, file_)) {
+				finish_(i, kFILE_RESUMED);
+				continue;
+			}
+			std::FILE* in_ = fs::is_regular_file(file_, ec_) 
+							 ? std::fopen(file_.c_str(), "rb") : nullptr;
+			if (in_ == nullptr) {
+				finish_(i, kFILE_FAILED);
+				continue;
+			}
+			
+			char          head_[ID3_HEADER + ID3_EXTENDED_HEADER_SIZE];
+			const size_t  got_    = std::fread(head_, 1, sizeof(head_), in_);
+			ID3v2_header* header_ = get_tag_header_with_buffer(
+				head_, static_cast<int32_t>(got_));
+			Item item_;
+			item_.Index_ = i;
+			if (header_ != nullptr) {
+				item_.Charge_ = ID3_HEADER + static_cast<uint64_t>(header_->tag_size);
+				free(header_);
+				if (!acquireMemory(item_.Charge_)) {
+					std::fclose(in_);
+					finish_(i, kFILE_SKIPPED);
+					continue;
+				}
+				item_.Raw_.assign(static_cast<size_t>(item_.Charge_), '\0');
+				const size_t headBytes_ = std::min(got_, item_.Raw_.size());
+				std::memcpy(item_.Raw_.data(), head_, headBytes_);
+				if (std::fread(item_.Raw_.data() + headBytes_, 1, 
+							   item_.Raw_.size() - headBytes_, in_) 
+					!= (item_.Raw_.size() - headBytes_)) {
+					// The file is shorter than its tag says (or shrank):
+					std::fclose(in_);
+					drop_(item_, kFILE_FAILED);
+					continue;
+				}
+			}
+			std::fclose(in_);
+			push_(parseQueue_, item_);
+		}
+		--readersLeft_;
+	};
+	
+	// Stage 2: parse, transform, and pass on only the files to be saved:
+	auto parse_ = [&]() {
+		Item item_;
+		while (pop_(parseQueue_, readersLeft_, item_)) {
+			if (Cancelled_) {
+				drop_(item_, kFILE_SKIPPED);
+				continue;
+			}
+			if (!item_.Raw_.empty()) {
+				item_.Tag_ = load_tag_with_buffer(item_.Raw_.data(), 
+												  static_cast<int32_t>(item_.Raw_.size()));
+				std::vector<char>().swap(item_.Raw_);
+			}
+			if (item_.Tag_ == nullptr) {
+				if (!Options_.CreateMissingTags_) {
+					drop_(item_, kFILE_UNCHANGED);
+					continue;
+				}
+				item_.Tag_ = new_tag();
+			}
+			
+			int32_t status_ = kFILE_MODIFIED;
+			try {
+				if (!Fn(Files[item_.Index_], item_.Tag_)) {
+					status_ = kFILE_UNCHANGED;
+				}
+			} catch (...) {
+				// A throwing transform fails its own file, not the whole job:
+				status_ = kFILE_FAILED;
+			}
+			if (status_ != kFILE_MODIFIED) {
+				drop_(item_, status_);
+				continue;
+			}
+			push_(writeQueue_, item_);
+		}
+		--parsersLeft_;
+	};
+	
+	// Stage 3: hand every file that arrives to the scheduler, and save the 
+	// next one it allows. A thread quits once nothing more can arrive and 
+	// nothing is left pending; files already running belong to other threads:
+	auto write_ = [&]() {
+		Item     item_;
+		unsigned spins_ = 0;
+		for (;;) {
+			const bool last_  = (parsersLeft_.load() == 0);
+			bool       added_ = false;
+			while (writeQueue_.tryPop(item_)) {
+				const size_t i = item_.Index_;
+				scheduled_[i]  = std::move(item_);
+				scheduler_.add(i, Files[i]);
+				added_ = true;
+			}
+			size_t job_ = 0;
+			if (scheduler_.next(job_)) {
+				const int32_t status_ = saveTag(Files[job_], scheduled_[job_].Tag_, 
+												journal_.get(), job_);
+				scheduler_.done(job_);
+				drop_(scheduled_[job_], status_);
+				spins_ = 0;
+				continue;
+			}
+			if (last_ && !added_ && (scheduler_.pending() == 0)) {
+				break;
+			}
+			Backoff(spins_);
+		}
+	};
+	
+	std::vector<std::thread> threads_;
+	for (size_t t = readersLeft_.load(); t > 0; --t) {
+		threads_.emplace_back(read_);
+	}
+	for (size_t t = parsersLeft_.load(); t > 0; --t) {
+		threads_.emplace_back(parse_);
+	}
+	for (size_t t = StageThreads(Options_.WriteThreads_); t > 0; --t) {
+		threads_.emplace_back(write_);
+	}
+	for (std::thread& thread_ : threads_) {
+		thread_.join();
+	}
+	if (journal_) {
+		journal_->commit();
+	}
+	
+	// A complete job needs no checkpoint; any other keeps its last one:
+	if (checkpoint_) {
+		if (!Cancelled_ && (result_.FilesFailed_ == 0)) {
+			checkpoint_->remove();
+		} else {
+			checkpoint_->save();
+		}
+	}
+	
+	result_.Cancelled_ = Cancelled_.load();
+	return result_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    acquireMemory
+// DESCRIPTION: Charges 'Bytes' to the memory budget, waiting while it would be 
+//              overspent. Anything is let through while nothing else is held. 
+//              Returns 'false' if the job was cancelled while waiting.
+bool TagPipeline::acquireMemory(uint64_t Bytes) {
+	unsigned spins_ = 0;
+	uint64_t held_  = InFlight_.load();
+	while (!Cancelled_) {
+		if ((held_ == 0) || (held_ + Bytes <= Options_.MemoryBudget_)) {
+			if (InFlight_.compare_exchange_weak(held_, held_ + Bytes)) {
+				uint64_t peak_ = PeakInFlight_.load();
+				while ((held_ + Bytes > peak_) 
+					   && !PeakInFlight_.compare_exchange_weak(peak_, held_ + Bytes)) {}
+				return true;
+			}
+			continue;
+		}
+		Backoff(spins_);
+		held_ = InFlight_.load();
+	}
+	return false;
+}
+
+
+void TagPipeline::releaseMemory(uint64_t Bytes) noexcept {
+	InFlight_ -= Bytes;
+}
+
+
+// FUNCTION:    saveTag
+// DESCRIPTION: Saves 'Tag' to 'Filename', or stages it as 'Job' in 'Journal' 
+//              if there is one. As in 'BatchEngine', the padding policy is 
+//              shared, so each save works on a copy and the edit is then 
+//              recorded on the shared policy under a lock.
+int32_t TagPipeline::saveTag(const std::string& Filename, 
+							 ID3v2_tag*         Tag, 
+							 TagJournal*        Journal, 
+							 size_t             Job) {
+	ID3v2_padding_policy policy_;
+	{
+		std::lock_guard<std::mutex> guard_(PolicyLock_);
+		policy_ = Options_.PaddingPolicy_;
+	}
+	const int32_t oldSize_ = Tag->used_size;
+	if (Journal != nullptr) {
+		if (!Journal->stage(Job, Filename, Tag, &policy_)) {
+			return kFILE_FAILED;
+		}
+	} else if (set_tag_with_padding_policy(Filename.c_str(), Tag, &policy_) 
+			   == TAG_WRITE_FAILED) {
+		return kFILE_FAILED;
+	}
+	std::lock_guard<std::mutex> guard_(PolicyLock_);
+	record_padding_edit(&Options_.PaddingPolicy_, oldSize_, Tag->used_size);
+	return (Journal != nullptr) ? kFILE_PENDING : kFILE_MODIFIED;
+}
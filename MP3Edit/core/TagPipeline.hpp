@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagPipeline.hpp
+// FILE PURPOSE:  Declares the class 'TagPipeline', which runs the same 
+//                load -> transform -> save job as 'BatchEngine', but as three 
+//                stages on their own threads (read, parse/transform, write) 
+//                joined by bounded queues, so that disk and CPU work overlap.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "BatchCheckpoint.hpp"
+#include "BatchEngine.hpp"
+#include "TagJournal.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct PipelineOptions {
+	size_t   ReadThreads_       = 2;     // I/O: raw tag bytes off the disk
+	size_t   ParseThreads_      = 0;     // CPU: parse and transform; 0 = one per hardware thread
+	size_t   WriteThreads_      = 16;    // I/O: save changed tags (see 'MaxPerDevice_')
+	size_t   MaxPerDevice_      = 0;     // Concurrent saves per device; 0 = by device kind
+	size_t   QueueCapacity_     = 64;    // Files waiting between two stages
+	uint64_t MemoryBudget_      = 64ull * 1024 * 1024; // Tag bytes in flight
+	bool     CreateMissingTags_ = false; // Give tag-less files a new tag
+	std::string    Journal_;             // Save in durable groups through this journal; empty = off
+	JournalOptions JournalOptions_;      // Its group limits (held on top of 'MemoryBudget_')
+	std::string    Checkpoint_;          // Resume from, and save progress to, this file; empty = off
+	std::string    CheckpointJob_;       // Describes the work; another job's checkpoint is ignored
+	uint32_t       CheckpointMs_ = kCHECKPOINT_INTERVAL_MS; // Between saves
+	ID3v2_padding_policy PaddingPolicy_ = *get_default_padding_policy();
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// A file's tag is charged to the memory budget from the moment its size is 
+// read until the file leaves the pipeline, and the read stage waits while the 
+// budget is spent. A burst of large tags (big cover pictures) therefore slows 
+// the readers down instead of piling up in the queues; a single tag larger 
+// than the whole budget is still let through, alone. Saves are ordered by a 
+// 'WriteScheduler', which caps them per device: one at a time, in physical 
+// order, on a rotational disk, and up to 'WriteThreads_' on an SSD. With a 
+// 'Journal_', saves are staged in a 'TagJournal' instead, and a file counts 
+// as modified only once its group has committed. With a 'Checkpoint_', the 
+// files done so far are saved every 'CheckpointMs_', and a run over the same 
+// files resumes from there: the files done are only stat'ed (as resumed), 
+// unless modified since. Failed files are never marked done, so that a 
+// resumed run retries them.
+class TagPipeline {
+
+	public:
+		using Transform        = BatchEngine::Transform;
+		using ProgressCallback = BatchEngine::ProgressCallback;
+	
+	private:
+		PipelineOptions       Options_;
+		ProgressCallback      OnProgress_;
+		std::atomic<bool>     Cancelled_{false};
+		std::atomic<uint64_t> InFlight_{0};     // Bytes charged to the budget
+		std::atomic<uint64_t> PeakInFlight_{0};
+		std::mutex            ProgressLock_;
+		std::mutex            PolicyLock_;
+	
+	public:
+		TagPipeline() noexcept;
+		explicit TagPipeline(PipelineOptions Options) noexcept;
+		~TagPipeline() noexcept;
+		
+		TagPipeline(const TagPipeline&)            = delete;
+		TagPipeline& operator=(const TagPipeline&) = delete;
+		
+		void        setProgressCallback(ProgressCallback Callback);
+		void        cancel() noexcept;
+		bool        isCancelled() const noexcept;
+		uint64_t    peakMemory() const noexcept;
+		BatchResult run(const std::vector<std::string>& Files, 
+						const Transform&                Fn);
+	
+	private:
+		bool        acquireMemory(uint64_t Bytes);
+		void        releaseMemory(uint64_t Bytes) noexcept;
+		int32_t     saveTag(const std::string& Filename, 
+							ID3v2_tag*         Tag, 
+							TagJournal*        Journal, 
+							size_t             Job);
+
+};
@@ -0,0 +1,486 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagQuery.cpp
+// FILE PURPOSE:  Defines the class 'TagQuery'. Rows are filtered a batch at a 
+//                time: each group of clauses narrows the batch's selection 
+//                vector with a tight loop over one column, and a text clause 
+//                on a dictionary column is decided once per distinct value, 
+//                so testing a row is a table lookup.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <array>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cctype>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagFields.hpp"
+#include "TagQuery.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const size_t kQUERY_BATCH = 4096;
+
+// Searched by a bare word (as by 'TrigramIndex'):
+constexpr static const TagColumn kANY_TEXT_COLUMNS[] = {
+	TagColumn::Title, 
+	TagColumn::Artist, 
+	TagColumn::Album, 
+	TagColumn::Comment
+};
+
+
+/* ******************************* STRUCTURES ******************************* */
+// A predicate tied to one 'TagStore' for the length of a 'select()':
+struct BoundPredicate {
+	const QueryPredicate*                                Query_ = nullptr;
+	std::array<const uint32_t*, kINDEX_FIELD_COUNT>      Ids_{};
+	std::array<std::vector<uint8_t>, kINDEX_FIELD_COUNT> Accept_; // By dictionary id
+};
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    EqualsIgnoreCase
+// PURPOSE: Compares two strings, ignoring ASCII case.
+auto static EqualsIgnoreCase(std::string_view A, std::string_view B)->bool {
+	return (A.length() == B.length()) 
+		   && std::equal(A.begin(), A.end(), B.begin(), [](char a_, char b_) {
+				  return std::tolower(static_cast<unsigned char>(a_)) 
+						 == std::tolower(static_cast<unsigned char>(b_));
+			  });
+}
+
+
+// NAME:    Unquote
+// PURPOSE: Strips one pair of surrounding double quotes, if present.
+auto static Unquote(std::string_view Text)->std::string_view {
+	if ((Text.length() >= 2) && (Text.front() == '"') && (Text.back() == '"')) {
+		return Text.substr(1, Text.length() - 2);
+	}
+	return Text;
+}
+
+
+// NAME:    ParseNumber
+// PURPOSE: Parses a whole decimal 'Text' into 'Out'. Returns 'false' if it is 
+//          empty, not all digits, or too large.
+auto static ParseNumber(std::string_view Text, uint32_t& Out)->bool {
+	if (Text.empty() || (Text.length() > 9)) {
+		return false;
+	}
+	Out = 0;
+	for (char c_ : Text) {
+		if (!std::isdigit(static_cast<unsigned char>(c_))) {
+			return false;
+		}
+		Out = (Out * 10) + static_cast<uint32_t>(c_ - '0');
+	}
+	return true;
+}
+
+
+// NAME:    ColumnsOf
+// PURPOSE: Returns the columns a predicate reads.
+auto static ColumnsOf(const QueryPredicate& Query)->std::vector<TagColumn> {
+	switch (Query.Target_) {
+		case QueryTarget::Field:
+			return { Query.Column_ };
+		case QueryTarget::AnyText:
+			return std::vector<TagColumn>(std::begin(kANY_TEXT_COLUMNS), 
+										  std::end(kANY_TEXT_COLUMNS));
+		default:
+			return (Query.Feature_ == TagFeature::Comment) 
+				   ? std::vector<TagColumn>{ TagColumn::Comment }
+				   : std::vector<TagColumn>();
+	}
+}
+
+
+// NAME:    CostOf
+// PURPOSE: Estimates the work per row of a predicate, to run cheap ones first.
+auto static CostOf(const QueryPredicate& Query)->size_t {
+	if ((Query.Target_ == QueryTarget::Feature) || (Query.Op_ == QueryOp::Range)) {
+		return 1;
+	}
+	size_t cost_ = 0;
+	for (TagColumn column_ : ColumnsOf(Query)) {
+		cost_ += (TagStore::columnKind(column_) == TagColumnKind::Dictionary) ? 2 : 8;
+	}
+	return cost_;
+}
+
+
+// NAME:    TextMatches
+// PURPOSE: Tests a text predicate against one value.
+auto static TextMatches(const QueryPredicate& Query, std::string_view Value)->bool {
+	return (Query.Op_ == QueryOp::Equals) ? EqualsIgnoreCase(Value, Query.Text_) 
+										  : ContainsIgnoreCase(Value, Query.Text_);
+}
+
+
+// NAME:    Bind
+// PURPOSE: Prepares 'Query' to run over 'Store', deciding it once for every 
+//          value of each dictionary column it reads.
+auto static Bind(const QueryPredicate& Query, const TagStore& Store)->BoundPredicate {
+	BoundPredicate bound_;
+	bound_.Query_ = &Query;
+	if ((Query.Target_ == QueryTarget::Feature) || (Query.Op_ == QueryOp::Range)) {
+		return bound_;
+	}
+	for (TagColumn column_ : ColumnsOf(Query)) {
+		const size_t c = static_cast<size_t>(column_);
+		bound_.Ids_[c] = Store.dictionaryColumn(column_);
+		if (bound_.Ids_[c] == nullptr) {
+			continue;
+		}
+		const StringDictionary& dict_ = Store.dictionary(column_);
+		bound_.Accept_[c].resize(dict_.size());
+		for (uint32_t id_ = 0; id_ < dict_.size(); ++id_) {
+			bound_.Accept_[c][id_] = TextMatches(Query, dict_.value(id_)) ? 1 : 0;
+		}
+	}
+	return bound_;
+}
+
+
+// NAME:    MatchBatch
+// PURPOSE: Sets 'Out[i]' to 1 if row 'Rows[i]' satisfies 'Bound', else to 0.
+auto static MatchBatch(const BoundPredicate& Bound, 
+					   const TagStore&       Store, 
+					   const RowId*          Rows, 
+					   size_t                Count, 
+					   uint8_t*              Out)->void {
+	const QueryPredicate& query_ = *Bound.Query_;
+	if (query_.Target_ == QueryTarget::Feature) {
+		uint32_t bit_ = 0;
+		switch (query_.Feature_) {
+			case TagFeature::Tagged: bit_ = kINDEX_HAS_TAG;   break;
+			case TagFeature::Cover:  bit_ = kINDEX_HAS_COVER; break;
+			default:                 break;
+		}
+		for (size_t i = 0; i < Count; ++i) {
+			const uint32_t flags_ = Store.flags(Rows[i]);
+			bool           match_;
+			switch (query_.Feature_) {
+				case TagFeature::Comment:
+					match_ = !Store.textView(Rows[i], TagColumn::Comment).empty();
+					break;
+				case TagFeature::Id3v23:
+					match_ = ((flags_ >> kINDEX_VERSION_SHIFT) & 0xFF) == 3;
+					break;
+				case TagFeature::Id3v24:
+					match_ = ((flags_ >> kINDEX_VERSION_SHIFT) & 0xFF) == 4;
+					break;
+				default:
+					match_ = (flags_ & bit_) != 0;
+					break;
+			}
+			Out[i] = match_ ? 1 : 0;
+		}
+	} else if (query_.Op_ == QueryOp::Range) {
+		const uint32_t low_  = query_.Low_;
+		const uint32_t high_ = query_.High_;
+		for (size_t i = 0; i < Count; ++i) {
+			const uint32_t value_ = Store.number(Rows[i], query_.Column_);
+			Out[i] = static_cast<uint8_t>((value_ >= low_) & (value_ <= high_));
+		}
+	} else {
+		std::fill(Out, Out + Count, uint8_t(0));
+		for (TagColumn column_ : ColumnsOf(query_)) {
+			const size_t c = static_cast<size_t>(column_);
+			if (Bound.Ids_[c] != nullptr) {
+				const uint32_t* ids_    = Bound.Ids_[c];
+				const uint8_t*  accept_ = Bound.Accept_[c].data();
+				for (size_t i = 0; i < Count; ++i) {
+					Out[i] |= accept_[ids_[Rows[i]]];
+				}
+			} else {
+				for (size_t i = 0; i < Count; ++i) {
+					if ((Out[i] == 0) && TextMatches(query_, Store.textView(Rows[i], column_))) {
+						Out[i] = 1;
+					}
+				}
+			}
+		}
+	}
+	
+	if (query_.Negated_) {
+		for (size_t i = 0; i < Count; ++i) {
+			Out[i] ^= 1;
+		}
+	}
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+TagQuery::TagQuery() noexcept {}
+
+
+TagQuery::~TagQuery() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    compile
+// DESCRIPTION: Parses 'Text' into the query's plan. Returns 'false' (with the 
+//              reason in 'error()', and an empty plan) if it is malformed. An 
+//              empty query selects every row.
+bool TagQuery::compile(std::string_view Text) {
+	Groups_.clear();
+	FieldMask_ = 0;
+	Error_.clear();
+	
+	bool   joinNext_ = false;
+	size_t pos_      = 0;
+	while (pos_ < Text.length()) {
+		if (std::isspace(static_cast<unsigned char>(Text[pos_]))) {
+			++pos_;
+			continue;
+		}
+		// A clause runs to the next space outside quotes:
+		size_t end_   = pos_;
+		bool   quoted_ = false;
+		while ((end_ < Text.length()) 
+			   && (quoted_ || !std::isspace(static_cast<unsigned char>(Text[end_])))) {
+			quoted_ ^= (Text[end_] == '"');
+			++end_;
+		}
+		if (quoted_) {
+			return fail("unterminated quote in '" + std::string(Text.substr(pos_)) + "'");
+		}
+		const std::string_view clause_ = Text.substr(pos_, end_ - pos_);
+		pos_ = end_;
+		
+		if (clause_ == "OR") {
+			if (Groups_.empty() || joinNext_) {
+				return fail("'OR' needs a clause on each side");
+			}
+			joinNext_ = true;
+			continue;
+		}
+		QueryPredicate predicate_;
+		if (!parseClause(clause_, predicate_)) {
+			return false;
+		}
+		if (joinNext_) {
+			Groups_.back().push_back(std::move(predicate_));
+		} else {
+			Groups_.push_back({ std::move(predicate_) });
+		}
+		joinNext_ = false;
+	}
+	if (joinNext_) {
+		return fail("'OR' needs a clause on each side");
+	}
+	
+	for (const auto& group_ : Groups_) {
+		for (const QueryPredicate& predicate_ : group_) {
+			for (TagColumn column_ : ColumnsOf(predicate_)) {
+				FieldMask_ |= uint32_t(1) << static_cast<unsigned>(column_);
+			}
+		}
+	}
+	auto cost_ = [](const std::vector<QueryPredicate>& Group) {
+		size_t total_ = 0;
+		for (const QueryPredicate& predicate_ : Group) {
+			total_ += CostOf(predicate_);
+		}
+		return total_;
+	};
+	std::stable_sort(Groups_.begin(), Groups_.end(), 
+					 [&cost_](const auto& a_, const auto& b_) {
+						 return cost_(a_) < cost_(b_);
+					 });
+	return true;
+}
+
+
+const std::string& TagQuery::error() const noexcept {
+	return Error_;
+}
+
+
+// FUNCTION:    fieldMask
+// DESCRIPTION: Returns one bit per 'TagColumn' (as for 'ReadTagEntry()') that 
+//              the query reads; fields outside it need not be decoded.
+uint32_t TagQuery::fieldMask() const noexcept {
+	return FieldMask_;
+}
+
+
+bool TagQuery::empty() const noexcept {
+	return Groups_.empty();
+}
+
+
+// FUNCTION:    select
+// DESCRIPTION: Returns the rows of 'Store' that satisfy the query, ascending.
+std::vector<RowId> TagQuery::select(const TagStore& Store) const {
+	std::vector<std::vector<BoundPredicate>> plan_;
+	plan_.reserve(Groups_.size());
+	for (const auto& group_ : Groups_) {
+		plan_.emplace_back();
+		for (const QueryPredicate& predicate_ : group_) {
+			plan_.back().push_back(Bind(predicate_, Store));
+		}
+	}
+	
+	std::vector<RowId>   out_;
+	std::vector<RowId>   rows_(kQUERY_BATCH);
+	std::vector<uint8_t> match_(kQUERY_BATCH);
+	std::vector<uint8_t> other_(kQUERY_BATCH);
+	const RowId          total_ = static_cast<RowId>(Store.size());
+	for (RowId start_ = 0; start_ < total_; start_ += static_cast<RowId>(kQUERY_BATCH)) {
+		size_t count_ = std::min<size_t>(kQUERY_BATCH, total_ - start_);
+		for (size_t i = 0; i < count_; ++i) {
+			rows_[i] = start_ + static_cast<RowId>(i);
+		}
+		
+		for (size_t g = 0; (g < plan_.size()) && (count_ != 0); ++g) {
+			MatchBatch(plan_[g][0], Store, rows_.data(), count_, match_.data());
+			for (size_t p = 1; p < plan_[g].size(); ++p) {
+				MatchBatch(plan_[g][p], Store, rows_.data(), count_, other_.data());
+				for (size_t i = 0; i < count_; ++i) {
+					match_[i] |= other_[i];
+				}
+			}
+			// Keep the matching rows, without a branch per row:
+			size_t kept_ = 0;
+			for (size_t i = 0; i < count_; ++i) {
+				rows_[kept_]  = rows_[i];
+				kept_        += match_[i];
+			}
+			count_ = kept_;
+		}
+		out_.insert(out_.end(), rows_.begin(), rows_.begin() + count_);
+	}
+	return out_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    parseClause
+// DESCRIPTION: Parses one clause (see the class comment) into 'Out'.
+bool TagQuery::parseClause(std::string_view Clause, QueryPredicate& Out) {
+	if ((Clause.length() > 1) && (Clause[0] == '-')) {
+		Out.Negated_ = true;
+		Clause.remove_prefix(1);
+	}
+	
+	// A colon inside quotes is part of the text:
+	const size_t quote_ = Clause.find('"');
+	const size_t colon_ = Clause.find(':');
+	if ((colon_ == std::string_view::npos) || (colon_ > quote_)) {
+		Out.Target_ = QueryTarget::AnyText;
+		Out.Text_   = std::string(Unquote(Clause));
+		if (Out.Text_.empty()) {
+			return fail("empty search text");
+		}
+		return true;
+	}
+	
+	const std::string      key_   = std::string(Clause.substr(0, colon_));
+	const std::string_view value_ = Clause.substr(colon_ + 1);
+	if (value_.empty()) {
+		return fail("missing value after '" + key_ + ":'");
+	}
+	
+	if (EqualsIgnoreCase(key_, "has")) {
+		const std::string_view what_ = Unquote(value_);
+		Out.Target_ = QueryTarget::Feature;
+		if (EqualsIgnoreCase(what_, "cover") || EqualsIgnoreCase(what_, "picture")) {
+			Out.Feature_ = TagFeature::Cover;
+		} else if (EqualsIgnoreCase(what_, "comment")) {
+			Out.Feature_ = TagFeature::Comment;
+		} else if (EqualsIgnoreCase(what_, "tag")) {
+			Out.Feature_ = TagFeature::Tagged;
+		} else if (EqualsIgnoreCase(what_, "v2.3") || EqualsIgnoreCase(what_, "id3v2.3")) {
+			Out.Feature_ = TagFeature::Id3v23;
+		} else if (EqualsIgnoreCase(what_, "v2.4") || EqualsIgnoreCase(what_, "id3v2.4")) {
+			Out.Feature_ = TagFeature::Id3v24;
+		} else {
+			// 'has:FIELD' is '-FIELD:=""':
+			const TagField* field_ = FindTagField(std::string(what_));
+			if (field_ == nullptr) {
+				return fail("unknown feature '" + std::string(what_)
+							+ "' (try cover, comment, tag, v2.3, v2.4 or a field name)");
+			}
+			Out.Target_  = QueryTarget::Field;
+			Out.Column_  = static_cast<TagColumn>(field_ - GetTagFields().data());
+			Out.Op_      = (TagStore::columnKind(Out.Column_) == TagColumnKind::Number) 
+						   ? QueryOp::Range : QueryOp::Equals;
+			Out.Low_     = 1;
+			Out.High_    = UINT32_MAX;
+			Out.Negated_ = (Out.Op_ == QueryOp::Equals) ? !Out.Negated_ : Out.Negated_;
+		}
+		return true;
+	}
+	
+	const TagField* field_ = FindTagField(key_);
+	if (field_ == nullptr) {
+		return fail("unknown field '" + key_ + "'");
+	}
+	Out.Target_ = QueryTarget::Field;
+	Out.Column_ = static_cast<TagColumn>(field_ - GetTagFields().data());
+	
+	if (TagStore::columnKind(Out.Column_) == TagColumnKind::Number) {
+		std::string_view number_ = Unquote(value_);
+		Out.Op_   = QueryOp::Range;
+		Out.Low_  = 0;
+		Out.High_ = UINT32_MAX;
+		uint32_t     n_     = 0;
+		const size_t dots_  = number_.find("..");
+		bool         valid_ = true;
+		if (dots_ != std::string_view::npos) {
+			valid_ = ParseNumber(number_.substr(0, dots_), Out.Low_) 
+					 && ParseNumber(number_.substr(dots_ + 2), Out.High_);
+		} else if (number_.substr(0, 2) == ">=") {
+			valid_ = ParseNumber(number_.substr(2), Out.Low_);
+		} else if (number_.substr(0, 2) == "<=") {
+			valid_ = ParseNumber(number_.substr(2), Out.High_);
+		} else if (number_[0] == '>') {
+			valid_    = ParseNumber(number_.substr(1), n_);
+			Out.Low_  = n_ + 1;
+		} else if (number_[0] == '<') {
+			valid_    = ParseNumber(number_.substr(1), n_) && (n_ > 0);
+			Out.High_ = n_ - 1;
+		} else {
+			number_.remove_prefix((number_[0] == '=') ? 1 : 0);
+			valid_    = ParseNumber(number_, n_);
+			Out.Low_  = n_;
+			Out.High_ = n_;
+		}
+		if (!valid_) {
+			return fail(key_ + ": expected N, >N, >=N, <N, <=N or N..M, got '"
+						+ std::string(value_) + "'");
+		}
+		return true;
+	}
+	
+	std::string_view text_ = value_;
+	Out.Op_ = QueryOp::Contains;
+	if (text_[0] == '=') {
+		Out.Op_ = QueryOp::Equals;
+		text_.remove_prefix(1);
+	}
+	Out.Text_ = std::string(Unquote(text_));
+	if (Out.Text_.empty()) {
+		Out.Op_ = QueryOp::Equals; // 'field:""' is an empty field
+	}
+	return true;
+}
+
+
+// FUNCTION:    fail
+// DESCRIPTION: Records 'Message' as the error, drops the plan, and returns 
+//              'false'.
+bool TagQuery::fail(const std::string& Message) {
+	Error_ = Message;
+	Groups_.clear();
+	FieldMask_ = 0;
+	return false;
+}
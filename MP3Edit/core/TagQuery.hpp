@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagQuery.hpp
+// FILE PURPOSE:  Declares the class 'TagQuery', a small query language for 
+//                selecting files by their tags, e.g. 
+//                    artist:"Miles Davis" year:>=1959 -genre:Fusion has:cover 
+//                A query is compiled once into a plan and then run over the 
+//                rows of a 'TagStore'.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <string>
+#include <string_view>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "FacetIndex.hpp"
+#include "TagStore.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+enum class QueryTarget : uint8_t {
+	Field,    // One column
+	AnyText,  // Title, artist, album or comment (a bare word)
+	Feature   // 'has:cover', 'has:v2.4', ...
+};
+
+enum class QueryOp : uint8_t {
+	Contains, // Text, ignoring ASCII case
+	Equals,   // Whole text, ignoring ASCII case ('field:=value')
+	Range     // Number in ['Low_', 'High_']
+};
+
+struct QueryPredicate {
+	QueryTarget Target_  = QueryTarget::Field;
+	TagColumn   Column_  = TagColumn::Title;
+	TagFeature  Feature_ = TagFeature::Tagged;
+	QueryOp     Op_      = QueryOp::Contains;
+	bool        Negated_ = false;
+	std::string Text_;
+	uint32_t    Low_     = 0;
+	uint32_t    High_    = 0;
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// Clauses are separated by spaces and must all hold; 'OR' between two clauses 
+// makes either enough, and a leading '-' negates a clause:
+// 
+//   word, "two words"        in the title, artist, album or comment 
+//   field:text               field contains the text ("quotes" allowed) 
+//   field:=text              field is exactly the text 
+//   field:N, :>N, :>=N,      for track, year and disc 
+//   :<N, :<=N, :N..M 
+//   has:field                field is not empty 
+//   has:cover|comment|tag|v2.3|v2.4
+class TagQuery {
+
+	private:
+		// AND of ORs, cheapest group first:
+		std::vector<std::vector<QueryPredicate>> Groups_;
+		uint32_t                                 FieldMask_ = 0;
+		std::string                              Error_;
+	
+	public:
+		TagQuery() noexcept;
+		~TagQuery() noexcept;
+		
+		bool               compile(std::string_view Text);
+		const std::string& error() const noexcept;
+		uint32_t           fieldMask() const noexcept;
+		bool               empty() const noexcept;
+		
+		std::vector<RowId> select(const TagStore& Store) const;
+	
+	private:
+		bool               parseClause(std::string_view Clause, QueryPredicate& Out);
+		bool               fail(const std::string& Message);
+
+};
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagService.cpp
+// FILE PURPOSE:  Defines the class 'TagService'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <unordered_set>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <sys/stat.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagService.hpp"
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    IsRegularFile
+// PURPOSE: Tests whether 'Path' names a regular file (following links).
+auto static IsRegularFile(const std::string& Path)->bool {
+	struct stat st_;
+	return (::stat(Path.c_str(), &st_) == 0) && S_ISREG(st_.st_mode);
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+TagService::TagService() noexcept {
+	Options_.CreateMissingTags_ = true;
+}
+
+
+TagService::TagService(BatchOptions Options) noexcept : Options_(std::move(Options)) {}
+
+
+TagService::~TagService() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    read
+// DESCRIPTION: Returns the tags of 'Path', with any edits not yet written, 
+//              parsing the file only if it changed since it was last read. 
+//              Returns 'nullptr' if it is not a regular file. The pointer is 
+//              valid until the next call to any non-const member function.
+const IndexEntry* TagService::read(const std::string& Path) {
+	FileKey key_;
+	if (!GetFileKey(Path, key_)) {
+		Files_.erase(Path);
+		return nullptr;
+	}
+	auto found_ = Files_.find(Path);
+	if ((found_ != Files_.end()) && SameFileKey(found_->second.Key_, key_)) {
+		++Stats_.CacheHits_;
+		return &found_->second.Entry_;
+	}
+	if (!IsRegularFile(Path)) {
+		return nullptr;
+	}
+	
+	++Stats_.CacheMisses_;
+	CachedFile& file_ = Files_[Path];
+	IndexEntry  entry_;
+	entry_.Path_    = Path;
+	entry_.Device_  = key_.Device_;
+	entry_.Inode_   = key_.Inode_;
+	entry_.Size_    = key_.Size_;
+	entry_.MtimeNs_ = key_.MtimeNs_;
+	ReadTagEntry(entry_);
+	// Edits not yet written still win over what another program saved:
+	for (size_t f = 0; f < kINDEX_FIELD_COUNT; ++f) {
+		if (file_.Pending_ & (uint32_t(1) << f)) {
+			entry_.Fields_[f] = std::move(file_.Entry_.Fields_[f]);
+		}
+	}
+	file_.Key_   = key_;
+	file_.Entry_ = std::move(entry_);
+	return &file_.Entry_;
+}
+
+
+// FUNCTION:    edit
+// DESCRIPTION: Applies 'Edits' to the cached tags of 'Path' and queues the 
+//              file for the next 'flush()'. Returns 'false' (changing nothing) 
+//              if it is not a regular file.
+bool TagService::edit(const std::string& Path, const std::vector<FieldEdit>& Edits) {
+	if (read(Path) == nullptr) {
+		return false;
+	}
+	CachedFile&                  file_   = Files_[Path];
+	const std::vector<TagField>& fields_ = GetTagFields();
+	if (file_.Pending_ == 0) {
+		Dirty_.push_back(Path);
+	}
+	for (const FieldEdit& edit_ : Edits) {
+		const size_t   f    = static_cast<size_t>(edit_.Field_ - fields_.data());
+		const uint32_t bit_ = uint32_t(1) << f;
+		if (file_.Pending_ & bit_) {
+			++Stats_.EditsMerged_;
+		}
+		file_.Pending_         |= bit_;
+		file_.Entry_.Fields_[f] = edit_.Value_;
+	}
+	return true;
+}
+
+
+// FUNCTION:    flush
+// DESCRIPTION: Writes every file with pending edits (in parallel, through 
+//              'BatchEngine'), once each, and returns those that could not be 
+//              written. Those are dropped from the cache, so they are read 
+//              afresh; the rest are re-read so the cache matches the disk.
+std::vector<std::string> TagService::flush() {
+	if (Dirty_.empty()) {
+		return {};
+	}
+	// A file that vanished since it was edited has left the cache; it counts
+	// as failed:
+	std::vector<std::string> dirty_;
+	std::vector<std::string> gone_;
+	for (std::string& path_ : Dirty_) {
+		auto found_ = Files_.find(path_);
+		if ((found_ != Files_.end()) && (found_->second.Pending_ != 0)) {
+			dirty_.push_back(std::move(path_));
+		} else {
+			gone_.push_back(std::move(path_));
+		}
+	}
+	Dirty_.clear();
+	
+	// Workers only read the cache, which nothing changes during the run:
+	const std::vector<TagField>& fields_ = GetTagFields();
+	BatchEngine                  engine_(Options_);
+	BatchResult result_ = engine_.run(
+		dirty_, 
+		[this, &fields_](const std::string& Filename, ID3v2_tag* Tag) {
+			const CachedFile& file_    = Files_.at(Filename);
+			bool              changed_ = false;
+			for (size_t f = 0; f < kINDEX_FIELD_COUNT; ++f) {
+				if ((file_.Pending_ & (uint32_t(1) << f)) 
+					&& (GetTagFieldText(Tag, fields_[f]) != file_.Entry_.Fields_[f])) {
+					SetTagFieldText(Tag, fields_[f], file_.Entry_.Fields_[f]);
+					changed_ = true;
+				}
+			}
+			return changed_;
+		});
+	Stats_.FilesWritten_ += result_.FilesModified_;
+	
+	const std::unordered_set<std::string> failed_(result_.FailedFiles_.begin(), 
+												  result_.FailedFiles_.end());
+	for (const std::string& path_ : dirty_) {
+		if (failed_.count(path_) != 0) {
+			Files_.erase(path_);
+			continue;
+		}
+		CachedFile& file_ = Files_.at(path_);
+		file_.Pending_    = 0;
+		file_.Key_        = FileKey();
+		read(path_);
+	}
+	gone_.insert(gone_.end(), result_.FailedFiles_.begin(), result_.FailedFiles_.end());
+	return gone_;
+}
+
+
+bool TagService::hasPending() const noexcept {
+	return !Dirty_.empty();
+}
+
+
+// FUNCTION:    size
+// DESCRIPTION: Returns the number of files in the cache.
+size_t TagService::size() const noexcept {
+	return Files_.size();
+}
+
+
+const TagServiceStats& TagService::stats() const noexcept {
+	return Stats_;
+}
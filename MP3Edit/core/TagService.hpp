@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagService.hpp
+// FILE PURPOSE:  Declares the class 'TagService', which keeps the parsed tags 
+//                of many files in memory for repeated reads, and merges the 
+//                edits made to each file so that it is written only once.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "BatchEngine.hpp"
+#include "TagFields.hpp"
+#include "TagIndex.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct FieldEdit {
+	const TagField* Field_;
+	std::string     Value_;
+};
+
+struct TagServiceStats {
+	size_t CacheHits_    = 0; // Reads answered without opening the file
+	size_t CacheMisses_  = 0; // Reads that (re-)parsed the tag
+	size_t FilesWritten_ = 0;
+	size_t EditsMerged_  = 0; // Edits that replaced one not yet written
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// A cached file is trusted for as long as its key (device, inode, size, mtime) 
+// is unchanged. Edits take effect in the cache at once, so later reads see 
+// them, and reach the file at the next 'flush()', in the order they were made; 
+// any number of edits to one file between flushes cost one write. Not
+// thread-safe: one thread owns the service.
+class TagService {
+
+	private:
+		struct CachedFile {
+			FileKey    Key_;
+			IndexEntry Entry_;
+			uint32_t   Pending_ = 0; // Bits of fields edited but not yet written
+		};
+		
+		BatchOptions                                Options_;
+		std::unordered_map<std::string, CachedFile> Files_;
+		std::vector<std::string>                    Dirty_; // In order of first edit
+		TagServiceStats                             Stats_;
+	
+	public:
+		TagService() noexcept;
+		explicit TagService(BatchOptions Options) noexcept;
+		~TagService() noexcept;
+		
+		TagService(const TagService&)            = delete;
+		TagService& operator=(const TagService&) = delete;
+		
+		const IndexEntry*      read(const std::string& Path);
+		bool                   edit(const std::string&            Path, 
+									const std::vector<FieldEdit>& Edits);
+		std::vector<std::string> flush();
+		bool                   hasPending() const noexcept;
+		size_t                 size() const noexcept;
+		const TagServiceStats& stats() const noexcept;
+
+};
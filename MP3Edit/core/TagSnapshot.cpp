@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagSnapshot.cpp
+// FILE PURPOSE:  Defines the class 'TagSnapshot'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagSnapshot.hpp"
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+TagSnapshot::TagSnapshot() noexcept {}
+
+
+TagSnapshot::~TagSnapshot() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    open
+// DESCRIPTION: Maps the index published as 'Filename'. Returns 'false' if it 
+//              cannot be read, leaving no snapshot current.
+bool TagSnapshot::open(const std::string& Filename) {
+	std::lock_guard<std::mutex> lock_(RefreshLock_);
+	Filename_ = Filename;
+	std::atomic_store(&Current_, std::shared_ptr<const TagIndex>());
+	return load(true);
+}
+
+
+// FUNCTION:    refresh
+// DESCRIPTION: Swaps in the published index if it has been replaced since it 
+//              was last mapped. Returns 'true' if a new snapshot is now 
+//              current. Returns at once if another thread is already 
+//              refreshing.
+bool TagSnapshot::refresh() {
+	std::unique_lock<std::mutex> lock_(RefreshLock_, std::try_to_lock);
+	if (!lock_.owns_lock() || Filename_.empty()) {
+		return false;
+	}
+	return load(false);
+}
+
+
+// FUNCTION:    current
+// DESCRIPTION: Returns the current snapshot (null if none could be mapped). 
+//              It stays mapped, and unchanged, for as long as it is held.
+std::shared_ptr<const TagIndex> TagSnapshot::current() const noexcept {
+	return std::atomic_load(&Current_);
+}
+
+
+// FUNCTION:    publish
+// DESCRIPTION: Writes 'Entries' (sorted in place) as the index 'Filename', 
+//              atomically replacing any earlier one (see 'TagIndex::write()').
+bool TagSnapshot::publish(const std::string& Filename, std::vector<IndexEntry>& Entries) {
+	return TagIndex::write(Filename, Entries);
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    load
+// DESCRIPTION: Maps the file unless 'Force' is false and it is the one already 
+//              mapped. Must be called with 'RefreshLock_' held.
+bool TagSnapshot::load(bool Force) {
+	// The key is taken before the file is opened, so if another version is 
+	// renamed into place in between, the next refresh maps it (again):
+	FileKey key_;
+	if (!GetFileKey(Filename_, key_)) {
+		return false;
+	}
+	if (!Force && SameFileKey(key_, CurrentKey_)) {
+		return false;
+	}
+	auto index_ = std::make_shared<TagIndex>();
+	if (!index_->open(Filename_)) {
+		return false;
+	}
+	CurrentKey_ = key_;
+	std::atomic_store(&Current_, std::shared_ptr<const TagIndex>(std::move(index_)));
+	return true;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagSnapshot.hpp
+// FILE PURPOSE:  Declares the class 'TagSnapshot', which shares one published 
+//                'TagIndex' file among any number of readers and processes, 
+//                and moves them onto a newer one without stopping them.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagIndex.hpp"
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// A published index file is never changed in place: 'publish()' writes a new 
+// file beside it and renames it over the old one, so every process that maps 
+// the file shares its pages, and one that still has the old file mapped keeps 
+// a consistent (if dated) view. Within a process, 'current()' hands out the 
+// mapped snapshot; 'refresh()' maps a newly published file and swaps it in, 
+// and the old mapping goes away when its last reader lets go of it.
+class TagSnapshot {
+
+	private:
+		std::string                     Filename_;
+		std::shared_ptr<const TagIndex> Current_;     // Swapped atomically
+		FileKey                         CurrentKey_;  // Guarded by 'RefreshLock_'
+		std::mutex                      RefreshLock_; // Never taken by readers
+	
+	public:
+		TagSnapshot() noexcept;
+		~TagSnapshot() noexcept;
+		
+		TagSnapshot(const TagSnapshot&)            = delete;
+		TagSnapshot& operator=(const TagSnapshot&) = delete;
+		
+		bool                            open(const std::string& Filename);
+		bool                            refresh();
+		std::shared_ptr<const TagIndex> current() const noexcept;
+		
+		static bool                     publish(const std::string&       Filename, 
+												std::vector<IndexEntry>& Entries);
+	
+	private:
+		bool                            load(bool Force);
+
+};
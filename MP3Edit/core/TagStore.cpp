@@ -0,0 +1,708 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagStore.cpp
+// FILE PURPOSE:  Defines the classes 'StringArena', 'StringDictionary' and 
+//                'TagStore'. Columns whose values repeat across a library 
+//                (artist, album, ...) hold 32-bit ids into a per-column 
+//                dictionary, so a filter tests each distinct value once and 
+//                then scans a flat array of ids; numeric fields are packed 
+//                integers; only title and comment keep a string per row.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cctype>
+#include <cstring>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagStore.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const size_t kARENA_BLOCK_SIZE = 1 << 20;
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    FormatTagNumber
+// PURPOSE: Turns a packed 'number << 16 | total' back into "N/T", "N" or "".
+auto static FormatTagNumber(uint32_t Packed)->std::string {
+	const uint32_t number_ = Packed >> 16;
+	const uint32_t total_  = Packed & 0xFFFF;
+	if (number_ == 0) {
+		return std::string();
+	}
+	std::string out_ = std::to_string(number_);
+	if (total_ != 0) {
+		out_ += '/';
+		out_ += std::to_string(total_);
+	}
+	return out_;
+}
+
+
+// NAME:    BitWidth
+// PURPOSE: Returns the number of bits needed to hold 'Value'.
+auto static BitWidth(uint32_t Value)->unsigned {
+	unsigned bits_ = 0;
+	while (Value != 0) {
+		++bits_;
+		Value >>= 1;
+	}
+	return bits_;
+}
+
+
+// NAME:    RadixSortRows
+// PURPOSE: Sorts 'Rows' by 'Keys' (one per row, of which only the low 'Bits' 
+//          are used) with a stable LSD radix sort, one byte per pass. A pass 
+//          in which every key has the same byte is skipped.
+auto static RadixSortRows(std::vector<uint64_t>& Keys, 
+						  std::vector<RowId>&    Rows, 
+						  unsigned               Bits)->void {
+	const unsigned passes_ = (Bits + 7) / 8;
+	
+	// Count every pass's digits in one sweep over the keys:
+	std::vector<std::array<size_t, 256>> counts_(passes_);
+	for (auto& pass_ : counts_) {
+		pass_.fill(0);
+	}
+	for (uint64_t key_ : Keys) {
+		for (unsigned p = 0; p < passes_; ++p) {
+			++counts_[p][(key_ >> (p * 8)) & 0xFF];
+		}
+	}
+	
+	std::vector<uint64_t> keysTmp_(Keys.size());
+	std::vector<RowId>    rowsTmp_(Rows.size());
+	for (unsigned p = 0; p < passes_; ++p) {
+		std::array<size_t, 256>& count_ = counts_[p];
+		if (*std::max_element(count_.begin(), count_.end()) == Keys.size()) {
+			continue;
+		}
+		size_t sum_ = 0;
+		for (size_t& slot_ : count_) {
+			const size_t n_ = slot_;
+			slot_  = sum_;
+			sum_  += n_;
+		}
+		const unsigned shift_ = p * 8;
+		for (size_t i = 0; i < Keys.size(); ++i) {
+			const size_t at_ = count_[(Keys[i] >> shift_) & 0xFF]++;
+			keysTmp_[at_] = Keys[i];
+			rowsTmp_[at_] = Rows[i];
+		}
+		Keys.swap(keysTmp_);
+		Rows.swap(rowsTmp_);
+	}
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  StringArena  --------  */
+// FUNCTION:    add
+// DESCRIPTION: Copies 'Str' into the arena and returns a view of the copy. 
+//              Strings larger than a block get a block of their own.
+std::string_view StringArena::add(std::string_view Str) {
+	if (Str.empty()) {
+		return std::string_view();
+	}
+	if ((Used_ + Str.length()) > Capacity_) {
+		const size_t size_ = std::max(kARENA_BLOCK_SIZE, Str.length());
+		Blocks_.emplace_back(new char[size_]);
+		Used_       = 0;
+		Capacity_   = size_;
+		Allocated_ += size_;
+	}
+	char* dest_ = Blocks_.back().get() + Used_;
+	std::memcpy(dest_, Str.data(), Str.length());
+	Used_ += Str.length();
+	return std::string_view(dest_, Str.length());
+}
+
+
+size_t StringArena::bytes() const noexcept {
+	return Allocated_;
+}
+
+
+void StringArena::clear() noexcept {
+	Blocks_.clear();
+	Used_      = 0;
+	Capacity_  = 0;
+	Allocated_ = 0;
+}
+
+
+/*  --------  StringDictionary  --------  */
+// FUNCTION:    intern
+// DESCRIPTION: Returns the id of 'Str', adding it (copied into 'Strings', 
+//              which must outlive the dictionary's use) if it is new.
+uint32_t StringDictionary::intern(std::string_view Str, StringArena& Strings) {
+	if (Str.empty()) {
+		return 0;
+	}
+	const auto at_ = Ids_.find(Str);
+	if (at_ != Ids_.end()) {
+		return at_->second;
+	}
+	const uint32_t         id_    = static_cast<uint32_t>(Values_.size());
+	const std::string_view copy_  = Strings.add(Str);
+	Values_.push_back(copy_);
+	Ids_.emplace(copy_, id_);
+	Ranks_.clear();
+	return id_;
+}
+
+
+// FUNCTION:    find
+// DESCRIPTION: Returns the id of 'Str', or 'TagStore::kNOT_FOUND' if no row 
+//              holds it.
+uint32_t StringDictionary::find(std::string_view Str) const {
+	if (Str.empty()) {
+		return 0;
+	}
+	const auto at_ = Ids_.find(Str);
+	return (at_ != Ids_.end()) ? at_->second : TagStore::kNOT_FOUND;
+}
+
+
+std::string_view StringDictionary::value(uint32_t Id) const noexcept {
+	return (Id < Values_.size()) ? Values_[Id] : std::string_view();
+}
+
+
+size_t StringDictionary::size() const noexcept {
+	return Values_.size();
+}
+
+
+void StringDictionary::clear() noexcept {
+	Ids_.clear();
+	Ranks_.clear();
+	Values_.assign(1, std::string_view());
+}
+
+
+// FUNCTION:    sortRanks
+// DESCRIPTION: Returns, for every id, the position of its value in sorted 
+//              order, so that rows can be sorted by comparing two integers 
+//              instead of two strings. The ranks are worked out on first use 
+//              and kept until the next new value is interned.
+const std::vector<uint32_t>& StringDictionary::sortRanks() const {
+	std::lock_guard<std::mutex> lock_(RanksLock_);
+	if (Ranks_.size() == Values_.size()) {
+		return Ranks_;
+	}
+	
+	std::vector<uint32_t> order_(Values_.size());
+	std::iota(order_.begin(), order_.end(), 0);
+	std::sort(order_.begin(), order_.end(), [this](uint32_t a_, uint32_t b_) {
+		return Values_[a_] < Values_[b_];
+	});
+	Ranks_.resize(Values_.size());
+	for (uint32_t i = 0; i < order_.size(); ++i) {
+		Ranks_[order_[i]] = i;
+	}
+	return Ranks_;
+}
+
+
+/*  --------  TagStore: CONSTRUCTORS AND DESTRUCTOR  --------  */
+TagStore::TagStore() noexcept {}
+
+
+TagStore::~TagStore() noexcept {}
+
+
+/*  --------  TagStore: PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    add
+// DESCRIPTION: Appends a row for the file 'Path', whose fields are given in 
+//              'GetTagFields()' order and whose tag features are 'Flags' (as 
+//              in 'IndexRecord::Flags_'). Returns the new row's id.
+RowId TagStore::add(std::string_view Path, const FieldView& Fields, uint32_t Flags) {
+	const RowId row_ = static_cast<RowId>(Paths_.size());
+	Paths_.push_back(TextArena_.add(Path));
+	Flags_.push_back(Flags);
+	for (size_t c = 0; c < kINDEX_FIELD_COUNT; ++c) {
+		const TagColumn column_ = static_cast<TagColumn>(c);
+		switch (columnKind(column_)) {
+			case TagColumnKind::Text:
+				Text_[slot(column_)].push_back(TextArena_.add(Fields[c]));
+				break;
+			case TagColumnKind::Dictionary:
+				DictIds_[slot(column_)].push_back(
+					Dicts_[slot(column_)].intern(Fields[c], TextArena_));
+				break;
+			case TagColumnKind::Number:
+				if (column_ == TagColumn::Year) {
+					Years_.push_back(static_cast<uint16_t>(
+						ParseTagNumber(Fields[c]) >> 16));
+				} else if (column_ == TagColumn::Track) {
+					Tracks_.push_back(ParseTagNumber(Fields[c]));
+				} else {
+					Discs_.push_back(ParseTagNumber(Fields[c]));
+				}
+				break;
+		}
+	}
+	return row_;
+}
+
+
+RowId TagStore::add(const IndexEntry& Entry) {
+	FieldView fields_;
+	for (size_t c = 0; c < kINDEX_FIELD_COUNT; ++c) {
+		fields_[c] = Entry.Fields_[c];
+	}
+	return add(Entry.Path_, fields_, GetIndexFlags(Entry));
+}
+
+
+// FUNCTION:    load
+// DESCRIPTION: Replaces the contents of the store with the rows of 'Index', 
+//              reading the strings straight out of the mapped file.
+void TagStore::load(const TagIndex& Index) {
+	clear();
+	reserve(Index.size());
+	FieldView fields_;
+	for (size_t i = 0; i < Index.size(); ++i) {
+		for (size_t c = 0; c < kINDEX_FIELD_COUNT; ++c) {
+			fields_[c] = Index.field(i, c);
+		}
+		add(Index.path(i), fields_, Index.record(i).Flags_);
+	}
+}
+
+
+void TagStore::clear() noexcept {
+	TextArena_.clear();
+	Paths_.clear();
+	for (auto& column_ : Text_) {
+		column_.clear();
+	}
+	for (auto& dict_ : Dicts_) {
+		dict_.clear();
+	}
+	for (auto& column_ : DictIds_) {
+		column_.clear();
+	}
+	Years_.clear();
+	Tracks_.clear();
+	Discs_.clear();
+	Flags_.clear();
+}
+
+
+void TagStore::reserve(size_t Rows) {
+	Paths_.reserve(Rows);
+	for (auto& column_ : Text_) {
+		column_.reserve(Rows);
+	}
+	for (auto& column_ : DictIds_) {
+		column_.reserve(Rows);
+	}
+	Years_.reserve(Rows);
+	Tracks_.reserve(Rows);
+	Discs_.reserve(Rows);
+	Flags_.reserve(Rows);
+}
+
+
+size_t TagStore::size() const noexcept {
+	return Paths_.size();
+}
+
+
+// FUNCTION:    memoryUsage
+// DESCRIPTION: Returns roughly how many bytes the columns and arenas take 
+//              (the dictionaries' hash tables are not counted).
+size_t TagStore::memoryUsage() const noexcept {
+	size_t bytes_ = TextArena_.bytes()
+					+ (Paths_.capacity() * sizeof(std::string_view))
+					+ (Years_.capacity() * sizeof(uint16_t))
+					+ ((Tracks_.capacity() + Discs_.capacity() + Flags_.capacity()) 
+					   * sizeof(uint32_t));
+	for (const auto& column_ : Text_) {
+		bytes_ += column_.capacity() * sizeof(std::string_view);
+	}
+	for (const auto& column_ : DictIds_) {
+		bytes_ += column_.capacity() * sizeof(uint32_t);
+	}
+	for (const auto& dict_ : Dicts_) {
+		bytes_ += dict_.size() * sizeof(std::string_view);
+	}
+	return bytes_;
+}
+
+
+std::string_view TagStore::path(RowId Row) const noexcept {
+	return Paths_[Row];
+}
+
+
+// FUNCTION:    text
+// DESCRIPTION: Returns the value of 'Column' in 'Row' as text. Numbers come 
+//              back normalized ("07/12" as "7/12").
+std::string TagStore::text(RowId Row, TagColumn Column) const {
+	switch (columnKind(Column)) {
+		case TagColumnKind::Text:
+			return std::string(Text_[slot(Column)][Row]);
+		case TagColumnKind::Dictionary:
+			return std::string(
+				Dicts_[slot(Column)].value(DictIds_[slot(Column)][Row]));
+		case TagColumnKind::Number:
+			if (Column == TagColumn::Year) {
+				return (Years_[Row] != 0) ? std::to_string(Years_[Row]) 
+										  : std::string();
+			}
+			return FormatTagNumber((Column == TagColumn::Track) ? Tracks_[Row] 
+																 : Discs_[Row]);
+	}
+	return std::string();
+}
+
+
+// FUNCTION:    number
+// DESCRIPTION: Returns the year, track number or disc number of 'Row' (0 if 
+//              unset), or 0 for any other column.
+uint32_t TagStore::number(RowId Row, TagColumn Column) const noexcept {
+	switch (Column) {
+		case TagColumn::Year:
+			return Years_[Row];
+		case TagColumn::Track:
+			return Tracks_[Row] >> 16;
+		case TagColumn::Disc:
+			return Discs_[Row] >> 16;
+		default:
+			return 0;
+	}
+}
+
+
+// FUNCTION:    textView
+// DESCRIPTION: Returns the value of a 'Text' or 'Dictionary' column in 'Row' 
+//              without copying it (empty for a 'Number' column).
+std::string_view TagStore::textView(RowId Row, TagColumn Column) const noexcept {
+	switch (columnKind(Column)) {
+		case TagColumnKind::Text:
+			return Text_[slot(Column)][Row];
+		case TagColumnKind::Dictionary:
+			return Dicts_[slot(Column)].value(DictIds_[slot(Column)][Row]);
+		default:
+			return std::string_view();
+	}
+}
+
+
+uint32_t TagStore::dictionaryId(RowId Row, TagColumn Column) const noexcept {
+	return (columnKind(Column) == TagColumnKind::Dictionary) 
+		   ? DictIds_[slot(Column)][Row] : 0;
+}
+
+
+// FUNCTION:    dictionaryColumn
+// DESCRIPTION: Returns the dictionary ids of every row of a 'Dictionary' 
+//              column, for predicates evaluated over many rows at once; 
+//              'nullptr' for other columns.
+const uint32_t* TagStore::dictionaryColumn(TagColumn Column) const noexcept {
+	return (columnKind(Column) == TagColumnKind::Dictionary) 
+		   ? DictIds_[slot(Column)].data() : nullptr;
+}
+
+
+// FUNCTION:    flags
+// DESCRIPTION: Returns the tag features of 'Row' ('kINDEX_HAS_*' bits and the 
+//              ID3v2 version, as in 'IndexRecord::Flags_').
+uint32_t TagStore::flags(RowId Row) const noexcept {
+	return Flags_[Row];
+}
+
+
+// FUNCTION:    dictionary
+// DESCRIPTION: Returns the dictionary of a 'Dictionary' column.
+const StringDictionary& TagStore::dictionary(TagColumn Column) const noexcept {
+	return Dicts_[slot(Column)];
+}
+
+
+std::vector<RowId> TagStore::allRows() const {
+	std::vector<RowId> rows_(size());
+	std::iota(rows_.begin(), rows_.end(), 0);
+	return rows_;
+}
+
+
+// FUNCTION:    filterEquals
+// DESCRIPTION: Returns the rows (of 'Rows', or of the whole store) whose 
+//              'Column' equals 'Value' exactly. For a dictionary column, the 
+//              value is looked up once and the scan compares ids.
+std::vector<RowId> TagStore::filterEquals(TagColumn                 Column, 
+										  std::string_view          Value, 
+										  const std::vector<RowId>* Rows) const {
+	std::vector<RowId> out_;
+	auto scan_ = [&](auto Match) {
+		if (Rows != nullptr) {
+			for (RowId row_ : *Rows) {
+				if (Match(row_)) {
+					out_.push_back(row_);
+				}
+			}
+		} else {
+			for (RowId row_ = 0; row_ < size(); ++row_) {
+				if (Match(row_)) {
+					out_.push_back(row_);
+				}
+			}
+		}
+	};
+	
+	switch (columnKind(Column)) {
+		case TagColumnKind::Text: {
+			const auto& column_ = Text_[slot(Column)];
+			scan_([&](RowId Row) { return column_[Row] == Value; });
+			break;
+		}
+		case TagColumnKind::Dictionary: {
+			const uint32_t id_ = Dicts_[slot(Column)].find(Value);
+			if (id_ == kNOT_FOUND) {
+				break;
+			}
+			const uint32_t* ids_ = DictIds_[slot(Column)].data();
+			scan_([&](RowId Row) { return ids_[Row] == id_; });
+			break;
+		}
+		case TagColumnKind::Number: {
+			const uint32_t value_ = ParseTagNumber(Value) >> 16;
+			scan_([&](RowId Row) { return number(Row, Column) == value_; });
+			break;
+		}
+	}
+	return out_;
+}
+
+
+// FUNCTION:    filterContains
+// DESCRIPTION: Returns the rows whose 'Column' contains 'Needle', ignoring 
+//              ASCII case. For a dictionary column, each distinct value is 
+//              tested once and the scan looks its result up by id.
+std::vector<RowId> TagStore::filterContains(TagColumn                 Column, 
+											std::string_view          Needle, 
+											const std::vector<RowId>* Rows) const {
+	std::vector<RowId> out_;
+	const size_t       count_ = (Rows != nullptr) ? Rows->size() : size();
+	auto rowAt_ = [&](size_t i_) {
+		return (Rows != nullptr) ? (*Rows)[i_] : static_cast<RowId>(i_);
+	};
+	
+	if (columnKind(Column) == TagColumnKind::Dictionary) {
+		const StringDictionary& dict_ = Dicts_[slot(Column)];
+		std::vector<char>       hit_(dict_.size());
+		for (uint32_t id_ = 0; id_ < dict_.size(); ++id_) {
+			hit_[id_] = ContainsIgnoreCase(dict_.value(id_), Needle);
+		}
+		const uint32_t* ids_ = DictIds_[slot(Column)].data();
+		for (size_t i = 0; i < count_; ++i) {
+			if (hit_[ids_[rowAt_(i)]]) {
+				out_.push_back(rowAt_(i));
+			}
+		}
+	} else if (columnKind(Column) == TagColumnKind::Text) {
+		const auto& column_ = Text_[slot(Column)];
+		for (size_t i = 0; i < count_; ++i) {
+			if (ContainsIgnoreCase(column_[rowAt_(i)], Needle)) {
+				out_.push_back(rowAt_(i));
+			}
+		}
+	} else {
+		for (size_t i = 0; i < count_; ++i) {
+			if (ContainsIgnoreCase(text(rowAt_(i), Column), Needle)) {
+				out_.push_back(rowAt_(i));
+			}
+		}
+	}
+	return out_;
+}
+
+
+// FUNCTION:    filterRange
+// DESCRIPTION: Returns the rows whose year, track number or disc number lies 
+//              in [Low, High]. Other columns match nothing.
+std::vector<RowId> TagStore::filterRange(TagColumn                 Column, 
+										 uint32_t                  Low, 
+										 uint32_t                  High, 
+										 const std::vector<RowId>* Rows) const {
+	std::vector<RowId> out_;
+	if (columnKind(Column) != TagColumnKind::Number) {
+		return out_;
+	}
+	const size_t count_ = (Rows != nullptr) ? Rows->size() : size();
+	for (size_t i = 0; i < count_; ++i) {
+		const RowId    row_   = (Rows != nullptr) ? (*Rows)[i] : static_cast<RowId>(i);
+		const uint32_t value_ = number(row_, Column);
+		if ((value_ >= Low) && (value_ <= High)) {
+			out_.push_back(row_);
+		}
+	}
+	return out_;
+}
+
+
+// FUNCTION:    sortRows
+// DESCRIPTION: Sorts 'Rows' by 'Keys' (the first key first), keeping the 
+//              existing order of ties. Every key becomes an integer per row 
+//              (a dictionary rank or a packed number). When the keys together 
+//              fit in 64 bits, they are packed into one integer per row and 
+//              radix-sorted; otherwise (and always for title or comment, which 
+//              are compared as strings) a comparison sort runs.
+void TagStore::sortRows(std::vector<RowId>&         Rows, 
+						const std::vector<SortKey>& Keys) const {
+	// Integer value of key 'k' in 'Row' (not used for text keys):
+	std::vector<const std::vector<uint32_t>*> ranks_(Keys.size(), nullptr);
+	std::vector<unsigned>                     bits_(Keys.size(), 0);
+	unsigned                                  totalBits_ = 0;
+	bool                                      packable_  = true;
+	for (size_t k = 0; k < Keys.size(); ++k) {
+		const TagColumn column_ = Keys[k].Column_;
+		switch (columnKind(column_)) {
+			case TagColumnKind::Text:
+				packable_ = false;
+				break;
+			case TagColumnKind::Dictionary:
+				ranks_[k] = &Dicts_[slot(column_)].sortRanks();
+				bits_[k]  = BitWidth(static_cast<uint32_t>(ranks_[k]->size() - 1));
+				break;
+			case TagColumnKind::Number:
+				bits_[k] = (column_ == TagColumn::Year) ? 16 : 32;
+				break;
+		}
+		totalBits_ += bits_[k];
+	}
+	auto valueOf_ = [&](size_t k, RowId Row)->uint32_t {
+		const TagColumn column_ = Keys[k].Column_;
+		if (ranks_[k] != nullptr) {
+			return (*ranks_[k])[DictIds_[slot(column_)][Row]];
+		}
+		return (column_ == TagColumn::Year) ? Years_[Row] 
+			   : (column_ == TagColumn::Track) ? Tracks_[Row] : Discs_[Row];
+	};
+	
+	if (packable_ && (totalBits_ <= 64)) {
+		std::vector<uint64_t> packed_(Rows.size());
+		for (size_t i = 0; i < Rows.size(); ++i) {
+			uint64_t key_ = 0;
+			for (size_t k = 0; k < Keys.size(); ++k) {
+				uint64_t value_ = valueOf_(k, Rows[i]);
+				if (Keys[k].Descending_) {
+					value_ = ((uint64_t(1) << bits_[k]) - 1) - value_;
+				}
+				key_ = (key_ << bits_[k]) | value_;
+			}
+			packed_[i] = key_;
+		}
+		RadixSortRows(packed_, Rows, totalBits_);
+		return;
+	}
+	
+	std::stable_sort(Rows.begin(), Rows.end(), [&](RowId a_, RowId b_) {
+		for (size_t k = 0; k < Keys.size(); ++k) {
+			int cmp_ = 0;
+			if (columnKind(Keys[k].Column_) == TagColumnKind::Text) {
+				const auto& column_ = Text_[slot(Keys[k].Column_)];
+				cmp_ = column_[a_].compare(column_[b_]);
+			} else {
+				const uint32_t va_ = valueOf_(k, a_);
+				const uint32_t vb_ = valueOf_(k, b_);
+				cmp_ = (va_ < vb_) ? -1 : (va_ > vb_) ? 1 : 0;
+			}
+			if (cmp_ != 0) {
+				return Keys[k].Descending_ ? (cmp_ > 0) : (cmp_ < 0);
+			}
+		}
+		return false;
+	});
+}
+
+
+// FUNCTION:    columnKind
+// DESCRIPTION: Returns how 'Column' is stored.
+TagColumnKind TagStore::columnKind(TagColumn Column) noexcept {
+	switch (Column) {
+		case TagColumn::Title:
+		case TagColumn::Comment:
+			return TagColumnKind::Text;
+		case TagColumn::Track:
+		case TagColumn::Year:
+		case TagColumn::Disc:
+			return TagColumnKind::Number;
+		default:
+			return TagColumnKind::Dictionary;
+	}
+}
+
+
+/*  --------  TagStore: PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    slot
+// DESCRIPTION: Returns the position of 'Column' among the columns of its kind.
+size_t TagStore::slot(TagColumn Column) noexcept {
+	switch (Column) {
+		case TagColumn::Title:       return 0;
+		case TagColumn::Comment:     return 1;
+		case TagColumn::Artist:      return 0;
+		case TagColumn::Album:       return 1;
+		case TagColumn::AlbumArtist: return 2;
+		case TagColumn::Genre:       return 3;
+		case TagColumn::Composer:    return 4;
+		default:                     return 0;
+	}
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    ContainsIgnoreCase
+// DESCRIPTION: Returns 'true' if 'Needle' occurs in 'Haystack', comparing 
+//              ASCII letters without regard to case. An empty needle matches.
+auto ContainsIgnoreCase(std::string_view Haystack, std::string_view Needle)->bool {
+	if (Needle.length() > Haystack.length()) {
+		return false;
+	}
+	auto lower_ = [](char c_) {
+		return static_cast<char>(std::tolower(static_cast<unsigned char>(c_)));
+	};
+	auto it_ = std::search(Haystack.begin(), Haystack.end(), 
+						   Needle.begin(), Needle.end(), 
+						   [&](char a_, char b_) { return lower_(a_) == lower_(b_); });
+	return (it_ != Haystack.end()) || Needle.empty();
+}
+
+
+// FUNCTION:    ParseTagNumber
+// DESCRIPTION: Parses a track, disc or year field ("7", "07/12", "2004-05-01") 
+//              into 'number << 16 | total', each part clamped to 65535. Text 
+//              without leading digits gives 0.
+auto ParseTagNumber(std::string_view Text)->uint32_t {
+	size_t i = 0;
+	while ((i < Text.length()) && (Text[i] == ' ')) {
+		++i;
+	}
+	auto digits_ = [&](uint32_t& Out) {
+		Out = 0;
+		while ((i < Text.length()) && std::isdigit(static_cast<unsigned char>(Text[i]))) {
+			Out = std::min<uint32_t>((Out * 10) + (Text[i] - '0'), 0xFFFF);
+			++i;
+		}
+	};
+	uint32_t number_ = 0;
+	uint32_t total_  = 0;
+	digits_(number_);
+	if ((i < Text.length()) && (Text[i] == '/')) {
+		++i;
+		digits_(total_);
+	}
+	return (number_ << 16) | total_;
+}
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagStore.hpp
+// FILE PURPOSE:  Declares the class 'TagStore', a column-per-field, in-memory 
+//                table of the tags of a whole library, built for fast filtering 
+//                and sorting.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagIndex.hpp"
+
+
+/* ******************************* STRUCTURES ******************************* */
+// One column per entry of 'GetTagFields()', in the same order:
+enum class TagColumn : uint8_t {
+	Title, 
+	Artist, 
+	Album, 
+	AlbumArtist, 
+	Genre, 
+	Track, 
+	Year, 
+	Comment, 
+	Disc, 
+	Composer
+};
+
+enum class TagColumnKind : uint8_t {
+	Text,       // Free text, one arena string per row (title, comment)
+	Dictionary, // Shared values, one 32-bit id per row (artist, album, ...)
+	Number      // Packed integers (track, year, disc)
+};
+
+struct SortKey {
+	TagColumn Column_;
+	bool      Descending_ = false;
+};
+
+using RowId     = uint32_t;
+using FieldView = std::array<std::string_view, kINDEX_FIELD_COUNT>;
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// Append-only storage for strings. Memory is taken in large blocks that never 
+// move, so the views it hands out stay valid for the life of the arena.
+class StringArena {
+
+	private:
+		std::vector<std::unique_ptr<char[]>> Blocks_;
+		size_t                               Used_      = 0; // In the last block
+		size_t                               Capacity_  = 0; // Of the last block
+		size_t                               Allocated_ = 0;
+	
+	public:
+		std::string_view add(std::string_view Str);
+		size_t           bytes() const noexcept;
+		void             clear() noexcept;
+
+};
+
+
+// Maps each distinct string of a column to a dense id. Id 0 is always "". 
+// The strings themselves are copied into the arena given to 'intern()' (the 
+// store's own), so a store that is cleared or rebuilt gives back the values 
+// no row holds now.
+class StringDictionary {
+
+	private:
+		std::vector<std::string_view>                  Values_ = { std::string_view() };
+		std::unordered_map<std::string_view, uint32_t> Ids_;     // Value -> own id
+		mutable std::mutex                             RanksLock_;
+		mutable std::vector<uint32_t>                  Ranks_;   // Cached by 'sortRanks()'
+	
+	public:
+		uint32_t         intern(std::string_view Str, StringArena& Strings);
+		uint32_t         find(std::string_view Str) const;
+		std::string_view value(uint32_t Id) const noexcept;
+		size_t           size() const noexcept;
+		void             clear() noexcept;
+		
+		const std::vector<uint32_t>& sortRanks() const;
+
+};
+
+
+class TagStore {
+
+	public:
+		constexpr static const uint32_t kNOT_FOUND = UINT32_MAX;
+	
+	private:
+		constexpr static const size_t kDICT_COLUMNS   = 5;
+		constexpr static const size_t kTEXT_COLUMNS   = 2;
+		
+		StringArena                                   TextArena_;
+		std::vector<std::string_view>                 Paths_;
+		std::array<std::vector<std::string_view>, kTEXT_COLUMNS> Text_;
+		std::array<StringDictionary, kDICT_COLUMNS>   Dicts_;
+		std::array<std::vector<uint32_t>, kDICT_COLUMNS> DictIds_;
+		std::vector<uint16_t>                         Years_;
+		std::vector<uint32_t>                         Tracks_; // Number << 16 | total
+		std::vector<uint32_t>                         Discs_;  // Number << 16 | total
+		std::vector<uint32_t>                         Flags_;  // 'IndexRecord::Flags_'
+	
+	public:
+		TagStore() noexcept;
+		~TagStore() noexcept;
+		
+		TagStore(const TagStore&)            = delete;
+		TagStore& operator=(const TagStore&) = delete;
+		
+		RowId            add(std::string_view Path, const FieldView& Fields, 
+							 uint32_t Flags = 0);
+		RowId            add(const IndexEntry& Entry);
+		void             load(const TagIndex& Index);
+		void             clear() noexcept;
+		void             reserve(size_t Rows);
+		
+		size_t           size() const noexcept;
+		size_t           memoryUsage() const noexcept;
+		std::string_view path(RowId Row) const noexcept;
+		std::string      text(RowId Row, TagColumn Column) const;
+		uint32_t         number(RowId Row, TagColumn Column) const noexcept;
+		std::string_view textView(RowId Row, TagColumn Column) const noexcept;
+		uint32_t         dictionaryId(RowId Row, TagColumn Column) const noexcept;
+		const uint32_t*  dictionaryColumn(TagColumn Column) const noexcept;
+		uint32_t         flags(RowId Row) const noexcept;
+		const StringDictionary& dictionary(TagColumn Column) const noexcept;
+		
+		std::vector<RowId> allRows() const;
+		std::vector<RowId> filterEquals(TagColumn                 Column, 
+										std::string_view          Value, 
+										const std::vector<RowId>* Rows = nullptr) const;
+		std::vector<RowId> filterContains(TagColumn                 Column, 
+										  std::string_view          Needle, 
+										  const std::vector<RowId>* Rows = nullptr) const;
+		std::vector<RowId> filterRange(TagColumn                 Column, 
+									   uint32_t                  Low, 
+									   uint32_t                  High, 
+									   const std::vector<RowId>* Rows = nullptr) const;
+		void               sortRows(std::vector<RowId>&         Rows, 
+									const std::vector<SortKey>& Keys) const;
+		
+		static TagColumnKind columnKind(TagColumn Column) noexcept;
+	
+	private:
+		static size_t        slot(TagColumn Column) noexcept;
+
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto ContainsIgnoreCase(std::string_view Haystack, std::string_view Needle)->bool;
+auto ParseTagNumber(std::string_view Text)->uint32_t;
@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagStream.cpp
+// FILE PURPOSE:  Defines the class 'TagStreamParser'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cstring>
+
+// THIRD-PARTY LIBRARY HEADERS:
+// id3v2lib:
+#include <id3v2lib.h>
+#include <id3v2lib/codec.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagStream.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const uint8_t kFLAG_EXTENDED_HEADER = 0x40;
+constexpr static const uint8_t kFLAG_FOOTER          = 0x10; // v2.4 only
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    IsFrameIdChar
+// PURPOSE: Tests whether 'C' may appear in a frame ID ('A'-'Z', '0'-'9'). 
+//          Anything else after the last frame is padding or junk.
+auto static IsFrameIdChar(char C)->bool {
+	return ((C >= 'A') && (C <= 'Z')) || ((C >= '0') && (C <= '9'));
+}
+
+
+// NAME:    AsBytes
+// PURPOSE: Views gathered header bytes as the unsigned bytes 'codec.h' reads.
+auto static AsBytes(const char* Data)->const uint8_t* {
+	return reinterpret_cast<const uint8_t*>(Data);
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+TagStreamParser::TagStreamParser(FrameCallback OnFrame, size_t MaxBuffered) 
+	: OnFrame_(std::move(OnFrame)), MaxBuffered_(MaxBuffered) {
+	reset();
+}
+
+
+TagStreamParser::~TagStreamParser() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    push
+// DESCRIPTION: Parses the next 'Length' bytes of the stream, calling the frame 
+//              callback for each frame (or piece of one) they complete. 
+//              Returns how many of them belong to the tag: all of them until 
+//              the tag ends, then fewer, and from then on none.
+size_t TagStreamParser::push(const void* Data, size_t Length) {
+	const char* in_    = static_cast<const char*>(Data);
+	size_t      taken_ = 0;
+	
+	while (!done()) {
+		const TagStreamState before_ = State_;
+		size_t               step_   = 0;
+		switch (State_) {
+			case TagStreamState::Header:
+				step_ = readHeader(in_ + taken_, Length - taken_);
+				break;
+			case TagStreamState::ExtendedHeader:
+				step_ = readExtendedHeader(in_ + taken_, Length - taken_);
+				break;
+			case TagStreamState::FrameHeader:
+				step_ = readFrameHeader(in_ + taken_, Length - taken_);
+				break;
+			case TagStreamState::FrameData:
+				step_ = readFrameData(in_ + taken_, Length - taken_);
+				break;
+			case TagStreamState::Padding:
+				step_ = readPadding(in_ + taken_, Length - taken_);
+				break;
+			default:
+				break;
+		}
+		taken_ += step_;
+		// Stop when the chunk is used up and nothing more can happen without 
+		// more bytes (an empty frame or the end of the tag need none):
+		if ((step_ == 0) && (State_ == before_)) {
+			break;
+		}
+	}
+	
+	Consumed_ += taken_;
+	return taken_;
+}
+
+
+// FUNCTION:    finish
+// DESCRIPTION: Tells the parser the stream has ended. Returns 'false' (and 
+//              sets the error) if that cut the tag short; a stream with no 
+//              bytes at all has no tag.
+bool TagStreamParser::finish() {
+	if ((State_ == TagStreamState::Header) && (HeldSize_ == 0)) {
+		State_ = TagStreamState::NoTag;
+	}
+	if (!done()) {
+		fail("the stream ends inside the tag");
+	}
+	return State_ != TagStreamState::Error;
+}
+
+
+// FUNCTION:    reset
+// DESCRIPTION: Forgets everything, to parse a new stream.
+void TagStreamParser::reset() noexcept {
+	State_    = TagStreamState::Header;
+	Error_.clear();
+	Held_.fill('\0');
+	HeldSize_ = 0;
+	Version_  = 0;
+	Revision_ = 0;
+	Flags_    = 0;
+	TagSize_  = 0;
+	Left_     = 0;
+	Skip_     = 0;
+	UsedSize_ = 0;
+	Consumed_ = 0;
+	Frame_    = TagStreamFrame();
+	Buffer_.clear();
+}
+
+
+// FUNCTION:    state
+// DESCRIPTION: Returns what the parser is doing, or why it stopped.
+TagStreamState TagStreamParser::state() const noexcept {
+	return State_;
+}
+
+
+// FUNCTION:    done
+// DESCRIPTION: Tests whether the parser wants no more bytes: the tag ended, 
+//              there is none, or it is damaged.
+bool TagStreamParser::done() const noexcept {
+	return (State_ == TagStreamState::Done) 
+		   || (State_ == TagStreamState::NoTag) 
+		   || (State_ == TagStreamState::Error);
+}
+
+
+// FUNCTION:    error
+// DESCRIPTION: Returns why the state is 'Error'.
+const std::string& TagStreamParser::error() const noexcept {
+	return Error_;
+}
+
+
+// FUNCTION:    version
+// DESCRIPTION: Returns the major version (3 or 4), once the header was read.
+uint8_t TagStreamParser::version() const noexcept {
+	return Version_;
+}
+
+
+// FUNCTION:    revision
+// DESCRIPTION: Returns the revision (almost always 0), once the header was read.
+uint8_t TagStreamParser::revision() const noexcept {
+	return Revision_;
+}
+
+
+// FUNCTION:    tagSize
+// DESCRIPTION: Returns the size from the tag header (excluding the header).
+uint32_t TagStreamParser::tagSize() const noexcept {
+	return TagSize_;
+}
+
+
+// FUNCTION:    usedSize
+// DESCRIPTION: Returns the bytes taken by the frames read so far, headers 
+//              included; once 'Done', the rest of 'tagSize()' is padding.
+uint32_t TagStreamParser::usedSize() const noexcept {
+	return UsedSize_;
+}
+
+
+// FUNCTION:    consumed
+// DESCRIPTION: Returns the bytes of the stream taken so far.
+uint64_t TagStreamParser::consumed() const noexcept {
+	return Consumed_;
+}
+
+
+// FUNCTION:    held
+// DESCRIPTION: Returns the bytes taken by earlier calls to 'push()' when the 
+//              state became 'NoTag' (fewer than three, all of which looked 
+//              like the start of "ID3"); they belong to the audio.
+std::string_view TagStreamParser::held() const noexcept {
+	return (State_ == TagStreamState::NoTag) 
+		   ? std::string_view(Held_.data(), HeldSize_) 
+		   : std::string_view();
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    readHeader
+// DESCRIPTION: Gathers the tag header and checks it.
+size_t TagStreamParser::readHeader(const char* Data, size_t Length) {
+	// Give up at the first byte that cannot start a tag, leaving it unread:
+	for (size_t i = HeldSize_; (i < 3) && ((i - HeldSize_) < Length); ++i) {
+		if (Data[i - HeldSize_] != "ID3"[i]) {
+			State_ = TagStreamState::NoTag;
+			return 0;
+		}
+	}
+	const size_t taken_ = gather(Data, Length, ID3_HEADER);
+	if (HeldSize_ < ID3_HEADER) {
+		return taken_;
+	}
+	
+	Version_  = static_cast<uint8_t>(Held_[3]);
+	Revision_ = static_cast<uint8_t>(Held_[4]);
+	Flags_    = static_cast<uint8_t>(Held_[5]);
+	const uint32_t raw_ = id3_read_be32(AsBytes(Held_.data() + 6));
+	if ((Version_ != 3) && (Version_ != 4)) {
+		fail("ID3v2." + std::to_string(Version_) + " tags are not supported");
+		return taken_;
+	}
+	if (!id3_syncsafe_valid(raw_)) {
+		fail("the tag size is not a syncsafe integer");
+		return taken_;
+	}
+	TagSize_  = id3_syncsafe_decode(raw_);
+	Left_     = TagSize_;
+	HeldSize_ = 0;
+	State_    = TagStreamState::FrameHeader;
+	if (Flags_ & kFLAG_EXTENDED_HEADER) {
+		if (TagSize_ < ID3_EXTENDED_HEADER_SIZE) {
+			fail("the extended header runs past the end of the tag");
+			return taken_;
+		}
+		State_ = TagStreamState::ExtendedHeader;
+	}
+	return taken_;
+}
+
+
+// FUNCTION:    readExtendedHeader
+// DESCRIPTION: Gathers the size of the extended header, then skips the rest 
+//              of it. In v2.3 the size leaves out its own four bytes; in v2.4 
+//              it is syncsafe and counts them.
+size_t TagStreamParser::readExtendedHeader(const char* Data, size_t Length) {
+	size_t taken_ = 0;
+	if (HeldSize_ < ID3_EXTENDED_HEADER_SIZE) {
+		taken_  = gather(Data, Length, ID3_EXTENDED_HEADER_SIZE);
+		Left_  -= static_cast<uint32_t>(taken_);
+		if (HeldSize_ < ID3_EXTENDED_HEADER_SIZE) {
+			return taken_;
+		}
+		
+		const uint32_t raw_  = id3_read_be32(AsBytes(Held_.data()));
+		uint32_t       rest_ = raw_;
+		if (Version_ == 4) {
+			rest_ = id3_syncsafe_decode(raw_);
+			if (!id3_syncsafe_valid(raw_) || (rest_ < ID3_EXTENDED_HEADER_SIZE)) {
+				fail("the extended header size is invalid");
+				return taken_;
+			}
+			rest_ -= ID3_EXTENDED_HEADER_SIZE;
+		}
+		if (rest_ > Left_) {
+			fail("the extended header runs past the end of the tag");
+			return taken_;
+		}
+		Skip_ = rest_;
+	}
+	
+	const size_t skip_ = std::min<size_t>(Length - taken_, Skip_);
+	Skip_  -= static_cast<uint32_t>(skip_);
+	Left_  -= static_cast<uint32_t>(skip_);
+	taken_ += skip_;
+	if (Skip_ == 0) {
+		HeldSize_ = 0;
+		State_    = TagStreamState::FrameHeader;
+	}
+	return taken_;
+}
+
+
+// FUNCTION:    readFrameHeader
+// DESCRIPTION: Gathers the next frame header. A zero or invalid frame ID, or 
+//              too little room left for a header, starts the padding.
+size_t TagStreamParser::readFrameHeader(const char* Data, size_t Length) {
+	if ((HeldSize_ == 0) && (Left_ < ID3_FRAME)) {
+		startPadding();
+		return 0;
+	}
+	const size_t taken_ = gather(Data, Length, ID3_FRAME);
+	Left_ -= static_cast<uint32_t>(taken_);
+	if (HeldSize_ < ID3_FRAME) {
+		return taken_;
+	}
+	HeldSize_ = 0;
+	
+	if (!std::all_of(Held_.begin(), Held_.begin() + ID3_FRAME_ID, IsFrameIdChar)) {
+		startPadding();
+		return taken_;
+	}
+	
+	const uint32_t raw_ = id3_read_be32(AsBytes(Held_.data() + ID3_FRAME_ID));
+	Frame_ = TagStreamFrame();
+	std::memcpy(Frame_.Id_.data(), Held_.data(), ID3_FRAME_ID);
+	Frame_.Size_     = (Version_ == 4) ? id3_syncsafe_decode(raw_) : raw_;
+	Frame_.Flags_[0] = static_cast<uint8_t>(Held_[8]);
+	Frame_.Flags_[1] = static_cast<uint8_t>(Held_[9]);
+	if (Frame_.Size_ > Left_) {
+		fail("frame " + std::string(Frame_.Id_.data())
+			 + " runs past the end of the tag");
+		return taken_;
+	}
+	
+	UsedSize_ += ID3_FRAME + Frame_.Size_;
+	Skip_      = Frame_.Size_;
+	State_     = TagStreamState::FrameData;
+	return taken_;
+}
+
+
+// FUNCTION:    readFrameData
+// DESCRIPTION: Takes the payload of the current frame. Small frames are passed
+//              on whole: straight from the caller's chunk if it holds all of 
+//              it, else once 'Buffer_' has it. Large ones are passed on in the 
+//              pieces they arrive in.
+size_t TagStreamParser::readFrameData(const char* Data, size_t Length) {
+	const size_t   taken_  = std::min<size_t>(Length, Skip_);
+	const uint32_t offset_ = Frame_.Size_ - Skip_;
+	
+	if (Frame_.Size_ > MaxBuffered_) {
+		if (taken_ > 0) {
+			emit(Data, taken_, offset_);
+		}
+	} else if (Buffer_.empty() && (taken_ == Frame_.Size_)) {
+		emit(Data, taken_, 0);
+	} else {
+		if (Buffer_.empty()) {
+			Buffer_.reserve(Frame_.Size_);
+		}
+		Buffer_.insert(Buffer_.end(), Data, Data + taken_);
+		if (Buffer_.size() == Frame_.Size_) {
+			emit(Buffer_.data(), Buffer_.size(), 0);
+		}
+	}
+	
+	Skip_ -= static_cast<uint32_t>(taken_);
+	Left_ -= static_cast<uint32_t>(taken_);
+	if (Skip_ == 0) {
+		Buffer_.clear();
+		State_ = TagStreamState::FrameHeader;
+	}
+	return taken_;
+}
+
+
+// FUNCTION:    readPadding
+// DESCRIPTION: Skips what is left of the tag, and the footer if it has one.
+size_t TagStreamParser::readPadding(const char*, size_t Length) {
+	const size_t taken_ = std::min<size_t>(Length, Skip_);
+	Skip_ -= static_cast<uint32_t>(taken_);
+	if (Skip_ == 0) {
+		State_ = TagStreamState::Done;
+	}
+	return taken_;
+}
+
+
+// FUNCTION:    startPadding
+// DESCRIPTION: Ends the frames: the rest of the tag, and the footer if it has 
+//              one, are skipped.
+void TagStreamParser::startPadding() {
+	const bool footer_ = (Version_ == 4) && (Flags_ & kFLAG_FOOTER);
+	Skip_  = Left_ + (footer_ ? ID3_HEADER : 0);
+	Left_  = 0;
+	State_ = TagStreamState::Padding;
+}
+
+
+// FUNCTION:    gather
+// DESCRIPTION: Copies bytes into 'Held_' until it holds 'Want' of them. 
+//              Returns how many were taken.
+size_t TagStreamParser::gather(const char* Data, size_t Length, size_t Want) {
+	const size_t taken_ = std::min(Length, Want - HeldSize_);
+	std::memcpy(Held_.data() + HeldSize_, Data, taken_);
+	HeldSize_ += taken_;
+	return taken_;
+}
+
+
+// FUNCTION:    emit
+// DESCRIPTION: Passes payload bytes of the current frame to the callback.
+void TagStreamParser::emit(const char* Data, size_t Length, uint32_t Offset) {
+	Frame_.Data_   = Data;
+	Frame_.Length_ = Length;
+	Frame_.Offset_ = Offset;
+	Frame_.Last_   = (Offset + Length) == Frame_.Size_;
+	if (OnFrame_) {
+		OnFrame_(Frame_);
+	}
+}
+
+
+// FUNCTION:    fail
+// DESCRIPTION: Stops parsing with 'Message' as the error.
+void TagStreamParser::fail(const std::string& Message) {
+	Error_ = Message;
+	State_ = TagStreamState::Error;
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TagStream.hpp
+// FILE PURPOSE:  Declares the class 'TagStreamParser', which parses an ID3v2 
+//                tag fed to it in chunks of any size (from a pipe, say) and 
+//                reports each frame as soon as it is complete, without ever 
+//                holding the whole tag in memory.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <array>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+#include <cstddef>
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// Frames up to this size are reported in one piece; larger ones (pictures, 
+// mostly) are reported in pieces as their bytes arrive:
+constexpr static const size_t kSTREAM_MAX_BUFFERED = 64 * 1024;
+
+
+/* ******************************* STRUCTURES ******************************* */
+enum class TagStreamState : uint8_t {
+	Header,         // Reading the 10-byte tag header
+	ExtendedHeader, // Skipping the extended header
+	FrameHeader,    // Reading a 10-byte frame header
+	FrameData,      // Reading a frame's payload
+	Padding,        // Skipping padding (and any footer) after the frames
+	Done,           // The tag ended; the bytes after it are audio
+	NoTag,          // The stream does not start with an ID3v2 tag
+	Error           // The tag is damaged, unsupported or cut short
+};
+
+// One frame, or one piece of a frame larger than the parser buffers. The data 
+// is only valid during the callback:
+struct TagStreamFrame {
+	std::array<char, 5>    Id_     = {};      // NUL-terminated, e.g. "TIT2"
+	uint32_t               Size_   = 0;       // Of the whole payload
+	std::array<uint8_t, 2> Flags_  = {};
+	uint32_t               Offset_ = 0;       // Of 'Data_' within the payload
+	const char*            Data_   = nullptr;
+	size_t                 Length_ = 0;
+	bool                   Last_   = true;    // 'Offset_ + Length_ == Size_'
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// 'push()' takes the next chunk of the stream and returns how many of its 
+// bytes belonged to the tag; once the state is 'Done' the rest of the chunk 
+// (and of the stream) is audio. Apart from one buffered frame of at most 
+// 'MaxBuffered' bytes, the parser keeps a few dozen bytes of state, so tags 
+// of any size can be read in constant memory. As with 'load_tag()', v2.3 and 
+// v2.4 are supported, and unsynchronisation is not undone.
+class TagStreamParser {
+
+	public:
+		using FrameCallback = std::function<void(const TagStreamFrame&)>;
+	
+	private:
+		FrameCallback         OnFrame_;
+		size_t                MaxBuffered_;
+		TagStreamState        State_;
+		std::string           Error_;
+		
+		std::array<char, 10>  Held_;      // Header being gathered
+		size_t                HeldSize_;
+		uint8_t               Version_;   // Major version, 3 or 4
+		uint8_t               Revision_;
+		uint8_t               Flags_;     // Tag header flags
+		uint32_t              TagSize_;   // Without the header (and footer)
+		uint32_t              Left_;      // Bytes of the tag not yet read
+		uint32_t              Skip_;      // Bytes of the current section left
+		uint32_t              UsedSize_;  // Bytes in frames
+		uint64_t              Consumed_;  // Bytes of the stream taken so far
+		
+		TagStreamFrame        Frame_;     // The frame being read
+		std::vector<char>     Buffer_;    // Its payload, if buffered
+	
+	public:
+		explicit TagStreamParser(FrameCallback OnFrame, 
+								 size_t        MaxBuffered = kSTREAM_MAX_BUFFERED);
+		~TagStreamParser() noexcept;
+		
+		TagStreamParser(const TagStreamParser&)            = delete;
+		TagStreamParser& operator=(const TagStreamParser&) = delete;
+		
+		size_t             push(const void* Data, size_t Length);
+		bool               finish();
+		void               reset() noexcept;
+		
+		TagStreamState     state() const noexcept;
+		bool               done() const noexcept;
+		const std::string& error() const noexcept;
+		uint8_t            version() const noexcept;
+		uint8_t            revision() const noexcept;
+		uint32_t           tagSize() const noexcept;
+		uint32_t           usedSize() const noexcept;
+		uint64_t           consumed() const noexcept;
+		std::string_view   held() const noexcept;
+	
+	private:
+		size_t             readHeader(const char* Data, size_t Length);
+		size_t             readExtendedHeader(const char* Data, size_t Length);
+		size_t             readFrameHeader(const char* Data, size_t Length);
+		size_t             readFrameData(const char* Data, size_t Length);
+		size_t             readPadding(const char* Data, size_t Length);
+		void               startPadding();
+		size_t             gather(const char* Data, size_t Length, size_t Want);
+		void               emit(const char* Data, size_t Length, uint32_t Offset);
+		void               fail(const std::string& Message);
+
+};
@@ -0,0 +1,604 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TrigramIndex.cpp
+// FILE PURPOSE:  Defines the class 'TrigramIndex'. Every run of three bytes in 
+//                a file's (lowercased) searched fields maps to the sorted list 
+//                of files that contain it. A query intersects the lists of its 
+//                terms' trigrams, starting from the shortest, then checks each 
+//                surviving file for the actual terms and ranks it.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cctype>
+#include <cstring>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TrigramIndex.hpp"
+#include "SimdSupport.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const char     kFIELD_SEPARATOR = '\x1F';
+// A posting packs 'id delta << 4 | field bits' into 32 bits:
+constexpr static const size_t   kMAX_DOCS        = size_t(1) << 28;
+// Index of each searched field in 'GetTagFields()' order:
+constexpr static const size_t   kSEARCH_FIELDS[kSEARCH_FIELD_COUNT] = { 0, 1, 2, 7 };
+// A match in the title counts for more than one in the comment:
+constexpr static const uint32_t kFIELD_WEIGHTS[kSEARCH_FIELD_COUNT] = { 8, 6, 4, 1 };
+// Terms whose possible fields are tracked during intersection (4 bits each):
+constexpr static const size_t   kMASKED_TERMS = 8;
+// Dense lists are left to verification once the candidates are this sparse:
+constexpr static const size_t   kSKIP_RATIO   = 8;
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    ToLower
+// PURPOSE: Lowercases ASCII letters; other bytes (including UTF-8) are kept.
+auto static ToLower(std::string_view Str)->std::string {
+	std::string out_(Str);
+	for (char& c_ : out_) {
+		if ((c_ >= 'A') && (c_ <= 'Z')) {
+			c_ = static_cast<char>(c_ - 'A' + 'a');
+		}
+	}
+	return out_;
+}
+
+
+// NAME:    AppendTrigrams
+// PURPOSE: Appends the trigrams of 'Str' (lowercased already) to 'Out'.
+auto static AppendTrigrams(std::string_view Str, std::vector<uint32_t>& Out)->void {
+	for (size_t i = 0; (i + 3) <= Str.length(); ++i) {
+		Out.push_back((static_cast<uint32_t>(static_cast<uint8_t>(Str[i])) << 16)
+					  | (static_cast<uint32_t>(static_cast<uint8_t>(Str[i + 1])) << 8)
+					  | static_cast<uint8_t>(Str[i + 2]));
+	}
+}
+
+
+// NAME:    MaxFieldScore
+// PURPOSE: Returns the most one term can score for a match in field 'Field'.
+auto static MaxFieldScore(size_t Field)->uint32_t {
+	return kFIELD_WEIGHTS[Field] * 2;
+}
+
+
+// NAME:    TermMask
+// PURPOSE: Returns a candidate mask that allows every field for every term 
+//          but 'Term', which may only be in 'Fields'.
+auto static TermMask(uint8_t Fields, size_t Term)->uint32_t {
+	if (Term >= kMASKED_TERMS) {
+		return UINT32_MAX;
+	}
+	return ~(uint32_t(0xF) << (4 * Term)) | (static_cast<uint32_t>(Fields) << (4 * Term));
+}
+
+
+// NAME:    PutVarint
+// PURPOSE: Appends 'Value' to 'Out' in 7-bit groups, low group first.
+auto static PutVarint(uint32_t Value, std::vector<uint8_t>& Out)->void {
+	while (Value >= 0x80) {
+		Out.push_back(static_cast<uint8_t>(Value | 0x80));
+		Value >>= 7;
+	}
+	Out.push_back(static_cast<uint8_t>(Value));
+}
+
+
+// NAME:    GetVarint
+// PURPOSE: Reads a value written by 'PutVarint()' and advances 'Pos'.
+auto static GetVarint(const uint8_t* Bytes, size_t& Pos)->uint32_t {
+	uint32_t value_ = 0;
+	unsigned shift_ = 0;
+	uint8_t  byte_;
+	do {
+		byte_   = Bytes[Pos++];
+		value_ |= static_cast<uint32_t>(byte_ & 0x7F) << shift_;
+		shift_ += 7;
+	} while (byte_ & 0x80);
+	return value_;
+}
+
+
+// NAME:    LowerBound
+// PURPOSE: Returns the first position at or after 'Pos' in the sorted 'Ids' 
+//          whose id is not less than 'Id'. With SSE2, four ids are compared 
+//          per step.
+auto static LowerBound(const uint32_t* Ids, size_t Pos, size_t Count, uint32_t Id)->size_t {
+#if defined(MP3EDIT_HAVE_SSE2)
+	// SSE2 only compares signed integers; flipping the top bit of both sides
+	// gives the unsigned order:
+	const __m128i bias_ = _mm_set1_epi32(static_cast<int>(0x80000000u));
+	const __m128i key_  = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(Id)), bias_);
+	while ((Pos + 4) <= Count) {
+		const __m128i block_ = _mm_xor_si128(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(Ids + Pos)), bias_);
+		const int less_ = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(block_, key_)));
+		if (less_ != 0xF) {
+			// The ids are sorted, so the lanes below 'Id' are a prefix:
+			size_t lane_ = 0;
+			while (less_ & (1 << lane_)) {
+				++lane_;
+			}
+			return Pos + lane_;
+		}
+		Pos += 4;
+	}
+#endif
+	while ((Pos < Count) && (Ids[Pos] < Id)) {
+		++Pos;
+	}
+	return Pos;
+}
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+TrigramIndex::TrigramIndex() noexcept {}
+
+
+TrigramIndex::~TrigramIndex() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    add
+// DESCRIPTION: Indexes the file 'Path', replacing any earlier entry for it. 
+//              A file always gets a new id, so posting lists only ever grow 
+//              at the end; the old entry is left as a tombstone until the 
+//              next 'compact()'.
+void TrigramIndex::add(std::string_view Path, const SearchFields& Fields) {
+	remove(Path);
+	
+	std::string text_;
+	for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+		if (f != 0) {
+			text_ += kFIELD_SEPARATOR;
+		}
+		text_ += ToLower(Fields[f]);
+	}
+	
+	if (Docs_.size() >= kMAX_DOCS) {
+		compact();
+		if (Docs_.size() >= kMAX_DOCS) {
+			throw std::length_error("TrigramIndex: too many files");
+		}
+	}
+	const DocId id_ = static_cast<DocId>(Docs_.size());
+	Doc         doc_;
+	doc_.Path_ = Arena_.add(Path);
+	doc_.Text_ = Arena_.add(text_);
+	Docs_.push_back(doc_);
+	ByPath_[doc_.Path_] = id_;
+	
+	// Trigrams never span two fields; each is stored once, with the set of 
+	// fields it occurs in ('trigram << 4 | field bit' until merged):
+	std::vector<uint32_t> grams_;
+	size_t                start_ = 0;
+	for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+		size_t end_ = text_.find(kFIELD_SEPARATOR, start_);
+		if (end_ == std::string::npos) {
+			end_ = text_.length();
+		}
+		const size_t first_ = grams_.size();
+		AppendTrigrams(std::string_view(text_).substr(start_, end_ - start_), grams_);
+		for (size_t i = first_; i < grams_.size(); ++i) {
+			grams_[i] = (grams_[i] << 4) | (uint32_t(1) << f);
+		}
+		start_ = end_ + 1;
+	}
+	std::sort(grams_.begin(), grams_.end());
+	for (size_t i = 0; i < grams_.size(); ) {
+		const uint32_t gram_ = grams_[i] >> 4;
+		uint8_t        mask_ = 0;
+		for (; (i < grams_.size()) && ((grams_[i] >> 4) == gram_); ++i) {
+			mask_ |= static_cast<uint8_t>(grams_[i] & 0xF);
+		}
+		addPosting(gram_, id_, mask_);
+	}
+}
+
+
+void TrigramIndex::add(const IndexEntry& Entry) {
+	SearchFields fields_;
+	for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+		fields_[f] = Entry.Fields_[kSEARCH_FIELDS[f]];
+	}
+	add(Entry.Path_, fields_);
+}
+
+
+// FUNCTION:    remove
+// DESCRIPTION: Drops 'Path' from search results. Returns 'false' if it was not 
+//              indexed. Once tombstones outnumber live files, the index is 
+//              compacted.
+bool TrigramIndex::remove(std::string_view Path) {
+	auto it_ = ByPath_.find(Path);
+	if (it_ == ByPath_.end()) {
+		return false;
+	}
+	Docs_[it_->second].Live_ = false;
+	ByPath_.erase(it_);
+	++Dead_;
+	if ((Dead_ >= 4096) && (Dead_ > ByPath_.size())) {
+		compact();
+	}
+	return true;
+}
+
+
+// FUNCTION:    load
+// DESCRIPTION: Replaces the contents with the files in 'Index'.
+void TrigramIndex::load(const TagIndex& Index) {
+	clear();
+	Docs_.reserve(Index.size());
+	ByPath_.reserve(Index.size());
+	SearchFields fields_;
+	for (size_t i = 0; i < Index.size(); ++i) {
+		for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+			fields_[f] = Index.field(i, kSEARCH_FIELDS[f]);
+		}
+		add(Index.path(i), fields_);
+	}
+}
+
+
+// FUNCTION:    compact
+// DESCRIPTION: Rebuilds the index from its live files, dropping tombstones and 
+//              renumbering the files densely.
+void TrigramIndex::compact() {
+	std::vector<std::pair<std::string, std::string>> live_;
+	live_.reserve(ByPath_.size());
+	for (const Doc& doc_ : Docs_) {
+		if (doc_.Live_) {
+			live_.emplace_back(std::string(doc_.Path_), std::string(doc_.Text_));
+		}
+	}
+	clear();
+	
+	SearchFields fields_;
+	for (const auto& [path_, text_ ] : live_) {
+		// The stored text is already lowercased; split it back into fields:
+		std::string_view rest_ = text_;
+		for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+			const size_t end_ = rest_.find(kFIELD_SEPARATOR);
+			fields_[f] = rest_.substr(0, end_);
+			rest_      = (end_ == std::string_view::npos) ? std::string_view() 
+														  : rest_.substr(end_ + 1);
+		}
+		add(path_, fields_);
+	}
+}
+
+
+void TrigramIndex::clear() noexcept {
+	Postings_.clear();
+	ByPath_.clear();
+	Docs_.clear();
+	Arena_.clear();
+	Dead_ = 0;
+}
+
+
+// FUNCTION:    size
+// DESCRIPTION: Returns the number of files that can be found.
+size_t TrigramIndex::size() const noexcept {
+	return ByPath_.size();
+}
+
+
+// FUNCTION:    memoryUsage
+// DESCRIPTION: Returns roughly how many bytes the posting lists and the stored 
+//              text take.
+size_t TrigramIndex::memoryUsage() const noexcept {
+	size_t bytes_ = Arena_.bytes() + (Docs_.capacity() * sizeof(Doc));
+	for (const auto& posting_ : Postings_) {
+		bytes_ += sizeof(posting_) + posting_.second.Bytes_.capacity()
+				  + (posting_.second.Skips_.capacity() * sizeof(Skip));
+	}
+	return bytes_;
+}
+
+
+// FUNCTION:    search
+// DESCRIPTION: Returns up to 'Limit' files that contain every whitespace- 
+//              separated term of 'Query' (ignoring ASCII case) in any of the 
+//              searched fields, best first: a term in the title outranks one 
+//              in the comment, and a match at the start of a word counts 
+//              double. Terms shorter than three bytes have 
+//              no trigrams and only filter the candidates of the longer ones 
+//              (or, if no term is long enough, every file).
+std::vector<SearchHit> TrigramIndex::search(std::string_view Query, 
+											size_t           Limit) const {
+	std::vector<SearchHit> hits_;
+	std::vector<std::string> terms_;
+	{
+		const std::string lower_ = ToLower(Query);
+		size_t            pos_   = 0;
+		while (pos_ < lower_.length()) {
+			while ((pos_ < lower_.length()) && std::isspace(static_cast<unsigned char>(lower_[pos_]))) {
+				++pos_;
+			}
+			size_t end_ = pos_;
+			while ((end_ < lower_.length()) && !std::isspace(static_cast<unsigned char>(lower_[end_]))) {
+				++end_;
+			}
+			if (end_ > pos_) {
+				terms_.push_back(lower_.substr(pos_, end_ - pos_));
+			}
+			pos_ = end_;
+		}
+	}
+	if (terms_.empty() || (Limit == 0)) {
+		return hits_;
+	}
+	
+	// Gather the posting lists of every term's trigrams; a missing one means
+	// no hit:
+	struct TermList {
+		const Posting* List_;
+		size_t         Term_;
+	};
+	std::vector<TermList> lists_;
+	for (size_t t = 0; t < terms_.size(); ++t) {
+		std::vector<uint32_t> grams_;
+		AppendTrigrams(terms_[t], grams_);
+		std::sort(grams_.begin(), grams_.end());
+		grams_.erase(std::unique(grams_.begin(), grams_.end()), grams_.end());
+		for (uint32_t gram_ : grams_) {
+			auto it_ = Postings_.find(gram_);
+			if (it_ == Postings_.end()) {
+				return hits_;
+			}
+			lists_.push_back({ &it_->second, t });
+		}
+	}
+	
+	// Intersect, shortest list first, so that the candidate set only shrinks. 
+	// Alongside each candidate goes the set of fields each term can be in 
+	// (the fields holding all of the term's trigrams seen so far):
+	std::vector<DocId>    candidates_;
+	std::vector<uint32_t> masks_;
+	if (!lists_.empty()) {
+		std::sort(lists_.begin(), lists_.end(), [](const TermList& a_, const TermList& b_) {
+			return a_.List_->Count_ < b_.List_->Count_;
+		});
+		std::vector<DocId>   block_;
+		std::vector<uint8_t> fields_;
+		const Posting&       first_ = *lists_[0].List_;
+		candidates_.reserve(first_.Count_);
+		masks_.reserve(first_.Count_);
+		for (size_t b = 0; b < first_.Skips_.size(); ++b) {
+			decodeBlock(first_, b, block_, fields_);
+			candidates_.insert(candidates_.end(), block_.begin(), block_.end());
+			for (uint8_t mask_ : fields_) {
+				masks_.push_back(TermMask(mask_, lists_[0].Term_));
+			}
+		}
+		for (size_t l = 1; (l < lists_.size()) && !candidates_.empty(); ++l) {
+			// Verifying a few candidates is cheaper than decoding a long list:
+			if ((candidates_.size() * kSKIP_RATIO) < lists_[l].List_->Count_) {
+				break;
+			}
+			intersect(candidates_, masks_, *lists_[l].List_, lists_[l].Term_);
+		}
+	}
+	
+	// The best score each candidate could reach, from its terms' fields:
+	std::array<uint32_t, 16> fieldsBound_{};
+	for (uint32_t m = 0; m < 16; ++m) {
+		for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+			if (m & (uint32_t(1) << f)) {
+				fieldsBound_[m] = std::max(fieldsBound_[m], MaxFieldScore(f));
+			}
+		}
+	}
+	auto bound_ = [&terms_, &fieldsBound_](uint32_t Mask) {
+		uint32_t total_ = 0;
+		for (size_t t = 0; t < terms_.size(); ++t) {
+			const uint32_t best_ = fieldsBound_[(t < kMASKED_TERMS) ? ((Mask >> (4 * t)) & 0xF) : 0xF];
+			if (best_ == 0) {
+				return uint32_t(0);
+			}
+			total_ += best_;
+		}
+		return total_;
+	};
+	const uint32_t topBound_ = bound_(UINT32_MAX);
+	
+	// Candidates are taken highest bound first, ids ascending within a bound; 
+	// usually only the first bound or two need to be looked at:
+	std::vector<uint16_t> bounds_(candidates_.size());
+	std::vector<bool>     present_(topBound_ + 1, false);
+	for (size_t i = 0; i < candidates_.size(); ++i) {
+		bounds_[i]           = static_cast<uint16_t>(bound_(masks_[i]));
+		present_[bounds_[i]] = true;
+	}
+	
+	// Verify (trigrams can match across a term's boundaries) and rank. The 
+	// current top 'Limit' is a heap with the worst hit on top; once no later 
+	// candidate's bound can beat it, the rest are never looked at:
+	struct Ranked {
+		DocId    Doc_;
+		uint32_t Score_;
+	};
+	auto better_ = [](const Ranked& a_, const Ranked& b_) {
+		return (a_.Score_ != b_.Score_) ? (a_.Score_ > b_.Score_) : (a_.Doc_ < b_.Doc_);
+	};
+	std::vector<Ranked> best_;
+	auto consider_ = [&](DocId Id, uint32_t Bound) {
+		if (best_.size() == Limit) {
+			const Ranked& worst_ = best_.front();
+			if ((Bound < worst_.Score_) 
+				|| ((Bound == worst_.Score_) && (Id > worst_.Doc_))) {
+				return false;
+			}
+		}
+		if (!Docs_[Id].Live_) {
+			return true;
+		}
+		const Ranked hit_ = { Id, score(Docs_[Id], terms_) };
+		if (hit_.Score_ == 0) {
+			return true;
+		}
+		if (best_.size() < Limit) {
+			best_.push_back(hit_);
+			std::push_heap(best_.begin(), best_.end(), better_);
+		} else if (better_(hit_, best_.front())) {
+			std::pop_heap(best_.begin(), best_.end(), better_);
+			best_.back() = hit_;
+			std::push_heap(best_.begin(), best_.end(), better_);
+		}
+		return true;
+	};
+	if (lists_.empty()) {
+		for (DocId id_ = 0; (id_ < Docs_.size()) && consider_(id_, topBound_); ++id_) {}
+	} else {
+		bool more_ = true;
+		for (uint32_t k = topBound_; more_ && (k > 0); --k) {
+			for (size_t i = 0; more_ && present_[k] && (i < candidates_.size()); ++i) {
+				if (bounds_[i] == k) {
+					more_ = consider_(candidates_[i], k);
+				}
+			}
+		}
+	}
+	
+	std::sort(best_.begin(), best_.end(), better_);
+	hits_.reserve(best_.size());
+	for (const Ranked& hit_ : best_) {
+		hits_.push_back({ std::string(Docs_[hit_.Doc_].Path_), hit_.Score_ });
+	}
+	return hits_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+// FUNCTION:    addPosting
+// DESCRIPTION: Appends 'Id' (always larger than any id in the list), found in 
+//              the fields 'Fields', to the posting list of 'Trigram', opening 
+//              a new block as needed.
+void TrigramIndex::addPosting(uint32_t Trigram, DocId Id, uint8_t Fields) {
+	Posting& list_ = Postings_[Trigram];
+	if ((list_.Count_ % kBLOCK_SIZE) == 0) {
+		list_.Skips_.push_back({ Id, list_.Last_, 
+								 static_cast<uint32_t>(list_.Bytes_.size()) });
+	}
+	PutVarint(((Id - list_.Last_) << 4) | Fields, list_.Bytes_);
+	list_.Last_ = Id;
+	++list_.Count_;
+}
+
+
+// FUNCTION:    decodeBlock
+// DESCRIPTION: Decodes block number 'Block' of 'List' into its ids ('Ids') and 
+//              their field bits ('Fields').
+void TrigramIndex::decodeBlock(const Posting&        List, 
+							   size_t                Block, 
+							   std::vector<DocId>&   Ids, 
+							   std::vector<uint8_t>& Fields) const {
+	const size_t count_ = std::min(kBLOCK_SIZE, 
+								   List.Count_ - (Block * kBLOCK_SIZE));
+	Ids.resize(count_);
+	Fields.resize(count_);
+	size_t pos_  = List.Skips_[Block].Offset_;
+	DocId  prev_ = List.Skips_[Block].Base_;
+	for (size_t i = 0; i < count_; ++i) {
+		const uint32_t value_ = GetVarint(List.Bytes_.data(), pos_);
+		prev_     += value_ >> 4;
+		Ids[i]     = prev_;
+		Fields[i]  = static_cast<uint8_t>(value_ & 0xF);
+	}
+}
+
+
+// FUNCTION:    intersect
+// DESCRIPTION: Keeps only the 'Candidates' that are also in 'List', narrowing 
+//              the fields allowed for term 'Term' in their 'Masks'. The skip 
+//              table is binary-searched for each candidate's block, so blocks 
+//              that hold no candidate are never decoded; within a block, the 
+//              search compares several ids per step.
+void TrigramIndex::intersect(std::vector<DocId>&    Candidates, 
+							 std::vector<uint32_t>& Masks, 
+							 const Posting&         List, 
+							 size_t                 Term) const {
+	std::vector<DocId>   block_;
+	std::vector<uint8_t> fields_;
+	size_t               current_ = SIZE_MAX;
+	size_t               pos_     = 0;
+	size_t               kept_    = 0;
+	for (size_t i = 0; i < Candidates.size(); ++i) {
+		const DocId id_ = Candidates[i];
+		// Candidates ascend, so most stay in the current block; otherwise find 
+		// the last block whose first id is <= 'id_':
+		if ((current_ == SIZE_MAX) 
+			|| (((current_ + 1) < List.Skips_.size()) 
+				&& (id_ >= List.Skips_[current_ + 1].First_))) {
+			auto next_ = std::upper_bound(
+				List.Skips_.begin() + ((current_ == SIZE_MAX) ? 0 : (current_ + 1)), 
+				List.Skips_.end(), id_, 
+				[](DocId Id, const Skip& S) { return Id < S.First_; });
+			if (next_ == List.Skips_.begin()) {
+				continue;
+			}
+			current_ = static_cast<size_t>(next_ - List.Skips_.begin()) - 1;
+			pos_     = 0;
+			decodeBlock(List, current_, block_, fields_);
+		}
+		pos_ = LowerBound(block_.data(), pos_, block_.size(), id_);
+		if ((pos_ < block_.size()) && (block_[pos_] == id_)) {
+			Candidates[kept_] = id_;
+			Masks[kept_++]    = Masks[i] & TermMask(fields_[pos_], Term);
+		}
+	}
+	Candidates.resize(kept_);
+	Masks.resize(kept_);
+}
+
+
+// FUNCTION:    score
+// DESCRIPTION: Scores 'Document' against the (lowercased) 'Terms'; returns 0 
+//              if any term is missing from every searched field.
+uint32_t TrigramIndex::score(const Doc&                      Document, 
+							 const std::vector<std::string>& Terms) const {
+	// Split the stored text back into its fields:
+	std::array<std::string_view, kSEARCH_FIELD_COUNT> fields_;
+	std::string_view rest_ = Document.Text_;
+	for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+		const size_t end_ = rest_.find(kFIELD_SEPARATOR);
+		fields_[f] = rest_.substr(0, end_);
+		rest_      = (end_ == std::string_view::npos) ? std::string_view() 
+													  : rest_.substr(end_ + 1);
+	}
+	
+	uint32_t total_ = 0;
+	for (const std::string& term_ : Terms) {
+		uint32_t best_ = 0;
+		for (size_t f = 0; f < kSEARCH_FIELD_COUNT; ++f) {
+			const std::string_view field_ = fields_[f];
+			size_t                 at_    = field_.find(term_);
+			if (at_ == std::string_view::npos) {
+				continue;
+			}
+			uint32_t points_ = kFIELD_WEIGHTS[f];
+			for (; at_ != std::string_view::npos; at_ = field_.find(term_, at_ + 1)) {
+				if ((at_ == 0) || !std::isalnum(static_cast<unsigned char>(field_[at_ - 1]))) {
+					points_ = MaxFieldScore(f);
+					break;
+				}
+			}
+			best_ = std::max(best_, points_);
+		}
+		if (best_ == 0) {
+			return 0;
+		}
+		total_ += best_;
+	}
+	return total_;
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      TrigramIndex.hpp
+// FILE PURPOSE:  Declares the class 'TrigramIndex', an in-memory full-text 
+//                index over the title, artist, album and comment of every 
+//                file in a library, for search-as-you-type.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagIndex.hpp"
+#include "TagStore.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// Searched fields, in the order 'add()' takes them:
+constexpr static const size_t kSEARCH_FIELD_COUNT = 4; // Title, artist, album, comment
+
+
+/* ******************************* STRUCTURES ******************************* */
+using SearchFields = std::array<std::string_view, kSEARCH_FIELD_COUNT>;
+
+// A hit owns its path: any 'add()' or 'remove()' may compact the index, which 
+// frees the strings of the files it held.
+struct SearchHit {
+	std::string Path_;
+	uint32_t    Score_;  // Higher is better
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+class TrigramIndex {
+
+	public:
+		using DocId = uint32_t;
+	
+	private:
+		constexpr static const size_t kBLOCK_SIZE = 128;
+		
+		// Entry point into a posting list every 'kBLOCK_SIZE' ids:
+		struct Skip {
+			DocId    First_;  // First id in the block
+			DocId    Base_;   // Id before the block (deltas start from it)
+			uint32_t Offset_; // Byte offset of the block
+		};
+		
+		// Sorted doc ids, each stored as a variable-length 'delta << 4 | fields' 
+		// (one bit per searched field that holds the trigram):
+		struct Posting {
+			std::vector<uint8_t> Bytes_;
+			std::vector<Skip>    Skips_;
+			uint32_t             Count_ = 0;
+			DocId                Last_  = 0;
+		};
+		
+		struct Doc {
+			std::string_view Path_;
+			std::string_view Text_;  // Lowercased fields joined by '\x1F'
+			bool             Live_ = true;
+		};
+		
+		StringArena                               Arena_;
+		std::vector<Doc>                          Docs_;
+		std::unordered_map<uint32_t, Posting>     Postings_;
+		std::unordered_map<std::string_view, DocId> ByPath_;
+		size_t                                    Dead_ = 0;
+	
+	public:
+		TrigramIndex() noexcept;
+		~TrigramIndex() noexcept;
+		
+		TrigramIndex(const TrigramIndex&)            = delete;
+		TrigramIndex& operator=(const TrigramIndex&) = delete;
+		
+		void   add(std::string_view Path, const SearchFields& Fields);
+		void   add(const IndexEntry& Entry);
+		bool   remove(std::string_view Path);
+		void   load(const TagIndex& Index);
+		void   compact();
+		void   clear() noexcept;
+		
+		size_t size() const noexcept;
+		size_t memoryUsage() const noexcept;
+		
+		std::vector<SearchHit> search(std::string_view Query, size_t Limit) const;
+	
+	private:
+		void   addPosting(uint32_t Trigram, DocId Id, uint8_t Fields);
+		void   decodeBlock(const Posting& List, size_t Block, 
+						   std::vector<DocId>& Ids, std::vector<uint8_t>& Fields) const;
+		void   intersect(std::vector<DocId>& Candidates, std::vector<uint32_t>& Masks, 
+						 const Posting& List, size_t Term) const;
+		uint32_t score(const Doc& Document, 
+					   const std::vector<std::string>& Terms) const;
+
+};
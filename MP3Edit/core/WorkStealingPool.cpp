@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      WorkStealingPool.cpp
+// FILE PURPOSE:  Defines the class 'WorkStealingPool'.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// PROJECT-SPECIFIC HEADERS:
+#include "WorkStealingPool.hpp"
+
+
+/* **************************** STATIC VARIABLES **************************** */
+// Index of the pool worker running on this thread, so that tasks submitted 
+// from inside a task land on the submitting worker's own queue:
+static thread_local WorkStealingPool* tl_Pool_   = nullptr;
+static thread_local size_t            tl_Worker_ = 0;
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+WorkStealingPool::WorkStealingPool(size_t ThreadCount) {
+	if (ThreadCount == 0) {
+		ThreadCount = std::thread::hardware_concurrency();
+		if (ThreadCount == 0) {
+			ThreadCount = 1;
+		}
+	}
+	
+	Workers_.reserve(ThreadCount);
+	for (size_t i = 0; i < ThreadCount; ++i) {
+		Workers_.emplace_back(std::make_unique<Worker>());
+	}
+	Threads_.reserve(ThreadCount);
+	for (size_t i = 0; i < ThreadCount; ++i) {
+		Threads_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+	}
+}
+
+
+WorkStealingPool::~WorkStealingPool() noexcept {
+	{
+		std::lock_guard<std::mutex> guard_(SleepLock_);
+		Stopping_ = true;
+	}
+	WakeUp_.notify_all();
+	for (std::thread& thread_ : Threads_) {
+		if (thread_.joinable()) {
+			thread_.join();
+		}
+	}
+}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    submit
+// DESCRIPTION: Queues 'NewTask'. Tasks submitted by a worker go to the back of 
+//              that worker's own queue (it will run them next, while they are 
+//              still warm in cache); tasks from other threads are dealt out 
+//              round-robin.
+void WorkStealingPool::submit(Task NewTask) {
+	size_t index_ = (tl_Pool_ == this) 
+					? tl_Worker_ 
+					: (NextQueue_.fetch_add(1) % Workers_.size());
+	++Pending_;
+	++Queued_;
+	{
+		std::lock_guard<std::mutex> guard_(Workers_[index_]->Lock_);
+		Workers_[index_]->Queue_.push_back(std::move(NewTask));
+	}
+	{
+		std::lock_guard<std::mutex> guard_(SleepLock_);
+	}
+	WakeUp_.notify_one();
+}
+
+
+// FUNCTION:    defer
+// DESCRIPTION: Like 'submit()', but when called from a worker the task goes to 
+//              the front of that worker's queue, behind everything else it 
+//              already has queued. Used to retry work that could not start 
+//              yet without starving the tasks queued after it.
+void WorkStealingPool::defer(Task NewTask) {
+	if (tl_Pool_ != this) {
+		submit(std::move(NewTask));
+		return;
+	}
+	++Pending_;
+	++Queued_;
+	{
+		std::lock_guard<std::mutex> guard_(Workers_[tl_Worker_]->Lock_);
+		Workers_[tl_Worker_]->Queue_.push_front(std::move(NewTask));
+	}
+	{
+		std::lock_guard<std::mutex> guard_(SleepLock_);
+	}
+	WakeUp_.notify_one();
+}
+
+
+// FUNCTION:    wait
+// DESCRIPTION: Blocks until every submitted task (including tasks submitted by 
+//              other tasks) has finished.
+void WorkStealingPool::wait() {
+	std::unique_lock<std::mutex> lock_(SleepLock_);
+	AllDone_.wait(lock_, [this]() { return Pending_.load() == 0; });
+}
+
+
+size_t WorkStealingPool::size() const noexcept {
+	return Workers_.size();
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+bool WorkStealingPool::tryPop(size_t Index, Task& Out) {
+	Worker& worker_ = *Workers_[Index];
+	std::lock_guard<std::mutex> guard_(worker_.Lock_);
+	if (worker_.Queue_.empty()) {
+		return false;
+	}
+	Out = std::move(worker_.Queue_.back());
+	worker_.Queue_.pop_back();
+	return true;
+}
+
+
+// Thieves take from the front of the victim's queue, i.e. the oldest work, 
+// which keeps them away from the end the owner is working on:
+bool WorkStealingPool::trySteal(size_t Thief, Task& Out) {
+	const size_t count_ = Workers_.size();
+	for (size_t i = 1; i < count_; ++i) {
+		Worker& victim_ = *Workers_[(Thief + i) % count_];
+		std::lock_guard<std::mutex> guard_(victim_.Lock_);
+		if (!victim_.Queue_.empty()) {
+			Out = std::move(victim_.Queue_.front());
+			victim_.Queue_.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void WorkStealingPool::workerLoop(size_t Index) {
+	tl_Pool_   = this;
+	tl_Worker_ = Index;
+	
+	Task task_;
+	while (true) {
+		if (tryPop(Index, task_) || trySteal(Index, task_)) {
+			--Queued_;
+			try {
+				task_();
+			} catch (...) {
+				// A task reports its own failures; one that throws anyway 
+				// must not take the worker (and the process) down with it:
+			}
+			task_ = nullptr;
+			finishTask();
+			continue;
+		}
+		
+		// Nothing to do anywhere; sleep until new work arrives. 'Queued_' is 
+		// raised before a submit takes 'SleepLock_' to notify, so a task 
+		// queued after the failed steal above is never slept through:
+		std::unique_lock<std::mutex> lock_(SleepLock_);
+		if (Stopping_ && (Pending_.load() == 0)) {
+			return;
+		}
+		WakeUp_.wait(lock_, [this]() {
+			return (Queued_.load() > 0) || (Stopping_ && (Pending_.load() == 0));
+		});
+	}
+}
+
+
+void WorkStealingPool::finishTask() {
+	if (--Pending_ == 0) {
+		std::lock_guard<std::mutex> guard_(SleepLock_);
+		AllDone_.notify_all();
+		if (Stopping_) {
+			WakeUp_.notify_all();
+		}
+	}
+}
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      WorkStealingPool.hpp
+// FILE PURPOSE:  Declares the class 'WorkStealingPool', a fixed-size pool of 
+//                worker threads that each own a task queue and steal from the 
+//                others when their own queue runs dry.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/* *************************** CLASS DECLARATION **************************** */
+class WorkStealingPool {
+
+	public:
+		using Task = std::function<void()>;
+	
+	private:
+		struct Worker {
+			std::mutex       Lock_;
+			std::deque<Task> Queue_;
+		};
+		
+		std::vector<std::unique_ptr<Worker>> Workers_;
+		std::vector<std::thread>             Threads_;
+		std::atomic<size_t>                  NextQueue_{0};
+		std::atomic<size_t>                  Pending_{0};  // Queued or running
+		std::atomic<size_t>                  Queued_{0};   // Not yet taken by a worker
+		std::atomic<bool>                    Stopping_{false};
+		std::mutex                           SleepLock_;
+		std::condition_variable              WakeUp_;
+		std::condition_variable              AllDone_;
+	
+	public:
+		WorkStealingPool() = delete;
+		explicit WorkStealingPool(size_t ThreadCount);
+		~WorkStealingPool() noexcept;
+		
+		WorkStealingPool(const WorkStealingPool&)            = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+		
+		void   submit(Task NewTask);
+		void   defer(Task NewTask);
+		void   wait();
+		size_t size() const noexcept;
+	
+	private:
+		bool   tryPop(size_t Index, Task& Out);
+		bool   trySteal(size_t Thief, Task& Out);
+		void   workerLoop(size_t Index);
+		void   finishTask();
+
+};
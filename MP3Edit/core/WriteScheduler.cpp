@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      WriteScheduler.cpp
+// FILE PURPOSE:  Defines the class 'WriteScheduler', and the device queries 
+//                it relies on.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <algorithm>
+#include <fstream>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+// PROJECT-SPECIFIC HEADERS:
+#include "TagIndex.hpp"
+#include "WriteScheduler.hpp"
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+#if defined(__linux__)
+// NAME:    ReadSysValue
+// PURPOSE: Reads the number in the sysfs file 'Path'.
+auto static ReadSysValue(const std::string& Path, uint64_t& Value)->bool {
+	std::ifstream in_(Path);
+	return static_cast<bool>(in_ >> Value);
+}
+#endif
+
+
+/* **************************** CLASS DEFINITION **************************** */
+/*  --------  CONSTRUCTORS AND DESTRUCTOR  --------  */
+// 'MaxPerDevice' overrides the limit of every device; 0 uses the one 
+// 'GetDeviceInfo()' finds.
+WriteScheduler::WriteScheduler(size_t MaxPerDevice) 
+	: MaxPerDevice_(MaxPerDevice) {}
+
+
+WriteScheduler::~WriteScheduler() noexcept {}
+
+
+/*  --------  PUBLIC MEMBER FUNCTIONS  --------  */
+// FUNCTION:    add
+// DESCRIPTION: Queues 'Job', which saves 'Filename', on the file's device. A 
+//              file that cannot be stat'ed goes to device 0, in the order 
+//              added, so that the save itself reports the failure.
+void WriteScheduler::add(size_t Job, const std::string& Filename) {
+	FileKey key_;
+	if (!GetFileKey(Filename, key_)) {
+		key_.Device_ = 0;
+		key_.Inode_  = 0;
+	}
+	
+	// Looking up a new device, and the file's position, both touch the 
+	// file system, so neither is done under the lock:
+	bool rotational_ = false;
+	bool known_      = false;
+	{
+		std::lock_guard<std::mutex> guard_(Lock_);
+		auto it_ = Devices_.find(key_.Device_);
+		if (it_ != Devices_.end()) {
+			known_      = true;
+			rotational_ = it_->second.Info_.Rotational_;
+		}
+	}
+	DeviceInfo info_;
+	if (!known_) {
+		info_       = (key_.Device_ != 0) ? GetDeviceInfo(key_.Device_) : DeviceInfo();
+		rotational_ = info_.Rotational_;
+	}
+	uint64_t position_ = key_.Inode_;
+	if (rotational_) {
+		GetPhysicalOffset(Filename, position_);
+	}
+	
+	std::lock_guard<std::mutex> guard_(Lock_);
+	auto [it_, added_] = Devices_.try_emplace(key_.Device_);
+	if (added_) {
+		it_->second.Info_ = info_;
+	}
+	it_->second.Pending_.emplace(position_, Job);
+	++Pending_;
+}
+
+
+// FUNCTION:    next
+// DESCRIPTION: Takes the next job to run, from the device after the last one 
+//              served that is below its limit, and marks it running. Returns 
+//              'false' if every pending job's device is at its limit (or 
+//              nothing is pending). Call 'done()' when the job is over.
+bool WriteScheduler::next(size_t& Job) {
+	std::lock_guard<std::mutex> guard_(Lock_);
+	if (Pending_ == 0) {
+		return false;
+	}
+	
+	// Round robin over the devices, starting after the last one served:
+	auto start_ = Devices_.upper_bound(LastDevice_);
+	for (size_t n = 0; n < Devices_.size(); ++n, ++start_) {
+		if (start_ == Devices_.end()) {
+			start_ = Devices_.begin();
+		}
+		Device& dev_ = start_->second;
+		if (dev_.Pending_.empty() || (dev_.Active_ >= limit(dev_))) {
+			continue;
+		}
+		
+		auto it_ = dev_.Pending_.lower_bound(dev_.Head_);
+		if (it_ == dev_.Pending_.end()) {
+			it_ = dev_.Pending_.begin(); // End of the sweep; start over
+		}
+		Job         = it_->second;
+		dev_.Head_  = it_->first;
+		dev_.Pending_.erase(it_);
+		++dev_.Active_;
+		--Pending_;
+		LastDevice_ = start_->first;
+		Running_[Job] = start_->first;
+		return true;
+	}
+	return false;
+}
+
+
+// FUNCTION:    done
+// DESCRIPTION: Frees the slot that 'Job' held on its device.
+void WriteScheduler::done(size_t Job) {
+	std::lock_guard<std::mutex> guard_(Lock_);
+	auto it_ = Running_.find(Job);
+	if (it_ == Running_.end()) {
+		return;
+	}
+	--Devices_[it_->second].Active_;
+	Running_.erase(it_);
+}
+
+
+// FUNCTION:    pending
+// DESCRIPTION: Returns the number of jobs added but not yet taken by 'next()'.
+size_t WriteScheduler::pending() const {
+	std::lock_guard<std::mutex> guard_(Lock_);
+	return Pending_;
+}
+
+
+/*  --------  PRIVATE MEMBER FUNCTIONS  --------  */
+size_t WriteScheduler::limit(const Device& Dev) const noexcept {
+	return std::max<size_t>((MaxPerDevice_ > 0) ? MaxPerDevice_ : Dev.Info_.MaxWriters_, 1);
+}
+
+
+/* ************************** FUNCTION DEFINITIONS ************************** */
+// FUNCTION:    GetDeviceInfo
+// DESCRIPTION: Looks up the block device 'Device' (an 'st_dev' value) under
+//              /sys/dev/block: rotational devices get one writer, others as 
+//              many as 'kSOLID_STATE_WRITERS' (within the device's request 
+//              queue). Devices that are not found there (network and virtual 
+//              file systems, and every device off Linux) keep the defaults.
+auto GetDeviceInfo(uint64_t Device)->DeviceInfo {
+	DeviceInfo info_;
+	info_.Device_ = Device;
+#if defined(__linux__)
+	const std::string base_ = "/sys/dev/block/" + std::to_string(major(Device))
+							  + ":" + std::to_string(minor(Device));
+	// A partition has no queue of its own; its disk is the parent directory:
+	for (const char* queue_ : { "/queue/", "/../queue/" }) {
+		uint64_t rotational_ = 0;
+		if (!ReadSysValue(base_ + queue_ + "rotational", rotational_)) {
+			continue;
+		}
+		info_.Known_      = true;
+		info_.Rotational_ = (rotational_ != 0);
+		info_.MaxWriters_ = info_.Rotational_ ? kROTATIONAL_WRITERS 
+											  : kSOLID_STATE_WRITERS;
+		uint64_t requests_ = 0;
+		if (!info_.Rotational_ 
+			&& ReadSysValue(base_ + queue_ + "nr_requests", requests_) 
+			&& (requests_ > 0)) {
+			info_.MaxWriters_ = std::min<size_t>(info_.MaxWriters_, requests_);
+		}
+		break;
+	}
+#endif
+	return info_;
+}
+
+
+// FUNCTION:    GetPhysicalOffset
+// DESCRIPTION: Sets 'Offset' to where the first byte of 'Filename' lies on its 
+//              device, through the FIEMAP ioctl. Returns 'false' (leaving 
+//              'Offset' alone) if the file system cannot tell, e.g. for an 
+//              empty or inline file, or off Linux.
+auto GetPhysicalOffset(const std::string& Filename, uint64_t& Offset)->bool {
+#if defined(__linux__) && defined(FS_IOC_FIEMAP)
+	const int fd_ = ::open(Filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0) {
+		return false;
+	}
+	alignas(struct fiemap) char buffer_[sizeof(struct fiemap)
+										+ sizeof(struct fiemap_extent)] = {};
+	struct fiemap* map_   = reinterpret_cast<struct fiemap*>(buffer_);
+	map_->fm_start        = 0;
+	map_->fm_length       = FIEMAP_MAX_OFFSET;
+	map_->fm_extent_count = 1;
+	const bool ok_ = (::ioctl(fd_, FS_IOC_FIEMAP, map_) == 0) 
+					 && (map_->fm_mapped_extents > 0) 
+					 && !(map_->fm_extents[0].fe_flags
+						  & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_NOT_ALIGNED));
+	::close(fd_);
+	if (ok_) {
+		Offset = map_->fm_extents[0].fe_physical;
+	}
+	return ok_;
+#else
+	static_cast<void>(Filename);
+	static_cast<void>(Offset);
+	return false;
+#endif
+}
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      WriteScheduler.hpp
+// FILE PURPOSE:  Declares the class 'WriteScheduler', which decides the order 
+//                in which pending saves run: grouped by storage device, in 
+//                physical order on each, and with a per-device limit that 
+//                depends on whether the device is rotational.
+
+
+/* ****************************** HEADER GUARD ****************************** */
+#pragma once
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
+#include <cstddef>
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// Concurrent saves per device, by kind of device:
+constexpr static const size_t kROTATIONAL_WRITERS  = 1;  // One sweep of the heads
+constexpr static const size_t kSOLID_STATE_WRITERS = 16;
+constexpr static const size_t kUNKNOWN_WRITERS     = 4;  // Not under /sys/block
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct DeviceInfo {
+	uint64_t Device_     = 0;     // 'st_dev'
+	bool     Known_      = false; // Found under /sys/block
+	bool     Rotational_ = false;
+	size_t   MaxWriters_ = kUNKNOWN_WRITERS;
+};
+
+
+/* *************************** CLASS DECLARATION **************************** */
+// Jobs are identified by the caller's index. Each device keeps its pending 
+// jobs sorted by where the file starts on the disk (from FIEMAP on a 
+// rotational Linux device, and otherwise by inode number, which most file 
+// systems allocate near the data). 'next()' serves the devices in turn and, 
+// on each, sweeps upward from the last position served, wrapping around at 
+// the end (C-SCAN), so a spinning disk sees one pass instead of random seeks. 
+// All members may be called from any thread.
+class WriteScheduler {
+
+	private:
+		struct Device {
+			DeviceInfo                      Info_;
+			size_t                          Active_ = 0;
+			uint64_t                        Head_   = 0; // Position of the last job
+			std::multimap<uint64_t, size_t> Pending_;    // Position -> job
+		};
+		
+		size_t                               MaxPerDevice_;
+		std::map<uint64_t, Device>           Devices_;
+		std::unordered_map<size_t, uint64_t> Running_;   // Job -> device
+		uint64_t                             LastDevice_ = 0;
+		size_t                               Pending_    = 0;
+		mutable std::mutex                   Lock_;
+	
+	public:
+		explicit WriteScheduler(size_t MaxPerDevice = 0);
+		~WriteScheduler() noexcept;
+		
+		WriteScheduler(const WriteScheduler&)            = delete;
+		WriteScheduler& operator=(const WriteScheduler&) = delete;
+		
+		void   add(size_t Job, const std::string& Filename);
+		bool   next(size_t& Job);
+		void   done(size_t Job);
+		size_t pending() const;
+	
+	private:
+		size_t limit(const Device& Dev) const noexcept;
+
+};
+
+
+/* ************************** FUNCTION PROTOTYPES *************************** */
+auto GetDeviceInfo(uint64_t Device)->DeviceInfo;
+auto GetPhysicalOffset(const std::string& Filename, uint64_t& Offset)->bool;
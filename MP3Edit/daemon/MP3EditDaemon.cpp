@@ -0,0 +1,965 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// PROJECT NAME:  MP3Edit
+// COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
+// FILENAME:      MP3EditDaemon.cpp
+// FILE PURPOSE:  Defines the entry point of 'mp3editd', which serves tag reads 
+//                and edits to local clients over a Unix domain socket, so they 
+//                share one cache of parsed tags and one ordering of writes. 
+//                Linux only (epoll). 
+//
+// PROTOCOL:      One JSON object per line each way (NDJSON). Requests may be 
+//                pipelined; each connection's replies come back in order, and 
+//                echo the request's "id", if any:
+// 
+//   {"id":1,"op":"get","path":"/a.mp3"}          all non-empty fields 
+//   {"id":2,"op":"get","paths":["/a.mp3","/b.mp3"],"fields":["title","year"]} 
+//     -> {"id":2,"ok":true,"files":[{"path":"/a.mp3","tagged":true, 
+//                                    "fields":{"title":"...","year":"..."}}, 
+//                                   {"path":"/b.mp3","error":"not a file"}]} 
+//   {"id":3,"op":"set","paths":[...],"fields":{"artist":"X","year":"1959"}} 
+//     -> {"id":3,"ok":true}    once written, or 
+//        {"id":3,"ok":false,"error":"...","failed":["/b.mp3"]} 
+//   {"id":4,"op":"stats"} 
+//     -> {"id":4,"ok":true,"cached":N,"hits":N,"misses":N,"written":N, 
+//         "merged":N} 
+// 
+//                Edits are seen at once by later reads from any client, and 
+//                are written after each round of input, with all edits to a 
+//                file in that round merged into one write.
+
+
+/* **************************** INCLUDED HEADERS **************************** */
+// C++17 STANDARD LIBRARY/STL HEADERS:
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cerrno>
+#include <cinttypes>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// PROJECT-SPECIFIC HEADERS:
+#include "../core/TagFields.hpp"
+#include "../core/TagService.hpp"
+
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const int    kEXIT_OK        = 0;
+constexpr static const int    kEXIT_FAILURE   = 1;
+constexpr static const int    kEXIT_USAGE     = 2;
+
+constexpr static const size_t kMAX_LINE       = 1 << 20; // Longest request
+constexpr static const size_t kMAX_OUTPUT     = 1 << 24; // Stop reading a client
+													   // with this much unsent
+constexpr static const size_t kREAD_CHUNK     = 64 * 1024;
+constexpr static const int    kMAX_EVENTS     = 64;
+constexpr static const int    kJSON_MAX_DEPTH = 8;
+
+
+/* ******************************* STRUCTURES ******************************* */
+// A parsed JSON value; numbers are kept as their text:
+struct JsonValue {
+	enum class Kind : uint8_t { Null, Bool, Number, String, Array, Object };
+	
+	Kind                                           Kind_ = Kind::Null;
+	bool                                           Bool_ = false;
+	std::string                                    Text_;
+	std::vector<JsonValue>                         Items_;
+	std::vector<std::pair<std::string, JsonValue>> Members_;
+};
+
+// A reply is finished when its request is handled, except that of a 'set', 
+// which waits for the write:
+struct Reply {
+	std::string              Text_;
+	bool                     Ready_ = true;
+	std::string              Id_;     // JSON text of the request's "id"
+	std::vector<std::string> Paths_;  // Files a 'set' is waiting on
+	std::vector<std::string> Missing_; // Files a 'set' could not edit
+};
+
+struct Connection {
+	int                Fd_         = -1;
+	std::string        In_;
+	std::string        Out_;
+	size_t             Sent_       = 0;     // Bytes of 'Out_' already sent
+	std::vector<Reply> Replies_;
+	bool               ReadClosed_ = false;
+	bool               Broken_     = false;
+	uint32_t           Events_     = 0;     // As registered with epoll
+};
+
+struct DaemonOptions {
+	std::string SocketPath_;
+	size_t      Threads_ = 0; // For writing; 0 = one per hardware thread
+};
+
+
+/* **************************** STATIC VARIABLES **************************** */
+static volatile std::sig_atomic_t s_StopRequested_ = 0;
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+// NAME:    OnStopSignal
+// PURPOSE: Handles SIGINT/SIGTERM.
+extern "C" void OnStopSignal(int) {
+	s_StopRequested_ = 1;
+}
+
+
+// NAME:    SkipSpace
+// PURPOSE: Advances 'Pos' past JSON whitespace.
+auto static SkipSpace(std::string_view Text, size_t& Pos)->void {
+	while ((Pos < Text.length()) 
+		   && ((Text[Pos] == ' ') || (Text[Pos] == '\t') 
+			   || (Text[Pos] == '\r') || (Text[Pos] == '\n'))) {
+		++Pos;
+	}
+}
+
+
+// NAME:    ParseHex4
+// PURPOSE: Parses the four hex digits of a '\u' escape at 'Pos'.
+auto static ParseHex4(std::string_view Text, size_t& Pos, uint32_t& Out)->bool {
+	if ((Pos + 4) > Text.length()) {
+		return false;
+	}
+	Out = 0;
+	for (size_t i = 0; i < 4; ++i) {
+		const char c_ = Text[Pos++];
+		Out <<= 4;
+		if ((c_ >= '0') && (c_ <= '9')) {
+			Out |= static_cast<uint32_t>(c_ - '0');
+		} else if ((c_ >= 'a') && (c_ <= 'f')) {
+			Out |= static_cast<uint32_t>(c_ - 'a' + 10);
+		} else if ((c_ >= 'A') && (c_ <= 'F')) {
+			Out |= static_cast<uint32_t>(c_ - 'A' + 10);
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// NAME:    ParseJsonString
+// PURPOSE: Parses the string starting at the quote at 'Pos' into 'Out'.
+auto static ParseJsonString(std::string_view Text, size_t& Pos, std::string& Out)->bool {
+	++Pos; // Opening quote
+	while (Pos < Text.length()) {
+		const char c_ = Text[Pos++];
+		if (c_ == '"') {
+			return true;
+		}
+		if (static_cast<unsigned char>(c_) < 0x20) {
+			return false;
+		}
+		if (c_ != '\\') {
+			Out += c_;
+			continue;
+		}
+		if (Pos >= Text.length()) {
+			return false;
+		}
+		switch (Text[Pos++]) {
+			case '"':  Out += '"';  break;
+			case '\\': Out += '\\'; break;
+			case '/':  Out += '/';  break;
+			case 'b':  Out += '\b'; break;
+			case 'f':  Out += '\f'; break;
+			case 'n':  Out += '\n'; break;
+			case 'r':  Out += '\r'; break;
+			case 't':  Out += '\t'; break;
+			case 'u': {
+				uint32_t cp_ = 0;
+				if (!ParseHex4(Text, Pos, cp_)) {
+					return false;
+				}
+				// A UTF-16 surrogate pair spells one code point:
+				if ((cp_ >= 0xD800) && (cp_ < 0xDC00)) {
+					uint32_t low_ = 0;
+					if (((Pos + 2) > Text.length()) || (Text[Pos] != '\\') 
+						|| (Text[Pos + 1] != 'u')) {
+						return false;
+					}
+					Pos += 2;
+					if (!ParseHex4(Text, Pos, low_) || (low_ < 0xDC00) || (low_ > 0xDFFF)) {
+						return false;
+					}
+					cp_ = 0x10000 + ((cp_ - 0xD800) << 10) + (low_ - 0xDC00);
+				} else if ((cp_ >= 0xDC00) && (cp_ <= 0xDFFF)) {
+					return false;
+				}
+				AppendUTF8(Out, cp_);
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+	return false;
+}
+
+
+// NAME:    SkipJsonNumber
+// PURPOSE: Moves 'Pos' past a number of the JSON grammar: 
+//          -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? 
+//          Returns 'false' if there is none there.
+auto static SkipJsonNumber(std::string_view Text, size_t& Pos)->bool {
+	auto digits_ = [&]()->size_t {
+		const size_t from_ = Pos;
+		while ((Pos < Text.length()) && (Text[Pos] >= '0') && (Text[Pos] <= '9')) {
+			++Pos;
+		}
+		return Pos - from_;
+	};
+	if ((Pos < Text.length()) && (Text[Pos] == '-')) {
+		++Pos;
+	}
+	if ((Pos < Text.length()) && (Text[Pos] == '0')) {
+		++Pos;
+	} else if (digits_() == 0) {
+		return false;
+	}
+	if ((Pos < Text.length()) && (Text[Pos] == '.')) {
+		++Pos;
+		if (digits_() == 0) {
+			return false;
+		}
+	}
+	if ((Pos < Text.length()) && ((Text[Pos] == 'e') || (Text[Pos] == 'E'))) {
+		++Pos;
+		if ((Pos < Text.length()) && ((Text[Pos] == '+') || (Text[Pos] == '-'))) {
+			++Pos;
+		}
+		if (digits_() == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// NAME:    ParseJsonValue
+// PURPOSE: Parses the JSON value at 'Pos' into 'Out'.
+auto static ParseJsonValue(std::string_view Text, 
+						   size_t&          Pos, 
+						   JsonValue&       Out, 
+						   int              Depth)->bool {
+	SkipSpace(Text, Pos);
+	if ((Pos >= Text.length()) || (Depth > kJSON_MAX_DEPTH)) {
+		return false;
+	}
+	const char c_ = Text[Pos];
+	if (c_ == '"') {
+		Out.Kind_ = JsonValue::Kind::String;
+		return ParseJsonString(Text, Pos, Out.Text_);
+	}
+	if (c_ == '[') {
+		Out.Kind_ = JsonValue::Kind::Array;
+		++Pos;
+		SkipSpace(Text, Pos);
+		if ((Pos < Text.length()) && (Text[Pos] == ']')) {
+			++Pos;
+			return true;
+		}
+		while (true) {
+			Out.Items_.emplace_back();
+			if (!ParseJsonValue(Text, Pos, Out.Items_.back(), Depth + 1)) {
+				return false;
+			}
+			SkipSpace(Text, Pos);
+			if (Pos >= Text.length()) {
+				return false;
+			}
+			if (Text[Pos++] == ']') {
+				return true;
+			}
+			if (Text[Pos - 1] != ',') {
+				return false;
+			}
+		}
+	}
+	if (c_ == '{') {
+		Out.Kind_ = JsonValue::Kind::Object;
+		++Pos;
+		SkipSpace(Text, Pos);
+		if ((Pos < Text.length()) && (Text[Pos] == '}')) {
+			++Pos;
+			return true;
+		}
+		while (true) {
+			SkipSpace(Text, Pos);
+			std::string name_;
+			if ((Pos >= Text.length()) || (Text[Pos] != '"') 
+				|| !ParseJsonString(Text, Pos, name_)) {
+				return false;
+			}
+			SkipSpace(Text, Pos);
+			if ((Pos >= Text.length()) || (Text[Pos++] != ':')) {
+				return false;
+			}
+			Out.Members_.emplace_back(std::move(name_), JsonValue());
+			if (!ParseJsonValue(Text, Pos, Out.Members_.back().second, Depth + 1)) {
+				return false;
+			}
+			SkipSpace(Text, Pos);
+			if (Pos >= Text.length()) {
+				return false;
+			}
+			if (Text[Pos++] == '}') {
+				return true;
+			}
+			if (Text[Pos - 1] != ',') {
+				return false;
+			}
+		}
+	}
+	if (Text.substr(Pos, 4) == "true") {
+		Out.Kind_ = JsonValue::Kind::Bool;
+		Out.Bool_ = true;
+		Pos      += 4;
+		return true;
+	}
+	if (Text.substr(Pos, 5) == "false") {
+		Out.Kind_ = JsonValue::Kind::Bool;
+		Pos      += 5;
+		return true;
+	}
+	if (Text.substr(Pos, 4) == "null") {
+		Pos += 4;
+		return true;
+	}
+	// A number, kept as written (only ever echoed back, so it must be one):
+	const size_t start_ = Pos;
+	if (!SkipJsonNumber(Text, Pos)) {
+		return false;
+	}
+	Out.Kind_ = JsonValue::Kind::Number;
+	Out.Text_ = std::string(Text.substr(start_, Pos - start_));
+	return true;
+}
+
+
+// NAME:    FindMember
+// PURPOSE: Returns the member 'Name' of a JSON object, or 'nullptr'.
+auto static FindMember(const JsonValue& Object, std::string_view Name)->const JsonValue* {
+	for (const auto& [name_, value_] : Object.Members_) {
+		if (name_ == Name) {
+			return &value_;
+		}
+	}
+	return nullptr;
+}
+
+
+// NAME:    ParseJsonLine
+// PURPOSE: Parses one request line, which must hold exactly one object.
+auto static ParseJsonLine(std::string_view Line, JsonValue& Out)->bool {
+	size_t pos_ = 0;
+	if (!ParseJsonValue(Line, pos_, Out, 0) || (Out.Kind_ != JsonValue::Kind::Object)) {
+		return false;
+	}
+	SkipSpace(Line, pos_);
+	return pos_ == Line.length();
+}
+
+
+// NAME:    QuoteJson
+// PURPOSE: Appends 'Str' to 'Out' as a JSON string.
+auto static QuoteJson(std::string_view Str, std::string& Out)->void {
+	constexpr static const char kHEX[] = "0123456789abcdef";
+	Out += '"';
+	for (char c_ : Str) {
+		const unsigned char u_ = static_cast<unsigned char>(c_);
+		if (c_ == '"') {
+			Out += "\\\"";
+		} else if (c_ == '\\') {
+			Out += "\\\\";
+		} else if (c_ == '\n') {
+			Out += "\\n";
+		} else if (c_ == '\t') {
+			Out += "\\t";
+		} else if (u_ < 0x20) {
+			Out += "\\u00";
+			Out += kHEX[u_ >> 4];
+			Out += kHEX[u_ & 0xF];
+		} else {
+			Out += c_;
+		}
+	}
+	Out += '"';
+}
+
+
+// NAME:    JsonId
+// PURPOSE: Returns the JSON text of a request's "id" to echo, or "".
+auto static JsonId(const JsonValue& Request)->std::string {
+	const JsonValue* id_ = FindMember(Request, "id");
+	std::string      out_;
+	if (id_ != nullptr) {
+		if (id_->Kind_ == JsonValue::Kind::String) {
+			QuoteJson(id_->Text_, out_);
+		} else if (id_->Kind_ == JsonValue::Kind::Number) {
+			out_ = id_->Text_;
+		}
+	}
+	return out_;
+}
+
+
+// NAME:    BeginReply
+// PURPOSE: Starts a reply object with the request's id and 'ok' flag.
+auto static BeginReply(const std::string& Id, bool Ok)->std::string {
+	std::string out_ = "{";
+	if (!Id.empty()) {
+		out_ += "\"id\":" + Id + ",";
+	}
+	out_ += Ok ? "\"ok\":true" : "\"ok\":false";
+	return out_;
+}
+
+
+// NAME:    ErrorReply
+// PURPOSE: Returns a finished error reply.
+auto static ErrorReply(const std::string& Id, std::string_view Message)->std::string {
+	std::string out_ = BeginReply(Id, false) + ",\"error\":";
+	QuoteJson(Message, out_);
+	return out_ + "}\n";
+}
+
+
+// NAME:    GetPaths
+// PURPOSE: Collects the request's "path" and/or "paths" into 'Out'.
+auto static GetPaths(const JsonValue& Request, std::vector<std::string>& Out)->bool {
+	if (const JsonValue* path_ = FindMember(Request, "path")) {
+		if (path_->Kind_ != JsonValue::Kind::String) {
+			return false;
+		}
+		Out.push_back(path_->Text_);
+	}
+	if (const JsonValue* paths_ = FindMember(Request, "paths")) {
+		if (paths_->Kind_ != JsonValue::Kind::Array) {
+			return false;
+		}
+		for (const JsonValue& item_ : paths_->Items_) {
+			if (item_.Kind_ != JsonValue::Kind::String) {
+				return false;
+			}
+			Out.push_back(item_.Text_);
+		}
+	}
+	return !Out.empty();
+}
+
+
+// NAME:    HandleGet
+// PURPOSE: Answers a 'get' request from the cache.
+auto static HandleGet(TagService&                     Service, 
+					  const JsonValue&                Request, 
+					  const std::string&              Id, 
+					  const std::vector<std::string>& Paths)->std::string {
+	const std::vector<TagField>& fields_ = GetTagFields();
+	std::vector<size_t>          wanted_;
+	if (const JsonValue* names_ = FindMember(Request, "fields")) {
+		if (names_->Kind_ != JsonValue::Kind::Array) {
+			return ErrorReply(Id, "\"fields\" must be an array of field names");
+		}
+		for (const JsonValue& name_ : names_->Items_) {
+			const TagField* field_ = (name_.Kind_ == JsonValue::Kind::String) 
+									 ? FindTagField(name_.Text_) : nullptr;
+			if (field_ == nullptr) {
+				return ErrorReply(Id, "unknown field '" + name_.Text_ + "'");
+			}
+			wanted_.push_back(static_cast<size_t>(field_ - fields_.data()));
+		}
+	}
+	const bool all_ = wanted_.empty();
+	if (all_) {
+		for (size_t f = 0; f < kINDEX_FIELD_COUNT; ++f) {
+			wanted_.push_back(f);
+		}
+	}
+	
+	std::string out_ = BeginReply(Id, true) + ",\"files\":[";
+	for (size_t i = 0; i < Paths.size(); ++i) {
+		out_ += (i == 0) ? "{\"path\":" : ",{\"path\":";
+		QuoteJson(Paths[i], out_);
+		const IndexEntry* entry_ = Service.read(Paths[i]);
+		if (entry_ == nullptr) {
+			out_ += ",\"error\":\"not a file\"}";
+			continue;
+		}
+		out_ += entry_->HasTag_ ? ",\"tagged\":true,\"fields\":{" 
+								: ",\"tagged\":false,\"fields\":{";
+		bool first_ = true;
+		for (size_t f : wanted_) {
+			// Without "fields", empty ones are left out (as by 'mp3edit get'):
+			if (all_ && entry_->Fields_[f].empty()) {
+				continue;
+			}
+			out_ += first_ ? "" : ",";
+			QuoteJson(fields_[f].Name_, out_);
+			out_ += ':';
+			QuoteJson(entry_->Fields_[f], out_);
+			first_ = false;
+		}
+		out_ += "}}";
+	}
+	return out_ + "]}\n";
+}
+
+
+// NAME:    HandleRequest
+// PURPOSE: Handles one request line, adding its reply to 'Conn'.
+auto static HandleRequest(TagService& Service, std::string_view Line, Connection& Conn)->void {
+	Reply     reply_;
+	JsonValue request_;
+	if (!ParseJsonLine(Line, request_)) {
+		reply_.Text_ = ErrorReply("", "malformed request (expected one JSON object)");
+		Conn.Replies_.push_back(std::move(reply_));
+		return;
+	}
+	reply_.Id_ = JsonId(request_);
+	
+	const JsonValue* op_ = FindMember(request_, "op");
+	const std::string opName_ = ((op_ != nullptr) && (op_->Kind_ == JsonValue::Kind::String)) 
+								? op_->Text_ : std::string();
+	std::vector<std::string> paths_;
+	if (opName_ == "get") {
+		reply_.Text_ = GetPaths(request_, paths_) 
+					   ? HandleGet(Service, request_, reply_.Id_, paths_) 
+					   : ErrorReply(reply_.Id_, "get needs \"path\" or \"paths\"");
+	} else if (opName_ == "set") {
+		const JsonValue* values_ = FindMember(request_, "fields");
+		if (!GetPaths(request_, paths_) || (values_ == nullptr) 
+			|| (values_->Kind_ != JsonValue::Kind::Object)) {
+			reply_.Text_ = ErrorReply(reply_.Id_, 
+									  "set needs \"path\" or \"paths\", and \"fields\""
+									  " as an object of field names to values");
+		} else {
+			std::vector<FieldEdit> edits_;
+			for (const auto& [name_, value_] : values_->Members_) {
+				const TagField* field_ = FindTagField(name_);
+				if (field_ == nullptr) {
+					reply_.Text_ = ErrorReply(reply_.Id_, "unknown field '" + name_ + "'");
+					break;
+				}
+				if (value_.Kind_ != JsonValue::Kind::String) {
+					reply_.Text_ = ErrorReply(reply_.Id_, "value of '" + name_
+														  + "' must be a string");
+					break;
+				}
+				edits_.push_back({ field_, value_.Text_ });
+			}
+			if (reply_.Text_.empty()) {
+				reply_.Ready_ = false;
+				for (std::string& path_ : paths_) {
+					if (Service.edit(path_, edits_)) {
+						reply_.Paths_.push_back(std::move(path_));
+					} else {
+						reply_.Missing_.push_back(std::move(path_));
+					}
+				}
+			}
+		}
+	} else if (opName_ == "stats") {
+		const TagServiceStats& stats_ = Service.stats();
+		reply_.Text_ = BeginReply(reply_.Id_, true)
+					   + ",\"cached\":" + std::to_string(Service.size())
+					   + ",\"hits\":" + std::to_string(stats_.CacheHits_)
+					   + ",\"misses\":" + std::to_string(stats_.CacheMisses_)
+					   + ",\"written\":" + std::to_string(stats_.FilesWritten_)
+					   + ",\"merged\":" + std::to_string(stats_.EditsMerged_) + "}\n";
+	} else {
+		reply_.Text_ = ErrorReply(reply_.Id_, "unknown op (expected get, set or stats)");
+	}
+	Conn.Replies_.push_back(std::move(reply_));
+}
+
+
+// NAME:    ReadInput
+// PURPOSE: Reads what is available from a client. Sets 'ReadClosed_' at end of 
+//          input and 'Broken_' on an error.
+auto static ReadInput(Connection& Conn)->void {
+	char buffer_[kREAD_CHUNK];
+	while (!Conn.ReadClosed_) {
+		const ssize_t got_ = ::recv(Conn.Fd_, buffer_, sizeof(buffer_), 0);
+		if (got_ > 0) {
+			Conn.In_.append(buffer_, static_cast<size_t>(got_));
+			continue;
+		}
+		if (got_ == 0) {
+			Conn.ReadClosed_ = true;
+		} else if (errno == EINTR) {
+			continue;
+		} else if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+			Conn.Broken_ = true;
+			Conn.ReadClosed_ = true;
+		}
+		break;
+	}
+}
+
+
+// NAME:    ServiceInput
+// PURPOSE: Handles the complete request lines buffered for a client, unless 
+//          it already has too much output waiting to be read.
+auto static ServiceInput(TagService& Service, Connection& Conn)->void {
+	size_t start_ = 0;
+	while ((Conn.Out_.size() - Conn.Sent_) < kMAX_OUTPUT) {
+		const size_t end_ = Conn.In_.find('\n', start_);
+		if (end_ == std::string::npos) {
+			break;
+		}
+		std::string_view line_(Conn.In_.data() + start_, end_ - start_);
+		if (!line_.empty() && (line_.back() == '\r')) {
+			line_.remove_suffix(1);
+		}
+		if (!line_.empty()) {
+			HandleRequest(Service, line_, Conn);
+		}
+		start_ = end_ + 1;
+	}
+	Conn.In_.erase(0, start_);
+	// The last request need not end with a newline:
+	if (Conn.ReadClosed_ && !Conn.In_.empty() && (Conn.In_.find('\n') == std::string::npos) 
+		&& (Conn.In_.size() <= kMAX_LINE)) {
+		HandleRequest(Service, Conn.In_, Conn);
+		Conn.In_.clear();
+	}
+	if ((Conn.In_.size() > kMAX_LINE) && (Conn.In_.find('\n') == std::string::npos)) {
+		Reply reply_;
+		reply_.Text_ = ErrorReply("", "request too long");
+		Conn.Replies_.push_back(std::move(reply_));
+		Conn.In_.clear();
+		Conn.ReadClosed_ = true;
+	}
+}
+
+
+// NAME:    FinishReplies
+// PURPOSE: Completes the replies waiting on writes, given the files that 
+//          failed, and queues every reply for sending.
+auto static FinishReplies(Connection& Conn, const std::set<std::string>& Failed)->void {
+	for (Reply& reply_ : Conn.Replies_) {
+		if (!reply_.Ready_) {
+			std::string failed_;
+			for (const std::string& path_ : reply_.Missing_) {
+				failed_ += failed_.empty() ? "" : ",";
+				QuoteJson(path_, failed_);
+			}
+			for (const std::string& path_ : reply_.Paths_) {
+				if (Failed.count(path_) != 0) {
+					failed_ += failed_.empty() ? "" : ",";
+					QuoteJson(path_, failed_);
+				}
+			}
+			reply_.Text_ = failed_.empty() 
+						   ? BeginReply(reply_.Id_, true) + "}\n" 
+						   : BeginReply(reply_.Id_, false)
+							 + ",\"error\":\"could not update every file\",\"failed\":["
+							 + failed_ + "]}\n";
+		}
+		Conn.Out_ += reply_.Text_;
+	}
+	Conn.Replies_.clear();
+}
+
+
+// NAME:    WriteOutput
+// PURPOSE: Sends as much of a client's pending output as it will take.
+auto static WriteOutput(Connection& Conn)->void {
+	while (Conn.Sent_ < Conn.Out_.size()) {
+		const ssize_t put_ = ::send(Conn.Fd_, Conn.Out_.data() + Conn.Sent_, 
+									Conn.Out_.size() - Conn.Sent_, MSG_NOSIGNAL);
+		if (put_ > 0) {
+			Conn.Sent_ += static_cast<size_t>(put_);
+			continue;
+		}
+		if ((put_ < 0) && (errno == EINTR)) {
+			continue;
+		}
+		if ((put_ < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+			return;
+		}
+		Conn.Broken_ = true;
+		return;
+	}
+	Conn.Out_.clear();
+	Conn.Sent_ = 0;
+}
+
+
+// NAME:    OpenSocket
+// PURPOSE: Creates the listening socket at 'Path', replacing a stale one left 
+//          by a daemon that is no longer running. Returns -1 on failure.
+auto static OpenSocket(const std::string& Path)->int {
+	sockaddr_un addr_;
+	std::memset(&addr_, 0, sizeof(addr_));
+	addr_.sun_family = AF_UNIX;
+	if (Path.length() >= sizeof(addr_.sun_path)) {
+		std::cerr << "mp3editd: " << Path << ": socket path is too long\n";
+		return -1;
+	}
+	std::memcpy(addr_.sun_path, Path.c_str(), Path.length() + 1);
+	
+	const int fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd_ < 0) {
+		std::cerr << "mp3editd: socket: " << std::strerror(errno) << '\n';
+		return -1;
+	}
+	// Only this user may connect:
+	const mode_t mask_ = ::umask(0077);
+	int          rc_   = ::bind(fd_, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_));
+	if ((rc_ != 0) && (errno == EADDRINUSE)) {
+		const int probe_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		const bool live_ = (probe_ >= 0) 
+						   && (::connect(probe_, reinterpret_cast<const sockaddr*>(&addr_), 
+										 sizeof(addr_)) == 0);
+		if (probe_ >= 0) {
+			::close(probe_);
+		}
+		if (live_) {
+			::umask(mask_);
+			::close(fd_);
+			std::cerr << "mp3editd: " << Path << ": another daemon is running\n";
+			return -1;
+		}
+		::unlink(Path.c_str());
+		rc_ = ::bind(fd_, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_));
+	}
+	::umask(mask_);
+	if ((rc_ != 0) || (::listen(fd_, SOMAXCONN) != 0)) {
+		std::cerr << "mp3editd: " << Path << ": " << std::strerror(errno) << '\n';
+		::close(fd_);
+		return -1;
+	}
+	return fd_;
+}
+
+
+// NAME:    DefaultSocketPath
+// PURPOSE: Returns $XDG_RUNTIME_DIR/mp3editd.sock, or a per-user name in /tmp.
+auto static DefaultSocketPath()->std::string {
+	const char* runtime_ = std::getenv("XDG_RUNTIME_DIR");
+	if ((runtime_ != nullptr) && (runtime_[0] != '\0')) {
+		return std::string(runtime_) + "/mp3editd.sock";
+	}
+	return "/tmp/mp3editd-" + std::to_string(::getuid()) + ".sock";
+}
+
+
+// NAME:    PrintUsage
+// PURPOSE: Prints the command-line help to 'Out'.
+auto static PrintUsage(std::ostream& Out)->void {
+	Out << "usage: mp3editd [-j N] [-s SOCKET]\n"
+		   "\n"
+		   "Serves tag reads and edits to local clients, one JSON request per\n"
+		   "line, over a Unix domain socket (see MP3EditDaemon.cpp).\n"
+		   "\n"
+		   "options:\n"
+		   "  -s SOCKET    listen on SOCKET (default: " << DefaultSocketPath() << ")\n"
+		   "  -j N         write N files at a time (default: one per CPU)\n"
+		   "  -h, --help   show this help\n";
+}
+
+
+// NAME:    ParseArgs
+// PURPOSE: Fills 'Opts' from the command line. Returns 'kEXIT_OK' on success, 
+//          -1 after '--help', or the exit code to stop with.
+auto static ParseArgs(int argc, char* argv[], DaemonOptions& Opts)->int {
+	Opts.SocketPath_ = DefaultSocketPath();
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg_ = argv[i];
+		if ((arg_ == "-h") || (arg_ == "--help")) {
+			PrintUsage(std::cout);
+			return -1;
+		}
+		if ((arg_ == "-s") && ((i + 1) < argc)) {
+			Opts.SocketPath_ = argv[++i];
+			continue;
+		}
+		if ((arg_ == "-j") && ((i + 1) < argc)) {
+			char*              end_   = nullptr;
+			unsigned long long value_ = std::strtoull(argv[++i], &end_, 10);
+			if ((*end_ == '\0') && (value_ != 0)) {
+				Opts.Threads_ = static_cast<size_t>(value_);
+				continue;
+			}
+		}
+		std::cerr << "mp3editd: bad argument '" << arg_ << "'\n"
+				  << "Try 'mp3editd --help' for more information.\n";
+		return kEXIT_USAGE;
+	}
+	return kEXIT_OK;
+}
+
+
+// NAME:    Serve
+// PURPOSE: Runs the event loop on 'ListenFd' until SIGINT/SIGTERM. Each round 
+//          reads every client that has input, handles its complete requests, 
+//          writes the edited files, then sends the replies.
+auto static Serve(int ListenFd, TagService& Service)->int {
+	const int epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_ < 0) {
+		std::cerr << "mp3editd: epoll: " << std::strerror(errno) << '\n';
+		return kEXIT_FAILURE;
+	}
+	epoll_event listen_{};
+	listen_.events  = EPOLLIN;
+	listen_.data.fd = ListenFd;
+	if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, ListenFd, &listen_) != 0) {
+		std::cerr << "mp3editd: epoll_ctl: " << std::strerror(errno) << '\n';
+		::close(epoll_);
+		return kEXIT_FAILURE;
+	}
+	
+	std::unordered_map<int, std::unique_ptr<Connection>> conns_;
+	epoll_event                                          events_[kMAX_EVENTS];
+	
+	// Closes a client (closing the socket also takes it out of the epoll set, 
+	// so a failed 'EPOLL_CTL_DEL' changes nothing):
+	auto drop_ = [&](int Fd) {
+		static_cast<void>(::epoll_ctl(epoll_, EPOLL_CTL_DEL, Fd, nullptr));
+		::close(Fd);
+		conns_.erase(Fd);
+	};
+	while (!s_StopRequested_) {
+		const int count_ = ::epoll_wait(epoll_, events_, kMAX_EVENTS, -1);
+		if ((count_ < 0) && (errno != EINTR)) {
+			std::cerr << "mp3editd: epoll_wait: " << std::strerror(errno) << '\n';
+			break;
+		}
+		
+		std::vector<Connection*> active_;
+		for (int e = 0; e < count_; ++e) {
+			if (events_[e].data.fd == ListenFd) {
+				int fd_;
+				while ((fd_ = ::accept4(ListenFd, nullptr, nullptr, 
+										SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+					auto conn_     = std::make_unique<Connection>();
+					conn_->Fd_     = fd_;
+					conn_->Events_ = EPOLLIN;
+					epoll_event ev_{};
+					ev_.events  = EPOLLIN;
+					ev_.data.fd = fd_;
+					if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd_, &ev_) != 0) {
+						// A client the loop cannot watch would never be answered:
+						std::cerr << "mp3editd: epoll_ctl: " << std::strerror(errno) << '\n';
+						::close(fd_);
+						continue;
+					}
+					conns_.emplace(fd_, std::move(conn_));
+				}
+				continue;
+			}
+			auto found_ = conns_.find(events_[e].data.fd);
+			if (found_ == conns_.end()) {
+				continue;
+			}
+			Connection& conn_ = *found_->second;
+			if (events_[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+				ReadInput(conn_);
+			}
+			active_.push_back(&conn_);
+		}
+		
+		// Handle the requests, write the files once, then answer:
+		for (Connection* conn_ : active_) {
+			ServiceInput(Service, *conn_);
+		}
+		std::vector<std::string>    failedList_ = Service.flush();
+		const std::set<std::string> failed_(failedList_.begin(), failedList_.end());
+		for (Connection* conn_ : active_) {
+			FinishReplies(*conn_, failed_);
+			WriteOutput(*conn_);
+			// A client that was held back for its unread output may continue:
+			if (!conn_->In_.empty() && ((conn_->Out_.size() - conn_->Sent_) < kMAX_OUTPUT)) {
+				ServiceInput(Service, *conn_);
+				std::vector<std::string>    more_ = Service.flush();
+				FinishReplies(*conn_, std::set<std::string>(more_.begin(), more_.end()));
+				WriteOutput(*conn_);
+			}
+		}
+		
+		for (Connection* conn_ : active_) {
+			const size_t unsent_  = conn_->Out_.size() - conn_->Sent_;
+			const bool   pending_ = unsent_ != 0;
+			if (conn_->Broken_ || (conn_->ReadClosed_ && !pending_)) {
+				drop_(conn_->Fd_);
+				continue;
+			}
+			// Stop reading while output backs up; watch for room to write:
+			uint32_t want_ = 0;
+			if (!conn_->ReadClosed_ && (unsent_ < kMAX_OUTPUT)) {
+				want_ |= EPOLLIN;
+			}
+			if (pending_) {
+				want_ |= EPOLLOUT;
+			}
+			if (want_ != conn_->Events_) {
+				epoll_event ev_{};
+				ev_.events     = want_;
+				ev_.data.fd    = conn_->Fd_;
+				conn_->Events_ = want_;
+				if (::epoll_ctl(epoll_, EPOLL_CTL_MOD, conn_->Fd_, &ev_) != 0) {
+					std::cerr << "mp3editd: epoll_ctl: " << std::strerror(errno) << '\n';
+					drop_(conn_->Fd_);
+				}
+			}
+		}
+	}
+	
+	for (auto& [fd_, conn_] : conns_) {
+		::close(fd_);
+	}
+	::close(epoll_);
+	return kEXIT_OK;
+}
+
+
+/* ****************************** ENTRY POINT ******************************* */
+int main(int argc, char* argv[]) {
+	DaemonOptions opts_;
+	int           status_ = ParseArgs(argc, argv, opts_);
+	if (status_ < 0) {
+		return kEXIT_OK; // '--help'
+	}
+	if (status_ != kEXIT_OK) {
+		return status_;
+	}
+	
+	const int listen_ = OpenSocket(opts_.SocketPath_);
+	if (listen_ < 0) {
+		return kEXIT_FAILURE;
+	}
+	std::signal(SIGINT, OnStopSignal);
+	std::signal(SIGTERM, OnStopSignal);
+	std::signal(SIGPIPE, SIG_IGN);
+	
+	BatchOptions batch_;
+	batch_.Threads_           = opts_.Threads_;
+	batch_.CreateMissingTags_ = true;
+	TagService service_(batch_);
+	std::cerr << "mp3editd: listening on " << opts_.SocketPath_ << '\n';
+	status_ = Serve(listen_, service_);
+	
+	::close(listen_);
+	::unlink(opts_.SocketPath_.c_str());
+	return status_;
+}
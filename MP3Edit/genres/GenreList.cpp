@@ -2,362 +2,390 @@
 // PROJECT NAME:  MP3Edit
 // COPYRIGHT:     Copyright  2022 Sean Cassell <sean.cassell@outlook.com>
 // FILENAME:      GenreList.cpp
-// FILE PURPOSE:  Defines a function that provides a vector of genres.
+// FILE PURPOSE:  Defines the table of standard genres, built at compile time, 
+//                and the functions that look genres up and turn the contents 
+//                of a TCON frame ("(17)", "(4)(Eurodance)", "Rock", ...) into 
+//                one genre name. None of them allocates.
 
 
 /* **************************** INCLUDED HEADERS **************************** */
-#include <SDKDDKVer.h> // Master include file for versioning Windows SDK/DDK
+// C++ STANDARD LIBRARY/STL HEADERS:
+#include <array>
 
 // PROJECT-SPECIFIC HEADERS:
 #include "GenreList.hpp"
 
-// WINDOWS SDK HEADERS:
-// For a list and description of child header files included by <Windows.h>, see
-// the following entry on Wikipedia: https://en.wikipedia.org/wiki/Windows.h
-#include <tchar.h>    // Definitions for generic international text functions
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+constexpr static const std::string_view kGENRE_NAMES[kGENRE_COUNT] = {
+	"Blues",                 "Classic Rock",          "Country",                   // 0
+	"Dance",                 "Disco",                 "Funk",                      // 3
+	"Grunge",                "Hip-Hop",               "Jazz",                      // 6
+	"Metal",                 "New Age",               "Oldies",                    // 9
+	"Other",                 "Pop",                   "R&B",                       // 12
+	"Rap",                   "Reggae",                "Rock",                      // 15
+	"Techno",                "Industrial",            "Alternative",               // 18
+	"Ska",                   "Death Metal",           "Pranks",                    // 21
+	"Soundtrack",            "Euro-Techno",           "Ambient",                   // 24
+	"Trip-Hop",              "Vocal",                 "Jazz+Funk",                 // 27
+	"Fusion",                "Trance",                "Classical",                 // 30
+	"Instrumental",          "Acid",                  "House",                     // 33
+	"Game",                  "Sound Clip",            "Gospel",                    // 36
+	"Noise",                 "AlternRock",            "Bass",                      // 39
+	"Soul",                  "Punk",                  "Space",                     // 42
+	"Meditative",            "Instrumental Pop",      "Instrumental Rock",         // 45
+	"Ethnic",                "Gothic",                "Darkwave",                  // 48
+	"Techno-Industrial",     "Electronic",            "Pop-Folk",                  // 51
+	"Eurodance",             "Dream",                 "Southern Rock",             // 54
+	"Comedy",                "Cult",                  "Gangsta",                   // 57
+	"Top 40",                "Christian Rap",         "Pop/Funk",                  // 60
+	"Jungle",                "Native American",       "Cabaret",                   // 63
+	"New Wave",              "Psychadelic",           "Rave",                      // 66
+	"Showtunes",             "Trailer",               "Lo-Fi",                     // 69
+	"Tribal",                "Acid Punk",             "Acid Jazz",                 // 72
+	"Polka",                 "Retro",                 "Musical",                   // 75
+	"Rock & Roll",           "Hard Rock",             "Folk",                      // 78
+	"Folk-Rock",             "National Folk",         "Swing",                     // 81
+	"Fast Fusion",           "Bebop",                 "Latin",                     // 84
+	"Revival",               "Celtic",                "Bluegrass",                 // 87
+	"Avantgarde",            "Gothic Rock",           "Progressive Rock",          // 90
+	"Psychedelic Rock",      "Symphonic Rock",        "Slow Rock",                 // 93
+	"Big Band",              "Chorus",                "Easy Listening",            // 96
+	"Acoustic",              "Humour",                "Speech",                    // 99
+	"Chanson",               "Opera",                 "Chamber Music",             // 102
+	"Sonata",                "Symphony",              "Booty Bass",                // 105
+	"Primus",                "Porn Groove",           "Satire",                    // 108
+	"Slow Jam",              "Club",                  "Tango",                     // 111
+	"Samba",                 "Folklore",              "Ballad",                    // 114
+	"Power Ballad",          "Rhythmic Soul",         "Freestyle",                 // 117
+	"Duet",                  "Punk Rock",             "Drum Solo",                 // 120
+	"A Cappella",            "Euro-House",            "Dance Hall",                // 123
+	"Goa",                   "Drum & Bass",           "Club-House",                // 126
+	"Hardcore Techno",       "Terror",                "Indie",                     // 129
+	"BritPop",               "Afro-Punk",             "Polsk Punk",                // 132
+	"Beat",                  "Christian Gangsta Rap", "Heavy Metal",               // 135
+	"Black Metal",           "Crossover",             "Contemporary Christian",    // 138
+	"Christian Rock",        "Merengue",              "Salsa",                     // 141
+	"Thrash Metal",          "Anime",                 "JPop",                      // 144
+	"Synthpop",              "Abstract",              "Art Rock",                  // 147
+	"Baroque",               "Bhangra",               "Big Beat",                  // 150
+	"Breakbeat",             "Chillout",              "Downtempo",                 // 153
+	"Dub",                   "EBM",                   "Eclectic",                  // 156
+	"Electro",               "Electroclash",          "Emo",                       // 159
+	"Experimental",          "Garage",                "Global",                    // 162
+	"IDM",                   "Illbient",              "Industro-Goth",             // 165
+	"Jam Band",              "Krautrock",             "Leftfield",                 // 168
+	"Lounge",                "Math Rock",             "New Romantic",              // 171
+	"Nu-Breakz",             "Post-Punk",             "Post-Rock",                 // 174
+	"Psytrance",             "Shoegaze",              "Space Rock",                // 177
+	"Trop Rock",             "World Music",           "Neoclassical",              // 180
+	"Audiobook",             "Audio Theatre",         "Neue Deutsche Welle",       // 183
+	"Podcast",               "Indie Rock",            "G-Funk",                    // 186
+	"Dubstep",               "Garage Rock",           "Psybient",                  // 189
+};
+
+// Name lookup uses a perfect hash ("hash and displace"): a name's hash picks a 
+// bucket, and the bucket's displacement picks the name's slot, so that no two
+// names share one:
+constexpr static const uint32_t kHASH_BUCKETS = 64;
+constexpr static const uint32_t kHASH_SLOTS   = 256; // Power of two
+constexpr static const uint8_t  kEMPTY_SLOT   = 0xFF;
+
+
+/* ******************************* STRUCTURES ******************************* */
+struct GenreHash {
+	std::array<uint8_t, kHASH_BUCKETS> Displace_{};
+	std::array<uint8_t, kHASH_SLOTS>   Slots_{};   // Genre id, or 'kEMPTY_SLOT'
+	bool                               Perfect_ = true;
+};
+
+
+/* **************************** STATIC FUNCTIONS **************************** */
+//
+//    FUNCTION: ToLowerAscii(char) 
+//
+//    RETURNS:  char 
+//
+//    PURPOSE:  Lowercases an ASCII letter; leaves anything else alone. 
+//
+constexpr auto static ToLowerAscii(char C)->char {
+	return ((C >= 'A') && (C <= 'Z')) ? static_cast<char>(C - 'A' + 'a') : C;
+}
+
+
+//
+//    FUNCTION: HashName(std::string_view) 
+//
+//    RETURNS:  uint64_t 
+//
+//    PURPOSE:  Hashes a genre name, ignoring ASCII case (64-bit FNV-1a). 
+//
+constexpr auto static HashName(std::string_view Name)->uint64_t {
+	uint64_t hash_ = 14695981039346656037ull;
+	for (char c_ : Name) {
+		hash_ ^= static_cast<unsigned char>(ToLowerAscii(c_));
+		hash_ *= 1099511628211ull;
+	}
+	return hash_ ^ (hash_ >> 29);
+}
+
+
+//
+//    FUNCTION: SlotOf(uint64_t, uint32_t) 
+//
+//    RETURNS:  uint32_t 
+//
+//    PURPOSE:  Returns the slot of a name with hash 'Hash' in a bucket with 
+//              displacement 'Displace'. The step is odd, so a bucket can 
+//              reach every slot. 
+//
+constexpr auto static SlotOf(uint64_t Hash, uint32_t Displace)->uint32_t {
+	const uint32_t base_ = static_cast<uint32_t>(Hash >> 16);
+	const uint32_t step_ = static_cast<uint32_t>(Hash >> 40) | 1;
+	return (base_ + (Displace * step_)) & (kHASH_SLOTS - 1);
+}
+
+
+//
+//    FUNCTION: BuildGenreHash() 
+//
+//    RETURNS:  GenreHash 
+//
+//    PURPOSE:  Builds the perfect hash of 'kGENRE_NAMES': buckets are placed 
+//              largest first, each with the first displacement that puts all 
+//              of its names in free slots. 
+//
+constexpr auto static BuildGenreHash()->GenreHash {
+	GenreHash table_;
+	for (uint8_t& slot_ : table_.Slots_) {
+		slot_ = kEMPTY_SLOT;
+	}
+	std::array<uint64_t, kGENRE_COUNT>   hashes_{};
+	std::array<uint32_t, kHASH_BUCKETS> sizes_{};
+	for (uint32_t id_ = 0; id_ < kGENRE_COUNT; ++id_) {
+		hashes_[id_] = HashName(kGENRE_NAMES[id_]);
+		++sizes_[hashes_[id_] % kHASH_BUCKETS];
+	}
+	
+	std::array<bool, kHASH_BUCKETS> placed_{};
+	for (uint32_t n = 0; n < kHASH_BUCKETS; ++n) {
+		uint32_t bucket_ = 0;
+		for (uint32_t b = 0; b < kHASH_BUCKETS; ++b) {
+			if (!placed_[b] && (placed_[bucket_] || (sizes_[b] > sizes_[bucket_]))) {
+				bucket_ = b;
+			}
+		}
+		placed_[bucket_] = true;
+		
+		bool fits_ = false;
+		for (uint32_t d = 0; (d < kHASH_SLOTS) && !fits_; ++d) {
+			// Claim the slots, and give them back if any name does not fit:
+			fits_ = true;
+			for (uint32_t id_ = 0; id_ < kGENRE_COUNT; ++id_) {
+				if ((hashes_[id_] % kHASH_BUCKETS) != bucket_) {
+					continue;
+				}
+				uint8_t& slot_ = table_.Slots_[SlotOf(hashes_[id_], d)];
+				if (slot_ != kEMPTY_SLOT) {
+					fits_ = false;
+					break;
+				}
+				slot_ = static_cast<uint8_t>(id_);
+			}
+			if (!fits_) {
+				for (uint8_t& slot_ : table_.Slots_) {
+					if ((slot_ != kEMPTY_SLOT) 
+						&& ((hashes_[slot_] % kHASH_BUCKETS) == bucket_)) {
+						slot_ = kEMPTY_SLOT;
+					}
+				}
+				continue;
+			}
+			table_.Displace_[bucket_] = static_cast<uint8_t>(d);
+		}
+		table_.Perfect_ = table_.Perfect_ && fits_;
+	}
+	return table_;
+}
+
+
+constexpr static const GenreHash kGENRE_HASH = BuildGenreHash();
+static_assert(kGENRE_HASH.Perfect_, "genre names do not hash perfectly; change kHASH_*");
+
+
+//
+//    FUNCTION: EqualsIgnoreCase(std::string_view, std::string_view) 
+//
+//    RETURNS:  bool 
+//
+//    PURPOSE:  Compares two strings, ignoring ASCII case. 
+//
+auto static EqualsIgnoreCase(std::string_view A, std::string_view B)->bool {
+	if (A.length() != B.length()) {
+		return false;
+	}
+	for (size_t i = 0; i < A.length(); ++i) {
+		if (ToLowerAscii(A[i]) != ToLowerAscii(B[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+//
+//    FUNCTION: Trim(std::string_view) 
+//
+//    RETURNS:  std::string_view 
+//
+//    PURPOSE:  Strips leading and trailing spaces (and NULs, which some 
+//              taggers leave at the end of a frame). 
+//
+auto static Trim(std::string_view Text)->std::string_view {
+	while (!Text.empty() && ((Text.front() == ' ') || (Text.front() == '\0'))) {
+		Text.remove_prefix(1);
+	}
+	while (!Text.empty() && ((Text.back() == ' ') || (Text.back() == '\0'))) {
+		Text.remove_suffix(1);
+	}
+	return Text;
+}
+
+
+//
+//    FUNCTION: ParseGenreNumber(std::string_view) 
+//
+//    RETURNS:  uint32_t 
+//
+//    PURPOSE:  Parses a genre number of up to three digits. Returns 
+//              'kGENRE_NONE' if 'Text' is not one. 
+//
+auto static ParseGenreNumber(std::string_view Text)->uint32_t {
+	if (Text.empty() || (Text.length() > 3)) {
+		return kGENRE_NONE;
+	}
+	uint32_t id_ = 0;
+	for (char c_ : Text) {
+		if ((c_ < '0') || (c_ > '9')) {
+			return kGENRE_NONE;
+		}
+		id_ = (id_ * 10) + static_cast<uint32_t>(c_ - '0');
+	}
+	return id_;
+}
+
+
+//
+//    FUNCTION: CanonicalName(std::string_view) 
+//
+//    RETURNS:  std::string_view 
+//
+//    PURPOSE:  Returns the table's spelling of a standard genre name (so 
+//              "hip-hop" becomes "Hip-Hop"), or 'Name' itself. 
+//
+auto static CanonicalName(std::string_view Name)->std::string_view {
+	const uint32_t id_ = FindGenreId(Name);
+	return (id_ != kGENRE_NONE) ? kGENRE_NAMES[id_] : Name;
+}
 
 
 /* ************************** FUNCTION DEFINITIONS ************************** */
 //
-//    FUNCTION: getGenreList()
+//    FUNCTION: GetGenreName(uint32_t) 
+//
+//    RETURNS:  std::string_view 
+//
+//    PURPOSE:  Returns the name of genre 'Id', or "" if there is no such genre. 
+//
+auto GetGenreName(uint32_t Id)->std::string_view {
+	return (Id < kGENRE_COUNT) ? kGENRE_NAMES[Id] : std::string_view();
+}
+
+
+//
+//    FUNCTION: FindGenreId(std::string_view) 
+//
+//    RETURNS:  uint32_t 
+//
+//    PURPOSE:  Returns the id of the genre named 'Name' (ignoring ASCII case), 
+//              or 'kGENRE_NONE' if it is not a standard genre. 
+//
+auto FindGenreId(std::string_view Name)->uint32_t {
+	const uint64_t hash_ = HashName(Name);
+	const uint32_t slot_ = SlotOf(hash_, kGENRE_HASH.Displace_[hash_ % kHASH_BUCKETS]);
+	const uint8_t  id_   = kGENRE_HASH.Slots_[slot_];
+	return ((id_ != kEMPTY_SLOT) && EqualsIgnoreCase(kGENRE_NAMES[id_], Name)) 
+		   ? id_ : kGENRE_NONE;
+}
+
+
+//
+//    FUNCTION: ResolveGenre(std::string_view) 
+//
+//    RETURNS:  std::string_view 
+//
+//    PURPOSE:  Turns the text of a TCON frame into one genre name:
+//                  "(17)", "17", "rock"   ->  "Rock" 
+//                  "(4)Eurodisco"         ->  "Eurodisco" (refinement wins) 
+//                  "(4)(Eurodance)"       ->  "Eurodance" 
+//                  "(RX)", "(CR)"         ->  "Remix", "Cover" 
+//                  "((Foo)"               ->  "(Foo)" 
+//              Standard names come back as spelled in the table; anything 
+//              else is returned as given, less surrounding spaces. The result 
+//              points into the table or into 'Tcon'. 
+//
+auto ResolveGenre(std::string_view Tcon)->std::string_view {
+	Tcon = Trim(Tcon);
+	std::string_view reference_;  // First genre referred to by number
+	std::string_view refinement_; // Last name given in parentheses
+	while (!Tcon.empty() && (Tcon.front() == '(')) {
+		if ((Tcon.length() > 1) && (Tcon[1] == '(')) {
+			return Tcon.substr(1); // "((" stands for a literal '('
+		}
+		const size_t close_ = Tcon.find(')');
+		if (close_ == std::string_view::npos) {
+			break;
+		}
+		const std::string_view inner_ = Trim(Tcon.substr(1, close_ - 1));
+		Tcon = Trim(Tcon.substr(close_ + 1));
+		
+		const uint32_t id_ = ParseGenreNumber(inner_);
+		std::string_view name_;
+		if (id_ < kGENRE_COUNT) {
+			name_ = kGENRE_NAMES[id_];
+		} else if (inner_ == "RX") {
+			name_ = "Remix";
+		} else if (inner_ == "CR") {
+			name_ = "Cover";
+		} else if (id_ == kGENRE_NONE) {
+			refinement_ = inner_.empty() ? refinement_ : inner_;
+		}
+		reference_ = reference_.empty() ? name_ : reference_;
+	}
+	
+	// Text after the references refines them:
+	if (!Tcon.empty()) {
+		const uint32_t id_ = ParseGenreNumber(Tcon);
+		if (id_ < kGENRE_COUNT) {
+			return kGENRE_NAMES[id_]; // ID3v2.4 drops the parentheses
+		}
+		return CanonicalName(Tcon);
+	}
+	return refinement_.empty() ? reference_ : CanonicalName(refinement_);
+}
+
+
+//
+//    FUNCTION: NormalizeGenre(std::string&)
 //    
-//    RETURNS:  std::vector<_Genre>
+//    RETURNS:  void
 //    
-//    PURPOSE:  
+//    PURPOSE:  Replaces the text of a TCON frame with 'ResolveGenre()' of it, 
+//              in place; a value that is already a plain name is untouched.
 //
-auto getGenreList()->std::vector<_Genre> {
-	std::vector<_Genre> list;
-	list.reserve(82);
-	
-	_Genre _temp;
-	
-	_temp._id = 0;
-	_temp._value = _T("Blues");
-	list.emplace_back(_temp);
-	
-	_temp._id = 1;
-	_temp._value = _T("Classic Rock");
-	list.emplace_back(_temp);
-	
-	_temp._id = 2;
-	_temp._value = _T("Country");
-	list.emplace_back(_temp);
-	
-	_temp._id = 3;
-	_temp._value = _T("Dance");
-	list.emplace_back(_temp);
-	
-	_temp._id = 4;
-	_temp._value = _T("Disco");
-	list.emplace_back(_temp);
-	
-	_temp._id = 5;
-	_temp._value = _T("Funk");
-	list.emplace_back(_temp);
-	
-	_temp._id = 6;
-	_temp._value = _T("Grunge");
-	list.emplace_back(_temp);
-	
-	_temp._id = 7;
-	_temp._value = _T("Hip-Hop");
-	list.emplace_back(_temp);
-	
-	_temp._id = 8;
-	_temp._value = _T("Jazz");
-	list.emplace_back(_temp);
-	
-	_temp._id = 9;
-	_temp._value = _T("Metal");
-	list.emplace_back(_temp);
-	
-	_temp._id = 10;
-	_temp._value = _T("New Age");
-	list.emplace_back(_temp);
-	
-	_temp._id = 11;
-	_temp._value = _T("Oldies");
-	list.emplace_back(_temp);
-	
-	_temp._id = 12;
-	_temp._value = _T("Other");
-	list.emplace_back(_temp);
-	
-	_temp._id = 13;
-	_temp._value = _T("Pop");
-	list.emplace_back(_temp);
-	
-	_temp._id = 14;
-	_temp._value = _T("R&B");
-	list.emplace_back(_temp);
-	
-	_temp._id = 15;
-	_temp._value = _T("Rap");
-	list.emplace_back(_temp);
-	
-	_temp._id = 16;
-	_temp._value = _T("Reggae");
-	list.emplace_back(_temp);
-	
-	_temp._id = 17;
-	_temp._value = _T("Rock");
-	list.emplace_back(_temp);
-	
-	_temp._id = 18;
-	_temp._value = _T("Techno");
-	list.emplace_back(_temp);
-	
-	_temp._id = 19;
-	_temp._value = _T("Industrial");
-	list.emplace_back(_temp);
-	
-	_temp._id = 20;
-	_temp._value = _T("Alternative");
-	list.emplace_back(_temp);
-	
-	_temp._id = 21;
-	_temp._value = _T("Ska");
-	list.emplace_back(_temp);
-	
-	_temp._id = 22;
-	_temp._value = _T("Death Metal");
-	list.emplace_back(_temp);
-	
-	_temp._id = 23;
-	_temp._value = _T("Pranks");
-	list.emplace_back(_temp);
-	
-	_temp._id = 24;
-	_temp._value = _T("Soundtrack");
-	list.emplace_back(_temp);
-	
-	_temp._id = 25;
-	_temp._value = _T("Euro-Techno");
-	list.emplace_back(_temp);
-	
-	_temp._id = 26;
-	_temp._value = _T("Ambient");
-	list.emplace_back(_temp);
-	
-	_temp._id = 27;
-	_temp._value = _T("Trip-Hop");
-	list.emplace_back(_temp);
-	
-	_temp._id = 28;
-	_temp._value = _T("Vocal");
-	list.emplace_back(_temp);
-	
-	_temp._id = 29;
-	_temp._value = _T("Jazz+Funk");
-	list.emplace_back(_temp);
-	
-	_temp._id = 30;
-	_temp._value = _T("Fusion");
-	list.emplace_back(_temp);
-	
-	_temp._id = 31;
-	_temp._value = _T("Trance");
-	list.emplace_back(_temp);
-	
-	_temp._id = 32;
-	_temp._value = _T("Classical");
-	list.emplace_back(_temp);
-	
-	_temp._id = 33;
-	_temp._value = _T("Instrumental");
-	list.emplace_back(_temp);
-	
-	_temp._id = 34;
-	_temp._value = _T("Acid");
-	list.emplace_back(_temp);
-	
-	_temp._id = 35;
-	_temp._value = _T("House");
-	list.emplace_back(_temp);
-	
-	_temp._id = 36;
-	_temp._value = _T("Game");
-	list.emplace_back(_temp);
-	
-	_temp._id = 37;
-	_temp._value = _T("Sound Clip");
-	list.emplace_back(_temp);
-	
-	_temp._id = 38;
-	_temp._value = _T("Gospel");
-	list.emplace_back(_temp);
-	
-	_temp._id = 39;
-	_temp._value = _T("Noise");
-	list.emplace_back(_temp);
-	
-	_temp._id = 40;
-	_temp._value = _T("AlternRock");
-	list.emplace_back(_temp);
-	
-	_temp._id = 41;
-	_temp._value = _T("Bass");
-	list.emplace_back(_temp);
-	
-	_temp._id = 42;
-	_temp._value = _T("Soul");
-	list.emplace_back(_temp);
-	
-	_temp._id = 43;
-	_temp._value = _T("Punk");
-	list.emplace_back(_temp);
-	
-	_temp._id = 44;
-	_temp._value = _T("Space");
-	list.emplace_back(_temp);
-	
-	_temp._id = 45;
-	_temp._value = _T("Meditative");
-	list.emplace_back(_temp);
-	
-	_temp._id = 46;
-	_temp._value = _T("Instrumental Pop");
-	list.emplace_back(_temp);
-	
-	_temp._id = 47;
-	_temp._value = _T("Instrumental Rock");
-	list.emplace_back(_temp);
-	
-	_temp._id = 48;
-	_temp._value = _T("Ethnic");
-	list.emplace_back(_temp);
-	
-	_temp._id = 49;
-	_temp._value = _T("Gothic");
-	list.emplace_back(_temp);
-	
-	_temp._id = 50;
-	_temp._value = _T("Darkwave");
-	list.emplace_back(_temp);
-	
-	_temp._id = 51;
-	_temp._value = _T("Techno-Industrial");
-	list.emplace_back(_temp);
-	
-	_temp._id = 52;
-	_temp._value = _T("Electronic");
-	list.emplace_back(_temp);
-	
-	_temp._id = 53;
-	_temp._value = _T("Pop-Folk");
-	list.emplace_back(_temp);
-	
-	_temp._id = 54;
-	_temp._value = _T("Eurodance");
-	list.emplace_back(_temp);
-	
-	_temp._id = 55;
-	_temp._value = _T("Dream");
-	list.emplace_back(_temp);
-	
-	_temp._id = 56;
-	_temp._value = _T("Southern Rock");
-	list.emplace_back(_temp);
-	
-	_temp._id = 57;
-	_temp._value = _T("Comedy");
-	list.emplace_back(_temp);
-	
-	_temp._id = 58;
-	_temp._value = _T("Cult");
-	list.emplace_back(_temp);
-	
-	_temp._id = 59;
-	_temp._value = _T("Gangsta");
-	list.emplace_back(_temp);
-	
-	_temp._id = 60;
-	_temp._value = _T("Top 40");
-	list.emplace_back(_temp);
-	
-	_temp._id = 61;
-	_temp._value = _T("Christian Rap");
-	list.emplace_back(_temp);
-	
-	_temp._id = 62;
-	_temp._value = _T("Pop/Funk");
-	list.emplace_back(_temp);
-	
-	_temp._id = 63;
-	_temp._value = _T("Jungle");
-	list.emplace_back(_temp);
-	
-	_temp._id = 64;
-	_temp._value = _T("Native American");
-	list.emplace_back(_temp);
-	
-	_temp._id = 65;
-	_temp._value = _T("Cabaret");
-	list.emplace_back(_temp);
-	
-	_temp._id = 66;
-	_temp._value = _T("New Wave");
-	list.emplace_back(_temp);
-	
-	_temp._id = 67;
-	_temp._value = _T("Psychadelic");
-	list.emplace_back(_temp);
-	
-	_temp._id = 68;
-	_temp._value = _T("Rave");
-	list.emplace_back(_temp);
-	
-	_temp._id = 69;
-	_temp._value = _T("Showtunes");
-	list.emplace_back(_temp);
-	
-	_temp._id = 70;
-	_temp._value = _T("Trailer");
-	list.emplace_back(_temp);
-	
-	_temp._id = 71;
-	_temp._value = _T("Lo-Fi");
-	list.emplace_back(_temp);
-	
-	_temp._id = 72;
-	_temp._value = _T("Tribal");
-	list.emplace_back(_temp);
-	
-	_temp._id = 73;
-	_temp._value = _T("Acid Punk");
-	list.emplace_back(_temp);
-	
-	_temp._id = 74;
-	_temp._value = _T("Acid Jazz");
-	list.emplace_back(_temp);
-	
-	_temp._id = 75;
-	_temp._value = _T("Polka");
-	list.emplace_back(_temp);
-	
-	_temp._id = 76;
-	_temp._value = _T("Retro");
-	list.emplace_back(_temp);
-	
-	_temp._id = 77;
-	_temp._value = _T("Musical");
-	list.emplace_back(_temp);
-	
-	_temp._id = 78;
-	_temp._value = _T("Rock & Roll");
-	list.emplace_back(_temp);
-	
-	_temp._id = 79;
-	_temp._value = _T("Hard Rock");
-	list.emplace_back(_temp);
-	
-	_temp._id = 80;
-	_temp._value = _T("Podcast");
-	list.emplace_back(_temp);
-	
-	_temp._id = 81;
-	_temp._value = _T("Audiobook");
-	list.emplace_back(_temp);
-	
-	return list;
+auto NormalizeGenre(std::string& Genre)->void {
+	const std::string_view genre_ = ResolveGenre(Genre);
+	if ((genre_.data() != Genre.data()) || (genre_.length() != Genre.length())) {
+		Genre.assign(genre_.data(), genre_.length());
+	}
 }
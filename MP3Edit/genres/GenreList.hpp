@@ -4,17 +4,21 @@
 
 /* **************************** INCLUDED HEADERS **************************** */
 // C++ STANDARD LIBRARY/STL HEADERS:
-#include <new>
 #include <string>
-#include <vector>
+#include <string_view>
 
+// C RUNTIME COMPATIBILITY HEADERS:
+#include <cinttypes>
 
-/* ******************************* STRUCTURES ******************************* */
-typedef struct __genre {
-	uint32_t    _id;
-	std::string _value;
-} _Genre;
+
+/* ************************** CONSTEXPR CONSTANTS *************************** */
+// The ID3v1 genres (0-79) and Winamp's extensions to them (80-191):
+constexpr static const uint32_t kGENRE_COUNT = 192;
+constexpr static const uint32_t kGENRE_NONE  = UINT32_MAX;
 
 
 /* ************************** FUNCTION PROTOTYPES *************************** */
-auto getGenreList()->std::vector<_Genre>;
+auto GetGenreName(uint32_t Id)->std::string_view;
+auto FindGenreId(std::string_view Name)->uint32_t;
+auto ResolveGenre(std::string_view Tcon)->std::string_view;
+auto NormalizeGenre(std::string& Genre)->void;
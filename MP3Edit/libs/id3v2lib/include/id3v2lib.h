@@ -21,14 +21,20 @@ extern "C" {
 #include <id3v2lib/constants.h>
 #include <id3v2lib/frame.h>
 #include <id3v2lib/header.h>
+#include <id3v2lib/padding.h>
 #include <id3v2lib/types.h>
 #include <id3v2lib/utils.h>
 
 
 ID3v2_tag* load_tag(const char* file_name);
 ID3v2_tag* load_tag_with_buffer(char* buffer, int32_t length);
-void       remove_tag(const char* file_name);
+int32_t    remove_tag(const char* file_name);
 void       set_tag(const char* file_name, ID3v2_tag* tag);
+int32_t    set_tag_with_padding_policy(const char*           file_name, 
+                                       ID3v2_tag*            tag, 
+                                       ID3v2_padding_policy* policy);
+int32_t    normalize_tag_padding(const char*           file_name, 
+                                 ID3v2_padding_policy* policy);
 
 
 // Getter functions:
@@ -0,0 +1,86 @@
+/*
+ * This file is part of the id3v2lib library
+ *
+ * Copyright (c) 2013, Lorenzo Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#pragma once
+#ifndef ID3V2LIB_CODEC_H
+#define ID3V2LIB_CODEC_H
+
+
+#include <inttypes.h>
+
+
+// Every integer in an ID3v2 tag is big-endian; the tag size, the size of the 
+// extended header and (in v2.4) frame sizes are also "syncsafe": 28 bits 
+// stored 7 to a byte with the top bit of each byte clear, so that no 0xFF 
+// byte in the header can be mistaken for an MPEG frame sync. 
+// 
+// Everything here is branch-free and header-only. The shift forms are what 
+// compilers turn into a single load and 'bswap' (or 'movbe'), and the masks 
+// are what 'pdep'/'pext' would compute, without tying the library to BMI2. 
+// In C++ the functions are 'constexpr', so sizes can be checked at compile 
+// time; in C they are plain 'static inline'.
+#ifdef __cplusplus
+#define ID3V2_CODEC constexpr inline
+#else
+#define ID3V2_CODEC static inline
+#endif
+
+
+// Big-endian 32-bit integers:
+ID3V2_CODEC uint32_t id3_read_be32(const uint8_t* bytes) {
+	return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16)
+		 | ((uint32_t) bytes[2] <<  8) |  (uint32_t) bytes[3];
+}
+
+ID3V2_CODEC void id3_write_be32(uint8_t* bytes, uint32_t value) {
+	bytes[0] = (uint8_t) (value >> 24);
+	bytes[1] = (uint8_t) (value >> 16);
+	bytes[2] = (uint8_t) (value >>  8);
+	bytes[3] = (uint8_t)  value;
+}
+
+
+// Syncsafe integers, on values already in host order. Encoding keeps the low 
+// 28 bits; decoding ignores the (invalid) top bit of each byte:
+ID3V2_CODEC uint32_t id3_syncsafe_encode(uint32_t value) {
+	return  (value        & 0x0000007Fu)
+		 | ((value << 1)  & 0x00007F00u)
+		 | ((value << 2)  & 0x007F0000u)
+		 | ((value << 3)  & 0x7F000000u);
+}
+
+ID3V2_CODEC uint32_t id3_syncsafe_decode(uint32_t raw) {
+	return  (raw          & 0x0000007Fu)
+		 | ((raw          & 0x00007F00u) >> 1)
+		 | ((raw          & 0x007F0000u) >> 2)
+		 | ((raw          & 0x7F000000u) >> 3);
+}
+
+ID3V2_CODEC int32_t id3_syncsafe_valid(uint32_t raw) {
+	return (raw & 0x80808080u) == 0;
+}
+
+
+// Both steps at once, straight from/to the tag bytes:
+ID3V2_CODEC uint32_t id3_read_syncsafe32(const uint8_t* bytes) {
+	return id3_syncsafe_decode(id3_read_be32(bytes));
+}
+
+ID3V2_CODEC void id3_write_syncsafe32(uint8_t* bytes, uint32_t value) {
+	id3_write_be32(bytes, id3_syncsafe_encode(value));
+}
+
+
+#ifdef __cplusplus
+static_assert(id3_syncsafe_encode(0x0FFFFFFFu) == 0x7F7F7F7Fu, "syncsafe encode");
+static_assert(id3_syncsafe_decode(0x7F7F7F7Fu) == 0x0FFFFFFFu, "syncsafe decode");
+static_assert(id3_syncsafe_decode(id3_syncsafe_encode(257)) == 257, "syncsafe round trip");
+#endif
+
+#endif  // ID3V2LIB_CODEC_H
@@ -65,6 +65,25 @@ extern "C" {
 //  ----  END OF FRAME IDs  ----
 
 
+//  ----  START OF PADDING CONSTANTS  ----
+#define ID3_DEFAULT_PADDING    2048
+#define ID3_DEFAULT_BLOCK_SIZE 4096
+#define ID3_MAX_TAG_SIZE       0x0FFFFFFF
+
+// Padding policy modes:
+#define PADDING_FIXED    0
+#define PADDING_PERCENT  1
+#define PADDING_BLOCK    2
+#define PADDING_ADAPTIVE 3
+
+// Results of writing a tag to a file:
+#define TAG_WRITE_FAILED       0
+#define TAG_WRITE_IN_PLACE     1
+#define TAG_WRITE_REWRITE      2
+#define TAG_WRITE_INSERT_RANGE 3
+//  ----  END OF PADDING CONSTANTS  ----
+
+
 //  ----  START OF APIC FRAME CONSTANTS  ----
 #define ID3_FRAME_PICTURE_TYPE 1
 #define JPG_MIME_TYPE "image/jpeg"
@@ -0,0 +1,41 @@
+/*
+ * This file is part of the id3v2lib library
+ *
+ * Copyright (c) 2013, Lorenzo Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#pragma once
+#ifndef ID3V2LIB_PADDING_H
+#define ID3V2LIB_PADDING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <inttypes.h>
+#include <id3v2lib/constants.h>
+#include <id3v2lib/types.h>
+
+
+// Padding policy functions:
+ID3v2_padding_policy  make_padding_policy(int32_t mode);
+ID3v2_padding_policy* get_default_padding_policy();
+void                  set_default_padding_policy(ID3v2_padding_policy* policy);
+int32_t               get_fs_block_size(const char* file_name);
+int32_t               compute_padding(ID3v2_padding_policy* policy, 
+                                      int32_t               frames_size, 
+                                      const char*           file_name);
+void                  record_padding_edit(ID3v2_padding_policy* policy, 
+                                          int32_t old_frames_size, 
+                                          int32_t new_frames_size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ID3V2LIB_PADDING_H
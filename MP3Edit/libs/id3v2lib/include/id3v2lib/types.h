@@ -69,8 +69,22 @@ typedef struct {
 	char*             raw;
 	ID3v2_header*     tag_header;
 	ID3v2_frame_list* frames;
+	int32_t           used_size; // Bytes occupied by frames when parsed
 } ID3v2_tag;
 
+typedef struct {
+	int32_t mode;           // One of the PADDING_* constants
+	int32_t fixed_size;     // PADDING_FIXED, and PADDING_ADAPTIVE w/o history
+	int32_t percent;        // PADDING_PERCENT: percentage of the frames' size
+	int32_t block_size;     // Alignment for PADDING_BLOCK; 0 = ask the FS
+	int32_t align;          // Non-zero: also block-align the other modes
+	int32_t min_padding;
+	int32_t max_padding;    // 0 = no upper limit
+	int32_t history_count;  // PADDING_ADAPTIVE: number of recorded edits
+	int32_t history_growth; // PADDING_ADAPTIVE: moving average of growth
+	int32_t history_peak;   // PADDING_ADAPTIVE: largest recorded growth
+} ID3v2_padding_policy;
+
 
 // Constructor functions:
 ID3v2_header*                new_header();
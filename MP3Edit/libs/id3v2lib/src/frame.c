@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <id3v2lib/codec.h>
 #include <id3v2lib/constants.h>
 #include <id3v2lib/frame.h>
 #include <id3v2lib/utils.h>
@@ -47,7 +48,8 @@ static inline char* uni2text(unsigned char* binary_buffer, int32_t len) {
 
 
 ID3v2_frame* parse_frame(char* bytes, int32_t offset, int32_t version) {
-	ID3v2_frame* frame = new_frame();
+	ID3v2_frame* frame    = new_frame();
+	uint32_t     raw_size = 0;
 	
 	// Parse the frame header:
 	memcpy(frame->frame_id, bytes + offset, ID3_FRAME_ID);
@@ -58,10 +60,9 @@ ID3v2_frame* parse_frame(char* bytes, int32_t offset, int32_t version) {
 		return NULL;
 	}
 	
-	frame->size = bytes_to_int(bytes, 4, offset += ID3_FRAME_ID);
-	if (version == ID3v24) {
-		frame->size = syncint_decode(frame->size);
-	}
+	raw_size = id3_read_be32((const uint8_t*) bytes + (offset += ID3_FRAME_ID));
+	frame->size = (int32_t) ((version == ID3v24) ? id3_syncsafe_decode(raw_size) 
+												 : raw_size);
 	
 	memcpy(frame->flags, bytes + (offset += ID3_FRAME_SIZE), 2);
 	
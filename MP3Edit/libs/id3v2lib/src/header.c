@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <id3v2lib/codec.h>
 #include <id3v2lib/header.h>
 #include <id3v2lib/utils.h>
 
@@ -30,15 +31,17 @@ int32_t _has_id3v2tag(char* raw_header) {
 }
 
 ID3v2_header* get_tag_header(const char* file_name) {
-	char  buffer[ID3_HEADER];
-	FILE* file = fopen(file_name, "rb");
+	// Room for the size of an extended header as well:
+	char    buffer[ID3_HEADER + ID3_EXTENDED_HEADER_SIZE];
+	int32_t length = 0;
+	FILE*   file   = fopen(file_name, "rb");
 	if (file == NULL) {
 		perror("Error opening file");
 		return NULL;
 	}
-	fread(buffer, ID3_HEADER, 1, file);
+	length = (int32_t) fread(buffer, 1, sizeof(buffer), file);
 	fclose(file);
-	return get_tag_header_with_buffer(buffer, ID3_HEADER);
+	return get_tag_header_with_buffer(buffer, length);
 }
 
 
@@ -55,21 +58,18 @@ ID3v2_header* get_tag_header_with_buffer(char* buffer, int32_t length) {
 	tag_header = new_header();
 	
 	memcpy(tag_header->tag, buffer, ID3_HEADER_TAG);
-	int32_t tmp1 = position += ID3_HEADER_FLAGS;
 	tag_header->major_version = buffer[position += ID3_HEADER_TAG];
 	tag_header->minor_version = buffer[position += ID3_HEADER_VERSION];
 	tag_header->flags         = buffer[position += ID3_HEADER_REVISION];
-	tag_header->tag_size = syncint_decode(bytes_to_int(buffer, 
-													   ID3_HEADER_SIZE, 
-													   tmp1));
+	tag_header->tag_size = (int32_t) id3_read_syncsafe32(
+		(const uint8_t*) buffer + (position += ID3_HEADER_FLAGS));
 	
-	if ((tag_header->flags & (1 << 6)) == (1 << 6)) {
+	if (((tag_header->flags & (1 << 6)) == (1 << 6)) 
+		&& (length >= ID3_HEADER + ID3_EXTENDED_HEADER_SIZE)) {
 		// An extended header exists, so we retrieve the actual size of it and 
 		// save it into the struct:
-		tag_header->extended_header_size 
-			= syncint_decode(bytes_to_int(buffer, 
-										  ID3_EXTENDED_HEADER_SIZE, 
-										  position += ID3_HEADER_SIZE));
+		tag_header->extended_header_size = (int32_t) id3_read_syncsafe32(
+			(const uint8_t*) buffer + (position += ID3_HEADER_SIZE));
 	} else {
 		// No extended header exists:
 		tag_header->extended_header_size = 0;
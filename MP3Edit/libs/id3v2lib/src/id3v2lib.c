@@ -7,10 +7,40 @@
  * file that was distributed with this source code.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#elif !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/falloc.h>
+#endif
 #include <id3v2lib.h>
+#include <id3v2lib/codec.h>
+
+
+#define COPY_BUFFER_SIZE  65536
+#define SHIFT_BUFFER_SIZE 1048576
+
+#ifdef _WIN32
+#define file_seek _fseeki64
+#define file_tell _ftelli64
+#else
+#define file_seek fseeko
+#define file_tell ftello
+#endif
 
 
 ID3v2_tag* load_tag(const char* file_name) {
@@ -108,57 +138,241 @@ ID3v2_tag* load_tag_with_buffer(char* bytes, int32_t length) {
 			break;
 		}
 	}
+	tag->used_size = offset;
 	return tag;
 }
 
 
-void remove_tag(const char* file_name) {
-	int32_t       c;
+static int32_t truncate_file(FILE* file, int64_t size) {
+	if (fflush(file) != 0) {
+		return 0;
+	}
+#ifdef _WIN32
+	return _chsize_s(_fileno(file), size) == 0;
+#else
+	if (ftruncate(fileno(file), (off_t) size) != 0) {
+		perror("Could not truncate file");
+		return 0;
+	}
+	return 1;
+#endif
+}
+
+
+static int64_t get_file_size(FILE* file) {
+	file_seek(file, 0, SEEK_END);
+	return file_tell(file);
+}
+
+
+// Asks the file system to insert 'length' bytes of unwritten space at 'offset' 
+// without moving any data (ext4 and XFS). Both values must be multiples of the 
+// file system block size. Returns 0 if the file system, kernel or platform 
+// cannot do it, in which case the caller has to copy:
+static int32_t insert_range(FILE* file, int64_t offset, int64_t length) {
+#if defined(__linux__) && defined(FALLOC_FL_INSERT_RANGE)
+	fflush(file);
+	if (fallocate(fileno(file), 
+				  FALLOC_FL_INSERT_RANGE, 
+				  (off_t) offset, 
+				  (off_t) length) == 0) {
+		return 1;
+	}
+#else
+	(void) file;
+	(void) offset;
+	(void) length;
+#endif
+	return 0;
+}
+
+
+// The opposite of 'insert_range()': removes 'length' bytes at 'offset' and 
+// closes the gap, which also shrinks the file. The same alignment rules apply, 
+// and the range may not reach the end of the file:
+static int32_t collapse_range(FILE* file, int64_t offset, int64_t length) {
+#if defined(__linux__) && defined(FALLOC_FL_COLLAPSE_RANGE)
+	fflush(file);
+	if (fallocate(fileno(file), 
+				  FALLOC_FL_COLLAPSE_RANGE, 
+				  (off_t) offset, 
+				  (off_t) length) == 0) {
+		return 1;
+	}
+#else
+	(void) file;
+	(void) offset;
+	(void) length;
+#endif
+	return 0;
+}
+
+
+// Moves 'length' bytes from 'from' down to 'to' inside the kernel. The ranges 
+// may not overlap, so the copy advances in steps of at most 'from - to'. 
+// Returns the number of bytes moved; the caller copies whatever is left:
+static int64_t copy_range_down(FILE* file, 
+							   int64_t from, 
+							   int64_t to, 
+							   int64_t length) {
+	int64_t done = 0;
+#if defined(__linux__)
+	loff_t  in_off;
+	loff_t  out_off;
+	ssize_t count;
+	int64_t step = from - to;
+	
+	fflush(file);
+	while (done < length) {
+		in_off  = (loff_t) (from + done);
+		out_off = (loff_t) (to + done);
+		count   = copy_file_range(fileno(file), 
+								  &in_off, 
+								  fileno(file), 
+								  &out_off, 
+								  (size_t) ((length - done < step) 
+											? (length - done) 
+											: step), 
+								  0);
+		if (count <= 0) {
+			break;
+		}
+		done += count;
+	}
+#else
+	(void) file;
+	(void) from;
+	(void) to;
+	(void) length;
+#endif
+	return done;
+}
+
+
+// Moves everything from 'from' to the end of the file so that it starts at 
+// 'to' instead. Growing copies back-to-front through one large buffer so that 
+// nothing is overwritten before it has been read. Shrinking lets the kernel do 
+// the copy when the distance is large enough to make that worthwhile, and 
+// truncates the file to its new length afterwards. Returns 0 if any read, 
+// write or seek falls short, in which case the file is left damaged and the 
+// caller must report the save as failed:
+static int32_t shift_file_contents(FILE* file, int64_t from, int64_t to) {
+	char*   buffer;
+	int64_t length;
+	int64_t done = 0;
+	int64_t src;
+	int64_t dst;
+	size_t  chunk;
+	
+	if (from == to) {
+		return 1;
+	}
+	length = get_file_size(file) - from;
+	if (length < 0) {
+		length = 0;
+	}
+	if ((to < from) && (from - to >= SHIFT_BUFFER_SIZE)) {
+		done = copy_range_down(file, from, to, length);
+	}
+	buffer = (char*) malloc(SHIFT_BUFFER_SIZE);
+	if (buffer == NULL) {
+		perror("Could not allocate buffer");
+		return 0;
+	}
+	
+	while (done < length) {
+		chunk = (length - done < SHIFT_BUFFER_SIZE) 
+				? (size_t) (length - done) 
+				: SHIFT_BUFFER_SIZE;
+		if (to > from) {
+			src = from + length - done - chunk;
+			dst = to + length - done - chunk;
+		} else {
+			src = from + done;
+			dst = to + done;
+		}
+		if ((file_seek(file, src, SEEK_SET) != 0) 
+			|| (fread(buffer, 1, chunk, file) != chunk) 
+			|| (file_seek(file, dst, SEEK_SET) != 0) 
+			|| (fwrite(buffer, 1, chunk, file) != chunk)) {
+			perror("Could not move the audio data");
+			free(buffer);
+			return 0;
+		}
+		done += chunk;
+	}
+	free(buffer);
+	
+	if ((to < from) && !truncate_file(file, to + length)) {
+		return 0;
+	}
+	return fflush(file) == 0;
+}
+
+
+int32_t remove_tag(const char* file_name) {
 	FILE*         file;
-	FILE*         temp_file;
 	ID3v2_header* tag_header;
+	int64_t       tag_size;
+	int64_t       block;
+	int32_t       result = 1;
 	
-	file       = fopen(file_name, "r+b");
-	temp_file  = tmpfile();
 	tag_header = get_tag_header(file_name);
 	if (tag_header == NULL) {
-		return;
+		// Nothing to remove:
+		return 1;
+	}
+	tag_size = (int64_t) tag_header->tag_size + ID3_HEADER;
+	if (tag_header->flags & (1 << 4)) {
+		tag_size += ID3_HEADER;
 	}
+	free(tag_header);
 	
-	fseek(file, tag_header->tag_size + 10, SEEK_SET);
-	while ((c = getc(file)) != EOF) {
-		putc(c, temp_file);
+	file = fopen(file_name, "r+b");
+	if (file == NULL) {
+		perror("Error opening file");
+		return 0;
 	}
 	
-	// Write temp file data back to original file:
-	fseek(temp_file, 0, SEEK_SET);
-	fseek(file,      0, SEEK_SET);
-	while ((c = getc(temp_file)) != EOF) {
-		putc(c, file);
+	// A block-aligned tag (e.g. one written with PADDING_BLOCK) can be cut out 
+	// by the file system without touching the audio data at all; anything 
+	// else has to be shifted down:
+	block = get_fs_block_size(file_name);
+	if ((tag_size % block != 0) || !collapse_range(file, 0, tag_size)) {
+		result = shift_file_contents(file, tag_size, 0);
 	}
+	fclose(file);
+	return result;
 }
 
 
 void write_header(ID3v2_header* tag_header, FILE* file) {
+	uint8_t size[4];
+	id3_write_syncsafe32(size, (uint32_t) tag_header->tag_size);
+	
 	fwrite("ID3",                      3, 1, file);
 	fwrite(&tag_header->major_version, 1, 1, file);
 	fwrite(&tag_header->minor_version, 1, 1, file);
 	fwrite(&tag_header->flags,         1, 1, file);
-	fwrite(int_to_bytes(syncint_encode(tag_header->tag_size)), 4, 1, file);
+	fwrite(size,                       4, 1, file);
 }
 
 
 void write_frame(ID3v2_frame* frame, FILE* file) {
-	fwrite(frame->frame_id, 1, 4, file);
-	fwrite(int_to_bytes(frame->size), 1, 4, file);
-	fwrite(frame->flags, 1, 2, file);
-	fwrite(frame->data, 1, frame->size, file);
+	// 'write_tag()' always writes v2.3, whose frame sizes are not syncsafe:
+	uint8_t size[4];
+	id3_write_be32(size, (uint32_t) frame->size);
+	
+	fwrite(frame->frame_id, 1, 4,           file);
+	fwrite(size,            1, 4,           file);
+	fwrite(frame->flags,    1, 2,           file);
+	fwrite(frame->data,     1, frame->size, file);
 }
 
 
 int32_t get_tag_size(ID3v2_tag* tag) {
 	int32_t           size       = 0;
-	ID3v2_frame_list* frame_list = new_frame_list();
+	ID3v2_frame_list* frame_list = NULL;
 	
 	if (tag->frames == NULL) {
 		return size;
@@ -173,60 +387,162 @@ int32_t get_tag_size(ID3v2_tag* tag) {
 }
 
 
-void set_tag(const char* file_name, ID3v2_tag* tag) {
+static void write_padding(int32_t padding, FILE* file) {
+	char zeros[COPY_BUFFER_SIZE];
+	memset(zeros, 0, sizeof(zeros));
+	while (padding > 0) {
+		int32_t chunk = (padding < (int32_t) sizeof(zeros)) 
+						? padding 
+						: (int32_t) sizeof(zeros);
+		fwrite(zeros, 1, chunk, file);
+		padding -= chunk;
+	}
+}
+
+
+static int32_t write_tag(const char*           file_name, 
+						 ID3v2_tag*            tag, 
+						 ID3v2_padding_policy* policy, 
+						 int32_t               force_rewrite) {
 	ID3v2_frame_list* frame_list;
-	int32_t c;
+	ID3v2_header*     disk_header;
 	FILE*   file;
-	FILE*   temp_file;
-	int32_t i;
-	int32_t padding = 2048;
-	int32_t old_size;
-	
-	if (tag == NULL) {
-		return;
+	int32_t frames_size;
+	int32_t padding;
+	int32_t capacity = 0;
+	int32_t old_size = 0;
+	int32_t new_size;
+	int32_t has_tag  = 0;
+	int32_t result;
+	int32_t failed;
+	int64_t block;
+	int64_t grow;
+	
+	if ((tag == NULL) || (file_name == NULL)) {
+		return TAG_WRITE_FAILED;
+	}
+	
+	// Size the tag that is already in the file (if there is one), including 
+	// the ID3v2.4 footer, since the whole region gets overwritten:
+	disk_header = get_tag_header(file_name);
+	if (disk_header != NULL) {
+		old_size = disk_header->tag_size + ID3_HEADER;
+		if (disk_header->flags & (1 << 4)) {
+			old_size += ID3_HEADER;
+		}
+		capacity = old_size - ID3_HEADER;
+		has_tag  = 1;
+		free(disk_header);
 	}
 	
-	old_size = tag->tag_header->tag_size;
+	frames_size = get_tag_size(tag);
 	
 	// Set the new tag header:
+	free(tag->tag_header);
 	tag->tag_header = new_header();
 	memcpy(tag->tag_header->tag, "ID3", 3);
 	tag->tag_header->major_version = '\x03';
 	tag->tag_header->minor_version = '\x00';
 	tag->tag_header->flags = '\x00';
-	tag->tag_header->tag_size = get_tag_size(tag) + padding;
 	
-	// Create a temporary file and prepare to write to it:
-	file      = fopen(file_name, "r+b");
-	temp_file = tmpfile();
+	file = fopen(file_name, "r+b");
+	if (file == NULL) {
+		perror("Error opening file");
+		return TAG_WRITE_FAILED;
+	}
+	
+	if (!force_rewrite && has_tag && (frames_size <= capacity)) {
+		// The new frames fit inside the existing tag, so overwrite it in place 
+		// and keep the audio data exactly where it is:
+		padding  = capacity - frames_size;
+		new_size = old_size;
+		result   = TAG_WRITE_IN_PLACE;
+	} else {
+		padding  = compute_padding(policy, frames_size, file_name);
+		new_size = ID3_HEADER + frames_size + padding;
+		result   = TAG_WRITE_REWRITE;
+		
+		// When the tag grows, first try to make room by inserting whole blocks 
+		// in front of the old tag; the extra space in the last block becomes 
+		// padding, so the cost is O(tag) instead of O(file):
+		if (!force_rewrite && (new_size > old_size)) {
+			block = ((policy != NULL) && (policy->block_size > 0)) 
+					? policy->block_size 
+					: get_fs_block_size(file_name);
+			grow  = ((new_size - old_size + block - 1) / block) * block;
+			if ((old_size + grow - ID3_HEADER <= ID3_MAX_TAG_SIZE) 
+				&& insert_range(file, 0, grow)) {
+				new_size = old_size + (int32_t) grow;
+				padding  = new_size - ID3_HEADER - frames_size;
+				result   = TAG_WRITE_INSERT_RANGE;
+			}
+		}
+		
+		// Otherwise, stream the audio data to its new position:
+		if ((result == TAG_WRITE_REWRITE) 
+			&& !shift_file_contents(file, old_size, new_size)) {
+			fclose(file);
+			return TAG_WRITE_FAILED;
+		}
+	}
+	tag->tag_header->tag_size = new_size - ID3_HEADER;
 	
-	// Write to file:
-	write_header(tag->tag_header, temp_file);
+	// Write the tag over the space reserved for it at the start of the file:
+	file_seek(file, 0, SEEK_SET);
+	write_header(tag->tag_header, file);
 	frame_list = tag->frames->start;
 	while (frame_list != NULL) {
-		write_frame(frame_list->frame, temp_file);
+		write_frame(frame_list->frame, file);
 		frame_list = frame_list->next;
 	}
-	
-	// Write padding (if necessary):
-	for (i = 0; i < padding; ++i) {
-		putc('\x00', temp_file);
+	write_padding(padding, file);
+	failed = (fflush(file) != 0) || ferror(file);
+	failed = (fclose(file) != 0) || failed;
+	if (failed) {
+		perror("Could not write the tag");
+		return TAG_WRITE_FAILED;
 	}
 	
-	fseek(file, old_size + 10, SEEK_SET);
-	while ((c = getc(file)) != EOF) {
-		putc(c, temp_file);
+	// Only a completed edit is learned from; normalizing the padding is not an 
+	// edit at all:
+	if (!force_rewrite) {
+		record_padding_edit(policy, tag->used_size, frames_size);
 	}
-	
-	// Write the temporary file's data back to the original file:
-	fseek(temp_file, 0, SEEK_SET);
-	fseek(file, 0, SEEK_SET);
-	while ((c = getc(temp_file)) != EOF) {
-		putc(c, file);
+	tag->used_size = frames_size;
+	return result;
+}
+
+
+void set_tag(const char* file_name, ID3v2_tag* tag) {
+	write_tag(file_name, tag, get_default_padding_policy(), 0);
+}
+
+
+int32_t set_tag_with_padding_policy(const char*           file_name, 
+									ID3v2_tag*            tag, 
+									ID3v2_padding_policy* policy) {
+	return write_tag(file_name, tag, policy, 0);
+}
+
+
+int32_t normalize_tag_padding(const char*           file_name, 
+							  ID3v2_padding_policy* policy) {
+	int32_t    result;
+	ID3v2_tag* tag = load_tag(file_name);
+	if (tag == NULL) {
+		return TAG_WRITE_FAILED;
 	}
 	
-	fclose(file);
-	fclose(temp_file);
+	// Only rewrite when the current padding differs from what the policy asks 
+	// for; tags that are already sized correctly are left untouched:
+	if (tag->tag_header->tag_size - tag->used_size 
+		== compute_padding(policy, get_tag_size(tag), file_name)) {
+		free_tag(tag);
+		return TAG_WRITE_IN_PLACE;
+	}
+	result = write_tag(file_name, tag, policy, 1);
+	free_tag(tag);
+	return result;
 }
 
 
@@ -333,9 +649,11 @@ void set_text_frame(char*        data,
 	memcpy(frame->frame_id, frame_id, 4);
 	frame->size = 1 + (int32_t) strlen(data);
 	
-	// Set the frame data:
+	// Set the frame data ('frame_data' has room for the NUL that 'sprintf()' 
+	// appends; replacing the value of an existing frame frees the old one):
 	// TODO: Make the encoding param relevant.
-	frame_data  = (char*) malloc(frame->size * sizeof(char));
+	frame_data  = (char*) malloc((frame->size + 1) * sizeof(char));
+	free(frame->data);
 	frame->data = (char*) malloc(frame->size * sizeof(char));
 	
 	sprintf(frame_data, "%c%s", encoding, data);
@@ -351,7 +669,8 @@ void set_comment_frame(char* data, char encoding, ID3v2_frame* frame) {
 	// For 'frame->size', remember to account for:
 	// encoding + language + description + comment
 	frame->size = 1 + 3 + 1 + (int32_t) strlen(data);
-	frame_data  = (char*) malloc(frame->size * sizeof(char));
+	frame_data  = (char*) malloc((frame->size + 1) * sizeof(char));
+	free(frame->data);
 	frame->data = (char*) malloc(frame->size * sizeof(char));
 	sprintf(frame_data, "%c%s%c%s", encoding, "eng", '\x00', data);
 	memcpy(frame->data, frame_data, frame->size);
@@ -373,9 +692,10 @@ void set_album_cover_frame(char*        album_cover_bytes,
 	frame->size = 1 + (int32_t) strlen(mimetype) + 1 + 1 + 1 + picture_size;
 	
 	frame_data  = (char*) malloc(frame->size * sizeof(char));
+	free(frame->data);
 	frame->data = (char*) malloc(frame->size * sizeof(char));
 	
-	offset = 1ui64 + strlen(mimetype) + 1ui64 + 1ui64 + 1ui64;
+	offset = 1 + strlen(mimetype) + 1 + 1 + 1;
 	sprintf(frame_data, "%c%s%c%c%c", '\x00', mimetype, '\x00', FRONT_COVER, '\x00');
 	memcpy(frame->data, frame_data, offset);
 	memcpy(frame->data + offset, album_cover_bytes, picture_size);
@@ -0,0 +1,156 @@
+/*
+ * This file is part of the id3v2lib library
+ *
+ * Copyright (c) 2013, Lorenzo Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#include <id3v2lib/padding.h>
+
+
+// Policy used by 'set_tag()'; it matches the historical fixed 2048 bytes:
+static ID3v2_padding_policy default_policy = {
+	PADDING_FIXED, ID3_DEFAULT_PADDING, 10, 0, 0, 0, 0, 0, 0, 0
+};
+
+
+ID3v2_padding_policy make_padding_policy(int32_t mode) {
+	ID3v2_padding_policy policy;
+	memset(&policy, 0, sizeof(policy));
+	policy.mode       = mode;
+	policy.fixed_size = ID3_DEFAULT_PADDING;
+	policy.percent    = 10;
+	policy.align      = (mode == PADDING_BLOCK) ? 1 : 0;
+	return policy;
+}
+
+
+ID3v2_padding_policy* get_default_padding_policy() {
+	return &default_policy;
+}
+
+
+void set_default_padding_policy(ID3v2_padding_policy* policy) {
+	if (policy == NULL) {
+		default_policy = make_padding_policy(PADDING_FIXED);
+		return;
+	}
+	default_policy = *policy;
+}
+
+
+int32_t get_fs_block_size(const char* file_name) {
+#ifndef _WIN32
+	struct stat st;
+	if ((file_name != NULL) 
+		&& (stat(file_name, &st) == 0) 
+		&& (st.st_blksize > 0)) {
+		return (int32_t) st.st_blksize;
+	}
+#else
+	(void) file_name;
+#endif
+	// NTFS, ext4 and XFS all default to 4 KiB clusters/blocks:
+	return ID3_DEFAULT_BLOCK_SIZE;
+}
+
+
+int32_t compute_padding(ID3v2_padding_policy* policy, 
+						int32_t               frames_size, 
+						const char*           file_name) {
+	int64_t padding;
+	int64_t block;
+	int64_t total;
+	
+	if (policy == NULL) {
+		policy = &default_policy;
+	}
+	
+	switch (policy->mode) {
+		case PADDING_PERCENT:
+			padding = ((int64_t) frames_size * policy->percent) / 100;
+			break;
+		case PADDING_BLOCK:
+			padding = 0;
+			break;
+		case PADDING_ADAPTIVE:
+			// Leave room for twice the typical growth seen so far, but never
+			// less than the largest single growth that has been recorded:
+			if (policy->history_count == 0) {
+				padding = policy->fixed_size;
+			} else {
+				padding = 2 * (int64_t) policy->history_growth;
+				if (padding < policy->history_peak) {
+					padding = policy->history_peak;
+				}
+			}
+			break;
+		case PADDING_FIXED:
+		default:
+			padding = policy->fixed_size;
+			break;
+	}
+	
+	if (padding < policy->min_padding) {
+		padding = policy->min_padding;
+	}
+	if ((policy->max_padding > 0) && (padding > policy->max_padding)) {
+		padding = policy->max_padding;
+	}
+	if (padding < 0) {
+		padding = 0;
+	}
+	
+	// Round the whole tag (header + frames + padding) up so that the audio
+	// data starts on a file system block boundary:
+	if ((policy->mode == PADDING_BLOCK) || policy->align) {
+		block = (policy->block_size > 0) 
+				? policy->block_size 
+				: get_fs_block_size(file_name);
+		total = ID3_HEADER + (int64_t) frames_size + padding;
+		total = ((total + block - 1) / block) * block;
+		padding = total - ID3_HEADER - frames_size;
+	}
+	
+	if ((int64_t) frames_size + padding > ID3_MAX_TAG_SIZE) {
+		padding = ID3_MAX_TAG_SIZE - (int64_t) frames_size;
+		if (padding < 0) {
+			padding = 0;
+		}
+	}
+	return (int32_t) padding;
+}
+
+
+void record_padding_edit(ID3v2_padding_policy* policy, 
+						 int32_t old_frames_size, 
+						 int32_t new_frames_size) {
+	int32_t growth;
+	if ((policy == NULL) || (old_frames_size <= 0)) {
+		return;
+	}
+	
+	// Only growth matters for sizing padding; shrinking edits count as zero so
+	// that the average decays when a library settles down:
+	growth = new_frames_size - old_frames_size;
+	if (growth < 0) {
+		growth = 0;
+	}
+	if (policy->history_count == 0) {
+		policy->history_growth = growth;
+	} else {
+		policy->history_growth = (3 * policy->history_growth + growth) / 4;
+	}
+	if (growth > policy->history_peak) {
+		policy->history_peak = growth;
+	}
+	++policy->history_count;
+}
@@ -17,6 +17,8 @@ ID3v2_tag* new_tag() {
 	ID3v2_tag* tag  = (ID3v2_tag*) malloc(sizeof(ID3v2_tag));
 	tag->tag_header = new_header();
 	tag->frames     = new_frame_list();
+	tag->raw        = NULL;
+	tag->used_size  = 0;
 	return tag;
 }
 
@@ -28,7 +30,8 @@ ID3v2_header* new_header() {
 		tag_header->minor_version = 0x00;
 		tag_header->major_version = 0x00;
 		tag_header->flags         = 0x00;
-		memset(tag_header->tag, 0, ID3_HEADER_SIZE);
+		tag_header->tag_size      = 0;
+		tag_header->extended_header_size = 0;
 	}
 	return tag_header;
 }
@@ -36,6 +39,10 @@ ID3v2_header* new_header() {
 
 ID3v2_frame* new_frame() {
 	ID3v2_frame* frame = (ID3v2_frame*) malloc(sizeof(ID3v2_frame));
+	if (frame != NULL) {
+		frame->size = 0;
+		frame->data = NULL;
+	}
 	return frame;
 }
 
@@ -10,30 +10,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <id3v2lib/codec.h>
 #include <id3v2lib/utils.h>
 
 
 uint32_t bytes_to_int(char* bytes, int32_t size, int32_t offset) {
-	uint32_t result = 0x00;
-	int32_t  i      =    0;
+	const uint8_t* in     = (const uint8_t*) bytes + offset;
+	uint32_t       result = 0x00;
+	int32_t        i      =    0;
+	if (size == 4) {
+		return id3_read_be32(in);
+	}
 	for (i = 0; i < size; ++i) {
-		result = result << 8;
-		result = result | (unsigned char) bytes[offset + i];
+		result = (result << 8) | in[i];
 	}
 	
 	return result;
 }
 
 
+// Kept for callers of the old API, who own (and must free) the result; the 
+// library itself writes through 'id3_write_be32()' into a local buffer:
 char* int_to_bytes(int32_t integer) {
-	int32_t i;
-	int32_t size   = 4;
-	char*   result = (char*) malloc(sizeof(char) * size);
-	
-	// We need to reverse the bytes because Intel uses little endian:
-	char* aux = (char*) &integer;
-	for (i = size - 1; i >= 0; --i) {
-		result[size - 1 - i] = aux[i];
+	char* result = (char*) malloc(sizeof(char) * 4);
+	if (result != NULL) {
+		id3_write_be32((uint8_t*) result, (uint32_t) integer);
 	}
 	
 	return result;
@@ -41,38 +42,12 @@ char* int_to_bytes(int32_t integer) {
 
 
 int32_t syncint_encode(int32_t value) {
-	int32_t out;
-	int32_t mask = 0x7F;
-	
-	while (mask ^ 0x7FFFFFFF) {
-		out   = value & ~mask;
-		out   <<= 1;
-		out   |= value & mask;
-		mask  = ((mask + 1) << 8) - 1;
-		value = out;
-	}
-	
-	return out;
+	return (int32_t) id3_syncsafe_encode((uint32_t) value);
 }
 
 
 int32_t syncint_decode(int32_t value) {
-	uint32_t a      = 0;
-	uint32_t b      = 0;
-	uint32_t c      = 0;
-	uint32_t d      = 0;
-	uint32_t result = 0x0;
-	a = (value & 0xFF);
-	b = ((value >>  8) & 0xFF);
-	c = ((value >> 16) & 0xFF);
-	d = ((value >> 24) & 0xFF);
-	
-	result = (result | a);
-	result = (result | (b << 7));
-	result = (result | (c << 14));
-	result = (result | (d << 21));
-	
-	return result;
+	return (int32_t) id3_syncsafe_decode((uint32_t) value);
 }
 
 